@@ -0,0 +1,441 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <time.h>
+
+#include "backend/codegen.h"
+#include "backend/pipeline.h"
+#include "frontend/lexer.h"
+#include "frontend/parser.h"
+#include "opt/fold.h"
+#include "workload.h"
+
+typedef struct BenchOptions {
+    const char *preset;
+    WorkloadShape shape;
+    const char *input_path; /* benchmark this file instead of a generated workload */
+    const char *label;
+    unsigned iterations;
+    unsigned threads;
+    int opt_level;
+    int prelex;   /* parse from a pre-lexed token buffer (driver --prelex) */
+    int pipeline; /* overlap parsing and code generation (driver --pipeline) */
+} BenchOptions;
+
+/* Best and mean wall time over the iterations of one stage. */
+typedef struct StageTiming {
+    double best;
+    double total;
+    unsigned runs;
+} StageTiming;
+
+static double now_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+static void timing_record(StageTiming *timing, double seconds) {
+    if (timing->runs == 0 || seconds < timing->best) {
+        timing->best = seconds;
+    }
+    timing->total += seconds;
+    timing->runs += 1;
+}
+
+static double timing_mean(const StageTiming *timing) {
+    return timing->runs ? timing->total / timing->runs : 0.0;
+}
+
+static double per_second(double amount, double seconds) {
+    return seconds > 0.0 ? amount / seconds : 0.0;
+}
+
+/* Lexes the whole source the way the parser will; with `prelex` the buffer's
+ * footprint is stored in `*buffer_bytes`. */
+static size_t lex_all(const char *source, size_t length, int prelex, size_t *buffer_bytes) {
+    Interner *interner = interner_create();
+    Lexer lexer;
+    lexer_init(&lexer, source, length);
+    lexer_set_interner(&lexer, interner); /* same work as the parser's lexer */
+
+    size_t tokens = 0;
+    *buffer_bytes = 0;
+    TokenBuffer buffer;
+    if (prelex && lexer_tokenize(&lexer, &buffer) == 0) {
+        tokens = buffer.count;
+        *buffer_bytes = (size_t)buffer.capacity * (sizeof(*buffer.kinds) + sizeof(*buffer.offsets) +
+                                                   sizeof(*buffer.lengths) + sizeof(*buffer.payloads)) +
+                        (size_t)buffer.value_capacity * sizeof(*buffer.values);
+        token_buffer_free(&buffer);
+        interner_destroy(interner);
+        return tokens;
+    }
+    for (;;) {
+        Token token = lexer_next_token(&lexer);
+        tokens += 1;
+        if (token.kind == TOKEN_EOF) {
+            break;
+        }
+    }
+    interner_destroy(interner);
+    return tokens;
+}
+
+static AstTranslationUnit *parse_all(const char *source, size_t length, int prelex) {
+    Parser parser;
+    parser_init(&parser, source, length);
+    parser.prelex = prelex;
+    AstTranslationUnit *unit = parser_parse_translation_unit(&parser);
+    if (parser_status(&parser) != PARSER_OK) {
+        ast_free(unit);
+        return NULL;
+    }
+    return unit;
+}
+
+/* Lowers `unit` into `sink`; returns the assembly size or -1 on failure. At
+ * -O1 and above the AST is folded first, as the driver does. */
+static long codegen_into(AstTranslationUnit *unit, FILE *sink, unsigned threads, int opt_level) {
+    if (opt_level > 0 && fold_constants(unit, NULL) != 0) {
+        return -1;
+    }
+    CodegenOptions options;
+    codegen_options_init(&options);
+    options.threads = threads;
+    options.opt_level = opt_level;
+    if (codegen_emit_translation_unit_with_options(unit, sink, &options) != 0 || fflush(sink) != 0) {
+        return -1;
+    }
+    return ftell(sink);
+}
+
+/* Parses and lowers in one overlapped pass; returns the assembly size or -1.
+ * `stats` receives the pipeline's node count and largest batch. */
+static long pipeline_into(const char *source,
+                          size_t length,
+                          FILE *sink,
+                          const BenchOptions *bench,
+                          PipelineStats *stats) {
+    Parser parser;
+    parser_init(&parser, source, length);
+    parser.prelex = bench->prelex;
+    CodegenOptions options;
+    codegen_options_init(&options);
+    options.opt_level = bench->opt_level;
+    if (pipeline_compile(&parser, sink, &options, 0, stats) != 0 || fflush(sink) != 0) {
+        return -1;
+    }
+    return ftell(sink);
+}
+
+static int parse_size(const char *text, size_t *value) {
+    char *end = NULL;
+    unsigned long long parsed = strtoull(text, &end, 10);
+    if (*text == '\0' || *end != '\0') {
+        return -1;
+    }
+    *value = (size_t)parsed;
+    return 0;
+}
+
+static void print_usage(FILE *stream) {
+    fprintf(stream,
+            "usage: fungcc_bench [options]\n"
+            "  --preset <name>     workload shape (%s; default mixed)\n"
+            "  --functions <n>     override the number of functions\n"
+            "  --locals <n>        locals declared per function\n"
+            "  --statements <n>    assignments per function\n"
+            "  --chain <n>         operands per +/- expression\n"
+            "  --depth <n>         nested blocks per function\n"
+            "  --comments <n>      comment lines before each statement\n"
+            "  --muldiv <n>        percent of operands scaled by * / %% a constant\n"
+            "  --seed <n>          generator seed\n"
+            "  --input <path>      benchmark an existing source file instead\n"
+            "  --iterations <n>    timed runs per stage (default 5)\n"
+            "  -j <n>              codegen threads (default 1)\n"
+            "  -O <n>              optimisation level; 1 folds and allocates registers\n"
+            "                      inside the codegen stage (default 0)\n"
+            "  --prelex <0|1>      1 lexes the whole file into a token buffer before\n"
+            "                      parsing, as the driver's --prelex (default 0)\n"
+            "  --pipeline <0|1>    1 parses and lowers on two overlapped threads, as the\n"
+            "                      driver's --pipeline; only the compile stage is timed\n"
+            "                      and ast_bytes is the largest batch (default 0)\n"
+            "  --label <text>      free-form tag copied into the report (e.g. a commit id)\n"
+            "Prints one JSON object on stdout.\n",
+            workload_preset_names());
+}
+
+static int parse_arguments(int argc, char **argv, BenchOptions *options) {
+    options->preset = "mixed";
+    options->input_path = NULL;
+    options->label = "";
+    options->iterations = 5;
+    options->threads = 1;
+    options->opt_level = 0;
+    options->prelex = 0;
+    options->pipeline = 0;
+
+    /* The preset is applied first so the individual knobs can refine it. */
+    for (int i = 1; i + 1 < argc; ++i) {
+        if (strcmp(argv[i], "--preset") == 0) {
+            options->preset = argv[i + 1];
+        }
+    }
+    if (workload_preset(options->preset, &options->shape) != 0) {
+        fprintf(stderr, "fungcc_bench: unknown preset '%s'\n", options->preset);
+        return -1;
+    }
+
+    for (int i = 1; i < argc; ++i) {
+        const char *arg = argv[i];
+        if (strcmp(arg, "-h") == 0 || strcmp(arg, "--help") == 0) {
+            print_usage(stdout);
+            exit(0);
+        }
+        if (i + 1 >= argc) {
+            fprintf(stderr, "fungcc_bench: unknown or incomplete option '%s'\n", arg);
+            return -1;
+        }
+
+        const char *value = argv[++i];
+        size_t number = 0;
+        int numeric = parse_size(value, &number) == 0;
+        if (strcmp(arg, "--preset") == 0) {
+            continue;
+        } else if (strcmp(arg, "--input") == 0) {
+            options->input_path = value;
+        } else if (strcmp(arg, "--label") == 0) {
+            options->label = value;
+        } else if (!numeric) {
+            fprintf(stderr, "fungcc_bench: '%s' expects a number, got '%s'\n", arg, value);
+            return -1;
+        } else if (strcmp(arg, "--functions") == 0) {
+            options->shape.functions = number;
+        } else if (strcmp(arg, "--locals") == 0) {
+            options->shape.locals = number;
+        } else if (strcmp(arg, "--statements") == 0) {
+            options->shape.statements = number;
+        } else if (strcmp(arg, "--chain") == 0) {
+            options->shape.chain_length = number;
+        } else if (strcmp(arg, "--depth") == 0) {
+            options->shape.nesting_depth = number;
+        } else if (strcmp(arg, "--comments") == 0) {
+            options->shape.comment_lines = number;
+        } else if (strcmp(arg, "--muldiv") == 0) {
+            options->shape.muldiv_percent = number;
+        } else if (strcmp(arg, "--seed") == 0) {
+            options->shape.seed = (unsigned long)number;
+        } else if (strcmp(arg, "--iterations") == 0 && number > 0) {
+            options->iterations = (unsigned)number;
+        } else if (strcmp(arg, "-j") == 0) {
+            options->threads = (unsigned)number;
+        } else if (strcmp(arg, "-O") == 0) {
+            options->opt_level = (int)number;
+        } else if (strcmp(arg, "--prelex") == 0) {
+            options->prelex = number != 0;
+        } else if (strcmp(arg, "--pipeline") == 0) {
+            options->pipeline = number != 0;
+        } else {
+            fprintf(stderr, "fungcc_bench: unknown option '%s'\n", arg);
+            return -1;
+        }
+    }
+    return 0;
+}
+
+static char *read_input(const char *path, size_t *length) {
+    FILE *file = fopen(path, "rb");
+    if (!file) {
+        perror(path);
+        return NULL;
+    }
+
+    char *data = NULL;
+    long size = -1;
+    if (fseek(file, 0, SEEK_END) == 0 && (size = ftell(file)) >= 0 && fseek(file, 0, SEEK_SET) == 0) {
+        data = malloc((size_t)size + 1);
+    }
+    if (data && fread(data, 1, (size_t)size, file) != (size_t)size) {
+        free(data);
+        data = NULL;
+    }
+    fclose(file);
+    if (!data) {
+        fprintf(stderr, "fungcc_bench: cannot read '%s'\n", path);
+        return NULL;
+    }
+    *length = (size_t)size;
+    return data;
+}
+
+/* Writes `text` as a JSON string literal. */
+static void print_json_string(const char *text) {
+    putchar('"');
+    for (const char *p = text; *p; ++p) {
+        unsigned char c = (unsigned char)*p;
+        if (c == '"' || c == '\\') {
+            printf("\\%c", c);
+        } else if (c < 0x20) {
+            printf("\\u%04x", c);
+        } else {
+            putchar(c);
+        }
+    }
+    putchar('"');
+}
+
+int main(int argc, char **argv) {
+    BenchOptions options;
+    if (parse_arguments(argc, argv, &options) != 0) {
+        print_usage(stderr);
+        return 1;
+    }
+
+    double started = now_seconds();
+
+    size_t length = 0;
+    char *source = options.input_path ? read_input(options.input_path, &length)
+                                      : workload_generate(&options.shape, &length);
+    if (!source) {
+        fputs("fungcc_bench: could not produce the workload\n", stderr);
+        return 1;
+    }
+
+    size_t lines = 0;
+    for (size_t i = 0; i < length; ++i) {
+        lines += source[i] == '\n';
+    }
+
+    StageTiming lex_timing = {0};
+    StageTiming parse_timing = {0};
+    StageTiming codegen_timing = {0};
+    StageTiming total_timing = {0};
+    size_t tokens = 0;
+    size_t token_buffer_bytes = 0;
+    size_t nodes = 0;
+    size_t ast_bytes = 0;
+    long asm_bytes = 0;
+
+    FILE *sink = tmpfile();
+    if (!sink) {
+        perror("tmpfile");
+        free(source);
+        return 1;
+    }
+
+    for (unsigned run = 0; run < options.iterations; ++run) {
+        double t0 = now_seconds();
+        tokens = lex_all(source, length, options.prelex, &token_buffer_bytes);
+        double t1 = now_seconds();
+        if (options.pipeline) {
+            PipelineStats stats;
+            rewind(sink);
+            asm_bytes = pipeline_into(source, length, sink, &options, &stats);
+            double t2 = now_seconds();
+            if (asm_bytes < 0) {
+                fputs("fungcc_bench: workload failed to compile\n", stderr);
+                fclose(sink);
+                free(source);
+                return 1;
+            }
+            nodes = stats.nodes;
+            ast_bytes = stats.largest_ast;
+            timing_record(&lex_timing, t1 - t0);
+            timing_record(&total_timing, t2 - t1);
+            continue;
+        }
+
+        AstTranslationUnit *unit = parse_all(source, length, options.prelex);
+        double t2 = now_seconds();
+        if (!unit) {
+            fputs("fungcc_bench: workload failed to parse\n", stderr);
+            fclose(sink);
+            free(source);
+            return 1;
+        }
+
+        rewind(sink);
+        double t3 = now_seconds();
+        asm_bytes = codegen_into(unit, sink, options.threads, options.opt_level);
+        double t4 = now_seconds();
+        if (asm_bytes < 0) {
+            fputs("fungcc_bench: workload failed to lower\n", stderr);
+            ast_free(unit);
+            fclose(sink);
+            free(source);
+            return 1;
+        }
+
+        nodes = unit->node_count - 1; /* slot 0 is the "no node" placeholder */
+        ast_bytes = ast_memory(unit);
+        ast_free(unit);
+
+        timing_record(&lex_timing, t1 - t0);
+        timing_record(&parse_timing, t2 - t1);
+        timing_record(&codegen_timing, t4 - t3);
+        timing_record(&total_timing, (t2 - t1) + (t4 - t3));
+    }
+    fclose(sink);
+
+    struct rusage usage;
+    long peak_rss_kb = (getrusage(RUSAGE_SELF, &usage) == 0) ? usage.ru_maxrss : -1;
+    double wall = now_seconds() - started;
+
+    printf("{\n  \"label\": ");
+    print_json_string(options.label);
+    printf(",\n  \"workload\": {\"source\": ");
+    print_json_string(options.input_path ? options.input_path : options.preset);
+    if (!options.input_path) {
+        printf(", \"functions\": %zu, \"locals\": %zu, \"statements\": %zu, \"chain\": %zu, "
+               "\"depth\": %zu, \"comments\": %zu, \"muldiv\": %zu, \"seed\": %lu",
+               options.shape.functions,
+               options.shape.locals,
+               options.shape.statements,
+               options.shape.chain_length,
+               options.shape.nesting_depth,
+               options.shape.comment_lines,
+               options.shape.muldiv_percent,
+               options.shape.seed);
+    }
+    printf(", \"bytes\": %zu, \"lines\": %zu},\n", length, lines);
+    printf("  \"iterations\": %u,\n  \"threads\": %u,\n  \"opt_level\": %d,\n  \"prelex\": %d,\n"
+           "  \"pipeline\": %d,\n",
+           options.iterations,
+           options.threads,
+           options.opt_level,
+           options.prelex,
+           options.pipeline);
+    printf("  \"lexer\": {\"tokens\": %zu, \"token_buffer_bytes\": %zu, \"best_seconds\": %.6f, "
+           "\"mean_seconds\": %.6f, \"tokens_per_sec\": %.0f, \"bytes_per_sec\": %.0f},\n",
+           tokens,
+           token_buffer_bytes,
+           lex_timing.best,
+           timing_mean(&lex_timing),
+           per_second((double)tokens, lex_timing.best),
+           per_second((double)length, lex_timing.best));
+    printf("  \"parser\": {\"nodes\": %zu, \"ast_bytes\": %zu, \"best_seconds\": %.6f, \"mean_seconds\": %.6f, "
+           "\"nodes_per_sec\": %.0f},\n",
+           nodes,
+           ast_bytes,
+           parse_timing.best,
+           timing_mean(&parse_timing),
+           per_second((double)nodes, parse_timing.best));
+    printf("  \"codegen\": {\"bytes\": %ld, \"best_seconds\": %.6f, \"mean_seconds\": %.6f, "
+           "\"bytes_per_sec\": %.0f},\n",
+           asm_bytes,
+           codegen_timing.best,
+           timing_mean(&codegen_timing),
+           per_second((double)asm_bytes, codegen_timing.best));
+    printf("  \"compile\": {\"best_seconds\": %.6f, \"mean_seconds\": %.6f, \"bytes_per_sec\": %.0f},\n",
+           total_timing.best,
+           timing_mean(&total_timing),
+           per_second((double)length, total_timing.best));
+    printf("  \"peak_rss_kb\": %ld,\n  \"wall_seconds\": %.6f\n}\n", peak_rss_kb, wall);
+
+    free(source);
+    return 0;
+}
@@ -0,0 +1,60 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "workload.h"
+
+/* Writes a generated workload to stdout (or -o <path>) so it can be fed to
+ * fungcc_driver, e.g. for batch-mode timings. */
+int main(int argc, char **argv) {
+    const char *preset = "mixed";
+    const char *output_path = NULL;
+    unsigned long seed = 0;
+    int have_seed = 0;
+
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "--preset") == 0 && i + 1 < argc) {
+            preset = argv[++i];
+        } else if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc) {
+            seed = strtoul(argv[++i], NULL, 10);
+            have_seed = 1;
+        } else if (strcmp(argv[i], "-o") == 0 && i + 1 < argc) {
+            output_path = argv[++i];
+        } else {
+            fprintf(stderr,
+                    "usage: fungcc_workload [--preset <name>] [--seed <n>] [-o <path>]\n"
+                    "presets: %s\n",
+                    workload_preset_names());
+            return 1;
+        }
+    }
+
+    WorkloadShape shape;
+    if (workload_preset(preset, &shape) != 0) {
+        fprintf(stderr, "fungcc_workload: unknown preset '%s'\n", preset);
+        return 1;
+    }
+    if (have_seed) {
+        shape.seed = seed;
+    }
+
+    size_t length = 0;
+    char *source = workload_generate(&shape, &length);
+    if (!source) {
+        fputs("fungcc_workload: out of memory\n", stderr);
+        return 1;
+    }
+
+    FILE *out = output_path ? fopen(output_path, "w") : stdout;
+    if (!out) {
+        perror(output_path);
+        free(source);
+        return 1;
+    }
+    int status = (fwrite(source, 1, length, out) == length) ? 0 : 1;
+    if (output_path && fclose(out) != 0) {
+        status = 1;
+    }
+    free(source);
+    return status;
+}
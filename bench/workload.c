@@ -0,0 +1,220 @@
+#include "workload.h"
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef struct WorkloadPreset {
+    const char *name;
+    WorkloadShape shape;
+} WorkloadPreset;
+
+/*                 functions  locals  statements  chain  depth  comments  muldiv  seed */
+static const WorkloadPreset presets[] = {
+    {"mixed",     {2000,       8,      16,         8,     4,     1,        0,      1}},
+    {"functions", {50000,      1,      2,          2,     0,     0,        0,      1}},
+    {"chains",    {200,        4,      20,         200,   0,     0,        0,      1}},
+    {"nesting",   {500,        2,      4,          4,     64,    0,        0,      1}},
+    {"locals",    {20,         2000,   50,         4,     0,     0,        0,      1}},
+    {"comments",  {1000,       4,      8,          4,     2,     8,        0,      1}},
+    {"arith",     {2000,       8,      16,         8,     0,     0,        40,     1}},
+    {"small",     {20,         4,      4,          4,     2,     1,        0,      1}},
+};
+
+int workload_preset(const char *name, WorkloadShape *shape) {
+    for (size_t i = 0; i < sizeof(presets) / sizeof(presets[0]); ++i) {
+        if (strcmp(presets[i].name, name) == 0) {
+            *shape = presets[i].shape;
+            return 0;
+        }
+    }
+    return -1;
+}
+
+const char *workload_preset_names(void) {
+    return "mixed, functions, chains, nesting, locals, comments, arith, small";
+}
+
+typedef struct TextBuffer {
+    char *data;
+    size_t length;
+    size_t capacity;
+    int failed;
+} TextBuffer;
+
+static void text_append(TextBuffer *buffer, const char *format, ...) {
+    if (buffer->failed) {
+        return;
+    }
+
+    for (;;) {
+        size_t available = buffer->capacity - buffer->length;
+        va_list args;
+        va_start(args, format);
+        int written = vsnprintf(buffer->data + buffer->length, available, format, args);
+        va_end(args);
+        if (written < 0) {
+            buffer->failed = 1;
+            return;
+        }
+        if ((size_t)written < available) {
+            buffer->length += (size_t)written;
+            return;
+        }
+
+        size_t new_capacity = buffer->capacity * 2 + (size_t)written;
+        char *resized = realloc(buffer->data, new_capacity);
+        if (!resized) {
+            buffer->failed = 1;
+            return;
+        }
+        buffer->data = resized;
+        buffer->capacity = new_capacity;
+    }
+}
+
+/* xorshift64: fixed seeds give byte-identical workloads on every platform. */
+static unsigned long next_random(unsigned long long *state) {
+    unsigned long long x = *state;
+    x ^= x << 13;
+    x ^= x >> 7;
+    x ^= x << 17;
+    *state = x;
+    return (unsigned long)(x >> 16);
+}
+
+static void append_indent(TextBuffer *buffer, size_t depth) {
+    text_append(buffer, "%*s", (int)(4 * (depth + 1)), "");
+}
+
+static void append_comments(TextBuffer *buffer, const WorkloadShape *shape, size_t depth, unsigned long long *rng) {
+    static const char filler[] =
+        "lorem ipsum dolor sit amet consectetur adipiscing elit sed do eiusmod tempor incididunt";
+    for (size_t i = 0; i < shape->comment_lines; ++i) {
+        int width = 24 + (int)(next_random(rng) % 60);
+        append_indent(buffer, depth);
+        if (i % 2 == 0) {
+            text_append(buffer, "// %.*s\n", width, filler);
+        } else {
+            text_append(buffer, "/* %.*s */\n", width, filler);
+        }
+    }
+}
+
+/* Emits one operand: a literal, a visible local, or a global read. */
+static void append_operand(TextBuffer *buffer, size_t visible_locals, unsigned long long *rng) {
+    unsigned long pick = next_random(rng) % 8;
+    if (pick < 4 && visible_locals > 0) {
+        text_append(buffer, "v%lu", next_random(rng) % visible_locals);
+    } else if (pick == 4) {
+        text_append(buffer, "g%lu", next_random(rng) % 16);
+    } else if (pick == 5) {
+        text_append(buffer, "-%lu", next_random(rng) % 1000);
+    } else {
+        text_append(buffer, "%lu", next_random(rng) % 100000);
+    }
+}
+
+/* Emits an operand, scaled by a constant `muldiv_percent` of the time. The
+ * random draw is skipped entirely at 0 so older presets stay byte-identical. */
+static void append_term(TextBuffer *buffer, const WorkloadShape *shape, size_t visible_locals, unsigned long long *rng) {
+    static const unsigned long constants[] = {2, 3, 4, 5, 7, 8, 10, 12, 16, 60, 100, 1000};
+    append_operand(buffer, visible_locals, rng);
+    if (shape->muldiv_percent > 0 && next_random(rng) % 100 < shape->muldiv_percent) {
+        unsigned long pick = next_random(rng);
+        text_append(buffer, " %c %lu", "*/%"[pick % 3], constants[(pick / 3) % (sizeof(constants) / sizeof(constants[0]))]);
+    }
+}
+
+static void append_chain(TextBuffer *buffer, const WorkloadShape *shape, size_t length, size_t visible_locals, unsigned long long *rng) {
+    if (length == 0) {
+        length = 1;
+    }
+    for (size_t i = 0; i < length; ++i) {
+        if (i > 0) {
+            text_append(buffer, (next_random(rng) & 1) ? " + " : " - ");
+        }
+        /* An occasional parenthesised pair keeps the trees from being purely left-leaning. */
+        if (i + 1 < length && next_random(rng) % 8 == 0) {
+            text_append(buffer, "(");
+            append_term(buffer, shape, visible_locals, rng);
+            text_append(buffer, (next_random(rng) & 1) ? " + " : " - ");
+            append_term(buffer, shape, visible_locals, rng);
+            text_append(buffer, ")");
+            i += 1;
+            continue;
+        }
+        append_term(buffer, shape, visible_locals, rng);
+    }
+}
+
+static void append_function(TextBuffer *buffer, const WorkloadShape *shape, size_t index, unsigned long long *rng) {
+    text_append(buffer, "int f%zu() {\n", index);
+
+    for (size_t i = 0; i < shape->locals; ++i) {
+        append_comments(buffer, shape, 0, rng);
+        append_indent(buffer, 0);
+        text_append(buffer, "int v%zu = ", i);
+        append_chain(buffer, shape, shape->chain_length, i, rng);
+        text_append(buffer, ";\n");
+    }
+
+    /* Nested blocks each declare a shadowing local and update an outer one. */
+    for (size_t depth = 0; depth < shape->nesting_depth; ++depth) {
+        append_indent(buffer, depth);
+        text_append(buffer, "{\n");
+        append_comments(buffer, shape, depth + 1, rng);
+        append_indent(buffer, depth + 1);
+        text_append(buffer, "int n%zu = ", depth);
+        append_chain(buffer, shape, shape->chain_length, shape->locals, rng);
+        text_append(buffer, ";\n");
+        if (shape->locals > 0) {
+            append_indent(buffer, depth + 1);
+            text_append(buffer, "v%lu = n%zu + 1;\n", next_random(rng) % shape->locals, depth);
+        }
+    }
+    for (size_t depth = shape->nesting_depth; depth > 0; --depth) {
+        append_indent(buffer, depth - 1);
+        text_append(buffer, "}\n");
+    }
+
+    for (size_t i = 0; i < shape->statements; ++i) {
+        append_comments(buffer, shape, 0, rng);
+        append_indent(buffer, 0);
+        if (shape->locals > 0) {
+            text_append(buffer, "v%lu = ", next_random(rng) % shape->locals);
+        } else {
+            text_append(buffer, "int s%zu = ", i);
+        }
+        append_chain(buffer, shape, shape->chain_length, shape->locals, rng);
+        text_append(buffer, ";\n");
+    }
+
+    append_indent(buffer, 0);
+    text_append(buffer, "return ");
+    append_chain(buffer, shape, shape->chain_length, shape->locals, rng);
+    text_append(buffer, ";\n}\n\n");
+}
+
+char *workload_generate(const WorkloadShape *shape, size_t *length) {
+    TextBuffer buffer = {NULL, 0, 0, 0};
+    buffer.capacity = 64 * 1024;
+    buffer.data = malloc(buffer.capacity);
+    if (!buffer.data) {
+        return NULL;
+    }
+
+    unsigned long long rng = 0x9E3779B97F4A7C15ull ^ (unsigned long long)shape->seed;
+    text_append(&buffer, "/* fungcc synthetic workload, seed %lu */\n", shape->seed);
+    for (size_t i = 0; i < shape->functions; ++i) {
+        append_function(&buffer, shape, i, &rng);
+    }
+
+    if (buffer.failed) {
+        free(buffer.data);
+        return NULL;
+    }
+    *length = buffer.length;
+    return buffer.data;
+}
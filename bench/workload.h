@@ -0,0 +1,29 @@
+#ifndef FUNGCC_BENCH_WORKLOAD_H
+#define FUNGCC_BENCH_WORKLOAD_H
+
+#include <stddef.h>
+
+/* Shape of a synthetic translation unit. Every generated program parses and
+ * lowers cleanly, so the same text can drive each stage of the pipeline. */
+typedef struct WorkloadShape {
+    size_t functions;
+    size_t locals;         /* `int vN = ...;` declarations at the top of each function */
+    size_t statements;     /* assignments per function, after the locals */
+    size_t chain_length;   /* operands in each `+`/`-` expression */
+    size_t nesting_depth;  /* nested `{ ... }` blocks per function */
+    size_t comment_lines;  /* comment lines emitted before each statement */
+    size_t muldiv_percent; /* operands scaled by `* k`, `/ k` or `% k` for a literal k > 0 */
+    unsigned long seed;
+} WorkloadShape;
+
+/* Fills `shape` from a named preset ("mixed", "functions", "chains", "nesting",
+ * "locals", "comments", "arith", "small"). Returns 0 on success, -1 for an unknown name. */
+int workload_preset(const char *name, WorkloadShape *shape);
+
+/* Comma separated list of preset names, for usage messages. */
+const char *workload_preset_names(void);
+
+/* Generates the source text; the caller frees it. Returns NULL when out of memory. */
+char *workload_generate(const WorkloadShape *shape, size_t *length);
+
+#endif /* FUNGCC_BENCH_WORKLOAD_H */
@@ -0,0 +1,72 @@
+#ifndef FUNGCC_BACKEND_CODE_CACHE_H
+#define FUNGCC_BACKEND_CODE_CACHE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "backend/emitter.h"
+#include "frontend/ast.h"
+#include "support/hash.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* A content-addressed directory of per-function code: entries are named by a
+ * hash of the function's AST, the code generation options and the compiler
+ * build, so an entry never has to be invalidated, only missed. Several
+ * processes and threads may use one directory at once: entries are written to
+ * a private temporary file and renamed into place, and a reader that finds a
+ * torn or foreign file treats it as a miss. */
+typedef struct CodeCache {
+    char *directory;
+    Hash128 identity; /* the cache format and the running compiler binary */
+} CodeCache;
+
+typedef struct CodeCacheStats {
+    size_t hits;
+    size_t misses;
+} CodeCacheStats;
+
+/* The identifier expressions a key walked, in walk order. Cached relocations
+ * name their global by position in this list, so a hit can point them back
+ * into the current source text like freshly encoded ones. */
+typedef struct CodeCacheNames {
+    const AstIdentifier **items;
+    size_t count;
+    size_t capacity;
+    int failed;
+} CodeCacheNames;
+
+/* Creates `directory` if needed. Returns 0, or -1 with errno set. */
+int code_cache_open(CodeCache *cache, const char *directory);
+void code_cache_close(CodeCache *cache);
+
+/* Hashes the AST of the unit's `function` together with `variant` (whatever
+ * else changes the code for it) and the cache identity. `buffer` is scratch
+ * space for the serialized tree; `names` is refilled. Returns 0, or -1 on
+ * allocation failure. */
+int code_cache_key(const CodeCache *cache,
+                   const AstTranslationUnit *unit,
+                   AstNodeId function,
+                   uint64_t variant,
+                   Emitter *buffer,
+                   CodeCacheNames *names,
+                   Hash128 *key);
+
+/* Replaces `payload`'s contents with the entry stored under `key`. Returns 0
+ * on a hit, -1 when there is no intact entry. */
+int code_cache_load(const CodeCache *cache, Hash128 key, Emitter *payload);
+
+/* Publishes an entry atomically; a concurrent store of the same key is
+ * harmless since both write the same bytes. Returns 0, or -1 when the entry
+ * could not be written (the cache is best effort, so callers may ignore it). */
+int code_cache_store(const CodeCache *cache, Hash128 key, const void *payload, size_t length);
+
+void code_cache_names_free(CodeCacheNames *names);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* FUNGCC_BACKEND_CODE_CACHE_H */
@@ -3,13 +3,77 @@
 
 #include <stdio.h>
 
+#include "backend/code_cache.h"
+#include "backend/peephole.h"
+#include "backend/x86_encode.h"
 #include "frontend/ast.h"
+#include "ir/ir.h"
+#include "opt/dce.h"
 
 #ifdef __cplusplus
 extern "C" {
 #endif
 
-int codegen_emit_translation_unit(const AstNode *unit, FILE *out);
+typedef enum CodegenFormat {
+    CODEGEN_ASSEMBLY = 0, /* AT&T assembly text */
+    CODEGEN_OBJECT        /* an ELF64 relocatable object, encoded without an assembler */
+} CodegenFormat;
+
+typedef struct CodegenOptions {
+    unsigned threads;  /* functions lowered concurrently; 0 means one per CPU */
+    FILE *diagnostics; /* where error messages go, stderr by default */
+    int opt_level;     /* 0: every local in its own frame slot; 1+: dead code is removed, locals are
+                          SSA values in registers and the instruction stream goes through the
+                          peephole optimizer */
+    int keep_frame_pointer; /* above -O0, still set up %rbp frames (for profilers and debuggers)
+                               instead of addressing locals from %rsp */
+    CodegenFormat format;
+    PeepholeStats *peephole_stats; /* when non-NULL, rule hits are added to it */
+    DceStats *dce_stats;           /* when non-NULL, dead code removal counts are added to it */
+    const CodeCache *cache;        /* when non-NULL, functions whose AST and options match a
+                                      cached entry reuse its code instead of being lowered; the
+                                      peephole and dead code counters then only cover the rest */
+    CodeCacheStats *cache_stats;   /* when non-NULL, cache hits and misses are added to it */
+} CodegenOptions;
+
+void codegen_options_init(CodegenOptions *options);
+
+/* Lowers the unit with default options (single-threaded, -O0). */
+int codegen_emit_translation_unit(const AstTranslationUnit *unit, FILE *out);
+
+/* Functions are lowered into private buffers and written in source order, so the
+ * output is byte-identical for every thread count. */
+int codegen_emit_translation_unit_with_options(const AstTranslationUnit *unit, FILE *out, const CodegenOptions *options);
+
+/* Lowers every function of the unit to machine code appended to `object`,
+ * whatever `options->format` says; used for objects and by the JIT. */
+int codegen_encode_translation_unit(const AstTranslationUnit *unit, X86Object *object, const CodegenOptions *options);
+
+/* Output built up one unit at a time, for callers that parse a file function
+ * by function (see backend/pipeline.h). The bytes are those the whole-unit
+ * calls produce for the concatenated units; functions are lowered on the
+ * calling thread whatever `threads` says. */
+typedef struct CodegenStream CodegenStream;
+
+/* Writes the assembly header; NULL when out of memory. */
+CodegenStream *codegen_stream_open(FILE *out, const CodegenOptions *options);
+
+/* Emits every function of `unit` after those added before. Nothing refers to
+ * the unit afterwards, so it can be freed on return. After a failure further
+ * units are ignored and -1 is returned again. */
+int codegen_stream_add(CodegenStream *stream, const AstTranslationUnit *unit);
+
+/* Finishes the output (the assembly trailer, or the whole ELF object), adds
+ * the counters to the options' stats and releases the stream. Returns -1 if
+ * any step failed. */
+int codegen_stream_close(CodegenStream *stream);
+
+/* Emits one already-lowered function as assembly (no section directives; the
+ * format option is ignored); dead code
+ * elimination is left to the caller. The IR must be acyclic with blocks in
+ * topological order, and a block ending in IR_BRANCH must not target a block
+ * with phis. */
+int codegen_emit_ir_function(const IrFunction *function, FILE *out, const CodegenOptions *options);
 
 #ifdef __cplusplus
 }
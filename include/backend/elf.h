@@ -0,0 +1,24 @@
+#ifndef FUNGCC_BACKEND_ELF_H
+#define FUNGCC_BACKEND_ELF_H
+
+#include <stdio.h>
+
+#include "backend/x86_encode.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Writes `object` as an ELF64 x86-64 relocatable file: `.text`, its
+ * `.rela.text` (R_X86_64_PC32 per RIP-relative global), `.symtab`/`.strtab`
+ * with a global function symbol per function and an undefined symbol per
+ * referenced global, and the empty `.note.GNU-stack` that keeps the stack
+ * non-executable. Returns 0, or -1 on allocation/write failure or when two
+ * functions share a name. */
+int elf_write_object(const X86Object *object, FILE *out);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* FUNGCC_BACKEND_ELF_H */
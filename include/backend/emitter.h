@@ -0,0 +1,94 @@
+#ifndef FUNGCC_BACKEND_EMITTER_H
+#define FUNGCC_BACKEND_EMITTER_H
+
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* General-purpose registers in hardware encoding order. */
+typedef enum X86Reg {
+    X86_RAX = 0,
+    X86_RCX,
+    X86_RDX,
+    X86_RBX,
+    X86_RSP,
+    X86_RBP,
+    X86_RSI,
+    X86_RDI,
+    X86_R8,
+    X86_R9,
+    X86_R10,
+    X86_R11,
+    X86_R12,
+    X86_R13,
+    X86_R14,
+    X86_R15,
+    X86_REG_COUNT
+} X86Reg;
+
+/* Growable text buffer for assembly output. Appends never fail individually:
+ * an allocation or write error latches `failed` and later appends are dropped,
+ * so callers check once via emitter_finish. With a sink, the buffer is written
+ * out in large blocks whenever it passes the flush threshold. */
+typedef struct Emitter {
+    char *data;
+    size_t length;
+    size_t capacity;
+    FILE *sink; /* NULL keeps everything in memory */
+    size_t flush_threshold;
+    size_t bytes_written; /* bytes already handed to the sink */
+    int failed;
+} Emitter;
+
+void emitter_init(Emitter *emitter, FILE *sink);
+void emitter_free(Emitter *emitter);
+
+/* Makes room for `extra` bytes; returns 0 when the buffer can take them. */
+int emitter_reserve_slow(Emitter *emitter, size_t extra);
+
+/* Writes buffered text to the sink (no-op without one). Returns 0 on success. */
+int emitter_flush(Emitter *emitter);
+
+/* Flushes and reports whether every append and write succeeded. */
+int emitter_finish(Emitter *emitter);
+
+void emitter_int(Emitter *emitter, long value);
+void emitter_reg32(Emitter *emitter, X86Reg reg);
+void emitter_reg64(Emitter *emitter, X86Reg reg);
+
+static inline void emitter_view(Emitter *emitter, const char *text, size_t length) {
+    if (emitter->capacity - emitter->length < length && emitter_reserve_slow(emitter, length) != 0) {
+        return;
+    }
+    memcpy(emitter->data + emitter->length, text, length);
+    emitter->length += length;
+}
+
+static inline void emitter_text(Emitter *emitter, const char *text) {
+    emitter_view(emitter, text, strlen(text));
+}
+
+static inline void emitter_char(Emitter *emitter, char c) {
+    if (emitter->length == emitter->capacity && emitter_reserve_slow(emitter, 1) != 0) {
+        return;
+    }
+    emitter->data[emitter->length++] = c;
+}
+
+/* Marks the end of a line and gives the sink a chance to drain. */
+static inline void emitter_newline(Emitter *emitter) {
+    emitter_char(emitter, '\n');
+    if (emitter->sink && emitter->length >= emitter->flush_threshold) {
+        emitter_flush(emitter);
+    }
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* FUNGCC_BACKEND_EMITTER_H */
@@ -0,0 +1,59 @@
+#ifndef FUNGCC_BACKEND_JIT_H
+#define FUNGCC_BACKEND_JIT_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "backend/codegen.h"
+#include "backend/x86_encode.h"
+#include "frontend/ast.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct JitSymbol {
+    const char *name; /* into the module's own name block */
+    uint32_t length;
+    void *address;
+} JitSymbol;
+
+/* Encoded functions mapped into this process. The text is writable only while
+ * it is copied and relocated, then remapped read+execute (W^X); globals the
+ * unit reads but does not define get zeroed 4-byte cells in a separate
+ * read+write page, so `jit_global` can set them before a call. */
+typedef struct JitModule {
+    uint8_t *base;
+    size_t size; /* whole mapping: text pages, then data pages */
+    JitSymbol *functions;
+    size_t function_count;
+    JitSymbol *globals;
+    size_t global_count;
+    char *names;
+} JitModule;
+
+/* Maps `object` and resolves its relocations against its own functions and
+ * the data cells. Names are copied, so the object (and the source it points
+ * into) may be released afterwards. Returns 0, or -1 on allocation or mapping
+ * failure, or on hosts other than x86-64. */
+int jit_load(JitModule *module, const X86Object *object);
+
+/* Lowers and encodes `unit` with `options` (the format is ignored) and loads it. */
+int jit_load_translation_unit(JitModule *module, const AstTranslationUnit *unit, const CodegenOptions *options);
+
+void jit_unload(JitModule *module);
+
+/* Entry point of function `name`, or NULL. */
+void *jit_function(const JitModule *module, const char *name);
+
+/* Cell of global `name`, or NULL when the unit never reads it. */
+int32_t *jit_global(const JitModule *module, const char *name);
+
+/* Calls `main` and stores its return value; -1 when there is no `main`. */
+int jit_run_main(const JitModule *module, int *result);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* FUNGCC_BACKEND_JIT_H */
@@ -0,0 +1,43 @@
+#ifndef FUNGCC_BACKEND_PEEPHOLE_H
+#define FUNGCC_BACKEND_PEEPHOLE_H
+
+#include <stddef.h>
+
+#include "backend/x86.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef enum PeepholeRule {
+    PEEPHOLE_REDUNDANT_MOVE = 0, /* `mov a, a`, or `mov b, a` right after `mov a, b` */
+    PEEPHOLE_STORE_LOAD,         /* a load from the slot just stored reuses the stored register */
+    PEEPHOLE_COPY_FORWARD,       /* `mov x, %t; mov %t, d` with %t dead becomes `mov x, d` */
+    PEEPHOLE_RETARGET,           /* `mov y, %t; add z, %t; mov %t, %d` with %t dead computes into %d */
+    PEEPHOLE_JUMP_TO_NEXT,       /* `jmp L` straight before `L:` */
+    PEEPHOLE_ADD_LEA,            /* `mov %a, %b; add $k, %b` becomes `lea k(%a), %b` */
+    PEEPHOLE_ZERO_XOR,           /* `mov $0, %r` becomes `xor %r, %r` */
+    PEEPHOLE_RULE_COUNT
+} PeepholeRule;
+
+typedef struct PeepholeStats {
+    size_t hits[PEEPHOLE_RULE_COUNT];
+} PeepholeStats;
+
+const char *peephole_rule_name(PeepholeRule rule);
+
+void peephole_stats_add(PeepholeStats *total, const PeepholeStats *stats);
+
+/* Rewrites `code` in place with the rule table until no rule matches, then
+ * drops deleted instructions. Relies on how codegen uses registers: callee-saved
+ * registers hold values across statements, and no caller-saved register is live
+ * across a label or jump except %eax, which carries the return value. `stats`,
+ * when non-NULL, accumulates one hit per rewrite. Returns the number of
+ * instructions removed. */
+size_t peephole_optimize(X86Code *code, PeepholeStats *stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* FUNGCC_BACKEND_PEEPHOLE_H */
@@ -0,0 +1,52 @@
+#ifndef FUNGCC_BACKEND_PIPELINE_H
+#define FUNGCC_BACKEND_PIPELINE_H
+
+#include <stddef.h>
+#include <stdio.h>
+
+#include "backend/codegen.h"
+#include "frontend/parser.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Batches parsed ahead of code generation when the caller passes 0. */
+#define PIPELINE_DEFAULT_DEPTH 16
+
+/* Functions are handed over in batches of about this many AST nodes (a large
+ * function goes alone). Handing over every tiny function by itself cost more in
+ * per-unit setup and thread wake-ups than the overlap saved. */
+#define PIPELINE_BATCH_NODES 4096
+
+typedef struct PipelineStats {
+    size_t functions;
+    size_t batches;       /* units handed to code generation */
+    size_t nodes;         /* summed over the functions */
+    size_t names;
+    size_t literals;
+    size_t largest_ast;   /* ast_memory of the biggest batch */
+    size_t symbols;       /* interned for the whole file */
+    size_t folded;        /* constant operators, at -O1 and above */
+} PipelineStats;
+
+/* Compiles the parser's input with parsing and code generation overlapped:
+ * the calling thread parses, and a second thread folds (at -O1 and above) and
+ * emits functions as soon as their closing braces are seen. At most `depth`
+ * parsed batches wait in between, and each batch's AST is freed once its code
+ * is written, so the memory for ASTs is bounded by a few batches (or the
+ * largest function) rather than the file.
+ *
+ * The output is byte-identical to parsing the whole unit first and calling
+ * codegen_emit_translation_unit_with_options; `options->threads` is ignored.
+ * Code generation diagnostics are held back and written only if the whole
+ * input parsed, as they would have been, and the caller should remove a
+ * partial output file after a failure. Returns 0, or -1 with parser_status()
+ * telling a parse error from a code generation failure. `stats` may be NULL. */
+int pipeline_compile(Parser *parser, FILE *out, const CodegenOptions *options, size_t depth, PipelineStats *stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* FUNGCC_BACKEND_PIPELINE_H */
@@ -0,0 +1,32 @@
+#ifndef FUNGCC_BACKEND_REGALLOC_H
+#define FUNGCC_BACKEND_REGALLOC_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define REGALLOC_SPILLED (-1)
+
+/* Closed range of program points over which a value must be preserved. Points
+ * are numbered by the caller; a value may reuse a register released at the
+ * point where it starts, because operands are read before results are written. */
+typedef struct LiveInterval {
+    uint32_t start;
+    uint32_t end;
+    int reg; /* result: index into the register set, or REGALLOC_SPILLED */
+} LiveInterval;
+
+/* Linear-scan allocation (Poletto & Sarkar) of `register_count` registers.
+ * `intervals` must be sorted by start. When every register is busy the interval
+ * that ends last is spilled, which may evict one already holding a register.
+ * Returns the number of spilled intervals, or -1 on allocation failure. */
+long regalloc_linear_scan(LiveInterval *intervals, size_t count, size_t register_count);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* FUNGCC_BACKEND_REGALLOC_H */
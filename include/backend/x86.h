@@ -0,0 +1,166 @@
+#ifndef FUNGCC_BACKEND_X86_H
+#define FUNGCC_BACKEND_X86_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "backend/emitter.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef enum X86Opcode {
+    X86_NOP = 0, /* deleted by a pass; never printed */
+    X86_MOV,     /* dst = src */
+    X86_ADD,     /* dst += src */
+    X86_SUB,     /* dst -= src */
+    X86_XOR,     /* dst ^= src */
+    X86_AND,     /* dst &= src */
+    X86_IMUL,    /* dst *= src (signed, low half) */
+    X86_SHL,     /* dst <<= src (an immediate count) */
+    X86_SAR,     /* dst >>= src, arithmetic */
+    X86_SHR,     /* dst >>= src, logical */
+    X86_LEA,     /* dst = address of src */
+    X86_MOVSXD,  /* dst (64-bit) = src (32-bit), sign-extended */
+    X86_CDQ,     /* %edx = sign of %eax */
+    X86_IDIV,    /* %eax, %edx = %edx:%eax / src, % src */
+    X86_NEG,     /* dst = -dst */
+    X86_TEST,    /* flags = src & dst */
+    X86_PUSH,    /* push src */
+    X86_POP,     /* pop into dst */
+    X86_JMP,     /* goto src */
+    X86_JNE,     /* goto src unless ZF */
+    X86_LEAVE,
+    X86_RET,
+    X86_LABEL    /* src: */
+} X86Opcode;
+
+typedef enum X86OperandKind {
+    X86_OPERAND_NONE = 0,
+    X86_OPERAND_REG,
+    X86_OPERAND_IMM,
+    X86_OPERAND_MEM,    /* disp(base), or disp(base,index,scale) when scale != 0 */
+    X86_OPERAND_GLOBAL, /* name(%rip) */
+    X86_OPERAND_LABEL   /* a block of the current function, or its return label */
+} X86OperandKind;
+
+/* Label operand naming `.L<function>_return`; any other id prints as `.L<function>_bb<id>`. */
+#define X86_RETURN_LABEL UINT32_MAX
+
+typedef struct X86Operand {
+    uint8_t kind; /* X86OperandKind */
+    uint8_t reg;  /* REG, or the base of MEM */
+    uint8_t index; /* MEM index register, used when `scale` is 1, 2, 4 or 8 */
+    uint8_t scale;
+    uint32_t length; /* GLOBAL name length */
+    union {
+        int64_t imm;
+        int32_t disp;
+        uint32_t label;
+        const char *name; /* GLOBAL: points into the source text */
+    } u;
+} X86Operand;
+
+/* Two-operand AT&T form: `op src, dst`. Single-operand instructions use `dst`
+ * for what they write (neg, pop) and `src` for what they read (push, jumps). */
+typedef struct X86Instr {
+    uint8_t op;    /* X86Opcode */
+    uint8_t width; /* operand size in bytes: 4 or 8 */
+    X86Operand src;
+    X86Operand dst;
+} X86Instr;
+
+/* One function's instructions in emission order. Appends never fail
+ * individually: an allocation failure latches `failed` and later appends are
+ * dropped, like the Emitter. */
+typedef struct X86Code {
+    X86Instr *instrs;
+    size_t count;
+    size_t capacity;
+    int failed;
+} X86Code;
+
+void x86_code_init(X86Code *code);
+void x86_code_free(X86Code *code);
+
+/* Empties the list but keeps its storage for the next function. */
+void x86_code_reset(X86Code *code);
+
+int x86_code_reserve_slow(X86Code *code);
+
+static inline void x86_emit(X86Code *code, X86Opcode op, unsigned width, X86Operand src, X86Operand dst) {
+    if (code->count == code->capacity && x86_code_reserve_slow(code) != 0) {
+        return;
+    }
+    X86Instr *instr = &code->instrs[code->count++];
+    instr->op = (uint8_t)op;
+    instr->width = (uint8_t)width;
+    instr->src = src;
+    instr->dst = dst;
+}
+
+static inline X86Operand x86_none(void) {
+    X86Operand operand = {0};
+    return operand;
+}
+
+static inline X86Operand x86_reg(X86Reg reg) {
+    X86Operand operand = {0};
+    operand.kind = X86_OPERAND_REG;
+    operand.reg = (uint8_t)reg;
+    return operand;
+}
+
+static inline X86Operand x86_imm(int64_t value) {
+    X86Operand operand = {0};
+    operand.kind = X86_OPERAND_IMM;
+    operand.u.imm = value;
+    return operand;
+}
+
+static inline X86Operand x86_mem(X86Reg base, int32_t disp) {
+    X86Operand operand = {0};
+    operand.kind = X86_OPERAND_MEM;
+    operand.reg = (uint8_t)base;
+    operand.u.disp = disp;
+    return operand;
+}
+
+/* disp(base,index,scale) */
+static inline X86Operand x86_mem_index(X86Reg base, X86Reg index, unsigned scale, int32_t disp) {
+    X86Operand operand = x86_mem(base, disp);
+    operand.index = (uint8_t)index;
+    operand.scale = (uint8_t)scale;
+    return operand;
+}
+
+static inline X86Operand x86_global(const char *name, size_t length) {
+    X86Operand operand = {0};
+    operand.kind = X86_OPERAND_GLOBAL;
+    operand.length = (uint32_t)length;
+    operand.u.name = name;
+    return operand;
+}
+
+static inline X86Operand x86_label(uint32_t label) {
+    X86Operand operand = {0};
+    operand.kind = X86_OPERAND_LABEL;
+    operand.u.label = label;
+    return operand;
+}
+
+int x86_operand_equal(const X86Operand *lhs, const X86Operand *rhs);
+
+/* Does the operand read `reg`, as a register or as part of an address? */
+int x86_operand_uses(const X86Operand *operand, X86Reg reg);
+
+/* Prints the instructions as AT&T assembly, one per line; labels are scoped
+ * by `function_name`. */
+void x86_print_code(const X86Code *code, const char *function_name, size_t name_length, Emitter *out);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* FUNGCC_BACKEND_X86_H */
@@ -0,0 +1,73 @@
+#ifndef FUNGCC_BACKEND_X86_ENCODE_H
+#define FUNGCC_BACKEND_X86_ENCODE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "backend/x86.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* A 4-byte RIP-relative field at `offset` in the text that still needs the
+ * address of `name`: the linker stores name + addend - offset (R_X86_64_PC32). */
+typedef struct X86Reloc {
+    uint32_t offset;
+    int32_t addend;
+    const char *name; /* points into the source text, like X86Operand */
+    uint32_t length;
+} X86Reloc;
+
+/* A function defined in the text: `size` bytes starting at `offset`. */
+typedef struct X86Symbol {
+    uint32_t offset;
+    uint32_t size;
+    const char *name;
+    uint32_t length;
+} X86Symbol;
+
+/* Machine code for a sequence of functions laid out back to back, with the
+ * relocations and symbols an object file needs. Appends latch `failed` on
+ * allocation failure, like X86Code. */
+typedef struct X86Object {
+    uint8_t *text;
+    size_t text_length;
+    size_t text_capacity;
+    X86Reloc *relocs;
+    size_t reloc_count;
+    size_t reloc_capacity;
+    X86Symbol *symbols;
+    size_t symbol_count;
+    size_t symbol_capacity;
+    uint32_t *offsets; /* encoder scratch: per instruction, then per label */
+    size_t offset_capacity;
+    uint8_t *sizes;    /* encoder scratch: per instruction */
+    size_t size_capacity;
+    int failed;
+} X86Object;
+
+void x86_object_init(X86Object *object);
+void x86_object_free(X86Object *object);
+
+/* Encodes one function's instructions after whatever the object already
+ * holds and records `name` as a symbol covering them. Jumps use the 2-byte
+ * rel8 form wherever the target is in range. Returns 0, or -1 on allocation
+ * failure or an operand combination x86-64 cannot encode. */
+int x86_encode_function(X86Object *object, const X86Code *code, const char *name, size_t name_length);
+
+/* Appends `source`'s text, relocations and symbols, shifting their offsets. */
+int x86_object_append(X86Object *object, const X86Object *source);
+
+/* Numbers the names an object mentions: its functions take 0..symbol_count-1
+ * in order, then every other name relocated against takes the next number at
+ * its first use. `reloc_targets[i]` receives relocation i's number. Returns the
+ * count of names, or -1 on allocation failure or when two functions share a
+ * name. */
+long x86_object_number_names(const X86Object *object, uint32_t *reloc_targets);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* FUNGCC_BACKEND_X86_ENCODE_H */
@@ -2,13 +2,23 @@
 #define FUNGCC_FRONTEND_AST_H
 
 #include <stddef.h>
+#include <stdint.h>
+
+#include "support/arena.h"
+#include "support/intern.h"
 
 #ifdef __cplusplus
 extern "C" {
 #endif
 
+/* Nodes live in one array per translation unit and refer to each other by
+ * 32-bit index. Slot 0 is never a node, so AST_NODE_NONE marks an absent
+ * child. */
+typedef uint32_t AstNodeId;
+#define AST_NODE_NONE 0u
+
 typedef enum AstNodeKind {
-    AST_TRANSLATION_UNIT = 0,
+    AST_NONE = 0, /* the unused slot 0 */
     AST_FUNCTION_DECL,
     AST_RETURN_STMT,
     AST_NUMBER_LITERAL,
@@ -20,25 +30,24 @@ typedef enum AstNodeKind {
     AST_ASSIGNMENT
 } AstNodeKind;
 
-typedef struct AstNode AstNode;
-
 typedef struct AstIdentifier {
     const char *name;
-    size_t length;
+    uint32_t length;
+    SymbolId symbol; /* compare names by id, never by text */
 } AstIdentifier;
 
 typedef struct AstNumberLiteral {
     const char *lexeme;
-    size_t length;
+    uint32_t length;
+    int64_t value; /* decoded once by the parser (and by folding) */
 } AstNumberLiteral;
 
-typedef struct AstReturnStmt {
-    AstNode *expression;
-} AstReturnStmt;
-
 typedef enum AstBinaryOp {
     AST_BIN_ADD = 0,
-    AST_BIN_SUB
+    AST_BIN_SUB,
+    AST_BIN_MUL,
+    AST_BIN_DIV, /* truncates toward zero, like C */
+    AST_BIN_MOD  /* takes the sign of the dividend */
 } AstBinaryOp;
 
 typedef enum AstUnaryOp {
@@ -46,59 +55,111 @@ typedef enum AstUnaryOp {
     AST_UNARY_MINUS
 } AstUnaryOp;
 
-typedef struct AstUnaryExpr {
-    AstUnaryOp op;
-    AstNode *operand;
-} AstUnaryExpr;
+/* A run of `count` ids in the unit's `children` array. */
+typedef struct AstRange {
+    uint32_t first;
+    uint32_t count;
+} AstRange;
 
 typedef struct AstBinaryExpr {
-    AstBinaryOp op;
-    AstNode *left;
-    AstNode *right;
+    AstNodeId left;
+    AstNodeId right;
 } AstBinaryExpr;
 
-typedef struct AstBlock {
-    AstNode **statements;
-    size_t statement_count;
-} AstBlock;
-
 typedef struct AstVarDecl {
-    AstIdentifier name;
-    AstNode *initializer; /* optional */
+    uint32_t name; /* index into the unit's `names` */
+    AstNodeId initializer; /* optional */
 } AstVarDecl;
 
 typedef struct AstAssignment {
-    AstIdentifier target;
-    AstNode *value;
+    uint32_t target; /* index into `names` */
+    AstNodeId value;
 } AstAssignment;
 
 typedef struct AstFunctionDecl {
-    AstIdentifier name;
-    AstNode *body; /* AST_BLOCK */
+    uint32_t name; /* index into `names` */
+    AstNodeId body; /* AST_BLOCK */
 } AstFunctionDecl;
 
-typedef struct AstTranslationUnit {
-    AstNode **functions;
-    size_t function_count;
-} AstTranslationUnit;
-
+/* 12 bytes whatever the kind: spellings and literal values are kept in
+ * per-kind side arrays, and a block's statements are a range of `children`. */
 typedef struct AstNode {
-    AstNodeKind kind;
+    uint8_t kind; /* AstNodeKind */
+    uint8_t op;   /* AstUnaryOp or AstBinaryOp of an expression */
     union {
-        AstTranslationUnit translation_unit;
         AstFunctionDecl function_decl;
-        AstReturnStmt return_stmt;
-        AstNumberLiteral number_literal;
-        AstIdentifier identifier;
-        AstUnaryExpr unary_expr;
+        AstNodeId return_stmt;    /* the returned expression */
+        uint32_t number_literal;  /* index into `literals` */
+        uint32_t identifier;      /* index into `names` */
+        AstNodeId unary_expr;     /* the operand */
         AstBinaryExpr binary_expr;
-        AstBlock block;
+        AstRange block;           /* the statements */
         AstVarDecl var_decl;
         AstAssignment assignment;
     } value;
 } AstNode;
 
-void ast_free(AstNode *node);
+typedef struct AstTranslationUnit {
+    AstNode *nodes;     /* indexed by AstNodeId */
+    AstNodeId *children; /* every block's statements and the unit's functions */
+    AstIdentifier *names;
+    AstNumberLiteral *literals;
+    uint32_t node_count;
+    uint32_t node_capacity;
+    uint32_t child_count;
+    uint32_t child_capacity;
+    uint32_t name_count;
+    uint32_t name_capacity;
+    uint32_t literal_count;
+    uint32_t literal_capacity;
+    AstRange functions; /* the AST_FUNCTION_DECLs, in source order */
+    Arena *arena;       /* lexemes of folded literals */
+    Interner *interner; /* symbol table for every AstIdentifier in the unit */
+    int owns_interner;  /* 0 when the interner is shared with other units */
+} AstTranslationUnit;
+
+/* An empty unit owning a fresh arena and interner, or NULL. */
+AstTranslationUnit *ast_create(void);
+/* Like ast_create, but symbols come from `interner`, which the caller keeps
+ * alive and frees after the unit: the units of a streamed file share one. */
+AstTranslationUnit *ast_create_shared(Interner *interner);
+void ast_free(AstTranslationUnit *unit);
+
+/* Appenders return AST_NODE_NONE / -1 when out of memory or past 2^32 - 1
+ * entries. They may move the arrays, so hold ids rather than pointers across
+ * them. */
+AstNodeId ast_add_node(AstTranslationUnit *unit, AstNodeKind kind);
+int ast_add_name(AstTranslationUnit *unit, AstIdentifier name, uint32_t *index);
+int ast_add_literal(AstTranslationUnit *unit, AstNumberLiteral literal, uint32_t *index);
+/* Copies `count` ids to the end of `children`. */
+int ast_add_children(AstTranslationUnit *unit, const AstNodeId *ids, uint32_t count, AstRange *range);
+
+/* Gives back the slack of the doubling growth once the unit is complete. */
+void ast_shrink(AstTranslationUnit *unit);
+
+/* Bytes reserved by the node, child, name and literal arrays and the arena. */
+size_t ast_memory(const AstTranslationUnit *unit);
+
+static inline const AstNode *ast_node(const AstTranslationUnit *unit, AstNodeId id) {
+    return &unit->nodes[id];
+}
+
+static inline const AstNodeId *ast_children(const AstTranslationUnit *unit, AstRange range) {
+    return unit->children + range.first;
+}
+
+static inline const AstIdentifier *ast_name(const AstTranslationUnit *unit, uint32_t index) {
+    return &unit->names[index];
+}
+
+static inline const AstNumberLiteral *ast_literal(const AstTranslationUnit *unit, uint32_t index) {
+    return &unit->literals[index];
+}
+
+/* The unit's `index`th function declaration. */
+static inline AstNodeId ast_function(const AstTranslationUnit *unit, uint32_t index) {
+    return unit->children[unit->functions.first + index];
+}
 
 #ifdef __cplusplus
 }
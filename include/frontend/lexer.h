@@ -2,6 +2,7 @@
 #define FUNGCC_FRONTEND_LEXER_H
 
 #include <stddef.h>
+#include <stdint.h>
 
 #include "frontend/token.h"
 
@@ -15,12 +16,48 @@ typedef struct Lexer {
     size_t index;
     size_t line;
     size_t column;
+    Interner *interner; /* optional; identifiers get SYMBOL_NONE without one */
 } Lexer;
 
+/* A whole file lexed up front, one entry per token in parallel arrays: 13
+ * bytes a token against a 48-byte Token, and the parser's lookahead is an
+ * index. Line and column are not stored; token_buffer_position recomputes
+ * them for the rare diagnostic. The last token is TOKEN_EOF. */
+typedef struct TokenBuffer {
+    const char *source;
+    uint8_t *kinds;     /* TokenKind */
+    uint32_t *offsets;  /* lexeme start in `source` */
+    uint32_t *lengths;
+    uint32_t *payloads; /* SymbolId of an identifier, index into `values` of a number */
+    int64_t *values;    /* decoded number literals, in source order */
+    uint32_t count;
+    uint32_t capacity;
+    uint32_t value_count;
+    uint32_t value_capacity;
+} TokenBuffer;
+
+/* Payload of a number token whose lexeme is not a decimal integer. */
+#define TOKEN_NO_VALUE UINT32_MAX
+
 void lexer_init(Lexer *lexer, const char *source, size_t length);
+void lexer_set_interner(Lexer *lexer, Interner *interner);
 Token lexer_peek_token(const Lexer *lexer);
 Token lexer_next_token(Lexer *lexer);
 
+/* Lexes everything from the lexer's position to the end into `tokens`.
+ * Returns 0, or -1 on allocation failure or a source too large for 32-bit
+ * offsets (the caller can still stream tokens one by one). */
+int lexer_tokenize(Lexer *lexer, TokenBuffer *tokens);
+void token_buffer_free(TokenBuffer *tokens);
+
+/* Line and column of token `index`, counted like the lexer does. */
+void token_buffer_position(const TokenBuffer *tokens, uint32_t index, size_t *line, size_t *column);
+
+/* Value of a decimal literal, wrapped modulo 2^64 like the 32-bit folding
+ * that truncates it later. Returns -1 when the lexeme is not an integer
+ * (such as "1.5"). */
+int lexer_number_value(const char *lexeme, size_t length, int64_t *value);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,45 @@
+#ifndef FUNGCC_FRONTEND_LEXER_SCAN_H
+#define FUNGCC_FRONTEND_LEXER_SCAN_H
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef enum ScanIsa {
+    SCAN_ISA_SCALAR = 0,
+    SCAN_ISA_SSE2,
+    SCAN_ISA_AVX2
+} ScanIsa;
+
+/* Line bookkeeping for a bulk scan: `newlines` is incremented by the number of
+ * '\n' bytes crossed and `last_newline` receives the index of the last one. */
+typedef struct ScanLines {
+    size_t newlines;
+    size_t last_newline;
+} ScanLines;
+
+/* Returns the index of the first byte at or after `index` that is not a space,
+ * tab, carriage return or newline (or `length`). */
+size_t scan_skip_blanks(const char *text, size_t index, size_t length, ScanLines *lines);
+
+/* `index` points just past an opening slash-star. Returns the index just past the
+ * closing star-slash, or `length` when the comment is unterminated. */
+size_t scan_skip_block_comment(const char *text, size_t index, size_t length, ScanLines *lines);
+
+/* Returns the index of the next '\n' at or after `index` (or `length`). */
+size_t scan_find_newline(const char *text, size_t index, size_t length);
+
+/* The widest instruction set the running CPU supports, chosen on first use. */
+ScanIsa scan_active_isa(void);
+
+/* Forces a narrower implementation (tests and benchmarks); requests wider than
+ * the CPU supports are clamped. Returns the ISA now in use. */
+ScanIsa scan_force_isa(ScanIsa isa);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* FUNGCC_FRONTEND_LEXER_SCAN_H */
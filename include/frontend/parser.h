@@ -4,6 +4,8 @@
 #include "frontend/ast.h"
 #include "frontend/lexer.h"
 
+#include <stdio.h>
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -15,12 +17,39 @@ typedef enum ParserStatus {
 
 typedef struct Parser {
     Lexer lexer;
-    Token current;
+    int prelex;          /* lex the whole file into `tokens` before parsing;
+                            0 (the default) pulls tokens one at a time */
+    TokenKind kind;      /* the current token's kind, in either mode */
+    Token current;       /* the current token when streaming */
+    TokenBuffer tokens;  /* the pre-lexed file, released when parsing ends */
+    uint32_t position;   /* index of the current token in `tokens` */
     ParserStatus status;
+    AstTranslationUnit *unit; /* being built; returned to the caller or handed to the sink */
+    AstNodeId *pending;       /* statements of the blocks still open */
+    uint32_t pending_count;
+    uint32_t pending_capacity;
+    FILE *diagnostics;  /* error messages, stderr unless the caller redirects it */
 } Parser;
 
+/* Receives a unit of one or more whole parsed functions and takes ownership of
+ * it. A non-zero return stops parsing. */
+typedef int (*ParserFunctionSink)(void *context, AstTranslationUnit *functions);
+
 void parser_init(Parser *parser, const char *source, size_t length);
-AstNode *parser_parse_translation_unit(Parser *parser);
+AstTranslationUnit *parser_parse_translation_unit(Parser *parser);
+
+/* Streaming alternative: hands functions to `sink` as soon as their closing
+ * braces are parsed, so the parser never holds more than one batch of AST.
+ * Consecutive functions share a unit until it reaches `batch_nodes` nodes,
+ * which keeps tiny functions from paying a unit each; 0 hands every function
+ * over alone. All the units share `interner`, which must outlive them. Returns
+ * 0, or -1 after a parse error (the batch holding the error is not handed
+ * over). */
+int parser_parse_functions(Parser *parser,
+                           Interner *interner,
+                           uint32_t batch_nodes,
+                           ParserFunctionSink sink,
+                           void *context);
 ParserStatus parser_status(const Parser *parser);
 
 #ifdef __cplusplus
@@ -3,6 +3,8 @@
 
 #include <stddef.h>
 
+#include "support/intern.h"
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -29,6 +31,7 @@ typedef enum TokenKind {
     TOKEN_PLUS,
     TOKEN_MINUS,
     TOKEN_SLASH,
+    TOKEN_PERCENT,
     TOKEN_EQUAL,
     TOKEN_EQUAL_EQUAL,
 
@@ -41,6 +44,7 @@ typedef struct Token {
     size_t length;
     size_t line;
     size_t column;
+    SymbolId symbol; /* interned name for TOKEN_IDENTIFIER, SYMBOL_NONE otherwise */
 } Token;
 
 #ifdef __cplusplus
@@ -0,0 +1,149 @@
+#ifndef FUNGCC_IR_IR_H
+#define FUNGCC_IR_IR_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "support/arena.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Virtual register number. Every value is defined exactly once (SSA). */
+typedef uint32_t IrValue;
+
+#define IR_NO_VALUE UINT32_MAX
+#define IR_NO_VAR UINT32_MAX
+
+typedef enum IrOp {
+    IR_CONST = 0,  /* dest = imm */
+    IR_GLOBAL,     /* dest = 32-bit load of the global `name` */
+    IR_ADD,        /* dest = args[0] + args[1] */
+    IR_SUB,        /* dest = args[0] - args[1] */
+    IR_MUL,        /* dest = args[0] * args[1] */
+    IR_DIV,        /* dest = args[0] / args[1], truncated toward zero */
+    IR_MOD,        /* dest = args[0] % args[1] */
+    IR_NEG,        /* dest = -args[0] */
+    IR_PHI,        /* dest = phi_args[i] when control arrived from preds[i] */
+    IR_LOAD_SLOT,  /* dest = frame slot `slot` */
+    IR_STORE_SLOT, /* frame slot `slot` = args[0] */
+    IR_JUMP,       /* goto targets[0] */
+    IR_BRANCH,     /* goto args[0] != 0 ? targets[0] : targets[1] */
+    IR_RET         /* return args[0]; IR_NO_VALUE when falling off the end */
+} IrOp;
+
+typedef struct IrInstr {
+    IrOp op;
+    IrValue dest; /* IR_NO_VALUE for stores and terminators */
+    IrValue args[2];
+    union {
+        int64_t imm;
+        uint32_t slot;
+        uint32_t targets[2]; /* block ids */
+        struct {
+            const char *name; /* points into the source text */
+            size_t length;
+        } global;
+        IrValue *phi_args; /* one per predecessor of the block, same order */
+    } u;
+} IrInstr;
+
+/* Straight-line instructions ending in one terminator (IR_JUMP, IR_BRANCH or
+ * IR_RET). Phis are kept apart so they can be added after the block is filled. */
+typedef struct IrBlock {
+    uint32_t id;
+    IrInstr *phis;
+    size_t phi_count;
+    size_t phi_capacity;
+    IrInstr *instrs;
+    size_t count;
+    size_t capacity;
+    uint32_t *preds;
+    size_t pred_count;
+    size_t pred_capacity;
+} IrBlock;
+
+/* Source-level variable, only used to name values in dumps and diagnostics. */
+typedef struct IrVariable {
+    const char *name;
+    size_t length;
+} IrVariable;
+
+/* One function in SSA form. Everything hangs off `arena`, so the function is
+ * released by destroying the arena. Block 0 is the entry. */
+typedef struct IrFunction {
+    const char *name;
+    size_t name_length;
+    Arena *arena;
+    IrBlock **blocks;
+    size_t block_count;
+    size_t block_capacity;
+    uint32_t value_count;
+    uint32_t *value_vars; /* per value: the variable it was assigned to, or IR_NO_VAR */
+    size_t value_capacity;
+    IrVariable *vars;
+    uint32_t var_count;
+    size_t var_capacity;
+    uint32_t slot_count; /* frame slots used by IR_LOAD_SLOT/IR_STORE_SLOT */
+} IrFunction;
+
+/* Appends instructions at the end of `block` and tracks the current
+ * definition of each variable per block (Braun et al.'s SSA construction).
+ * Any allocation failure latches `failed`; builders then return IR_NO_VALUE. */
+typedef struct IrBuilder {
+    IrFunction *function;
+    IrBlock *block;
+    uint64_t *def_keys; /* (block << 32 | var) + 1, 0 when empty */
+    IrValue *def_values;
+    size_t def_mask;
+    size_t def_count;
+    int failed;
+} IrBuilder;
+
+IrFunction *ir_function_create(Arena *arena, const char *name, size_t name_length);
+IrBlock *ir_block_create(IrFunction *function);
+uint32_t ir_slot_create(IrFunction *function);
+
+/* Starts building `function` at its entry block (created if missing). */
+int ir_builder_init(IrBuilder *builder, IrFunction *function);
+void ir_builder_free(IrBuilder *builder);
+void ir_builder_set_block(IrBuilder *builder, IrBlock *block);
+
+/* Returns 1 once the current block has its terminator. */
+int ir_block_terminated(const IrBlock *block);
+
+IrValue ir_build_const(IrBuilder *builder, int64_t value);
+IrValue ir_build_global(IrBuilder *builder, const char *name, size_t length);
+IrValue ir_build_binary(IrBuilder *builder, IrOp op, IrValue left, IrValue right);
+IrValue ir_build_neg(IrBuilder *builder, IrValue operand);
+IrValue ir_build_load_slot(IrBuilder *builder, uint32_t slot);
+void ir_build_store_slot(IrBuilder *builder, uint32_t slot, IrValue value);
+void ir_build_jump(IrBuilder *builder, IrBlock *target);
+void ir_build_branch(IrBuilder *builder, IrValue condition, IrBlock *if_true, IrBlock *if_false);
+void ir_build_ret(IrBuilder *builder, IrValue value);
+
+/* Variables are renamed into SSA values as they are written: a read finds the
+ * reaching definition through the predecessors and places phis at joins. The
+ * IR has no loops, so a block must have all of its predecessors before a
+ * variable is read in it. Reading a variable with no reaching assignment
+ * latches `failed`. */
+uint32_t ir_variable_create(IrBuilder *builder, const char *name, size_t length);
+void ir_write_variable(IrBuilder *builder, uint32_t var, IrValue value);
+IrValue ir_read_variable(IrBuilder *builder, uint32_t var);
+
+const char *ir_op_name(IrOp op);
+
+/* Prints the function as text, one instruction per line, e.g.
+ *   bb0:
+ *     %0 = const 1  ; x
+ *     ret %0
+ * Values assigned to a variable carry its name as a comment. */
+void ir_dump_function(const IrFunction *function, FILE *out);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* FUNGCC_IR_IR_H */
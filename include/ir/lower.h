@@ -0,0 +1,31 @@
+#ifndef FUNGCC_IR_LOWER_H
+#define FUNGCC_IR_LOWER_H
+
+#include "backend/emitter.h"
+#include "frontend/ast.h"
+#include "ir/ir.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef enum IrLocalMode {
+    IR_LOCALS_IN_SLOTS = 0, /* each local is a frame slot read and written with load/store (-O0) */
+    IR_LOCALS_AS_VALUES     /* locals are renamed into SSA values (-O1) */
+} IrLocalMode;
+
+/* Lowers the unit's AST_FUNCTION_DECL `function` into an IrFunction allocated
+ * from `arena`. Statements after a `return` are checked but produce no IR.
+ * Source errors go to `diag` as "Codegen error: ..." lines; returns NULL on any
+ * failure. */
+IrFunction *ir_lower_function(const AstTranslationUnit *unit,
+                              AstNodeId function,
+                              Arena *arena,
+                              IrLocalMode mode,
+                              Emitter *diag);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* FUNGCC_IR_LOWER_H */
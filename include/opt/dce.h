@@ -0,0 +1,32 @@
+#ifndef FUNGCC_OPT_DCE_H
+#define FUNGCC_OPT_DCE_H
+
+#include <stddef.h>
+
+#include "ir/ir.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct DceStats {
+    size_t instructions; /* instructions and phis removed */
+    size_t slots;        /* frame slots no longer referenced */
+} DceStats;
+
+/* Removes what cannot affect a function's result: blocks unreachable from the
+ * entry are cut down to a bare `ret`, values that no live instruction reads
+ * are deleted, and so are stores to a frame slot that is never loaded again
+ * (overwritten first, or the function returns first). Slots left without any
+ * load or store are dropped and the remaining ones renumbered, shrinking
+ * `slot_count`. Loads have no side effects here: globals are plain ints and
+ * nothing else can observe the frame. Scratch memory comes from the function's
+ * arena. Returns 0, or -1 when the arena is exhausted, in which case the
+ * function is left unchanged. `stats`, when non-NULL, accumulates counts. */
+int eliminate_dead_code(IrFunction *function, DceStats *stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* FUNGCC_OPT_DCE_H */
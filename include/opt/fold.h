@@ -0,0 +1,34 @@
+#ifndef FUNGCC_OPT_FOLD_H
+#define FUNGCC_OPT_FOLD_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "frontend/ast.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Replaces every unary/binary expression whose operands are all literals with a
+ * single AST_NUMBER_LITERAL, evaluated with 32-bit two's complement wraparound
+ * (the width codegen computes in). Folded nodes are rewritten in place to
+ * refer to new entries of the unit's `literals`, whose lexemes live in its
+ * arena; a folded negative value keeps its sign in the lexeme ("-2"). Returns 0
+ * on success, -1 if memory runs out (the tree stays valid, just partially
+ * folded). `folded`, when non-NULL, receives
+ * the number of operator nodes removed. */
+int fold_constants(AstTranslationUnit *unit, size_t *folded);
+
+/* `lhs op rhs` with the wraparound above; INT32_MIN / -1 wraps to INT32_MIN.
+ * Returns -1, leaving `value` alone, for a division or modulo by zero. */
+int fold_binary(AstBinaryOp op, int32_t lhs, int32_t rhs, int32_t *value);
+
+/* Value of a literal truncated to 32 bits, as codegen would load it. */
+int32_t fold_literal_value(const AstNumberLiteral *literal);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* FUNGCC_OPT_FOLD_H */
@@ -0,0 +1,45 @@
+#ifndef FUNGCC_SUPPORT_ARENA_H
+#define FUNGCC_SUPPORT_ARENA_H
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct ArenaChunk ArenaChunk;
+
+typedef struct ArenaStats {
+    size_t allocations;     /* arena_alloc/arena_grow requests served */
+    size_t bytes_requested; /* sum of requested sizes */
+    size_t bytes_reserved;  /* sum of chunk capacities obtained from the heap */
+    size_t chunk_count;     /* heap allocations performed by the arena */
+} ArenaStats;
+
+/* Bump allocator: memory is handed out linearly from large chunks and is only
+ * released all at once by arena_destroy. Returned memory is zero-initialised. */
+typedef struct Arena {
+    ArenaChunk *head;
+    char *cursor;
+    char *limit;
+    void *last; /* most recent allocation, the only one arena_grow can extend in place */
+    size_t chunk_size;
+    ArenaStats stats;
+} Arena;
+
+Arena *arena_create(size_t chunk_size);
+void arena_destroy(Arena *arena);
+void *arena_alloc(Arena *arena, size_t size);
+void *arena_grow(Arena *arena, void *ptr, size_t old_size, size_t new_size);
+
+/* Releases every allocation at once but keeps the newest chunk, zeroed again,
+ * so an arena reused for a series of short-lived jobs stops calling malloc.
+ * The counters restart from that chunk. */
+void arena_reset(Arena *arena);
+ArenaStats arena_stats(const Arena *arena);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* FUNGCC_SUPPORT_ARENA_H */
@@ -0,0 +1,24 @@
+#ifndef FUNGCC_SUPPORT_HASH_H
+#define FUNGCC_SUPPORT_HASH_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct Hash128 {
+    uint64_t low;
+    uint64_t high;
+} Hash128;
+
+/* MurmurHash3, x64 128-bit variant: well mixed and fast, but not
+ * cryptographic, so it names content rather than authenticating it. */
+Hash128 hash128(const void *data, size_t length, uint64_t seed);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* FUNGCC_SUPPORT_HASH_H */
@@ -0,0 +1,45 @@
+#ifndef FUNGCC_SUPPORT_INTERN_H
+#define FUNGCC_SUPPORT_INTERN_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Dense, non-zero identifier handle; equal names share the same id. */
+typedef uint32_t SymbolId;
+
+#define SYMBOL_NONE ((SymbolId)0)
+
+typedef struct InternEntry {
+    const char *text; /* view into the source, not a copy */
+    uint32_t length;
+    uint32_t hash;
+} InternEntry;
+
+/* Open-addressing table from name to SymbolId. Strings are not copied, so the
+ * source buffer must outlive the interner. */
+typedef struct Interner {
+    InternEntry *entries; /* indexed by SymbolId; entry 0 is unused */
+    uint32_t count;       /* number of symbols, ids run from 1 to count */
+    uint32_t entry_capacity;
+    SymbolId *slots;
+    uint32_t slot_mask;
+} Interner;
+
+Interner *interner_create(void);
+void interner_destroy(Interner *interner);
+
+/* Returns the id for `text`, adding it on first sight; SYMBOL_NONE on allocation failure. */
+SymbolId interner_intern(Interner *interner, const char *text, size_t length);
+
+/* Looks up an id; returns NULL for unknown ids. */
+const char *interner_text(const Interner *interner, SymbolId symbol, size_t *length);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* FUNGCC_SUPPORT_INTERN_H */
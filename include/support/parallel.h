@@ -0,0 +1,34 @@
+#ifndef FUNGCC_SUPPORT_PARALLEL_H
+#define FUNGCC_SUPPORT_PARALLEL_H
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef void (*ParallelTaskFn)(void *context, size_t index);
+
+/* Runs fn(context, i) for every i in [0, count) on up to `threads` threads (the
+ * caller counts as one). The index space is split evenly between per-worker
+ * queues and idle workers steal from busy ones, so uneven task sizes balance
+ * out; completion order is unspecified. If worker threads cannot be started the
+ * remaining work runs on the calling thread. */
+void parallel_for(size_t count, unsigned threads, ParallelTaskFn fn, void *context);
+
+typedef void (*ParallelWorkerFn)(void *context, unsigned worker, size_t index);
+
+/* Like parallel_for, but also passes the index of the thread running the task,
+ * in [0, parallel_worker_count(count, threads)), so callers can keep
+ * per-thread state without locking. */
+void parallel_for_workers(size_t count, unsigned threads, ParallelWorkerFn fn, void *context);
+unsigned parallel_worker_count(size_t count, unsigned threads);
+
+/* Number of online CPUs, at least 1. */
+unsigned parallel_default_threads(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* FUNGCC_SUPPORT_PARALLEL_H */
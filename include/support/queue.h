@@ -0,0 +1,45 @@
+#ifndef FUNGCC_SUPPORT_QUEUE_H
+#define FUNGCC_SUPPORT_QUEUE_H
+
+#include <pthread.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* A fixed-capacity FIFO of pointers between threads. Producers block while it
+ * is full and consumers while it is empty, so a fast producer cannot run
+ * further ahead than `capacity` items. */
+typedef struct BoundedQueue {
+    pthread_mutex_t lock;
+    pthread_cond_t not_empty;
+    pthread_cond_t not_full;
+    void **items;
+    size_t capacity;
+    size_t head; /* next item to pop */
+    size_t count;
+    int closed;
+} BoundedQueue;
+
+/* Returns 0, or -1 when out of memory. */
+int bounded_queue_init(BoundedQueue *queue, size_t capacity);
+void bounded_queue_destroy(BoundedQueue *queue);
+
+/* Waits for room and appends `item` (never NULL). Returns -1 without adding
+ * it once the queue is closed. */
+int bounded_queue_push(BoundedQueue *queue, void *item);
+
+/* Waits for an item and removes it; NULL once the queue is closed and
+ * drained. */
+void *bounded_queue_pop(BoundedQueue *queue);
+
+/* No more pushes: wakes every waiting thread. Items already queued can still
+ * be popped. */
+void bounded_queue_close(BoundedQueue *queue);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* FUNGCC_SUPPORT_QUEUE_H */
@@ -0,0 +1,54 @@
+#ifndef FUNGCC_SUPPORT_SCOPE_TABLE_H
+#define FUNGCC_SUPPORT_SCOPE_TABLE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "support/intern.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct ScopeEntry {
+    SymbolId symbol;
+    uint32_t slot; /* position in the owning scope's hash table */
+    long value;
+} ScopeEntry;
+
+/* One lexical scope: an open-addressing hash from symbol to entry index. */
+typedef struct Scope {
+    ScopeEntry *entries;
+    size_t entry_count;
+    size_t entry_capacity;
+    uint32_t *slots; /* entry index + 1, 0 when empty */
+    uint32_t slot_mask;
+} Scope;
+
+/* Stack of scopes mirroring nested AST_BLOCKs. Popped scopes keep their storage
+ * so re-entering the same depth does not allocate again. */
+typedef struct ScopeTable {
+    Scope *scopes;
+    size_t depth;
+    size_t capacity;
+} ScopeTable;
+
+void scope_table_init(ScopeTable *table);
+void scope_table_free(ScopeTable *table);
+
+int scope_table_push(ScopeTable *table);
+void scope_table_pop(ScopeTable *table);
+
+/* Binds `symbol` in the innermost scope. Returns 0 on success, 1 if the symbol
+ * is already declared in that scope, -1 on allocation failure. */
+int scope_table_declare(ScopeTable *table, SymbolId symbol, long value);
+
+/* Resolves `symbol` from the innermost scope outwards; returns 1 and stores the
+ * bound value when found, 0 otherwise. */
+int scope_table_lookup(const ScopeTable *table, SymbolId symbol, long *value);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* FUNGCC_SUPPORT_SCOPE_TABLE_H */
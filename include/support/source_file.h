@@ -0,0 +1,34 @@
+#ifndef FUNGCC_SUPPORT_SOURCE_FILE_H
+#define FUNGCC_SUPPORT_SOURCE_FILE_H
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef enum SourceFileMode {
+    SOURCE_FILE_MAPPED = 0, /* read-only mmap of a regular file */
+    SOURCE_FILE_BUFFERED    /* heap copy: pipes, stdin, or mapping disabled */
+} SourceFileMode;
+
+/* Source text for one compilation. Lexer tokens and AST nodes point straight
+ * into `data`, so the file must stay open until the AST has been released. */
+typedef struct SourceFile {
+    const char *data;
+    size_t length;
+    SourceFileMode mode;
+    const char *path;
+} SourceFile;
+
+/* Opens `path` ("-" reads stdin). When allow_mmap is non-zero regular files are
+ * mapped, everything else falls back to a heap buffer. Returns 0 on success;
+ * on failure errno describes the problem. */
+int source_file_open(SourceFile *file, const char *path, int allow_mmap);
+void source_file_close(SourceFile *file);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* FUNGCC_SUPPORT_SOURCE_FILE_H */
@@ -0,0 +1,5 @@
+int main() {
+    int answer = 40;
+    answer = answer + 2;
+    return answer;
+}
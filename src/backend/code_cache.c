@@ -0,0 +1,391 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "backend/code_cache.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#ifndef FUNGCC_VERSION
+#define FUNGCC_VERSION "unknown"
+#endif
+
+/* Bump when the key serialization or the entry layout changes. */
+#define CODE_CACHE_FORMAT 1u
+
+/* magic, format, key (low, high), payload length, payload checksum */
+#define ENTRY_HEADER_SIZE 40
+static const char entry_magic[4] = {'F', 'G', 'C', 'C'};
+
+/* Marks an absent optional child in the serialized tree. */
+#define NO_NODE 0xFF
+
+static void put_u32(uint8_t *bytes, uint32_t value) {
+    for (int i = 0; i < 4; ++i) {
+        bytes[i] = (uint8_t)(value >> (8 * i));
+    }
+}
+
+static void put_u64(uint8_t *bytes, uint64_t value) {
+    for (int i = 0; i < 8; ++i) {
+        bytes[i] = (uint8_t)(value >> (8 * i));
+    }
+}
+
+static uint64_t get_u64(const uint8_t *bytes) {
+    uint64_t value = 0;
+    for (int i = 8; i-- > 0;) {
+        value = value << 8 | bytes[i];
+    }
+    return value;
+}
+
+/* The binary's size and modification time stand in for a build id: a rebuilt
+ * compiler may lower the same AST differently, and must not reuse old code. */
+static Hash128 compiler_identity(void) {
+    char text[256];
+    struct stat st;
+    int length;
+    if (stat("/proc/self/exe", &st) == 0) {
+        length = snprintf(text, sizeof(text), "fungcc %s/%u/%lld/%lld.%09ld", FUNGCC_VERSION, CODE_CACHE_FORMAT,
+                          (long long)st.st_size, (long long)st.st_mtim.tv_sec, (long)st.st_mtim.tv_nsec);
+    } else {
+        length = snprintf(text, sizeof(text), "fungcc %s/%u", FUNGCC_VERSION, CODE_CACHE_FORMAT);
+    }
+    return hash128(text, (size_t)length, 0);
+}
+
+int code_cache_open(CodeCache *cache, const char *directory) {
+    cache->directory = NULL;
+    if (mkdir(directory, 0777) != 0 && errno != EEXIST) {
+        return -1;
+    }
+    struct stat st;
+    if (stat(directory, &st) != 0) {
+        return -1;
+    }
+    if (!S_ISDIR(st.st_mode)) {
+        errno = ENOTDIR;
+        return -1;
+    }
+
+    size_t length = strlen(directory);
+    while (length > 1 && directory[length - 1] == '/') {
+        --length;
+    }
+    cache->directory = malloc(length + 1);
+    if (!cache->directory) {
+        errno = ENOMEM;
+        return -1;
+    }
+    memcpy(cache->directory, directory, length);
+    cache->directory[length] = '\0';
+    cache->identity = compiler_identity();
+    return 0;
+}
+
+void code_cache_close(CodeCache *cache) {
+    free(cache->directory);
+    cache->directory = NULL;
+}
+
+void code_cache_names_free(CodeCacheNames *names) {
+    free(names->items);
+    names->items = NULL;
+    names->count = names->capacity = 0;
+    names->failed = 0;
+}
+
+static void push_name(CodeCacheNames *names, const AstIdentifier *identifier) {
+    if (names->count == names->capacity) {
+        size_t capacity = names->capacity ? names->capacity * 2 : 16;
+        const AstIdentifier **items = realloc(names->items, capacity * sizeof(*items));
+        if (!items) {
+            names->failed = 1;
+            return;
+        }
+        names->items = items;
+        names->capacity = capacity;
+    }
+    names->items[names->count++] = identifier;
+}
+
+static void serialize_u64(Emitter *buffer, uint64_t value) {
+    uint8_t bytes[8];
+    put_u64(bytes, value);
+    emitter_view(buffer, (const char *)bytes, sizeof(bytes));
+}
+
+static void serialize_span(Emitter *buffer, const char *text, size_t length) {
+    serialize_u64(buffer, length);
+    emitter_view(buffer, text, length);
+}
+
+typedef struct KeyWriter {
+    Emitter *buffer;
+    const AstTranslationUnit *unit;
+    CodeCacheNames *names;
+    AstNodeId *spine; /* binary operators whose left operand is being written */
+    size_t spine_count;
+    size_t spine_capacity;
+    int failed;
+} KeyWriter;
+
+/* Writes the tree in prefix order with every lexeme length-prefixed, so two
+ * functions serialize alike exactly when they have the same structure and
+ * spelling, wherever they sit in the file. */
+static void serialize_node(KeyWriter *writer, AstNodeId id) {
+    Emitter *buffer = writer->buffer;
+    const AstTranslationUnit *unit = writer->unit;
+    if (id == AST_NODE_NONE) {
+        emitter_char(buffer, (char)NO_NODE);
+        return;
+    }
+
+    const AstNode *node = ast_node(unit, id);
+    emitter_char(buffer, (char)node->kind);
+    switch (node->kind) {
+    case AST_FUNCTION_DECL: {
+        const AstIdentifier *name = ast_name(unit, node->value.function_decl.name);
+        serialize_span(buffer, name->name, name->length);
+        serialize_node(writer, node->value.function_decl.body);
+        break;
+    }
+    case AST_RETURN_STMT:
+        serialize_node(writer, node->value.return_stmt);
+        break;
+    case AST_NUMBER_LITERAL: {
+        const AstNumberLiteral *literal = ast_literal(unit, node->value.number_literal);
+        serialize_span(buffer, literal->lexeme, literal->length);
+        break;
+    }
+    case AST_IDENTIFIER: {
+        const AstIdentifier *identifier = ast_name(unit, node->value.identifier);
+        serialize_span(buffer, identifier->name, identifier->length);
+        push_name(writer->names, identifier);
+        break;
+    }
+    case AST_UNARY_EXPR:
+        emitter_char(buffer, (char)node->op);
+        serialize_node(writer, node->value.unary_expr);
+        break;
+    case AST_BINARY_EXPR: {
+        /* A long left-associative chain nests down the left. Its operators come
+         * first in prefix order, then the innermost left operand, then the right
+         * operands from the inside out: a stack instead of recursion. */
+        size_t base = writer->spine_count;
+        for (;;) {
+            emitter_char(buffer, (char)node->op);
+            if (writer->spine_count == writer->spine_capacity) {
+                size_t capacity = writer->spine_capacity ? writer->spine_capacity * 2 : 64;
+                AstNodeId *spine = realloc(writer->spine, capacity * sizeof(*spine));
+                if (!spine) {
+                    writer->failed = 1;
+                    writer->spine_count = base;
+                    return;
+                }
+                writer->spine = spine;
+                writer->spine_capacity = capacity;
+            }
+            writer->spine[writer->spine_count++] = id;
+            id = node->value.binary_expr.left;
+            node = ast_node(unit, id);
+            if (node->kind != AST_BINARY_EXPR) {
+                break;
+            }
+            emitter_char(buffer, (char)node->kind);
+        }
+        serialize_node(writer, id);
+        while (writer->spine_count > base) {
+            const AstNode *binary = ast_node(unit, writer->spine[--writer->spine_count]);
+            serialize_node(writer, binary->value.binary_expr.right);
+        }
+        break;
+    }
+    case AST_BLOCK: {
+        const AstNodeId *statements = ast_children(unit, node->value.block);
+        serialize_u64(buffer, node->value.block.count);
+        for (uint32_t i = 0; i < node->value.block.count; ++i) {
+            serialize_node(writer, statements[i]);
+        }
+        break;
+    }
+    case AST_VAR_DECL: {
+        const AstIdentifier *name = ast_name(unit, node->value.var_decl.name);
+        serialize_span(buffer, name->name, name->length);
+        serialize_node(writer, node->value.var_decl.initializer);
+        break;
+    }
+    case AST_ASSIGNMENT: {
+        const AstIdentifier *target = ast_name(unit, node->value.assignment.target);
+        serialize_span(buffer, target->name, target->length);
+        serialize_node(writer, node->value.assignment.value);
+        break;
+    }
+    case AST_NONE:
+        break;
+    }
+}
+
+int code_cache_key(const CodeCache *cache,
+                   const AstTranslationUnit *unit,
+                   AstNodeId function,
+                   uint64_t variant,
+                   Emitter *buffer,
+                   CodeCacheNames *names,
+                   Hash128 *key) {
+    buffer->length = 0;
+    names->count = 0;
+    serialize_u64(buffer, cache->identity.low);
+    serialize_u64(buffer, cache->identity.high);
+    serialize_u64(buffer, variant);
+    KeyWriter writer = {buffer, unit, names, NULL, 0, 0, 0};
+    serialize_node(&writer, function);
+    free(writer.spine);
+    if (buffer->failed || names->failed || writer.failed) {
+        return -1;
+    }
+    *key = hash128(buffer->data, buffer->length, 0);
+    return 0;
+}
+
+/* "<directory>/ab/cdef..." for a key whose hex digits are "abcdef...", so no
+ * directory ends up with more than a 256th of the entries. */
+static char *entry_path(const CodeCache *cache, Hash128 key) {
+    size_t size = strlen(cache->directory) + 36;
+    char *path = malloc(size);
+    if (path) {
+        char hex[33];
+        snprintf(hex, sizeof(hex), "%016llx%016llx", (unsigned long long)key.high, (unsigned long long)key.low);
+        snprintf(path, size, "%s/%.2s/%s", cache->directory, hex, hex + 2);
+    }
+    return path;
+}
+
+static int read_exact(int fd, void *data, size_t length) {
+    uint8_t *bytes = data;
+    while (length > 0) {
+        ssize_t got = read(fd, bytes, length);
+        if (got < 0 && errno == EINTR) {
+            continue;
+        }
+        if (got <= 0) {
+            return -1;
+        }
+        bytes += got;
+        length -= (size_t)got;
+    }
+    return 0;
+}
+
+static int write_exact(int fd, const void *data, size_t length) {
+    const uint8_t *bytes = data;
+    while (length > 0) {
+        ssize_t put = write(fd, bytes, length);
+        if (put < 0 && errno == EINTR) {
+            continue;
+        }
+        if (put <= 0) {
+            return -1;
+        }
+        bytes += put;
+        length -= (size_t)put;
+    }
+    return 0;
+}
+
+static uint64_t payload_checksum(Hash128 key, const void *payload, size_t length) {
+    return hash128(payload, length, key.low).low;
+}
+
+static void fill_header(uint8_t *header, Hash128 key, const void *payload, size_t length) {
+    memcpy(header, entry_magic, sizeof(entry_magic));
+    put_u32(header + 4, CODE_CACHE_FORMAT);
+    put_u64(header + 8, key.low);
+    put_u64(header + 16, key.high);
+    put_u64(header + 24, length);
+    put_u64(header + 32, payload_checksum(key, payload, length));
+}
+
+int code_cache_load(const CodeCache *cache, Hash128 key, Emitter *payload) {
+    char *path = entry_path(cache, key);
+    if (!path) {
+        return -1;
+    }
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    free(path);
+    if (fd < 0) {
+        return -1;
+    }
+
+    uint8_t header[ENTRY_HEADER_SIZE];
+    struct stat st;
+    int status = -1;
+    payload->length = 0;
+    if (fstat(fd, &st) == 0 && st.st_size >= ENTRY_HEADER_SIZE && read_exact(fd, header, sizeof(header)) == 0) {
+        size_t length = (size_t)(st.st_size - ENTRY_HEADER_SIZE);
+        if (get_u64(header + 24) == length && emitter_reserve_slow(payload, length) == 0 &&
+            read_exact(fd, payload->data, length) == 0) {
+            uint8_t expected[ENTRY_HEADER_SIZE];
+            fill_header(expected, key, payload->data, length);
+            if (memcmp(header, expected, sizeof(expected)) == 0) {
+                payload->length = length;
+                status = 0;
+            }
+        }
+    }
+    close(fd);
+    return status;
+}
+
+int code_cache_store(const CodeCache *cache, Hash128 key, const void *payload, size_t length) {
+    static atomic_uint next_temporary;
+
+    char *path = entry_path(cache, key);
+    char *temporary = path ? malloc(strlen(path) + 48) : NULL;
+    if (!temporary) {
+        free(path);
+        return -1;
+    }
+
+    /* The shard directory may not exist yet, or another process may be
+     * creating it right now. */
+    char *slash = strrchr(path, '/');
+    *slash = '\0';
+    int status = (mkdir(path, 0777) == 0 || errno == EEXIST) ? 0 : -1;
+    sprintf(temporary, "%s/.tmp.%ld.%u", path, (long)getpid(),
+            atomic_fetch_add_explicit(&next_temporary, 1, memory_order_relaxed));
+    *slash = '/';
+
+    int fd = (status == 0) ? open(temporary, O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, 0666) : -1;
+    if (fd < 0) {
+        free(temporary);
+        free(path);
+        return -1;
+    }
+
+    uint8_t header[ENTRY_HEADER_SIZE];
+    fill_header(header, key, payload, length);
+    if (write_exact(fd, header, sizeof(header)) != 0 || write_exact(fd, payload, length) != 0) {
+        status = -1;
+    }
+    if (close(fd) != 0) {
+        status = -1;
+    }
+    /* rename() replaces atomically: readers see the old entry or the new one,
+     * never a partial file. */
+    if (status == 0 && rename(temporary, path) != 0) {
+        status = -1;
+    }
+    if (status != 0) {
+        unlink(temporary);
+    }
+    free(temporary);
+    free(path);
+    return status;
+}
@@ -1,297 +1,1249 @@
 #include "backend/codegen.h"
 
 #include <errno.h>
+#include <limits.h>
+#include <stdarg.h>
+#include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
 
-typedef struct LocalBinding {
-    char *name;
-    size_t length;
-    long offset; /* positive offset from rbp (use -offset) */
-} LocalBinding;
+#include "backend/code_cache.h"
+#include "backend/elf.h"
+#include "backend/emitter.h"
+#include "backend/peephole.h"
+#include "backend/regalloc.h"
+#include "backend/x86.h"
+#include "ir/lower.h"
+#include "opt/dce.h"
+#include "support/parallel.h"
 
-typedef struct LocalTable {
-    LocalBinding *items;
-    size_t count;
-    size_t capacity;
-} LocalTable;
+/* Each function's IR lives in its own arena, released once it is emitted. */
+#define IR_ARENA_CHUNK_SIZE ((size_t)4 * 1024)
+
+/* Where the backend keeps an IR value. */
+typedef enum ValueHome {
+    HOME_INLINE = 0, /* folded into its only user's expression tree */
+    HOME_CONSTANT,   /* IR_CONST: printed as an immediate at every use */
+    HOME_REGISTER,   /* a callee-saved register for its whole live range */
+    HOME_FRAME       /* -offset(%rbp) */
+} ValueHome;
+
+typedef struct ValueInfo {
+    const IrInstr *def;
+    uint32_t def_point;
+    uint32_t last_point; /* last point where its home is read */
+    uint32_t uses;
+    uint32_t user_point; /* the use, when there is exactly one */
+    uint32_t user_block;
+    uint32_t def_block;
+    uint32_t next_pending; /* inlined loads of one slot awaiting emission */
+    int phi_use;           /* used by a phi: needs a home of its own */
+    ValueHome home;
+    X86Reg reg;
+    unsigned char need; /* memoized Sethi-Ullman number, 0 when unknown */
+    long offset;
+} ValueInfo;
+
+/* Points between an IR slot's first access and the last point one of its loads
+ * is emitted; the layout is topological, so the slot is dead outside them. */
+typedef struct SlotRange {
+    uint32_t start;
+    uint32_t end;
+    uint32_t slot;
+} SlotRange;
+
+/* A cache key's identifier, found by the address of its name in the source. */
+typedef struct CachedName {
+    uintptr_t name;
+    uint32_t index; /* position in the key's CodeCacheNames */
+} CachedName;
+
+typedef struct BlockInfo {
+    uint32_t start; /* point of the block's phis; its instructions follow */
+    uint32_t end;   /* point of its terminator */
+    int reachable;
+} BlockInfo;
+
+/* How an operator on a left spine finishes once its left value is in pool[0]. */
+typedef enum ChainStepKind {
+    STEP_OPERAND, /* one computed operand: apply the operator to it */
+    STEP_REGISTER, /* compute the right value into pool[1], then combine */
+    STEP_SPILLED, /* the right value was pushed first: combine with (%rsp) */
+} ChainStepKind;
+
+/* An operator waiting for the value it is applied to. */
+typedef struct ChainStep {
+    const IrInstr *instr;
+    IrValue operand;
+    ChainStepKind kind;
+} ChainStep;
+
+/* Memory a thread reuses from one function to the next: the IR arena and the
+ * instruction list are reset and the backend tables only ever grow. */
+typedef struct CodegenScratch {
+    Arena *arena;
+    ValueInfo *values;
+    size_t value_capacity;
+    BlockInfo *blocks;
+    size_t block_capacity;
+    uint32_t *emit_at;
+    size_t point_capacity;
+    uint32_t *words; /* pending slot loads, then allocation order */
+    size_t word_capacity;
+    LiveInterval *intervals;
+    size_t interval_capacity;
+    uint32_t *owners; /* per packed interval: a value, or SLOT_OWNER | slot */
+    size_t owner_capacity;
+    SlotRange *slot_ranges;
+    size_t slot_range_capacity;
+    long *slot_offsets; /* per IR slot: bytes below %rbp */
+    size_t slot_offset_capacity;
+    X86Code code;
+    ChainStep *chain; /* operators waiting for their left value, see emit_instr_into */
+    size_t chain_count;
+    size_t chain_capacity;
+    PeepholeStats peephole; /* summed over every function this thread lowered */
+    DceStats dce;
+    Emitter cache_key;   /* the serialized AST being hashed */
+    Emitter cache_entry; /* a payload loaded from, or about to be stored in, the cache */
+    CodeCacheNames cache_names;
+    CachedName *cache_sorted;
+    size_t cache_sorted_capacity;
+    X86Reloc *cache_relocs;
+    size_t cache_reloc_capacity;
+    CodeCacheStats cache;
+} CodegenScratch;
 
 typedef struct CodegenContext {
-    FILE *out;
-    LocalTable *locals;
-    const char *return_label;
+    X86Code *code;
+    Emitter *diag; /* buffered so parallel runs report errors in source order */
+    const IrFunction *function;
+    CodegenScratch *scratch;
+    ValueInfo *values;
+    BlockInfo *blocks;
+    uint32_t *emit_at; /* per point: where the instruction's code is emitted */
+    const long *slot_offsets;
 } CodegenContext;
 
-static int copy_lexeme(const char *lexeme, size_t length, char **out_copy) {
-    char *buffer = malloc(length + 1);
-    if (!buffer) {
-        return -1;
+static void codegen_error(CodegenContext *ctx, const char *format, ...) {
+    char message[256];
+    va_list args;
+    va_start(args, format);
+    int length = vsnprintf(message, sizeof(message), format, args);
+    va_end(args);
+
+    if (length < 0) {
+        return;
     }
-    memcpy(buffer, lexeme, length);
-    buffer[length] = '\0';
-    *out_copy = buffer;
-    return 0;
+    if ((size_t)length >= sizeof(message)) {
+        length = (int)sizeof(message) - 1;
+    }
+    emitter_text(ctx->diag, "Codegen error: ");
+    emitter_view(ctx->diag, message, (size_t)length);
+    emitter_char(ctx->diag, '\n');
 }
 
-static long local_table_find(const LocalTable *table, const char *name, size_t length) {
-    for (size_t i = 0; i < table->count; ++i) {
-        if (table->items[i].length == length && strncmp(table->items[i].name, name, length) == 0) {
-            return table->items[i].offset;
-        }
-    }
-    return -1;
+/* Slot `offset` bytes below the frame pointer. */
+static X86Operand frame_slot(long offset) {
+    return x86_mem(X86_RBP, (int32_t)-offset);
 }
 
-static int local_table_add(LocalTable *table, const char *name, size_t length, long offset) {
-    if (table->count == table->capacity) {
-        size_t new_capacity = table->capacity ? table->capacity * 2 : 4;
-        LocalBinding *resized = realloc(table->items, new_capacity * sizeof(LocalBinding));
-        if (!resized) {
-            return -1;
+/* Where assign_homes put IR slot `slot`. */
+static X86Operand slot_home(const CodegenContext *ctx, uint32_t slot) {
+    return frame_slot(ctx->slot_offsets[slot]);
+}
+
+/* Scratch registers for expression temporaries: all caller-saved, so a function
+ * that only computes expressions never touches its callee-saved registers. The
+ * first entry is where every expression's value ends up. */
+static const X86Reg scratch_registers[] = {
+    X86_RAX, X86_RCX, X86_RDX, X86_RSI, X86_RDI,
+    X86_R8,  X86_R9,  X86_R10, X86_R11,
+};
+
+#define SCRATCH_REGISTER_COUNT (sizeof(scratch_registers) / sizeof(scratch_registers[0]))
+
+/* A value computed into its own register evaluates with that register in
+ * front of the scratch registers. */
+#define MAX_POOL_SIZE (SCRATCH_REGISTER_COUNT + 1)
+
+/* Values x86 can use directly as the source operand of add/sub/mov: anything
+ * with a home, plus inlined global and slot loads (memory operands). */
+static int is_leaf(const CodegenContext *ctx, IrValue value) {
+    const ValueInfo *info = &ctx->values[value];
+    return info->home != HOME_INLINE || info->def->op == IR_GLOBAL || info->def->op == IR_LOAD_SLOT;
+}
+
+/* A leaf as an operand: an immediate, a register, a frame slot or "name(%rip)". */
+static X86Operand leaf_operand(const CodegenContext *ctx, IrValue value) {
+    const ValueInfo *info = &ctx->values[value];
+    switch (info->home) {
+    case HOME_CONSTANT:
+        return x86_imm(info->def->u.imm);
+    case HOME_REGISTER:
+        return x86_reg(info->reg);
+    case HOME_FRAME:
+        return frame_slot(info->offset);
+    default:
+        if (info->def->op == IR_GLOBAL) {
+            return x86_global(info->def->u.global.name, info->def->u.global.length);
         }
-        table->items = resized;
-        table->capacity = new_capacity;
+        return slot_home(ctx, info->def->u.slot);
     }
+}
 
-    char *copy = NULL;
-    if (copy_lexeme(name, length, &copy) != 0) {
-        return -1;
-    }
+static int is_constant(const CodegenContext *ctx, IrValue value) {
+    return ctx->values[value].home == HOME_CONSTANT;
+}
 
-    table->items[table->count].name = copy;
-    table->items[table->count].length = length;
-    table->items[table->count].offset = offset;
-    table->count += 1;
-    return 0;
+/* IR constants are 64-bit; the code computes modulo 2^32. */
+static int32_t constant_value(const CodegenContext *ctx, IrValue value) {
+    uint32_t bits = (uint32_t)ctx->values[value].def->u.imm;
+    return (bits <= (uint32_t)INT32_MAX) ? (int32_t)bits : -(int32_t)~bits - 1;
 }
 
-static void local_table_free(LocalTable *table) {
-    for (size_t i = 0; i < table->count; ++i) {
-        free(table->items[i].name);
-    }
-    free(table->items);
-    table->items = NULL;
-    table->count = table->capacity = 0;
+static int is_commutative(IrOp op) {
+    return op == IR_ADD || op == IR_MUL;
 }
 
-static int emit_expression(const AstNode *node, CodegenContext *ctx);
+/* Division by a non-zero constant is a multiply and shift sequence; anything
+ * else needs idiv and its fixed registers. */
+static int divides_by_constant(const CodegenContext *ctx, const IrInstr *instr) {
+    return (instr->op == IR_DIV || instr->op == IR_MOD) && is_constant(ctx, instr->args[1]) &&
+           constant_value(ctx, instr->args[1]) != 0;
+}
 
-static int emit_number_literal(const AstNode *node, CodegenContext *ctx) {
-    char *literal = NULL;
-    if (copy_lexeme(node->value.number_literal.lexeme, node->value.number_literal.length, &literal) != 0) {
-        return -1;
+static uint32_t magnitude(int32_t value) {
+    return (value < 0) ? 0u - (uint32_t)value : (uint32_t)value;
+}
+
+static int is_power_of_two(uint32_t value) {
+    return value != 0 && (value & (value - 1)) == 0;
+}
+
+static unsigned log2_exact(uint32_t value) {
+    unsigned k = 0;
+    while (value > 1) {
+        value >>= 1;
+        k += 1;
     }
+    return k;
+}
 
-    char *endptr = NULL;
-    long value = strtol(literal, &endptr, 10);
-    if (endptr == literal || *endptr != '\0') {
-        free(literal);
-        return -1;
+/* Registers a division by `divisor` needs, the dividend's included. */
+static size_t constant_division_registers(IrOp op, int32_t divisor) {
+    uint32_t m = magnitude(divisor);
+    if (m == 1) {
+        return 1;
     }
+    return (op == IR_MOD && !is_power_of_two(m)) ? 3 : 2;
+}
 
-    int result = fprintf(ctx->out, "    movl $%ld, %%eax\n", value);
-    free(literal);
-    return (result < 0) ? -1 : 0;
+/* Registers a binary operator needs given those of its two computed operands. */
+static size_t combined_need(size_t lhs, size_t rhs) {
+    return (lhs == rhs) ? lhs + 1 : ((lhs > rhs) ? lhs : rhs);
 }
 
-static int emit_identifier(const AstNode *node, CodegenContext *ctx) {
-    long offset = local_table_find(ctx->locals, node->value.identifier.name, node->value.identifier.length);
-    if (offset >= 0) {
-        if (fprintf(ctx->out, "    movl -%ld(%%rbp), %%eax\n", offset) < 0) {
-            return -1;
+/* Sethi-Ullman number: registers needed to evaluate `value` without spilling.
+ * A leaf right operand (or, for `+` and `*`, a leaf left one) costs no
+ * register, so those links are followed iteratively and only nodes with two
+ * computed operands are memoized. Divisions by constants need temporaries,
+ * which put a floor under the chain. */
+static size_t registers_needed(CodegenContext *ctx, IrValue value) {
+    size_t floor = 1;
+    for (;;) {
+        if (is_leaf(ctx, value)) {
+            return floor;
         }
-        return 0;
+        const IrInstr *instr = ctx->values[value].def;
+        if (instr->op == IR_NEG) {
+            value = instr->args[0];
+            continue;
+        }
+
+        IrValue left = instr->args[0];
+        IrValue right = instr->args[1];
+        if (divides_by_constant(ctx, instr)) {
+            size_t temps = constant_division_registers(instr->op, constant_value(ctx, right));
+            floor = (temps > floor) ? temps : floor;
+            value = left;
+            continue;
+        }
+        if (is_leaf(ctx, right)) {
+            value = left;
+            continue;
+        }
+        if (is_commutative(instr->op) && is_leaf(ctx, left)) {
+            value = right;
+            continue;
+        }
+
+        ValueInfo *info = &ctx->values[value];
+        if (!info->need) {
+            size_t lhs = registers_needed(ctx, left);
+            size_t rhs = registers_needed(ctx, right);
+            size_t need = combined_need(lhs, rhs);
+            info->need = (unsigned char)((need < UCHAR_MAX) ? need : UCHAR_MAX);
+        }
+        return (info->need > floor) ? info->need : floor;
     }
+}
 
-    char *name = NULL;
-    if (copy_lexeme(node->value.identifier.name, node->value.identifier.length, &name) != 0) {
-        return -1;
+/* Fills in registers_needed's memo bottom-up. Operands are numbered before
+ * their users, so every memoized node finds its operands' counts already known
+ * and a long chain of such nodes is not recursed through when emitting it. */
+static void memoize_register_needs(CodegenContext *ctx) {
+    for (IrValue value = 1; value <= ctx->function->value_count; ++value) {
+        const ValueInfo *info = &ctx->values[value];
+        if (info->home != HOME_INLINE || !info->def) {
+            continue;
+        }
+        const IrInstr *instr = info->def;
+        switch (instr->op) {
+        case IR_ADD:
+        case IR_SUB:
+        case IR_MUL:
+        case IR_DIV:
+        case IR_MOD:
+            if (!divides_by_constant(ctx, instr) && !is_leaf(ctx, instr->args[1]) &&
+                !(is_commutative(instr->op) && is_leaf(ctx, instr->args[0]))) {
+                registers_needed(ctx, value);
+            }
+            break;
+        default:
+            break;
+        }
     }
+}
 
-    int result = fprintf(ctx->out, "    mov %s(%%rip), %%eax\n", name);
-    free(name);
-    return (result < 0) ? -1 : 0;
+static X86Opcode binary_opcode(IrOp op) {
+    switch (op) {
+    case IR_ADD:
+        return X86_ADD;
+    case IR_MUL:
+        return X86_IMUL;
+    default:
+        return X86_SUB;
+    }
 }
 
-static int emit_binary_expr(const AstNode *node, CodegenContext *ctx) {
-    if (emit_expression(node->value.binary_expr.left, ctx) != 0) {
-        return -1;
+/* `reg *= factor` with lea and shifts when at most two of them (counting a
+ * final neg) do it, which beats imul's three-cycle latency. */
+static void emit_multiply_constant(CodegenContext *ctx, X86Reg reg, int32_t factor) {
+    X86Operand dst = x86_reg(reg);
+    if (factor == 0) {
+        x86_emit(ctx->code, X86_MOV, 4, x86_imm(0), dst);
+        return;
+    }
+    uint32_t m = magnitude(factor);
+    unsigned shift = 0;
+    while ((m & 1) == 0) {
+        m >>= 1;
+        shift += 1;
     }
 
-    if (fprintf(ctx->out, "    push %%rax\n") < 0) {
-        return -1;
+    /* The odd part as a product of lea scales: 3, 5 and 9 are x + x*{2,4,8}. */
+    unsigned scales[2];
+    size_t lea_count = 0;
+    uint32_t rest = m;
+    while (rest != 1 && lea_count < 2) {
+        unsigned scale = (rest % 9 == 0) ? 8 : (rest % 5 == 0) ? 4 : (rest % 3 == 0) ? 2 : 0;
+        if (scale == 0) {
+            break;
+        }
+        rest /= scale + 1;
+        scales[lea_count++] = scale;
+    }
+    int negate = factor < 0 && factor != INT32_MIN; /* -INT32_MIN is itself */
+    if (rest != 1 || lea_count + (shift > 0) + negate > 2) {
+        x86_emit(ctx->code, X86_IMUL, 4, x86_imm(factor), dst);
+        return;
     }
 
-    if (emit_expression(node->value.binary_expr.right, ctx) != 0) {
-        return -1;
+    for (size_t i = 0; i < lea_count; ++i) {
+        x86_emit(ctx->code, X86_LEA, 4, x86_mem_index(reg, reg, scales[i], 0), dst);
+    }
+    if (shift > 0) {
+        x86_emit(ctx->code, X86_SHL, 4, x86_imm(shift), dst);
     }
+    if (negate) {
+        x86_emit(ctx->code, X86_NEG, 4, x86_none(), dst);
+    }
+}
 
-    if (fprintf(ctx->out, "    pop %%rcx\n") < 0) {
-        return -1;
+/* Multiplier and shift for signed 32-bit division by `divisor` (|divisor| >= 2,
+ * not a power of two), from Hacker's Delight, figure 10-1: the quotient is the
+ * high half of dividend * multiplier, plus or minus the dividend when the
+ * multiplier's sign differs from the divisor's, shifted right arithmetically,
+ * plus one when negative. */
+static void signed_magic(int32_t divisor, int32_t *multiplier, unsigned *shift) {
+    const uint32_t two31 = 0x80000000u;
+    uint32_t ad = magnitude(divisor);
+    uint32_t t = two31 + ((uint32_t)divisor >> 31);
+    uint32_t anc = t - 1 - t % ad;
+    unsigned p = 31;
+    uint32_t q1 = two31 / anc;
+    uint32_t r1 = two31 - q1 * anc;
+    uint32_t q2 = two31 / ad;
+    uint32_t r2 = two31 - q2 * ad;
+    uint32_t delta;
+    do {
+        p += 1;
+        q1 *= 2;
+        r1 *= 2;
+        if (r1 >= anc) {
+            q1 += 1;
+            r1 -= anc;
+        }
+        q2 *= 2;
+        r2 *= 2;
+        if (r2 >= ad) {
+            q2 += 1;
+            r2 -= ad;
+        }
+        delta = ad - r2;
+    } while (q1 < delta || (q1 == delta && r1 == 0));
+
+    uint32_t m = q2 + 1;
+    if (divisor < 0) {
+        m = 0u - m;
     }
+    *multiplier = (m <= (uint32_t)INT32_MAX) ? (int32_t)m : -(int32_t)~m - 1;
+    *shift = p - 32;
+}
 
-    if (fprintf(ctx->out, "    mov %%eax, %%edx\n") < 0) {
-        return -1;
+/* pool[0] = pool[0] / divisor or % divisor, for a non-zero constant divisor,
+ * with pool[1] (and for a modulo by a non-power of two, pool[2]) as
+ * temporaries. */
+static void emit_divide_constant(CodegenContext *ctx, IrOp op, int32_t divisor, const X86Reg *pool) {
+    X86Code *code = ctx->code;
+    X86Operand n = x86_reg(pool[0]);
+    uint32_t m = magnitude(divisor);
+    if (m == 1) {
+        if (op == IR_MOD) {
+            x86_emit(code, X86_MOV, 4, x86_imm(0), n);
+        } else if (divisor < 0) {
+            x86_emit(code, X86_NEG, 4, x86_none(), n);
+        }
+        return;
     }
 
-    if (fprintf(ctx->out, "    mov %%ecx, %%eax\n") < 0) {
-        return -1;
+    X86Operand t = x86_reg(pool[1]);
+    if (is_power_of_two(m)) {
+        /* Shifting rounds toward minus infinity; adding m - 1 to a negative
+         * dividend first makes it round toward zero like C. */
+        unsigned k = log2_exact(m);
+        x86_emit(code, X86_MOV, 4, n, t);
+        if (k > 1) {
+            x86_emit(code, X86_SAR, 4, x86_imm(31), t);
+        }
+        x86_emit(code, X86_SHR, 4, x86_imm(32 - k), t);
+        if (op == IR_DIV) {
+            x86_emit(code, X86_ADD, 4, t, n);
+            x86_emit(code, X86_SAR, 4, x86_imm(k), n);
+            if (divisor < 0) {
+                x86_emit(code, X86_NEG, 4, x86_none(), n);
+            }
+        } else {
+            /* n % m = n - ((n + bias) & -m), whatever the divisor's sign. */
+            x86_emit(code, X86_ADD, 4, n, t);
+            x86_emit(code, X86_AND, 4, x86_imm(-(int64_t)m), t);
+            x86_emit(code, X86_SUB, 4, t, n);
+        }
+        return;
     }
 
-    const char *op_instr = (node->value.binary_expr.op == AST_BIN_ADD) ? "add" : "sub";
-    if (fprintf(ctx->out, "    %s %%edx, %%eax\n", op_instr) < 0) {
-        return -1;
+    int32_t multiplier;
+    unsigned shift;
+    signed_magic(divisor, &multiplier, &shift);
+    int correction = (divisor > 0 && multiplier < 0) ? 1 : (divisor < 0 && multiplier > 0) ? -1 : 0;
+
+    /* The 64-bit product of the sign-extended dividend holds the high half. */
+    x86_emit(code, X86_MOVSXD, 8, n, t);
+    x86_emit(code, X86_IMUL, 8, x86_imm(multiplier), t);
+    if (correction == 0) {
+        x86_emit(code, X86_SAR, 8, x86_imm(32 + shift), t);
+    } else {
+        x86_emit(code, X86_SAR, 8, x86_imm(32), t);
+        x86_emit(code, (correction > 0) ? X86_ADD : X86_SUB, 4, n, t);
+        if (shift > 0) {
+            x86_emit(code, X86_SAR, 4, x86_imm(shift), t);
+        }
     }
 
-    return 0;
+    if (op == IR_DIV) {
+        x86_emit(code, X86_MOV, 4, t, n);
+        x86_emit(code, X86_SHR, 4, x86_imm(31), n);
+        x86_emit(code, X86_ADD, 4, t, n);
+        return;
+    }
+    X86Operand u = x86_reg(pool[2]);
+    x86_emit(code, X86_MOV, 4, t, u);
+    x86_emit(code, X86_SHR, 4, x86_imm(31), u);
+    x86_emit(code, X86_ADD, 4, u, t);
+    emit_multiply_constant(ctx, pool[1], divisor);
+    x86_emit(code, X86_SUB, 4, t, n);
 }
 
-static int emit_unary_expr(const AstNode *node, CodegenContext *ctx) {
-    if (emit_expression(node->value.unary_expr.operand, ctx) != 0) {
-        return -1;
+static void emit_instr_into(CodegenContext *ctx, const IrInstr *instr, const X86Reg *pool, size_t pool_size);
+
+/* The one operand to compute into pool[0] before `instr` finishes with a
+ * single instruction or sequence on it (see finish_with_operand), or
+ * IR_NO_VALUE when `instr` needs more than one computed operand. */
+static IrValue chained_operand(const CodegenContext *ctx, const IrInstr *instr) {
+    IrValue left = instr->args[0];
+    IrValue right = instr->args[1];
+    switch (instr->op) {
+    case IR_NEG:
+        return left;
+    case IR_MUL:
+        if (is_constant(ctx, right) || is_constant(ctx, left)) {
+            return is_constant(ctx, right) ? left : right;
+        }
+        /* fall through */
+    case IR_ADD:
+    case IR_SUB:
+        if (is_leaf(ctx, right)) {
+            return left;
+        }
+        return (is_commutative(instr->op) && is_leaf(ctx, left)) ? right : IR_NO_VALUE;
+    case IR_DIV:
+    case IR_MOD:
+        return divides_by_constant(ctx, instr) ? left : IR_NO_VALUE;
+    default:
+        return IR_NO_VALUE;
     }
+}
 
-    switch (node->value.unary_expr.op) {
-    case AST_UNARY_PLUS:
-        return 0;
-    case AST_UNARY_MINUS:
-        if (fprintf(ctx->out, "    neg %%eax\n") < 0) {
+/* Applies `instr` to its chained operand, already in pool[0]. */
+static void finish_with_operand(CodegenContext *ctx, const IrInstr *instr, IrValue operand, const X86Reg *pool) {
+    IrValue other = (operand == instr->args[0]) ? instr->args[1] : instr->args[0];
+    switch (instr->op) {
+    case IR_NEG:
+        x86_emit(ctx->code, X86_NEG, 4, x86_none(), x86_reg(pool[0]));
+        break;
+    case IR_DIV:
+    case IR_MOD:
+        emit_divide_constant(ctx, instr->op, constant_value(ctx, other), pool);
+        break;
+    default:
+        if (instr->op == IR_MUL && is_constant(ctx, other)) {
+            emit_multiply_constant(ctx, pool[0], constant_value(ctx, other));
+        } else {
+            x86_emit(ctx->code, binary_opcode(instr->op), 4, leaf_operand(ctx, other), x86_reg(pool[0]));
+        }
+        break;
+    }
+}
+
+static void emit_register_op(CodegenContext *ctx, IrOp op, X86Reg source, X86Reg destination) {
+    x86_emit(ctx->code, binary_opcode(op), 4, x86_reg(source), x86_reg(destination));
+}
+
+static int push_chain_step(CodegenContext *ctx, const IrInstr *instr, IrValue operand, ChainStepKind kind) {
+    CodegenScratch *scratch = ctx->scratch;
+    if (scratch->chain_count == scratch->chain_capacity) {
+        size_t capacity = scratch->chain_capacity ? scratch->chain_capacity * 2 : 64;
+        ChainStep *steps = realloc(scratch->chain, capacity * sizeof(*steps));
+        if (!steps) {
+            ctx->code->failed = 1;
             return -1;
         }
-        return 0;
+        scratch->chain = steps;
+        scratch->chain_capacity = capacity;
+    }
+    scratch->chain[scratch->chain_count++] = (ChainStep){instr, operand, kind};
+    return 0;
+}
+
+/* Evaluates `value` into pool[0], clobbering only registers in `pool`. */
+static void emit_value_into(CodegenContext *ctx, IrValue value, const X86Reg *pool, size_t pool_size) {
+    if (is_leaf(ctx, value)) {
+        x86_emit(ctx->code, X86_MOV, 4, leaf_operand(ctx, value), x86_reg(pool[0]));
+        return;
+    }
+    emit_instr_into(ctx, ctx->values[value].def, pool, pool_size);
+}
+
+/* The right side is heavier: evaluate it into pool[1] with the full pool
+ * (pool[0] is still free), then the left side into pool[0] without pool[1]. */
+static void emit_binary(CodegenContext *ctx, const IrInstr *instr, const X86Reg *pool, size_t pool_size) {
+    X86Reg right_pool[MAX_POOL_SIZE];
+    X86Reg left_pool[MAX_POOL_SIZE];
+    right_pool[0] = pool[1];
+    right_pool[1] = pool[0];
+    left_pool[0] = pool[0];
+    for (size_t i = 2; i < pool_size; ++i) {
+        right_pool[i] = pool[i];
+        left_pool[i - 1] = pool[i];
+    }
+    emit_value_into(ctx, instr->args[1], right_pool, pool_size);
+    emit_value_into(ctx, instr->args[0], left_pool, pool_size - 1);
+    emit_register_op(ctx, instr->op, pool[1], pool[0]);
+}
+
+/* idiv divides %edx:%eax, so the dividend goes to %eax and the divisor to any
+ * other register but %edx. Such divisions are only computed at statement level,
+ * where every scratch register is free. Leaves %eax. */
+static void emit_idiv(CodegenContext *ctx, const IrInstr *instr) {
+    static const X86Reg divisor_pool[] = {X86_RCX, X86_RDX, X86_RSI, X86_RDI, X86_R8, X86_R9, X86_R10, X86_R11};
+    static const X86Reg dividend_pool[] = {X86_RAX, X86_RDX, X86_RSI, X86_RDI, X86_R8, X86_R9, X86_R10, X86_R11};
+    const size_t pool_size = sizeof(divisor_pool) / sizeof(divisor_pool[0]);
+
+    IrValue divisor = instr->args[1];
+    X86Operand operand = x86_reg(X86_RCX);
+    if (is_leaf(ctx, divisor) && !is_constant(ctx, divisor)) {
+        operand = leaf_operand(ctx, divisor); /* values live in callee-saved registers */
+    } else {
+        emit_value_into(ctx, divisor, divisor_pool, pool_size);
+    }
+    emit_value_into(ctx, instr->args[0], dividend_pool, pool_size);
+    x86_emit(ctx->code, X86_CDQ, 4, x86_none(), x86_none());
+    x86_emit(ctx->code, X86_IDIV, 4, operand, x86_none());
+    if (instr->op == IR_MOD) {
+        x86_emit(ctx->code, X86_MOV, 4, x86_reg(X86_RDX), x86_reg(X86_RAX));
+    }
+}
+
+/* Computes the innermost value of a left spine, which is not taken apart any
+ * further, into pool[0]. */
+static void emit_innermost(CodegenContext *ctx, const IrInstr *instr, const X86Reg *pool, size_t pool_size) {
+    switch (instr->op) {
+    case IR_CONST:
+        x86_emit(ctx->code, X86_MOV, 4, x86_imm(instr->u.imm), x86_reg(pool[0]));
+        break;
+    case IR_GLOBAL:
+        x86_emit(ctx->code, X86_MOV, 4, x86_global(instr->u.global.name, instr->u.global.length), x86_reg(pool[0]));
+        break;
+    case IR_LOAD_SLOT:
+        x86_emit(ctx->code, X86_MOV, 4, slot_home(ctx, instr->u.slot), x86_reg(pool[0]));
+        break;
+    case IR_ADD:
+    case IR_SUB:
+    case IR_MUL:
+        emit_binary(ctx, instr, pool, pool_size);
+        break;
+    case IR_DIV:
+    case IR_MOD:
+        emit_idiv(ctx, instr);
+        if (pool[0] != X86_RAX) {
+            x86_emit(ctx->code, X86_MOV, 4, x86_reg(X86_RAX), x86_reg(pool[0]));
+        }
+        break;
     default:
         break;
     }
+}
+
+/* Computes the value `instr` defines into pool[0]. The left spine below it,
+ * such as a long `x + y * 3 - z`, is walked with an explicit stack rather than
+ * by recursion: the innermost value is computed first and the operators are
+ * then applied outwards, each computing its right operand (if any) in the
+ * registers left over. Only a heavier right side is evaluated first, and its
+ * depth is bounded by the pool. */
+static void emit_instr_into(CodegenContext *ctx, const IrInstr *instr, const X86Reg *pool, size_t pool_size) {
+    CodegenScratch *scratch = ctx->scratch;
+    size_t base = scratch->chain_count;
+    const IrInstr *innermost = instr;
+    for (;;) {
+        IrValue operand = chained_operand(ctx, innermost);
+        ChainStepKind kind = STEP_OPERAND;
+        if (operand == IR_NO_VALUE) {
+            if (innermost->op != IR_ADD && innermost->op != IR_SUB && innermost->op != IR_MUL) {
+                break;
+            }
+            size_t lhs = registers_needed(ctx, innermost->args[0]);
+            size_t rhs = registers_needed(ctx, innermost->args[1]);
+            if (combined_need(lhs, rhs) > pool_size) {
+                /* Out of registers: park the right value on the stack and use
+                 * it as a memory operand, so only one temporary ever lives in
+                 * memory per level. */
+                emit_value_into(ctx, innermost->args[1], pool, pool_size);
+                x86_emit(ctx->code, X86_PUSH, 8, x86_reg(pool[0]), x86_none());
+                kind = STEP_SPILLED;
+            } else if (lhs >= rhs) {
+                /* Heavier side first while every register is free; the right
+                 * side then fits in the registers that remain. */
+                kind = STEP_REGISTER;
+            } else {
+                break;
+            }
+            operand = innermost->args[0];
+        }
+        if (push_chain_step(ctx, innermost, operand, kind) != 0) {
+            scratch->chain_count = base;
+            return;
+        }
+        if (is_leaf(ctx, operand)) {
+            x86_emit(ctx->code, X86_MOV, 4, leaf_operand(ctx, operand), x86_reg(pool[0]));
+            innermost = NULL;
+            break;
+        }
+        innermost = ctx->values[operand].def;
+    }
 
-    return -1;
+    if (innermost) {
+        emit_innermost(ctx, innermost, pool, pool_size);
+    }
+    while (scratch->chain_count > base) {
+        ChainStep step = scratch->chain[--scratch->chain_count];
+        switch (step.kind) {
+        case STEP_OPERAND:
+            finish_with_operand(ctx, step.instr, step.operand, pool);
+            break;
+        case STEP_REGISTER:
+            emit_value_into(ctx, step.instr->args[1], pool + 1, pool_size - 1);
+            emit_register_op(ctx, step.instr->op, pool[1], pool[0]);
+            break;
+        case STEP_SPILLED:
+            x86_emit(ctx->code, binary_opcode(step.instr->op), 4, x86_mem(X86_RSP, 0), x86_reg(pool[0]));
+            x86_emit(ctx->code, X86_ADD, 8, x86_imm(8), x86_reg(X86_RSP));
+            break;
+        }
+    }
 }
 
-static int emit_expression(const AstNode *node, CodegenContext *ctx) {
-    if (!node) {
-        return -1;
+/* Does evaluating `value` read a value that lives in `reg`? Left operands are
+ * followed in a loop, so long left-leaning chains do not recurse. */
+static int reads_register(const CodegenContext *ctx, IrValue value, X86Reg reg) {
+    for (;;) {
+        const ValueInfo *info = &ctx->values[value];
+        if (info->home != HOME_INLINE) {
+            return info->home == HOME_REGISTER && info->reg == reg;
+        }
+        const IrInstr *instr = info->def;
+        switch (instr->op) {
+        case IR_ADD:
+        case IR_SUB:
+        case IR_MUL:
+        case IR_DIV:
+        case IR_MOD:
+            if (reads_register(ctx, instr->args[1], reg)) {
+                return 1;
+            }
+            value = instr->args[0];
+            break;
+        case IR_NEG:
+            value = instr->args[0];
+            break;
+        default:
+            return 0;
+        }
     }
+}
 
-    switch (node->kind) {
-    case AST_NUMBER_LITERAL:
-        return emit_number_literal(node, ctx);
-    case AST_IDENTIFIER:
-        return emit_identifier(node, ctx);
-    case AST_UNARY_EXPR:
-        return emit_unary_expr(node, ctx);
-    case AST_BINARY_EXPR:
-        return emit_binary_expr(node, ctx);
+static int instr_reads_register(const CodegenContext *ctx, const IrInstr *instr, X86Reg reg) {
+    switch (instr->op) {
+    case IR_ADD:
+    case IR_SUB:
+    case IR_MUL:
+    case IR_DIV:
+    case IR_MOD:
+        return reads_register(ctx, instr->args[0], reg) || reads_register(ctx, instr->args[1], reg);
+    case IR_NEG:
+        return reads_register(ctx, instr->args[0], reg);
     default:
-        break;
+        return 0;
     }
+}
+
+static X86Operand home_operand(const ValueInfo *target) {
+    return (target->home == HOME_REGISTER) ? x86_reg(target->reg) : frame_slot(target->offset);
+}
 
-    return -1;
+static void emit_move_to_home(CodegenContext *ctx, X86Reg source, const ValueInfo *target) {
+    if (target->home == HOME_REGISTER && target->reg == source) {
+        return;
+    }
+    x86_emit(ctx->code, X86_MOV, 4, x86_reg(source), home_operand(target));
 }
 
-static int emit_statement(const AstNode *node, CodegenContext *ctx);
+/* Computes a materialized value into its home, straight into the target's
+ * register when that cannot clobber an operand. */
+static void emit_value_definition(CodegenContext *ctx, const IrInstr *instr) {
+    const ValueInfo *target = &ctx->values[instr->dest];
 
-static int emit_return_stmt(const AstNode *node, CodegenContext *ctx) {
-    const AstNode *expr = node->value.return_stmt.expression;
-    if (emit_expression(expr, ctx) != 0) {
-        return -1;
+    if (target->home == HOME_REGISTER) {
+        X86Reg reg = target->reg;
+        if (!instr_reads_register(ctx, instr, reg)) {
+            X86Reg pool[MAX_POOL_SIZE];
+            pool[0] = reg;
+            memcpy(pool + 1, scratch_registers, sizeof(scratch_registers));
+            emit_instr_into(ctx, instr, pool, MAX_POOL_SIZE);
+            return;
+        }
+
+        /* `x = x + e` updates the register in place; so does `y = x + e` when y
+         * inherited x's register because x dies here, and `y = e + x`. The
+         * same goes for `*`, and for `/` and `%` by a constant. */
+        IrValue left = instr->args[0];
+        IrValue right = instr->args[1];
+        if (is_commutative(instr->op) && ctx->values[right].home == HOME_REGISTER && ctx->values[right].reg == reg) {
+            left = instr->args[1];
+            right = instr->args[0];
+        }
+        int in_place = ctx->values[left].home == HOME_REGISTER && ctx->values[left].reg == reg;
+        if (in_place && divides_by_constant(ctx, instr)) {
+            X86Reg pool[MAX_POOL_SIZE];
+            pool[0] = reg;
+            memcpy(pool + 1, scratch_registers, sizeof(scratch_registers));
+            emit_divide_constant(ctx, instr->op, constant_value(ctx, right), pool);
+            return;
+        }
+        if ((instr->op == IR_ADD || instr->op == IR_SUB || instr->op == IR_MUL) && in_place && !reads_register(ctx, right, reg)) {
+            if (instr->op == IR_MUL && is_constant(ctx, right)) {
+                emit_multiply_constant(ctx, reg, constant_value(ctx, right));
+                return;
+            }
+            if (is_leaf(ctx, right)) {
+                x86_emit(ctx->code, binary_opcode(instr->op), 4, leaf_operand(ctx, right), x86_reg(reg));
+                return;
+            }
+            emit_value_into(ctx, right, scratch_registers, SCRATCH_REGISTER_COUNT);
+            emit_register_op(ctx, instr->op, X86_RAX, reg);
+            return;
+        }
     }
 
-    if (fprintf(ctx->out, "    jmp %s\n", ctx->return_label) < 0) {
-        return -1;
+    emit_instr_into(ctx, instr, scratch_registers, SCRATCH_REGISTER_COUNT);
+    emit_move_to_home(ctx, X86_RAX, target);
+}
+
+/* Moves the phi operands for the edge `from` -> `to` into the phis' homes. All
+ * operands are pushed before any phi is written, which gives the copies the
+ * parallel semantics phis need. */
+static void emit_phi_copies(CodegenContext *ctx, uint32_t from, uint32_t to) {
+    const IrBlock *target = ctx->function->blocks[to];
+    size_t edge = 0;
+    while (edge < target->pred_count && target->preds[edge] != from) {
+        edge += 1;
+    }
+    if (target->phi_count == 0 || edge == target->pred_count) {
+        return;
     }
 
-    return 0;
+    for (size_t i = 0; i < target->phi_count; ++i) {
+        x86_emit(ctx->code, X86_PUSH, 8, leaf_operand(ctx, target->phis[i].u.phi_args[edge]), x86_none());
+    }
+    for (size_t i = target->phi_count; i-- > 0;) {
+        const ValueInfo *phi = &ctx->values[target->phis[i].dest];
+        if (phi->home == HOME_REGISTER) {
+            x86_emit(ctx->code, X86_POP, 8, x86_none(), x86_reg(phi->reg));
+        } else {
+            x86_emit(ctx->code, X86_POP, 8, x86_none(), x86_reg(X86_RAX));
+            emit_move_to_home(ctx, X86_RAX, phi);
+        }
+    }
+}
+
+/* ---- Value analysis and allocation ---- */
+
+/* Callee-saved registers available to values that outlive one expression;
+ * expression temporaries keep the caller-saved scratch registers to themselves. */
+static const X86Reg value_registers[] = {X86_RBX, X86_R12, X86_R13, X86_R14, X86_R15};
+
+#define VALUE_REGISTER_COUNT (sizeof(value_registers) / sizeof(value_registers[0]))
+
+static void note_use(CodegenContext *ctx, IrValue value, uint32_t point, uint32_t block) {
+    ValueInfo *info = &ctx->values[value];
+    info->uses += 1;
+    info->user_point = point;
+    info->user_block = block;
 }
 
-static int emit_statement(const AstNode *node, CodegenContext *ctx) {
-    switch (node->kind) {
-    case AST_RETURN_STMT:
-        return emit_return_stmt(node, ctx);
-    case AST_VAR_DECL: {
-        long offset = local_table_find(ctx->locals,
-                                       node->value.var_decl.name.name,
-                                       node->value.var_decl.name.length);
-        if (offset < 0) {
-            fprintf(stderr, "Codegen error: declaration for %.*s not in local table\n",
-                    (int)node->value.var_decl.name.length,
-                    node->value.var_decl.name.name);
+/* Numbers every instruction in layout order (a block's phis share the point
+ * before its first instruction), checks the CFG shape the backend supports and
+ * counts uses. */
+static int number_points(CodegenContext *ctx) {
+    const IrFunction *function = ctx->function;
+    uint32_t point = 0;
+    for (size_t b = 0; b < function->block_count; ++b) {
+        const IrBlock *block = function->blocks[b];
+        ctx->blocks[b].start = point;
+        point += (uint32_t)block->count + 1;
+        ctx->blocks[b].end = point - 1;
+        if (!ir_block_terminated(block)) {
+            codegen_error(ctx, "block bb%zu of %.*s has no terminator", b, (int)function->name_length, function->name);
             return -1;
         }
 
-        if (node->value.var_decl.initializer) {
-            if (emit_expression(node->value.var_decl.initializer, ctx) != 0) {
+        ctx->blocks[b].reachable = (b == 0);
+        for (size_t i = 0; i < block->pred_count && !ctx->blocks[b].reachable; ++i) {
+            ctx->blocks[b].reachable = block->preds[i] < b && ctx->blocks[block->preds[i]].reachable;
+        }
+
+        const IrInstr *last = &block->instrs[block->count - 1];
+        for (int t = 0; t < 2; ++t) {
+            if ((last->op == IR_JUMP && t == 1) || (last->op != IR_JUMP && last->op != IR_BRANCH)) {
+                break;
+            }
+            uint32_t target = last->u.targets[t];
+            if (target <= b) {
+                /* codegen.h: the IR must be acyclic with blocks in topological order. */
+                codegen_error(ctx, "branch from bb%zu to bb%u in %.*s: blocks must be acyclic and in topological order",
+                              b, target, (int)function->name_length, function->name);
                 return -1;
             }
-        } else {
-            if (fprintf(ctx->out, "    movl $0, %%eax\n") < 0) {
+            if (last->op == IR_BRANCH && function->blocks[target]->phi_count > 0) {
+                codegen_error(ctx, "critical edge into bb%u of %.*s", target, (int)function->name_length, function->name);
                 return -1;
             }
         }
+    }
 
-        if (fprintf(ctx->out, "    movl %%eax, -%ld(%%rbp)\n", offset) < 0) {
-            return -1;
+    for (size_t b = 0; b < function->block_count; ++b) {
+        const IrBlock *block = function->blocks[b];
+        if (!ctx->blocks[b].reachable) {
+            continue;
+        }
+        for (size_t i = 0; i < block->phi_count; ++i) {
+            const IrInstr *phi = &block->phis[i];
+            ctx->values[phi->dest].def = phi;
+            ctx->values[phi->dest].def_point = ctx->blocks[b].start;
+            ctx->values[phi->dest].def_block = (uint32_t)b;
+            for (size_t p = 0; p < block->pred_count; ++p) {
+                if (ctx->blocks[block->preds[p]].reachable) {
+                    note_use(ctx, phi->u.phi_args[p], ctx->blocks[block->preds[p]].end, block->preds[p]);
+                    ctx->values[phi->u.phi_args[p]].phi_use = 1;
+                }
+            }
+        }
+        for (size_t i = 0; i < block->count; ++i) {
+            const IrInstr *instr = &block->instrs[i];
+            uint32_t at = ctx->blocks[b].start + 1 + (uint32_t)i;
+            if (instr->dest != IR_NO_VALUE) {
+                ctx->values[instr->dest].def = instr;
+                ctx->values[instr->dest].def_point = at;
+                ctx->values[instr->dest].def_block = (uint32_t)b;
+            }
+            for (int a = 0; a < 2; ++a) {
+                if (instr->op != IR_PHI && instr->args[a] != IR_NO_VALUE) {
+                    note_use(ctx, instr->args[a], at, (uint32_t)b);
+                }
+            }
         }
-        return 0;
     }
-    case AST_ASSIGNMENT: {
-        long offset = local_table_find(ctx->locals,
-                                       node->value.assignment.target.name,
-                                       node->value.assignment.target.length);
-        if (offset < 0) {
-            fprintf(stderr, "Codegen error: assignment to undeclared identifier %.*s\n",
-                    (int)node->value.assignment.target.length,
-                    node->value.assignment.target.name);
-            return -1;
+    return 0;
+}
+
+/* Is `value` the operand a ret, branch or store evaluates first, with every
+ * scratch register free? Only there can an idiv be emitted inline. */
+static int used_at_statement_level(const CodegenContext *ctx, IrValue value) {
+    const ValueInfo *info = &ctx->values[value];
+    const IrInstr *user = &ctx->function->blocks[info->user_block]->instrs[info->user_point - ctx->blocks[info->user_block].start - 1];
+    return (user->op == IR_RET || user->op == IR_BRANCH || user->op == IR_STORE_SLOT) && user->args[0] == value;
+}
+
+/* A pure value with one use later in its own block is folded into that user's
+ * expression tree, unless it was assigned to a source variable: those keep a
+ * home so expression trees stay statement-sized. */
+static void choose_inlining(CodegenContext *ctx) {
+    const IrFunction *function = ctx->function;
+    for (uint32_t v = 0; v < function->value_count; ++v) {
+        ValueInfo *info = &ctx->values[v];
+        info->home = (info->def && info->def->op == IR_CONST) ? HOME_CONSTANT : HOME_FRAME;
+    }
+    for (uint32_t v = 0; v < function->value_count; ++v) {
+        ValueInfo *info = &ctx->values[v];
+        if (!info->def || info->home == HOME_CONSTANT) {
+            continue; /* defined in an unreachable block, or an immediate */
         }
+        IrOp op = info->def->op;
+        int inlinable = op == IR_ADD || op == IR_SUB || op == IR_MUL || op == IR_NEG || op == IR_GLOBAL || op == IR_LOAD_SLOT ||
+                   divides_by_constant(ctx, info->def);
+        if (!inlinable && (op == IR_DIV || op == IR_MOD)) {
+            inlinable = info->uses == 1 && !info->phi_use && used_at_statement_level(ctx, v);
+        }
+        if (inlinable && info->uses == 1 && !info->phi_use && info->user_block == info->def_block &&
+            function->value_vars[v] == IR_NO_VAR) {
+            info->home = HOME_INLINE;
+        }
+        /* Otherwise HOME_FRAME until assign_homes picks a real home. */
+    }
 
-        if (emit_expression(node->value.assignment.value, ctx) != 0) {
-            return -1;
+    /* An inlined instruction is emitted with the root of its tree. */
+    for (size_t b = function->block_count; b-- > 0;) {
+        const IrBlock *block = function->blocks[b];
+        if (!ctx->blocks[b].reachable) {
+            continue;
         }
+        ctx->emit_at[ctx->blocks[b].start] = ctx->blocks[b].start;
+        for (size_t i = block->count; i-- > 0;) {
+            uint32_t at = ctx->blocks[b].start + 1 + (uint32_t)i;
+            IrValue dest = block->instrs[i].dest;
+            int inlined = dest != IR_NO_VALUE && ctx->values[dest].home == HOME_INLINE;
+            ctx->emit_at[at] = inlined ? ctx->emit_at[ctx->values[dest].user_point] : at;
+        }
+    }
+}
 
-        if (fprintf(ctx->out, "    movl %%eax, -%ld(%%rbp)\n", offset) < 0) {
-            return -1;
+/* A slot load folded into a later tree must not move past a store to the same
+ * slot; such loads are given a home of their own. */
+static void keep_loads_before_stores(CodegenContext *ctx) {
+    const IrFunction *function = ctx->function;
+    uint32_t *pending = ctx->scratch->words;
+    for (uint32_t s = 0; s < function->slot_count; ++s) {
+        pending[s] = IR_NO_VALUE;
+    }
+
+    for (size_t b = 0; b < function->block_count; ++b) {
+        const IrBlock *block = function->blocks[b];
+        if (!ctx->blocks[b].reachable) {
+            continue;
+        }
+        for (size_t i = 0; i < block->count; ++i) {
+            const IrInstr *instr = &block->instrs[i];
+            uint32_t at = ctx->blocks[b].start + 1 + (uint32_t)i;
+            if (instr->op == IR_LOAD_SLOT && ctx->values[instr->dest].home == HOME_INLINE) {
+                ctx->values[instr->dest].next_pending = pending[instr->u.slot];
+                pending[instr->u.slot] = instr->dest;
+            } else if (instr->op == IR_STORE_SLOT) {
+                for (IrValue v = pending[instr->u.slot]; v != IR_NO_VALUE; v = ctx->values[v].next_pending) {
+                    if (ctx->emit_at[ctx->values[v].def_point] > at) {
+                        ctx->values[v].home = HOME_FRAME;
+                        ctx->emit_at[ctx->values[v].def_point] = ctx->values[v].def_point;
+                    }
+                }
+                pending[instr->u.slot] = IR_NO_VALUE;
+            }
         }
-        return 0;
     }
-    case AST_BLOCK: {
-        for (size_t i = 0; i < node->value.block.statement_count; ++i) {
-            if (emit_statement(node->value.block.statements[i], ctx) != 0) {
-                return -1;
+}
+
+static int has_home(const ValueInfo *info) {
+    return info->def && (info->home == HOME_REGISTER || info->home == HOME_FRAME);
+}
+
+/* A value's home is read where its users' trees are emitted; phi operands are
+ * read by the copies at the end of the predecessor. */
+static void compute_live_ranges(CodegenContext *ctx) {
+    const IrFunction *function = ctx->function;
+    for (uint32_t v = 0; v < function->value_count; ++v) {
+        ctx->values[v].last_point = ctx->values[v].def_point;
+    }
+
+    for (size_t b = 0; b < function->block_count; ++b) {
+        const IrBlock *block = function->blocks[b];
+        if (!ctx->blocks[b].reachable) {
+            continue;
+        }
+        for (size_t i = 0; i < block->phi_count; ++i) {
+            for (size_t p = 0; p < block->pred_count; ++p) {
+                ValueInfo *arg = &ctx->values[block->phis[i].u.phi_args[p]];
+                uint32_t end = ctx->blocks[block->preds[p]].end;
+                if (ctx->blocks[block->preds[p]].reachable && arg->last_point < end) {
+                    arg->last_point = end;
+                }
+            }
+        }
+        for (size_t i = 0; i < block->count; ++i) {
+            const IrInstr *instr = &block->instrs[i];
+            uint32_t read_at = ctx->emit_at[ctx->blocks[b].start + 1 + (uint32_t)i];
+            for (int a = 0; a < 2; ++a) {
+                if (instr->args[a] != IR_NO_VALUE && ctx->values[instr->args[a]].last_point < read_at) {
+                    ctx->values[instr->args[a]].last_point = read_at;
+                }
             }
         }
-        return 0;
     }
-    default:
-        fprintf(stderr, "Codegen error: unsupported statement kind %d\n", node->kind);
-        return -1;
+}
+
+/* Frame layout produced by assign_homes. */
+typedef struct FrameLayout {
+    long bytes; /* bytes of slots below the return address */
+    long size;  /* `bytes` rounded up to 16 */
+    X86Reg saved[VALUE_REGISTER_COUNT];
+    long save_offsets[VALUE_REGISTER_COUNT];
+    size_t saved_count;
+} FrameLayout;
+
+static long align_to(long value, long alignment);
+
+#define SLOT_OWNER 0x80000000u
+
+static int compare_slot_ranges(const void *lhs, const void *rhs) {
+    const SlotRange *a = lhs;
+    const SlotRange *b = rhs;
+    if (a->start != b->start) {
+        return (a->start < b->start) ? -1 : 1;
     }
+    return (a->slot < b->slot) ? -1 : (a->slot > b->slot);
 }
 
-static int collect_locals_block(const AstNode *block, LocalTable *table, long *offset) {
-    for (size_t i = 0; i < block->value.block.statement_count; ++i) {
-        const AstNode *stmt = block->value.block.statements[i];
-        switch (stmt->kind) {
-        case AST_VAR_DECL: {
-            *offset += 8; /* reserve 8 bytes for 4-byte int to keep alignment simple */
-            if (local_table_add(table,
-                                stmt->value.var_decl.name.name,
-                                stmt->value.var_decl.name.length,
-                                *offset) != 0) {
-                return -1;
+/* Live ranges of the IR slots that are still accessed, sorted by start. */
+static size_t collect_slot_ranges(CodegenContext *ctx, SlotRange *ranges) {
+    const IrFunction *function = ctx->function;
+    for (uint32_t s = 0; s < function->slot_count; ++s) {
+        ranges[s].start = UINT32_MAX;
+        ranges[s].end = 0;
+        ranges[s].slot = s;
+    }
+    for (size_t b = 0; b < function->block_count; ++b) {
+        const IrBlock *block = function->blocks[b];
+        if (!ctx->blocks[b].reachable) {
+            continue;
+        }
+        for (size_t i = 0; i < block->count; ++i) {
+            const IrInstr *instr = &block->instrs[i];
+            if (instr->op != IR_LOAD_SLOT && instr->op != IR_STORE_SLOT) {
+                continue;
             }
-            break;
+            uint32_t at = ctx->blocks[b].start + 1 + (uint32_t)i;
+            SlotRange *range = &ranges[instr->u.slot];
+            uint32_t end = (instr->op == IR_LOAD_SLOT) ? ctx->emit_at[at] : at;
+            range->start = (at < range->start) ? at : range->start;
+            range->end = (end > range->end) ? end : range->end;
         }
-        case AST_BLOCK:
-            if (collect_locals_block(stmt, table, offset) != 0) {
-                return -1;
+    }
+
+    size_t count = 0;
+    for (uint32_t s = 0; s < function->slot_count; ++s) {
+        if (ranges[s].start != UINT32_MAX) {
+            ranges[count++] = ranges[s];
+        }
+    }
+    qsort(ranges, count, sizeof(SlotRange), compare_slot_ranges);
+    return count;
+}
+
+/* Gives the spilled values (`spilled`, in definition order) and the IR slots
+ * 4-byte frame slots below `base`. Their live intervals are colored with an
+ * unbounded linear scan, so ranges that never overlap, like the locals of
+ * sibling blocks, share a slot and the frame only grows with the number of
+ * values live at once. Returns the bytes used, or -1 on allocation failure. */
+static long pack_frame_slots(CodegenContext *ctx, const IrValue *spilled, size_t spilled_count, long base) {
+    CodegenScratch *scratch = ctx->scratch;
+    size_t slot_count = collect_slot_ranges(ctx, scratch->slot_ranges);
+    LiveInterval *intervals = scratch->intervals;
+    uint32_t *owners = scratch->owners;
+
+    /* Merge the two start-sorted lists. */
+    size_t count = 0;
+    size_t v = 0;
+    size_t s = 0;
+    while (v < spilled_count || s < slot_count) {
+        const SlotRange *range = (s < slot_count) ? &scratch->slot_ranges[s] : NULL;
+        if (v < spilled_count && (!range || ctx->values[spilled[v]].def_point <= range->start)) {
+            intervals[count].start = ctx->values[spilled[v]].def_point;
+            intervals[count].end = ctx->values[spilled[v]].last_point;
+            owners[count++] = spilled[v++];
+        } else {
+            intervals[count].start = range->start;
+            intervals[count].end = range->end;
+            owners[count++] = SLOT_OWNER | range->slot;
+            s += 1;
+        }
+    }
+    if (regalloc_linear_scan(intervals, count, count) < 0) {
+        return -1;
+    }
+
+    long colors = 0;
+    for (size_t i = 0; i < count; ++i) {
+        long offset = base + 4 * ((long)intervals[i].reg + 1);
+        if (owners[i] & SLOT_OWNER) {
+            scratch->slot_offsets[owners[i] & ~SLOT_OWNER] = offset;
+        } else {
+            ctx->values[owners[i]].offset = offset;
+        }
+        colors = (intervals[i].reg + 1 > colors) ? intervals[i].reg + 1 : colors;
+    }
+    return 4 * colors;
+}
+
+/* At -O0 IR slots take the first frame slots, 8 bytes each in creation order,
+ * and every other value with a home gets the next one. From -O1 values go
+ * through linear scan over their live ranges; the callee-saved registers it
+ * hands out are saved at the top of the frame, and the values it spills share
+ * packed 4-byte slots with the IR slots. */
+static int assign_homes(CodegenContext *ctx, int opt_level, FrameLayout *frame) {
+    const IrFunction *function = ctx->function;
+    long slots = function->slot_count;
+    memset(frame, 0, sizeof(*frame));
+
+    /* Values in definition order, as linear scan wants them. */
+    IrValue *order = ctx->scratch->words;
+    LiveInterval *intervals = ctx->scratch->intervals;
+
+    size_t count = 0;
+    for (size_t b = 0; b < function->block_count; ++b) {
+        const IrBlock *block = function->blocks[b];
+        if (!ctx->blocks[b].reachable) {
+            continue;
+        }
+        for (size_t i = 0; i < block->phi_count; ++i) {
+            order[count++] = block->phis[i].dest;
+        }
+        for (size_t i = 0; i < block->count; ++i) {
+            IrValue dest = block->instrs[i].dest;
+            if (dest != IR_NO_VALUE && has_home(&ctx->values[dest])) {
+                order[count++] = dest;
             }
-            break;
-        default:
-            break;
         }
     }
+
+    if (opt_level <= 0) {
+        for (uint32_t s = 0; s < function->slot_count; ++s) {
+            ctx->scratch->slot_offsets[s] = 8 * ((long)s + 1);
+        }
+        for (size_t i = 0; i < count; ++i) {
+            ctx->values[order[i]].home = HOME_FRAME;
+            ctx->values[order[i]].offset = 8 * ++slots;
+        }
+        frame->bytes = 8 * slots;
+        frame->size = align_to(frame->bytes, 16);
+        return 0;
+    }
+
+    for (size_t i = 0; i < count; ++i) {
+        intervals[i].start = ctx->values[order[i]].def_point;
+        intervals[i].end = ctx->values[order[i]].last_point;
+    }
+    if (regalloc_linear_scan(intervals, count, VALUE_REGISTER_COUNT) < 0) {
+        return -1;
+    }
+
+    /* Spilled values keep their definition order at the front of `order`. */
+    unsigned used = 0;
+    size_t spilled = 0;
+    for (size_t i = 0; i < count; ++i) {
+        ValueInfo *info = &ctx->values[order[i]];
+        if (intervals[i].reg == REGALLOC_SPILLED) {
+            info->home = HOME_FRAME;
+            order[spilled++] = order[i];
+        } else {
+            info->home = HOME_REGISTER;
+            info->reg = value_registers[intervals[i].reg];
+            used |= 1u << intervals[i].reg;
+        }
+    }
+
+    for (size_t r = 0; r < VALUE_REGISTER_COUNT; ++r) {
+        if (used & (1u << r)) {
+            frame->saved[frame->saved_count] = value_registers[r];
+            frame->save_offsets[frame->saved_count] = 8 * ((long)frame->saved_count + 1);
+            frame->saved_count += 1;
+        }
+    }
+
+    long base = 8 * (long)frame->saved_count;
+    long packed = pack_frame_slots(ctx, order, spilled, base);
+    if (packed < 0) {
+        return -1;
+    }
+    frame->bytes = base + packed;
+    frame->size = align_to(frame->bytes, 16);
     return 0;
 }
 
+static void emit_register_saves(X86Code *code, const FrameLayout *frame, int restore) {
+    for (size_t i = 0; i < frame->saved_count; ++i) {
+        X86Operand reg = x86_reg(frame->saved[i]);
+        X86Operand slot = frame_slot(frame->save_offsets[i]);
+        x86_emit(code, X86_MOV, 8, restore ? slot : reg, restore ? reg : slot);
+    }
+}
+
 static long align_to(long value, long alignment) {
     long remainder = value % alignment;
     if (remainder == 0) {
@@ -300,97 +1252,835 @@ static long align_to(long value, long alignment) {
     return value + (alignment - remainder);
 }
 
-static int emit_function(const AstNode *node, FILE *out) {
-    char *name = NULL;
-    if (copy_lexeme(node->value.function_decl.name.name, node->value.function_decl.name.length, &name) != 0) {
+/* Next reachable block after `b` in layout order, or block_count. */
+static size_t next_reachable(const CodegenContext *ctx, size_t b) {
+    do {
+        b += 1;
+    } while (b < ctx->function->block_count && !ctx->blocks[b].reachable);
+    return b;
+}
+
+static void emit_terminator(CodegenContext *ctx, size_t b, const IrInstr *instr) {
+    const IrFunction *function = ctx->function;
+    size_t next = next_reachable(ctx, b);
+    switch (instr->op) {
+    case IR_RET:
+        if (instr->args[0] != IR_NO_VALUE) {
+            emit_value_into(ctx, instr->args[0], scratch_registers, SCRATCH_REGISTER_COUNT);
+        } else if (next == function->block_count) {
+            break; /* falls into the epilogue */
+        }
+        x86_emit(ctx->code, X86_JMP, 8, x86_label(X86_RETURN_LABEL), x86_none());
+        break;
+    case IR_JUMP:
+        emit_phi_copies(ctx, (uint32_t)b, instr->u.targets[0]);
+        if (instr->u.targets[0] != next) {
+            x86_emit(ctx->code, X86_JMP, 8, x86_label(instr->u.targets[0]), x86_none());
+        }
+        break;
+    case IR_BRANCH:
+        emit_value_into(ctx, instr->args[0], scratch_registers, SCRATCH_REGISTER_COUNT);
+        x86_emit(ctx->code, X86_TEST, 4, x86_reg(X86_RAX), x86_reg(X86_RAX));
+        x86_emit(ctx->code, X86_JNE, 8, x86_label(instr->u.targets[0]), x86_none());
+        if (instr->u.targets[1] != next) {
+            x86_emit(ctx->code, X86_JMP, 8, x86_label(instr->u.targets[1]), x86_none());
+        }
+        break;
+    default:
+        break;
+    }
+}
+
+static void emit_body(CodegenContext *ctx) {
+    const IrFunction *function = ctx->function;
+    for (size_t b = 0; b < function->block_count; ++b) {
+        const IrBlock *block = function->blocks[b];
+        if (!ctx->blocks[b].reachable) {
+            continue;
+        }
+        if (b != 0) {
+            x86_emit(ctx->code, X86_LABEL, 8, x86_label((uint32_t)b), x86_none());
+        }
+
+        for (size_t i = 0; i + 1 < block->count; ++i) {
+            const IrInstr *instr = &block->instrs[i];
+            if (instr->op == IR_STORE_SLOT) {
+                emit_value_into(ctx, instr->args[0], scratch_registers, SCRATCH_REGISTER_COUNT);
+                x86_emit(ctx->code, X86_MOV, 4, x86_reg(X86_RAX), slot_home(ctx, instr->u.slot));
+            } else if (instr->dest != IR_NO_VALUE && has_home(&ctx->values[instr->dest])) {
+                emit_value_definition(ctx, instr);
+            }
+        }
+        emit_terminator(ctx, b, &block->instrs[block->count - 1]);
+    }
+}
+
+/* Grows `*buffer` to hold `count` elements; existing contents are not kept. */
+static int scratch_reserve(void **buffer, size_t *capacity, size_t count, size_t element_size) {
+    if (count <= *capacity) {
+        return 0;
+    }
+    size_t grown = (*capacity * 2 > count) ? *capacity * 2 : count;
+    void *resized = malloc(grown * element_size);
+    if (!resized) {
         return -1;
     }
+    free(*buffer);
+    *buffer = resized;
+    *capacity = grown;
+    return 0;
+}
 
-    int status = 0;
-    LocalTable locals = {0};
-    long stack_usage = 0;
+static void scratch_init(CodegenScratch *scratch) {
+    memset(scratch, 0, sizeof(*scratch));
+    emitter_init(&scratch->cache_key, NULL);
+    emitter_init(&scratch->cache_entry, NULL);
+}
 
-    if (node->value.function_decl.body && node->value.function_decl.body->kind == AST_BLOCK) {
-        if (collect_locals_block(node->value.function_decl.body, &locals, &stack_usage) != 0) {
-            status = -1;
-            goto cleanup;
+static void scratch_free(CodegenScratch *scratch) {
+    arena_destroy(scratch->arena);
+    x86_code_free(&scratch->code);
+    free(scratch->values);
+    free(scratch->blocks);
+    free(scratch->emit_at);
+    free(scratch->words);
+    free(scratch->intervals);
+    free(scratch->owners);
+    free(scratch->slot_ranges);
+    free(scratch->slot_offsets);
+    free(scratch->chain);
+    emitter_free(&scratch->cache_key);
+    emitter_free(&scratch->cache_entry);
+    code_cache_names_free(&scratch->cache_names);
+    free(scratch->cache_sorted);
+    free(scratch->cache_relocs);
+    scratch_init(scratch);
+}
+
+/* System V lets a function use the 128 bytes below %rsp without moving it. */
+#define RED_ZONE_SIZE 128
+
+static int pushes_anything(const X86Code *code) {
+    for (size_t i = 0; i < code->count; ++i) {
+        if (code->instrs[i].op == X86_PUSH) {
+            return 1;
         }
     }
+    return 0;
+}
 
-    long aligned_stack = align_to(stack_usage, 16);
+/* Frame slots are emitted as -offset(%rbp), relative to the address below the
+ * return address. Without a frame pointer %rsp sits `stack_size` bytes lower
+ * after the prologue, and further down by whatever expression spills and phi
+ * copies have pushed, so each slot is re-based on %rsp at that depth. */
+static void address_frame_from_rsp(X86Code *code, long stack_size) {
+    long depth = 0;
+    for (size_t i = 0; i < code->count; ++i) {
+        X86Instr *instr = &code->instrs[i];
+        X86Operand *operands[2] = {&instr->src, &instr->dst};
+        for (int k = 0; k < 2; ++k) {
+            if (operands[k]->kind == X86_OPERAND_MEM && operands[k]->reg == X86_RBP) {
+                *operands[k] = x86_mem(X86_RSP, (int32_t)(stack_size + depth + operands[k]->u.disp));
+            }
+        }
+        if (instr->op == X86_PUSH) {
+            depth += 8;
+        } else if (instr->op == X86_POP) {
+            depth -= 8;
+        } else if (instr->op == X86_ADD && instr->dst.kind == X86_OPERAND_REG && instr->dst.reg == X86_RSP &&
+                   instr->src.kind == X86_OPERAND_IMM) {
+            depth -= (long)instr->src.u.imm;
+        }
+    }
+}
 
-    static int label_counter = 0;
-    char return_label[64];
-    snprintf(return_label, sizeof(return_label), ".Lreturn_%d", label_counter++);
+static void set_instr(X86Code *code, size_t index, X86Opcode op, X86Operand src, X86Operand dst) {
+    X86Instr *instr = &code->instrs[index];
+    instr->op = (uint8_t)op;
+    instr->width = 8;
+    instr->src = src;
+    instr->dst = dst;
+}
 
-    if (fprintf(out, ".globl %s\n%s:\n", name, name) < 0) {
-        status = -1;
-        goto cleanup;
+/* The function goes to `object` as machine code when that is non-NULL, and to
+ * `out` as assembly otherwise. */
+static int emit_ir_function(const IrFunction *function,
+                            Emitter *out,
+                            X86Object *object,
+                            Emitter *diag,
+                            const CodegenOptions *options,
+                            CodegenScratch *scratch) {
+    int opt_level = options->opt_level;
+    size_t values = (size_t)function->value_count + 1;
+    size_t blocks = function->block_count;
+    size_t points = blocks;
+    for (size_t b = 0; b < blocks; ++b) {
+        points += function->blocks[b]->count;
     }
+    size_t slots = (size_t)function->slot_count + 1;
+    size_t words = (values > slots) ? values : slots;
 
-    if (fprintf(out, "    push %%rbp\n    mov %%rsp, %%rbp\n") < 0) {
-        status = -1;
-        goto cleanup;
+    if (blocks == 0 ||
+        scratch_reserve((void **)&scratch->values, &scratch->value_capacity, values, sizeof(ValueInfo)) != 0 ||
+        scratch_reserve((void **)&scratch->blocks, &scratch->block_capacity, blocks, sizeof(BlockInfo)) != 0 ||
+        scratch_reserve((void **)&scratch->emit_at, &scratch->point_capacity, points, sizeof(uint32_t)) != 0 ||
+        scratch_reserve((void **)&scratch->words, &scratch->word_capacity, words, sizeof(uint32_t)) != 0 ||
+        scratch_reserve((void **)&scratch->intervals, &scratch->interval_capacity, values + slots, sizeof(LiveInterval)) != 0 ||
+        scratch_reserve((void **)&scratch->owners, &scratch->owner_capacity, values + slots, sizeof(uint32_t)) != 0 ||
+        scratch_reserve((void **)&scratch->slot_ranges, &scratch->slot_range_capacity, slots, sizeof(SlotRange)) != 0 ||
+        scratch_reserve((void **)&scratch->slot_offsets, &scratch->slot_offset_capacity, slots, sizeof(long)) != 0) {
+        return -1;
     }
+    memset(scratch->values, 0, values * sizeof(ValueInfo));
 
-    if (aligned_stack > 0) {
-        if (fprintf(out, "    sub $%ld, %%rsp\n", aligned_stack) < 0) {
-            status = -1;
-            goto cleanup;
+    x86_code_reset(&scratch->code);
+    CodegenContext ctx = {
+        .code = &scratch->code,
+        .diag = diag,
+        .function = function,
+        .scratch = scratch,
+        .values = scratch->values,
+        .blocks = scratch->blocks,
+        .emit_at = scratch->emit_at,
+        .slot_offsets = scratch->slot_offsets,
+    };
+
+    FrameLayout frame;
+    if (number_points(&ctx) != 0) {
+        return -1;
+    }
+    choose_inlining(&ctx);
+    keep_loads_before_stores(&ctx);
+    compute_live_ranges(&ctx);
+    if (assign_homes(&ctx, opt_level, &frame) != 0) {
+        return -1;
+    }
+    memoize_register_needs(&ctx);
+
+    /* The prologue is filled in once the body shows whether it pushes. */
+    X86Code *code = &scratch->code;
+    size_t prologue = 3;
+    for (size_t i = 0; i < prologue; ++i) {
+        x86_emit(code, X86_NOP, 8, x86_none(), x86_none());
+    }
+    emit_register_saves(code, &frame, 0);
+    emit_body(&ctx);
+    x86_emit(code, X86_LABEL, 8, x86_label(X86_RETURN_LABEL), x86_none());
+    emit_register_saves(code, &frame, 1);
+    if (code->failed) {
+        return -1;
+    }
+
+    /* From -O1 every function is a leaf, so %rbp is not needed: slots are
+     * addressed from %rsp, and a frame that fits the red zone is used without
+     * moving %rsp at all unless the body pushes into that same area. */
+    int omit_frame_pointer = opt_level > 0 && !options->keep_frame_pointer;
+    long stack_size = frame.size;
+    if (omit_frame_pointer && frame.bytes <= RED_ZONE_SIZE && !pushes_anything(code)) {
+        stack_size = 0;
+    }
+    if (!omit_frame_pointer) {
+        set_instr(code, 0, X86_PUSH, x86_reg(X86_RBP), x86_none());
+        set_instr(code, 1, X86_MOV, x86_reg(X86_RSP), x86_reg(X86_RBP));
+    }
+    if (stack_size > 0) {
+        set_instr(code, 2, X86_SUB, x86_imm(stack_size), x86_reg(X86_RSP));
+    }
+    if (!omit_frame_pointer) {
+        x86_emit(code, X86_LEAVE, 8, x86_none(), x86_none());
+    } else {
+        address_frame_from_rsp(code, stack_size);
+        if (stack_size > 0) {
+            x86_emit(code, X86_ADD, 8, x86_imm(stack_size), x86_reg(X86_RSP));
         }
     }
+    x86_emit(code, X86_RET, 8, x86_none(), x86_none());
+    if (code->failed) {
+        return -1;
+    }
 
-    CodegenContext ctx = {
-        .out = out,
-        .locals = &locals,
-        .return_label = return_label,
+    if (opt_level > 0) {
+        peephole_optimize(code, &scratch->peephole);
+    }
+
+    if (object) {
+        return x86_encode_function(object, code, function->name, function->name_length);
+    }
+    emitter_text(out, ".globl ");
+    emitter_view(out, function->name, function->name_length);
+    emitter_char(out, '\n');
+    emitter_view(out, function->name, function->name_length);
+    emitter_text(out, ":\n");
+    x86_print_code(code, function->name, function->name_length, out);
+    emitter_newline(out);
+    return 0;
+}
+
+static int lower_function(const AstTranslationUnit *unit,
+                          AstNodeId node,
+                          Emitter *out,
+                          X86Object *object,
+                          Emitter *diag,
+                          const CodegenOptions *options,
+                          CodegenScratch *scratch) {
+    int opt_level = options->opt_level;
+    if (scratch->arena) {
+        arena_reset(scratch->arena);
+    } else if (!(scratch->arena = arena_create(IR_ARENA_CHUNK_SIZE))) {
+        return -1;
+    }
+
+    IrLocalMode mode = (opt_level > 0) ? IR_LOCALS_AS_VALUES : IR_LOCALS_IN_SLOTS;
+    IrFunction *function = ir_lower_function(unit, node, scratch->arena, mode, diag);
+    if (!function || (opt_level > 0 && eliminate_dead_code(function, &scratch->dce) != 0)) {
+        return -1;
+    }
+    return emit_ir_function(function, out, object, diag, options, scratch);
+}
+
+/* Everything besides the AST that changes the code emitted for a function. */
+static uint64_t cache_variant(const CodegenOptions *options) {
+    return (uint64_t)(uint32_t)options->opt_level << 16 | (uint64_t)(options->keep_frame_pointer != 0) << 8 |
+           (uint64_t)options->format;
+}
+
+/* Object entries: text length, relocation count, then per relocation its
+ * offset, addend and the index of its global among the key's names, then the
+ * text. Assembly entries are the function's text as printed. */
+#define CACHED_RELOC_SIZE 12
+
+static void put_le32(uint8_t *bytes, uint32_t value) {
+    for (int i = 0; i < 4; ++i) {
+        bytes[i] = (uint8_t)(value >> (8 * i));
+    }
+}
+
+static uint32_t get_le32(const uint8_t *bytes) {
+    return (uint32_t)bytes[0] | (uint32_t)bytes[1] << 8 | (uint32_t)bytes[2] << 16 | (uint32_t)bytes[3] << 24;
+}
+
+static void reset_buffer(Emitter *buffer) {
+    if (buffer->failed) {
+        emitter_free(buffer);
+        emitter_init(buffer, NULL);
+    }
+    buffer->length = 0;
+}
+
+static void flush_when_full(Emitter *out) {
+    if (out->sink && out->length >= out->flush_threshold) {
+        emitter_flush(out);
+    }
+}
+
+/* Appends a cached object entry as the encoder would have. Returns 1 when the
+ * entry does not fit this function, so it is lowered instead. */
+static int replay_cached_object(const AstIdentifier *name, X86Object *object, CodegenScratch *scratch) {
+    const Emitter *entry = &scratch->cache_entry;
+    const CodeCacheNames *names = &scratch->cache_names;
+    const uint8_t *bytes = (const uint8_t *)entry->data;
+    if (entry->length < 8) {
+        return 1;
+    }
+    size_t text_length = get_le32(bytes);
+    size_t reloc_count = get_le32(bytes + 4);
+    if ((entry->length - 8) / CACHED_RELOC_SIZE < reloc_count ||
+        entry->length - 8 - reloc_count * CACHED_RELOC_SIZE != text_length ||
+        scratch_reserve((void **)&scratch->cache_relocs, &scratch->cache_reloc_capacity, reloc_count, sizeof(X86Reloc)) != 0) {
+        return 1;
+    }
+    for (size_t i = 0; i < reloc_count; ++i) {
+        const uint8_t *field = bytes + 8 + i * CACHED_RELOC_SIZE;
+        uint32_t offset = get_le32(field);
+        uint32_t index = get_le32(field + 8);
+        if (text_length < 4 || offset > text_length - 4 || index >= names->count) {
+            return 1;
+        }
+        const AstIdentifier *global = names->items[index];
+        scratch->cache_relocs[i] = (X86Reloc){offset, (int32_t)get_le32(field + 4), global->name, (uint32_t)global->length};
+    }
+
+    X86Symbol symbol = {0, (uint32_t)text_length, name->name, (uint32_t)name->length};
+    X86Object cached;
+    x86_object_init(&cached);
+    cached.text = (uint8_t *)bytes + 8 + reloc_count * CACHED_RELOC_SIZE;
+    cached.text_length = text_length;
+    cached.relocs = scratch->cache_relocs;
+    cached.reloc_count = reloc_count;
+    cached.symbols = &symbol;
+    cached.symbol_count = 1;
+    return x86_object_append(object, &cached);
+}
+
+static int compare_cached_names(const void *lhs, const void *rhs) {
+    const CachedName *a = lhs;
+    const CachedName *b = rhs;
+    return (a->name > b->name) - (a->name < b->name);
+}
+
+/* Serializes the function the encoder just appended to `object` at
+ * `text_start`/`reloc_start`. Returns -1 when it cannot be cached. */
+static int build_object_entry(const X86Object *object, size_t text_start, size_t reloc_start, CodegenScratch *scratch) {
+    const CodeCacheNames *names = &scratch->cache_names;
+    if (object->reloc_count > reloc_start) {
+        if (names->count == 0 ||
+            scratch_reserve((void **)&scratch->cache_sorted, &scratch->cache_sorted_capacity, names->count, sizeof(CachedName)) != 0) {
+            return -1;
+        }
+        for (size_t i = 0; i < names->count; ++i) {
+            scratch->cache_sorted[i] = (CachedName){(uintptr_t)names->items[i]->name, (uint32_t)i};
+        }
+        qsort(scratch->cache_sorted, names->count, sizeof(CachedName), compare_cached_names);
+    }
+
+    Emitter *entry = &scratch->cache_entry;
+    reset_buffer(entry);
+    uint8_t field[CACHED_RELOC_SIZE];
+    put_le32(field, (uint32_t)(object->text_length - text_start));
+    put_le32(field + 4, (uint32_t)(object->reloc_count - reloc_start));
+    emitter_view(entry, (const char *)field, 8);
+    for (size_t i = reloc_start; i < object->reloc_count; ++i) {
+        const X86Reloc *reloc = &object->relocs[i];
+        CachedName probe = {(uintptr_t)reloc->name, 0};
+        const CachedName *found = bsearch(&probe, scratch->cache_sorted, names->count, sizeof(CachedName), compare_cached_names);
+        if (!found) {
+            return -1;
+        }
+        put_le32(field, reloc->offset - (uint32_t)text_start);
+        put_le32(field + 4, (uint32_t)reloc->addend);
+        put_le32(field + 8, found->index);
+        emitter_view(entry, (const char *)field, CACHED_RELOC_SIZE);
+    }
+    emitter_view(entry, (const char *)object->text + text_start, object->text_length - text_start);
+    return entry->failed ? -1 : 0;
+}
+
+/* Looks the function up in the code cache before lowering it, and stores what
+ * lowering produced on a miss. Only functions that compiled without a
+ * diagnostic are stored. */
+static int emit_cached_function(const AstTranslationUnit *unit,
+                                AstNodeId node,
+                                Emitter *out,
+                                X86Object *object,
+                                Emitter *diag,
+                                const CodegenOptions *options,
+                                CodegenScratch *scratch) {
+    const CodeCache *cache = options->cache;
+    Emitter *entry = &scratch->cache_entry;
+    Hash128 key;
+    reset_buffer(&scratch->cache_key);
+    if (code_cache_key(cache, unit, node, cache_variant(options), &scratch->cache_key, &scratch->cache_names, &key) != 0) {
+        scratch->cache.misses += 1;
+        return lower_function(unit, node, out, object, diag, options, scratch);
+    }
+
+    reset_buffer(entry);
+    if (code_cache_load(cache, key, entry) == 0) {
+        int status = 0;
+        if (!object) {
+            emitter_view(out, entry->data, entry->length);
+            flush_when_full(out);
+        } else {
+            const AstIdentifier *name = ast_name(unit, ast_node(unit, node)->value.function_decl.name);
+            status = replay_cached_object(name, object, scratch);
+        }
+        if (status <= 0) {
+            scratch->cache.hits += 1;
+            return status;
+        }
+    }
+    scratch->cache.misses += 1;
+
+    if (object) {
+        size_t text_start = object->text_length;
+        size_t reloc_start = object->reloc_count;
+        int status = lower_function(unit, node, NULL, object, diag, options, scratch);
+        if (status == 0 && !object->failed && diag->length == 0 &&
+            build_object_entry(object, text_start, reloc_start, scratch) == 0) {
+            code_cache_store(cache, key, entry->data, entry->length);
+        }
+        return status;
+    }
+
+    /* Assembly goes through a private buffer: `out` may flush mid-function. */
+    reset_buffer(entry);
+    int status = lower_function(unit, node, entry, NULL, diag, options, scratch);
+    if (status != 0 || entry->failed) {
+        return -1;
+    }
+    if (diag->length == 0) {
+        code_cache_store(cache, key, entry->data, entry->length);
+    }
+    emitter_view(out, entry->data, entry->length);
+    flush_when_full(out);
+    return 0;
+}
+
+static int emit_function(const AstTranslationUnit *unit,
+                         AstNodeId node,
+                         Emitter *out,
+                         X86Object *object,
+                         Emitter *diag,
+                         const CodegenOptions *options,
+                         CodegenScratch *scratch) {
+    if (ast_node(unit, node)->kind != AST_FUNCTION_DECL) {
+        return -1;
+    }
+    return options->cache ? emit_cached_function(unit, node, out, object, diag, options, scratch)
+                          : lower_function(unit, node, out, object, diag, options, scratch);
+}
+
+typedef struct FunctionOutput {
+    Emitter code;
+    X86Object object; /* CODEGEN_OBJECT instead of `code` */
+    Emitter diag;
+    int status;
+} FunctionOutput;
+
+typedef struct ParallelCodegen {
+    const AstTranslationUnit *unit;
+    FunctionOutput *outputs;
+    CodegenScratch *scratch; /* one per worker thread */
+    const CodegenOptions *options;
+    int encode; /* machine code into each output's object instead of assembly */
+} ParallelCodegen;
+
+static void lower_function_task(void *context, unsigned worker, size_t index) {
+    ParallelCodegen *job = context;
+    FunctionOutput *output = &job->outputs[index];
+
+    emitter_init(&output->code, NULL);
+    emitter_init(&output->diag, NULL);
+    x86_object_init(&output->object);
+    X86Object *object = job->encode ? &output->object : NULL;
+    output->status = emit_function(job->unit, ast_function(job->unit, (uint32_t)index), &output->code, object,
+                                   &output->diag, job->options, &job->scratch[worker]);
+}
+
+/* Writes a diagnostics buffer to the caller's stream and releases it. */
+static void drain_diagnostics(Emitter *diag, FILE *stream) {
+    if (diag->length > 0 && stream) {
+        fwrite(diag->data, 1, diag->length, stream);
+    }
+    emitter_free(diag);
+}
+
+/* Hands a worker's counters to whoever asked for them. */
+static void add_scratch_stats(const CodegenScratch *scratch, const CodegenOptions *options) {
+    if (options->peephole_stats) {
+        peephole_stats_add(options->peephole_stats, &scratch->peephole);
+    }
+    if (options->dce_stats) {
+        options->dce_stats->instructions += scratch->dce.instructions;
+        options->dce_stats->slots += scratch->dce.slots;
+    }
+    if (options->cache_stats) {
+        options->cache_stats->hits += scratch->cache.hits;
+        options->cache_stats->misses += scratch->cache.misses;
+    }
+}
+
+/* Function names already defined, as a flag per SymbolId. A stream keeps one
+ * across its units, which share an interner. */
+typedef struct DefinedFunctions {
+    unsigned char *seen;
+    size_t capacity;
+} DefinedFunctions;
+
+/* Stores in `*index` the position of the first function of `unit` whose name
+ * was defined before it, or the function count when every name is new, and
+ * marks the names up to there as defined. Returns -1 when out of memory. */
+static int find_redefinition(const AstTranslationUnit *unit, DefinedFunctions *defined, uint32_t *index) {
+    const AstNodeId *functions = ast_children(unit, unit->functions);
+    uint32_t i = 0;
+    for (; i < unit->functions.count; ++i) {
+        const AstNode *func = ast_node(unit, functions[i]);
+        SymbolId symbol = func->kind == AST_FUNCTION_DECL ? ast_name(unit, func->value.function_decl.name)->symbol
+                                                          : SYMBOL_NONE;
+        if (symbol == SYMBOL_NONE) {
+            continue;
+        }
+        if (symbol >= defined->capacity) {
+            size_t capacity = defined->capacity ? defined->capacity : 256;
+            while (capacity <= symbol) {
+                capacity *= 2;
+            }
+            unsigned char *seen = realloc(defined->seen, capacity);
+            if (!seen) {
+                return -1;
+            }
+            memset(seen + defined->capacity, 0, capacity - defined->capacity);
+            defined->seen = seen;
+            defined->capacity = capacity;
+        }
+        if (defined->seen[symbol]) {
+            break;
+        }
+        defined->seen[symbol] = 1;
+    }
+    *index = i;
+    return 0;
+}
+
+/* A second definition would give the output two symbols of one name. */
+static void report_redefinition(const AstTranslationUnit *unit, uint32_t index, FILE *diagnostics) {
+    const AstNode *func = ast_node(unit, ast_function(unit, index));
+    const AstIdentifier *name = ast_name(unit, func->value.function_decl.name);
+    Emitter diag;
+    emitter_init(&diag, NULL);
+    CodegenContext ctx = {.diag = &diag};
+    codegen_error(&ctx, "duplicate definition of function '%.*s'", (int)name->length, name->name);
+    drain_diagnostics(&diag, diagnostics);
+}
+
+/* Emits the unit's functions in order, stopping at the first failure. */
+static int emit_unit_functions(const AstTranslationUnit *unit,
+                               Emitter *out,
+                               X86Object *object,
+                               const CodegenOptions *options,
+                               CodegenScratch *scratch,
+                               DefinedFunctions *defined) {
+    uint32_t redefined;
+    if (find_redefinition(unit, defined, &redefined) != 0) {
+        return -1;
+    }
+
+    /* The functions are one contiguous run of ids: a linear walk. */
+    const AstNodeId *functions = ast_children(unit, unit->functions);
+    int status = 0;
+    for (uint32_t i = 0; i < unit->functions.count && status == 0; ++i) {
+        if (i == redefined) {
+            report_redefinition(unit, i, options->diagnostics);
+            return -1;
+        }
+        Emitter diag;
+        emitter_init(&diag, NULL);
+        status = emit_function(unit, functions[i], out, object, &diag, options, scratch);
+        drain_diagnostics(&diag, options->diagnostics);
+    }
+    return status;
+}
+
+static int emit_functions_sequential(const AstTranslationUnit *unit, Emitter *out, X86Object *object, const CodegenOptions *options) {
+    CodegenScratch scratch;
+    DefinedFunctions defined = {NULL, 0};
+    scratch_init(&scratch);
+    int status = emit_unit_functions(unit, out, object, options, &scratch, &defined);
+    add_scratch_stats(&scratch, options);
+    scratch_free(&scratch);
+    free(defined.seen);
+    return status;
+}
+
+static int emit_functions_parallel(const AstTranslationUnit *unit,
+                                   Emitter *out,
+                                   X86Object *object,
+                                   const CodegenOptions *options,
+                                   unsigned threads) {
+    size_t count = unit->functions.count;
+    DefinedFunctions defined = {NULL, 0};
+    uint32_t redefined;
+    int found = find_redefinition(unit, &defined, &redefined);
+    free(defined.seen);
+    if (found != 0) {
+        return -1;
+    }
+    unsigned workers = parallel_worker_count(count, threads);
+    FunctionOutput *outputs = calloc(count, sizeof(FunctionOutput));
+    CodegenScratch *scratch = calloc(workers, sizeof(CodegenScratch));
+    if (!outputs || !scratch) {
+        free(outputs);
+        free(scratch);
+        return -1;
+    }
+
+    ParallelCodegen job = {
+        .unit = unit,
+        .outputs = outputs,
+        .scratch = scratch,
+        .options = options,
+        .encode = object != NULL,
     };
+    parallel_for_workers(count, threads, lower_function_task, &job);
+    for (unsigned i = 0; i < workers; ++i) {
+        add_scratch_stats(&scratch[i], options);
+        scratch_free(&scratch[i]);
+    }
+    free(scratch);
 
-    if (node->value.function_decl.body) {
-        if (emit_statement(node->value.function_decl.body, &ctx) != 0) {
+    /* Concatenate in source order; stop at the first failure like the sequential path. */
+    int status = 0;
+    for (size_t i = 0; i < count; ++i) {
+        FunctionOutput *output = &outputs[i];
+        if (status == 0 && i == redefined) {
+            report_redefinition(unit, (uint32_t)i, options->diagnostics);
             status = -1;
-            goto cleanup;
         }
+        if (status == 0) {
+            drain_diagnostics(&output->diag, options->diagnostics);
+            if (output->status != 0 || output->code.failed) {
+                status = -1;
+            } else if (object) {
+                status = x86_object_append(object, &output->object);
+            } else {
+                emitter_view(out, output->code.data, output->code.length);
+                emitter_flush(out);
+            }
+        }
+        emitter_free(&output->code);
+        x86_object_free(&output->object);
+        emitter_free(&output->diag);
     }
 
-    if (fprintf(out, "%s:\n", return_label) < 0) {
-        status = -1;
-        goto cleanup;
+    free(outputs);
+    return status;
+}
+
+void codegen_options_init(CodegenOptions *options) {
+    options->threads = 1;
+    options->diagnostics = stderr;
+    options->opt_level = 0;
+    options->keep_frame_pointer = 0;
+    options->format = CODEGEN_ASSEMBLY;
+    options->peephole_stats = NULL;
+    options->dce_stats = NULL;
+    options->cache = NULL;
+    options->cache_stats = NULL;
+}
+
+int codegen_emit_translation_unit(const AstTranslationUnit *unit, FILE *out) {
+    CodegenOptions options;
+    codegen_options_init(&options);
+    return codegen_emit_translation_unit_with_options(unit, out, &options);
+}
+
+int codegen_emit_ir_function(const IrFunction *function, FILE *out, const CodegenOptions *options) {
+    if (!function || !out || !options) {
+        return -1;
     }
 
-    if (fprintf(out, "    leave\n    ret\n\n") < 0) {
+    CodegenScratch scratch;
+    Emitter emitter;
+    Emitter diag;
+    scratch_init(&scratch);
+    emitter_init(&emitter, out);
+    emitter_init(&diag, NULL);
+    int status = emit_ir_function(function, &emitter, NULL, &diag, options, &scratch);
+    drain_diagnostics(&diag, options->diagnostics);
+    add_scratch_stats(&scratch, options);
+    scratch_free(&scratch);
+    if (emitter_finish(&emitter) != 0) {
         status = -1;
-        goto cleanup;
     }
-
-cleanup:
-    local_table_free(&locals);
-    free(name);
+    emitter_free(&emitter);
     return status;
 }
 
-int codegen_emit_translation_unit(const AstNode *unit, FILE *out) {
-    if (!unit || unit->kind != AST_TRANSLATION_UNIT || !out) {
+int codegen_encode_translation_unit(const AstTranslationUnit *unit, X86Object *object, const CodegenOptions *options) {
+    if (!unit || !object || !options) {
         return -1;
     }
+    unsigned threads = options->threads ? options->threads : parallel_default_threads();
+    return (threads > 1 && unit->functions.count > 1) ? emit_functions_parallel(unit, NULL, object, options, threads)
+                                                      : emit_functions_sequential(unit, NULL, object, options);
+}
 
-    if (fprintf(out, ".text\n") < 0) {
+int codegen_emit_translation_unit_with_options(const AstTranslationUnit *unit, FILE *out, const CodegenOptions *options) {
+    if (!unit || !out || !options) {
         return -1;
     }
 
-    for (size_t i = 0; i < unit->value.translation_unit.function_count; ++i) {
-        const AstNode *func = unit->value.translation_unit.functions[i];
-        if (!func || func->kind != AST_FUNCTION_DECL) {
-            return -1;
+    if (options->format == CODEGEN_OBJECT) {
+        X86Object object;
+        x86_object_init(&object);
+        int status = codegen_encode_translation_unit(unit, &object, options);
+        if (status == 0) {
+            status = elf_write_object(&object, out);
         }
-        if (emit_function(func, out) != 0) {
-            return -1;
+        x86_object_free(&object);
+        return status;
+    }
+
+    unsigned threads = options->threads ? options->threads : parallel_default_threads();
+
+    Emitter emitter;
+    emitter_init(&emitter, out);
+    emitter_text(&emitter, ".text\n");
+
+    int status = (threads > 1 && unit->functions.count > 1)
+                     ? emit_functions_parallel(unit, &emitter, NULL, options, threads)
+                     : emit_functions_sequential(unit, &emitter, NULL, options);
+
+    if (status == 0) {
+        emitter_text(&emitter, ".section .note.GNU-stack,\"\",@progbits\n");
+        status = emitter_finish(&emitter);
+    }
+
+    emitter_free(&emitter);
+    return status;
+}
+
+struct CodegenStream {
+    CodegenOptions options;
+    FILE *out;
+    Emitter emitter;  /* assembly, written through to `out` as it fills */
+    X86Object object; /* CODEGEN_OBJECT: kept until the ELF file is written */
+    CodegenScratch scratch;
+    DefinedFunctions defined; /* across every unit added so far */
+    int status;
+};
+
+CodegenStream *codegen_stream_open(FILE *out, const CodegenOptions *options) {
+    if (!out || !options) {
+        return NULL;
+    }
+    CodegenStream *stream = malloc(sizeof(*stream));
+    if (!stream) {
+        return NULL;
+    }
+    stream->options = *options;
+    stream->out = out;
+    stream->status = 0;
+    emitter_init(&stream->emitter, out);
+    x86_object_init(&stream->object);
+    scratch_init(&stream->scratch);
+    stream->defined = (DefinedFunctions){NULL, 0};
+    if (options->format != CODEGEN_OBJECT) {
+        emitter_text(&stream->emitter, ".text\n");
+    }
+    return stream;
+}
+
+int codegen_stream_add(CodegenStream *stream, const AstTranslationUnit *unit) {
+    if (stream->status == 0) {
+        if (stream->options.format == CODEGEN_OBJECT) {
+            stream->status =
+                emit_unit_functions(unit, NULL, &stream->object, &stream->options, &stream->scratch, &stream->defined);
+        } else {
+            stream->status =
+                emit_unit_functions(unit, &stream->emitter, NULL, &stream->options, &stream->scratch, &stream->defined);
         }
     }
+    return stream->status;
+}
 
-    if (fprintf(out, ".section .note.GNU-stack,\"\",@progbits\n") < 0) {
+int codegen_stream_close(CodegenStream *stream) {
+    if (!stream) {
         return -1;
     }
+    int status = stream->status;
+    if (status == 0 && stream->options.format == CODEGEN_OBJECT) {
+        status = elf_write_object(&stream->object, stream->out);
+    } else if (status == 0) {
+        emitter_text(&stream->emitter, ".section .note.GNU-stack,\"\",@progbits\n");
+        status = emitter_finish(&stream->emitter);
+    }
 
-    return 0;
+    add_scratch_stats(&stream->scratch, &stream->options);
+    scratch_free(&stream->scratch);
+    free(stream->defined.seen);
+    x86_object_free(&stream->object);
+    emitter_free(&stream->emitter);
+    free(stream);
+    return status;
 }
@@ -0,0 +1,233 @@
+#include "backend/elf.h"
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "backend/emitter.h"
+
+/* The subset of the ELF64 format (System V gABI, x86-64 psABI) we write. */
+#define ELF_HEADER_SIZE 64
+#define ELF_SECTION_HEADER_SIZE 64
+#define ELF_SYMBOL_SIZE 24
+#define ELF_RELA_SIZE 24
+
+#define ELF_ET_REL 1
+#define ELF_EM_X86_64 62
+
+#define ELF_SHT_PROGBITS 1
+#define ELF_SHT_SYMTAB 2
+#define ELF_SHT_STRTAB 3
+#define ELF_SHT_RELA 4
+
+#define ELF_SHF_ALLOC 0x2
+#define ELF_SHF_EXECINSTR 0x4
+#define ELF_SHF_INFO_LINK 0x40
+
+#define ELF_STB_GLOBAL 1
+#define ELF_STT_NOTYPE 0
+#define ELF_STT_FUNC 2
+
+#define ELF_R_X86_64_PC32 2
+
+enum {
+    SECTION_NULL,
+    SECTION_TEXT,
+    SECTION_RELA_TEXT,
+    SECTION_SYMTAB,
+    SECTION_STRTAB,
+    SECTION_SHSTRTAB,
+    SECTION_NOTE_GNU_STACK,
+    SECTION_COUNT
+};
+
+static const char *const section_names[SECTION_COUNT] = {
+    "", ".text", ".rela.text", ".symtab", ".strtab", ".shstrtab", ".note.GNU-stack",
+};
+
+typedef struct ElfName {
+    const char *name;
+    uint32_t length;
+} ElfName;
+
+/* Symbol table contents: index 0 is the null symbol, then every function, then
+ * the undefined globals in order of first reference. */
+typedef struct ElfSymbols {
+    ElfName *names;
+    size_t count;
+} ElfSymbols;
+
+static void put_u8(Emitter *out, uint8_t value) {
+    emitter_char(out, (char)value);
+}
+
+static void put_u16(Emitter *out, uint16_t value) {
+    put_u8(out, (uint8_t)value);
+    put_u8(out, (uint8_t)(value >> 8));
+}
+
+static void put_u32(Emitter *out, uint32_t value) {
+    put_u16(out, (uint16_t)value);
+    put_u16(out, (uint16_t)(value >> 16));
+}
+
+static void put_u64(Emitter *out, uint64_t value) {
+    put_u32(out, (uint32_t)value);
+    put_u32(out, (uint32_t)(value >> 32));
+}
+
+static void pad_to(Emitter *out, uint64_t *offset, uint64_t alignment) {
+    while (*offset % alignment != 0) {
+        put_u8(out, 0);
+        *offset += 1;
+    }
+}
+
+static void put_section_header(Emitter *out,
+                               uint32_t name,
+                               uint32_t type,
+                               uint64_t flags,
+                               uint64_t offset,
+                               uint64_t size,
+                               uint32_t link,
+                               uint32_t info,
+                               uint64_t alignment,
+                               uint64_t entry_size) {
+    put_u32(out, name);
+    put_u32(out, type);
+    put_u64(out, flags);
+    put_u64(out, 0); /* sh_addr */
+    put_u64(out, offset);
+    put_u64(out, size);
+    put_u32(out, link);
+    put_u32(out, info);
+    put_u64(out, alignment);
+    put_u64(out, entry_size);
+}
+
+static void write_file(Emitter *out, const X86Object *object, const ElfSymbols *symbols, const uint32_t *reloc_symbols) {
+    uint32_t section_name_offsets[SECTION_COUNT];
+    uint64_t shstrtab_size = 0;
+    for (int s = 0; s < SECTION_COUNT; ++s) {
+        section_name_offsets[s] = (uint32_t)shstrtab_size;
+        shstrtab_size += strlen(section_names[s]) + 1;
+    }
+    uint64_t strtab_size = 1;
+    for (size_t i = 1; i < symbols->count; ++i) {
+        strtab_size += symbols->names[i].length + 1;
+    }
+
+    /* Layout: header, .text, then the 8-aligned tables, strings and finally the
+     * section headers. */
+    uint64_t text_offset = ELF_HEADER_SIZE;
+    uint64_t rela_offset = (text_offset + object->text_length + 7) & ~(uint64_t)7;
+    uint64_t rela_size = (uint64_t)object->reloc_count * ELF_RELA_SIZE;
+    uint64_t symtab_offset = rela_offset + rela_size;
+    uint64_t symtab_size = (uint64_t)symbols->count * ELF_SYMBOL_SIZE;
+    uint64_t strtab_offset = symtab_offset + symtab_size;
+    uint64_t shstrtab_offset = strtab_offset + strtab_size;
+    uint64_t section_headers_offset = (shstrtab_offset + shstrtab_size + 7) & ~(uint64_t)7;
+
+    static const uint8_t ident[16] = {0x7F, 'E', 'L', 'F', 2 /* 64-bit */, 1 /* little endian */, 1 /* version */};
+    emitter_view(out, (const char *)ident, sizeof(ident));
+    put_u16(out, ELF_ET_REL);
+    put_u16(out, ELF_EM_X86_64);
+    put_u32(out, 1);
+    put_u64(out, 0); /* e_entry */
+    put_u64(out, 0); /* e_phoff */
+    put_u64(out, section_headers_offset);
+    put_u32(out, 0); /* e_flags */
+    put_u16(out, ELF_HEADER_SIZE);
+    put_u16(out, 0); /* e_phentsize */
+    put_u16(out, 0); /* e_phnum */
+    put_u16(out, ELF_SECTION_HEADER_SIZE);
+    put_u16(out, SECTION_COUNT);
+    put_u16(out, SECTION_SHSTRTAB);
+
+    uint64_t offset = text_offset;
+    emitter_view(out, (const char *)object->text, object->text_length);
+    offset += object->text_length;
+    pad_to(out, &offset, 8);
+
+    for (size_t i = 0; i < object->reloc_count; ++i) {
+        const X86Reloc *reloc = &object->relocs[i];
+        put_u64(out, reloc->offset);
+        put_u64(out, (uint64_t)reloc_symbols[i] << 32 | ELF_R_X86_64_PC32);
+        put_u64(out, (uint64_t)(int64_t)reloc->addend);
+    }
+
+    uint32_t name_offset = 1;
+    for (size_t i = 0; i < symbols->count; ++i) {
+        const X86Symbol *function = (i >= 1 && i <= object->symbol_count) ? &object->symbols[i - 1] : NULL;
+        put_u32(out, i == 0 ? 0 : name_offset);
+        put_u8(out, i == 0 ? 0 : (uint8_t)(ELF_STB_GLOBAL << 4 | (function ? ELF_STT_FUNC : ELF_STT_NOTYPE)));
+        put_u8(out, 0); /* default visibility */
+        put_u16(out, function ? SECTION_TEXT : 0);
+        put_u64(out, function ? function->offset : 0);
+        put_u64(out, function ? function->size : 0);
+        if (i > 0) {
+            name_offset += symbols->names[i].length + 1;
+        }
+    }
+
+    put_u8(out, 0);
+    for (size_t i = 1; i < symbols->count; ++i) {
+        emitter_view(out, symbols->names[i].name, symbols->names[i].length);
+        put_u8(out, 0);
+    }
+    for (int s = 0; s < SECTION_COUNT; ++s) {
+        emitter_view(out, section_names[s], strlen(section_names[s]) + 1);
+    }
+    offset = shstrtab_offset + shstrtab_size;
+    pad_to(out, &offset, 8);
+
+    put_section_header(out, 0, 0, 0, 0, 0, 0, 0, 0, 0);
+    put_section_header(out, section_name_offsets[SECTION_TEXT], ELF_SHT_PROGBITS, ELF_SHF_ALLOC | ELF_SHF_EXECINSTR, text_offset,
+                       object->text_length, 0, 0, 1, 0);
+    put_section_header(out, section_name_offsets[SECTION_RELA_TEXT], ELF_SHT_RELA, ELF_SHF_INFO_LINK, rela_offset, rela_size,
+                       SECTION_SYMTAB, SECTION_TEXT, 8, ELF_RELA_SIZE);
+    /* sh_info is the first non-local symbol; only the null symbol is local. */
+    put_section_header(out, section_name_offsets[SECTION_SYMTAB], ELF_SHT_SYMTAB, 0, symtab_offset, symtab_size, SECTION_STRTAB, 1,
+                       8, ELF_SYMBOL_SIZE);
+    put_section_header(out, section_name_offsets[SECTION_STRTAB], ELF_SHT_STRTAB, 0, strtab_offset, strtab_size, 0, 0, 1, 0);
+    put_section_header(out, section_name_offsets[SECTION_SHSTRTAB], ELF_SHT_STRTAB, 0, shstrtab_offset, shstrtab_size, 0, 0, 1, 0);
+    put_section_header(out, section_name_offsets[SECTION_NOTE_GNU_STACK], ELF_SHT_PROGBITS, 0, shstrtab_offset + shstrtab_size, 0,
+                       0, 0, 1, 0);
+}
+
+int elf_write_object(const X86Object *object, FILE *out) {
+    if (!object || !out || object->failed) {
+        return -1;
+    }
+
+    uint32_t *reloc_symbols = malloc((object->reloc_count + 1) * sizeof(uint32_t));
+    long name_count = reloc_symbols ? x86_object_number_names(object, reloc_symbols) : -1;
+    ElfSymbols symbols = {
+        .names = (name_count >= 0) ? malloc(((size_t)name_count + 1) * sizeof(ElfName)) : NULL,
+        .count = 1,
+    };
+    int status = symbols.names ? 0 : -1;
+
+    if (status == 0) {
+        for (size_t i = 0; i < object->symbol_count; ++i) {
+            symbols.names[symbols.count++] = (ElfName){object->symbols[i].name, object->symbols[i].length};
+        }
+        for (size_t i = 0; i < object->reloc_count; ++i) {
+            /* Symbol 0 is the null symbol, so names shift up by one. */
+            reloc_symbols[i] += 1;
+            if (reloc_symbols[i] == symbols.count) {
+                symbols.names[symbols.count++] = (ElfName){object->relocs[i].name, object->relocs[i].length};
+            }
+        }
+
+        Emitter emitter;
+        emitter_init(&emitter, out);
+        write_file(&emitter, object, &symbols, reloc_symbols);
+        status = emitter_finish(&emitter);
+        emitter_free(&emitter);
+    }
+
+    free(symbols.names);
+    free(reloc_symbols);
+    return status;
+}
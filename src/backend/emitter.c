@@ -0,0 +1,117 @@
+#include "backend/emitter.h"
+
+#include <stdlib.h>
+
+#define EMITTER_INITIAL_CAPACITY ((size_t)4096)
+#define EMITTER_FLUSH_THRESHOLD ((size_t)256 * 1024)
+
+typedef struct RegName {
+    const char *text;
+    size_t length;
+} RegName;
+
+#define REG_NAME(text) {text, sizeof(text) - 1}
+
+static const RegName reg32_names[X86_REG_COUNT] = {
+    REG_NAME("%eax"), REG_NAME("%ecx"), REG_NAME("%edx"), REG_NAME("%ebx"),
+    REG_NAME("%esp"), REG_NAME("%ebp"), REG_NAME("%esi"), REG_NAME("%edi"),
+    REG_NAME("%r8d"), REG_NAME("%r9d"), REG_NAME("%r10d"), REG_NAME("%r11d"),
+    REG_NAME("%r12d"), REG_NAME("%r13d"), REG_NAME("%r14d"), REG_NAME("%r15d"),
+};
+
+static const RegName reg64_names[X86_REG_COUNT] = {
+    REG_NAME("%rax"), REG_NAME("%rcx"), REG_NAME("%rdx"), REG_NAME("%rbx"),
+    REG_NAME("%rsp"), REG_NAME("%rbp"), REG_NAME("%rsi"), REG_NAME("%rdi"),
+    REG_NAME("%r8"), REG_NAME("%r9"), REG_NAME("%r10"), REG_NAME("%r11"),
+    REG_NAME("%r12"), REG_NAME("%r13"), REG_NAME("%r14"), REG_NAME("%r15"),
+};
+
+void emitter_init(Emitter *emitter, FILE *sink) {
+    emitter->data = NULL;
+    emitter->length = 0;
+    emitter->capacity = 0;
+    emitter->sink = sink;
+    emitter->flush_threshold = EMITTER_FLUSH_THRESHOLD;
+    emitter->bytes_written = 0;
+    emitter->failed = 0;
+}
+
+void emitter_free(Emitter *emitter) {
+    free(emitter->data);
+    emitter->data = NULL;
+    emitter->length = emitter->capacity = 0;
+}
+
+int emitter_reserve_slow(Emitter *emitter, size_t extra) {
+    if (emitter->failed) {
+        return -1;
+    }
+    if (emitter->capacity - emitter->length >= extra) {
+        return 0;
+    }
+
+    size_t needed = emitter->length + extra;
+    size_t capacity = emitter->capacity ? emitter->capacity : EMITTER_INITIAL_CAPACITY;
+    while (capacity < needed) {
+        capacity *= 2;
+    }
+
+    char *resized = realloc(emitter->data, capacity);
+    if (!resized) {
+        emitter->failed = 1;
+        return -1;
+    }
+    emitter->data = resized;
+    emitter->capacity = capacity;
+    return 0;
+}
+
+int emitter_flush(Emitter *emitter) {
+    if (emitter->failed) {
+        return -1;
+    }
+    if (!emitter->sink || emitter->length == 0) {
+        return 0;
+    }
+
+    /* One large fwrite bypasses stdio's own buffer and becomes a single write(2). */
+    if (fwrite(emitter->data, 1, emitter->length, emitter->sink) != emitter->length) {
+        emitter->failed = 1;
+        return -1;
+    }
+    emitter->bytes_written += emitter->length;
+    emitter->length = 0;
+    return 0;
+}
+
+int emitter_finish(Emitter *emitter) {
+    if (emitter_flush(emitter) != 0) {
+        return -1;
+    }
+    return emitter->failed ? -1 : 0;
+}
+
+void emitter_int(Emitter *emitter, long value) {
+    char digits[24];
+    size_t count = 0;
+    /* Work on the magnitude as unsigned so LONG_MIN does not overflow. */
+    unsigned long magnitude = (value < 0) ? 0ul - (unsigned long)value : (unsigned long)value;
+
+    do {
+        digits[sizeof(digits) - 1 - count++] = (char)('0' + magnitude % 10);
+        magnitude /= 10;
+    } while (magnitude != 0);
+
+    if (value < 0) {
+        digits[sizeof(digits) - 1 - count++] = '-';
+    }
+    emitter_view(emitter, digits + sizeof(digits) - count, count);
+}
+
+void emitter_reg32(Emitter *emitter, X86Reg reg) {
+    emitter_view(emitter, reg32_names[reg].text, reg32_names[reg].length);
+}
+
+void emitter_reg64(Emitter *emitter, X86Reg reg) {
+    emitter_view(emitter, reg64_names[reg].text, reg64_names[reg].length);
+}
@@ -0,0 +1,162 @@
+#define _DEFAULT_SOURCE /* MAP_ANONYMOUS */
+
+#include "backend/jit.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#if !defined(MAP_ANONYMOUS) && defined(MAP_ANON)
+#define MAP_ANONYMOUS MAP_ANON
+#endif
+
+#define JIT_GLOBAL_SIZE 4
+
+static size_t round_to_page(size_t size, size_t page) {
+    return (size + page - 1) / page * page;
+}
+
+static JitSymbol *find(JitSymbol *symbols, size_t count, const char *name, size_t length) {
+    for (size_t i = 0; i < count; ++i) {
+        if (symbols[i].length == length && memcmp(symbols[i].name, name, length) == 0) {
+            return &symbols[i];
+        }
+    }
+    return NULL;
+}
+
+static JitSymbol copy_name(char **next, const char *name, uint32_t length) {
+    JitSymbol symbol = {*next, length, NULL};
+    memcpy(*next, name, length);
+    *next += length;
+    return symbol;
+}
+
+/* Copies the function names and the names of the globals relocated against,
+ * in the numbering of x86_object_number_names (globals follow functions). */
+static int collect_symbols(JitModule *module, const X86Object *object, const uint32_t *targets) {
+    size_t name_bytes = 0;
+    for (size_t i = 0; i < object->symbol_count; ++i) {
+        name_bytes += object->symbols[i].length;
+    }
+    for (size_t i = 0; i < object->reloc_count; ++i) {
+        name_bytes += object->relocs[i].length;
+    }
+    module->names = malloc(name_bytes + 1);
+    module->functions = malloc((object->symbol_count + 1) * sizeof(JitSymbol));
+    module->globals = malloc((object->reloc_count + 1) * sizeof(JitSymbol));
+    if (!module->names || !module->functions || !module->globals) {
+        return -1;
+    }
+
+    char *next = module->names;
+    for (size_t i = 0; i < object->symbol_count; ++i) {
+        module->functions[module->function_count++] = copy_name(&next, object->symbols[i].name, object->symbols[i].length);
+    }
+    for (size_t i = 0; i < object->reloc_count; ++i) {
+        if (targets[i] == object->symbol_count + module->global_count) {
+            module->globals[module->global_count++] = copy_name(&next, object->relocs[i].name, object->relocs[i].length);
+        }
+    }
+    return 0;
+}
+
+int jit_load(JitModule *module, const X86Object *object) {
+    memset(module, 0, sizeof(*module));
+#if !defined(__x86_64__)
+    (void)object;
+    return -1;
+#else
+    uint32_t *targets = malloc((object->reloc_count + 1) * sizeof(uint32_t));
+    if (object->failed || !targets || x86_object_number_names(object, targets) < 0 ||
+        collect_symbols(module, object, targets) != 0) {
+        free(targets);
+        jit_unload(module);
+        return -1;
+    }
+
+    size_t page = (size_t)sysconf(_SC_PAGESIZE);
+    size_t text_size = round_to_page(object->text_length > 0 ? object->text_length : 1, page);
+    size_t data_size = round_to_page(module->global_count * JIT_GLOBAL_SIZE, page);
+    void *base = mmap(NULL, text_size + data_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (base == MAP_FAILED) {
+        free(targets);
+        jit_unload(module);
+        return -1;
+    }
+    module->base = base;
+    module->size = text_size + data_size;
+
+    memcpy(module->base, object->text, object->text_length);
+    for (size_t i = 0; i < module->function_count; ++i) {
+        module->functions[i].address = module->base + object->symbols[i].offset;
+    }
+    for (size_t i = 0; i < module->global_count; ++i) {
+        module->globals[i].address = module->base + text_size + i * JIT_GLOBAL_SIZE;
+    }
+
+    /* R_X86_64_PC32: the field holds target + addend - field address, and
+     * everything lives in one mapping, well within 32-bit reach. */
+    for (size_t i = 0; i < object->reloc_count; ++i) {
+        const X86Reloc *reloc = &object->relocs[i];
+        const JitSymbol *target = (targets[i] < module->function_count) ? &module->functions[targets[i]]
+                                                                        : &module->globals[targets[i] - module->function_count];
+        uint8_t *field = module->base + reloc->offset;
+        int32_t value = (int32_t)((intptr_t)target->address + reloc->addend - (intptr_t)field);
+        memcpy(field, &value, sizeof(value));
+    }
+    free(targets);
+
+    if (mprotect(module->base, text_size, PROT_READ | PROT_EXEC) != 0) {
+        jit_unload(module);
+        return -1;
+    }
+    return 0;
+#endif
+}
+
+int jit_load_translation_unit(JitModule *module, const AstTranslationUnit *unit, const CodegenOptions *options) {
+    X86Object object;
+    x86_object_init(&object);
+    int status = codegen_encode_translation_unit(unit, &object, options);
+    if (status == 0) {
+        status = jit_load(module, &object);
+    } else {
+        memset(module, 0, sizeof(*module));
+    }
+    x86_object_free(&object);
+    return status;
+}
+
+void jit_unload(JitModule *module) {
+    if (module->base) {
+        munmap(module->base, module->size);
+    }
+    free(module->functions);
+    free(module->globals);
+    free(module->names);
+    memset(module, 0, sizeof(*module));
+}
+
+void *jit_function(const JitModule *module, const char *name) {
+    JitSymbol *symbol = find(module->functions, module->function_count, name, strlen(name));
+    return symbol ? symbol->address : NULL;
+}
+
+int32_t *jit_global(const JitModule *module, const char *name) {
+    JitSymbol *symbol = find(module->globals, module->global_count, name, strlen(name));
+    return symbol ? symbol->address : NULL;
+}
+
+int jit_run_main(const JitModule *module, int *result) {
+    void *address = jit_function(module, "main");
+    if (!address) {
+        return -1;
+    }
+    /* ISO C has no object-to-function pointer conversion; copy the bits. */
+    int (*entry)(void);
+    memcpy(&entry, &address, sizeof(entry));
+    *result = entry();
+    return 0;
+}
@@ -0,0 +1,377 @@
+#include "backend/peephole.h"
+
+#include <stdint.h>
+
+/* Instructions scanned ahead when deciding whether a register is dead. */
+#define PEEPHOLE_LIVENESS_WINDOW 32
+
+/* Full passes over a function before giving up on reaching a fixed point. */
+#define PEEPHOLE_MAX_PASSES 8
+
+static const char *const rule_names[PEEPHOLE_RULE_COUNT] = {
+    [PEEPHOLE_REDUNDANT_MOVE] = "redundant-move",
+    [PEEPHOLE_STORE_LOAD] = "store-load",
+    [PEEPHOLE_COPY_FORWARD] = "copy-forward",
+    [PEEPHOLE_RETARGET] = "retarget",
+    [PEEPHOLE_JUMP_TO_NEXT] = "jump-to-next",
+    [PEEPHOLE_ADD_LEA] = "add-lea",
+    [PEEPHOLE_ZERO_XOR] = "zero-xor",
+};
+
+const char *peephole_rule_name(PeepholeRule rule) {
+    return ((unsigned)rule < PEEPHOLE_RULE_COUNT) ? rule_names[rule] : "?";
+}
+
+void peephole_stats_add(PeepholeStats *total, const PeepholeStats *stats) {
+    for (size_t r = 0; r < PEEPHOLE_RULE_COUNT; ++r) {
+        total->hits[r] += stats->hits[r];
+    }
+}
+
+/* Index of the first live instruction after `i`, or `count`. */
+static size_t next_instr(const X86Code *code, size_t i) {
+    do {
+        i += 1;
+    } while (i < code->count && code->instrs[i].op == X86_NOP);
+    return i;
+}
+
+/* Index of the last live instruction before `i`, or SIZE_MAX. */
+static size_t prev_instr(const X86Code *code, size_t i) {
+    while (i-- > 0) {
+        if (code->instrs[i].op != X86_NOP) {
+            return i;
+        }
+    }
+    return SIZE_MAX;
+}
+
+static int is_reg(const X86Operand *operand, X86Reg reg) {
+    return operand->kind == X86_OPERAND_REG && operand->reg == reg;
+}
+
+static int is_memory(const X86Operand *operand) {
+    return operand->kind == X86_OPERAND_MEM || operand->kind == X86_OPERAND_GLOBAL;
+}
+
+/* Caller-saved registers: expression temporaries that never hold a value past
+ * the statement that computed it. */
+static int is_scratch(X86Reg reg) {
+    return reg != X86_RBX && reg != X86_RSP && reg != X86_RBP && reg < X86_R12;
+}
+
+static int reads_reg(const X86Instr *instr, X86Reg reg) {
+    switch ((X86Opcode)instr->op) {
+    case X86_MOV:
+    case X86_LEA:
+        return x86_operand_uses(&instr->src, reg) || (instr->dst.kind == X86_OPERAND_MEM && instr->dst.reg == reg);
+    case X86_XOR:
+        if (x86_operand_equal(&instr->src, &instr->dst)) {
+            return 0; /* zeroing idiom */
+        }
+        return x86_operand_uses(&instr->src, reg) || x86_operand_uses(&instr->dst, reg);
+    case X86_ADD:
+    case X86_SUB:
+    case X86_AND:
+    case X86_IMUL:
+    case X86_TEST:
+        return x86_operand_uses(&instr->src, reg) || x86_operand_uses(&instr->dst, reg);
+    case X86_NEG:
+    case X86_SHL:
+    case X86_SAR:
+    case X86_SHR:
+        return x86_operand_uses(&instr->dst, reg);
+    case X86_MOVSXD:
+        return x86_operand_uses(&instr->src, reg);
+    case X86_CDQ:
+        return reg == X86_RAX;
+    case X86_IDIV:
+        return reg == X86_RAX || reg == X86_RDX || x86_operand_uses(&instr->src, reg);
+    case X86_PUSH:
+        return reg == X86_RSP || x86_operand_uses(&instr->src, reg);
+    case X86_POP:
+        return reg == X86_RSP;
+    default:
+        return 1;
+    }
+}
+
+/* Overwrites `reg` without reading its previous value. */
+static int defines_reg(const X86Instr *instr, X86Reg reg) {
+    switch ((X86Opcode)instr->op) {
+    case X86_MOV:
+    case X86_LEA:
+    case X86_MOVSXD:
+    case X86_POP:
+    case X86_XOR:
+        return is_reg(&instr->dst, reg);
+    case X86_CDQ:
+        return reg == X86_RDX;
+    default:
+        return 0;
+    }
+}
+
+/* Is `reg` overwritten before it is read again after instruction `i`? Unknown
+ * answers (window exhausted, end of code) count as live. */
+static int reg_dead_after(const X86Code *code, size_t i, X86Reg reg) {
+    size_t scanned = 0;
+    for (size_t j = next_instr(code, i); j < code->count && scanned < PEEPHOLE_LIVENESS_WINDOW; j = next_instr(code, j)) {
+        const X86Instr *instr = &code->instrs[j];
+        switch ((X86Opcode)instr->op) {
+        case X86_LABEL:
+        case X86_JMP:
+        case X86_JNE:
+        case X86_LEAVE:
+        case X86_RET:
+            return is_scratch(reg) && reg != X86_RAX;
+        default:
+            break;
+        }
+        if (reads_reg(instr, reg)) {
+            return 0;
+        }
+        if (defines_reg(instr, reg)) {
+            return 1;
+        }
+        scanned += 1;
+    }
+    return 0;
+}
+
+/* Flags are only consumed by a `jne` right after the instruction that set them. */
+static int flags_read_after(const X86Code *code, size_t i) {
+    size_t j = next_instr(code, i);
+    return j < code->count && code->instrs[j].op == X86_JNE;
+}
+
+static int is_move(const X86Instr *instr, unsigned width) {
+    return instr->op == X86_MOV && instr->width == width;
+}
+
+static int rule_redundant_move(X86Code *code, size_t i) {
+    X86Instr *first = &code->instrs[i];
+    if (first->op != X86_MOV) {
+        return 0;
+    }
+    if (first->dst.kind == X86_OPERAND_REG && x86_operand_equal(&first->src, &first->dst)) {
+        first->op = X86_NOP;
+        return 1;
+    }
+
+    size_t j = next_instr(code, i);
+    if (j == code->count || first->dst.kind != X86_OPERAND_REG || first->src.kind != X86_OPERAND_REG) {
+        return 0;
+    }
+    X86Instr *second = &code->instrs[j];
+    if (is_move(second, first->width) && x86_operand_equal(&second->src, &first->dst) &&
+        x86_operand_equal(&second->dst, &first->src)) {
+        second->op = X86_NOP;
+        return 1;
+    }
+    return 0;
+}
+
+static int rule_store_load(X86Code *code, size_t i) {
+    X86Instr *store = &code->instrs[i];
+    if (!is_move(store, 4) || store->src.kind != X86_OPERAND_REG || store->dst.kind != X86_OPERAND_MEM) {
+        return 0;
+    }
+    size_t j = next_instr(code, i);
+    if (j == code->count) {
+        return 0;
+    }
+    X86Instr *load = &code->instrs[j];
+    if (!is_move(load, 4) || load->dst.kind != X86_OPERAND_REG || !x86_operand_equal(&load->src, &store->dst)) {
+        return 0;
+    }
+    if (load->dst.reg == store->src.reg) {
+        load->op = X86_NOP;
+    } else {
+        load->src = store->src;
+    }
+    return 1;
+}
+
+static int rule_copy_forward(X86Code *code, size_t i) {
+    X86Instr *first = &code->instrs[i];
+    if (!is_move(first, 4) || first->dst.kind != X86_OPERAND_REG || !is_scratch((X86Reg)first->dst.reg)) {
+        return 0;
+    }
+    size_t j = next_instr(code, i);
+    if (j == code->count) {
+        return 0;
+    }
+    X86Instr *second = &code->instrs[j];
+    X86Reg temp = (X86Reg)first->dst.reg;
+    if (!is_move(second, 4) || !is_reg(&second->src, temp) || x86_operand_uses(&second->dst, temp)) {
+        return 0;
+    }
+    if (is_memory(&first->src) && is_memory(&second->dst)) {
+        return 0; /* x86 has no memory-to-memory move */
+    }
+    if (!reg_dead_after(code, j, temp)) {
+        return 0;
+    }
+    first->dst = second->dst;
+    second->op = X86_NOP;
+    return 1;
+}
+
+/* `<def> %t; ...; mov %t, %d` with %t dead afterwards computes into %d from
+ * the start when nothing in between touches %d. */
+static int rule_retarget(X86Code *code, size_t i) {
+    X86Instr *move = &code->instrs[i];
+    if (!is_move(move, 4) || move->src.kind != X86_OPERAND_REG || move->dst.kind != X86_OPERAND_REG ||
+        move->src.reg == move->dst.reg || !is_scratch((X86Reg)move->src.reg)) {
+        return 0;
+    }
+    X86Reg temp = (X86Reg)move->src.reg;
+    X86Reg target = (X86Reg)move->dst.reg;
+
+    size_t def = SIZE_MAX;
+    size_t scanned = 0;
+    for (size_t k = prev_instr(code, i); k != SIZE_MAX && scanned < PEEPHOLE_LIVENESS_WINDOW; k = prev_instr(code, k)) {
+        const X86Instr *instr = &code->instrs[k];
+        if (instr->width != 4 || instr->op == X86_PUSH || instr->op == X86_POP || instr->op == X86_LABEL ||
+            instr->op == X86_JMP || instr->op == X86_JNE || instr->op == X86_CDQ || instr->op == X86_IDIV) {
+            return 0; /* cltd and idiv use %eax and %edx implicitly */
+        }
+        if (defines_reg(instr, temp)) {
+            def = k; /* it may still read %d: that happens before %d is written */
+            break;
+        }
+        if (x86_operand_uses(&instr->src, target) || x86_operand_uses(&instr->dst, target)) {
+            return 0;
+        }
+        scanned += 1;
+    }
+    if (def == SIZE_MAX || !reg_dead_after(code, i, temp)) {
+        return 0;
+    }
+
+    for (size_t k = def; k < i; ++k) {
+        X86Instr *instr = &code->instrs[k];
+        if (is_reg(&instr->src, temp)) {
+            instr->src.reg = (uint8_t)target;
+        }
+        if (is_reg(&instr->dst, temp)) {
+            instr->dst.reg = (uint8_t)target;
+        }
+        /* Addresses after the definition read the new value too. */
+        if (k > def && instr->src.kind == X86_OPERAND_MEM) {
+            if (instr->src.reg == temp) {
+                instr->src.reg = (uint8_t)target;
+            }
+            if (instr->src.scale != 0 && instr->src.index == temp) {
+                instr->src.index = (uint8_t)target;
+            }
+        }
+    }
+    move->op = X86_NOP;
+    return 1;
+}
+
+static int rule_jump_to_next(X86Code *code, size_t i) {
+    X86Instr *jump = &code->instrs[i];
+    if (jump->op != X86_JMP) {
+        return 0;
+    }
+    for (size_t j = next_instr(code, i); j < code->count && code->instrs[j].op == X86_LABEL; j = next_instr(code, j)) {
+        if (code->instrs[j].src.u.label == jump->src.u.label) {
+            jump->op = X86_NOP;
+            return 1;
+        }
+    }
+    return 0;
+}
+
+static int rule_add_lea(X86Code *code, size_t i) {
+    X86Instr *move = &code->instrs[i];
+    if (!is_move(move, 4) || move->src.kind != X86_OPERAND_REG || move->dst.kind != X86_OPERAND_REG ||
+        move->src.reg == move->dst.reg) {
+        return 0;
+    }
+    size_t j = next_instr(code, i);
+    if (j == code->count) {
+        return 0;
+    }
+    X86Instr *add = &code->instrs[j];
+    if ((add->op != X86_ADD && add->op != X86_SUB) || add->width != 4 || add->src.kind != X86_OPERAND_IMM ||
+        !x86_operand_equal(&add->dst, &move->dst) || flags_read_after(code, j)) {
+        return 0;
+    }
+    int64_t displacement = (add->op == X86_ADD) ? add->src.u.imm : -add->src.u.imm;
+    if (displacement < INT32_MIN || displacement > INT32_MAX) {
+        return 0;
+    }
+    move->op = X86_LEA;
+    move->src = x86_mem((X86Reg)move->src.reg, (int32_t)displacement);
+    add->op = X86_NOP;
+    return 1;
+}
+
+static int rule_zero_xor(X86Code *code, size_t i) {
+    X86Instr *move = &code->instrs[i];
+    if (!is_move(move, 4) || move->src.kind != X86_OPERAND_IMM || move->src.u.imm != 0 ||
+        move->dst.kind != X86_OPERAND_REG || flags_read_after(code, i)) {
+        return 0;
+    }
+    move->op = X86_XOR;
+    move->src = move->dst;
+    return 1;
+}
+
+typedef int (*PeepholeRewrite)(X86Code *code, size_t i);
+
+/* Tried in order at every instruction. Rules that delete instructions come
+ * before the ones that only change encodings, so `mov $0, %eax` still folds into
+ * a following store before it can turn into `xor`. */
+static const PeepholeRewrite rules[PEEPHOLE_RULE_COUNT] = {
+    [PEEPHOLE_REDUNDANT_MOVE] = rule_redundant_move,
+    [PEEPHOLE_STORE_LOAD] = rule_store_load,
+    [PEEPHOLE_COPY_FORWARD] = rule_copy_forward,
+    [PEEPHOLE_RETARGET] = rule_retarget,
+    [PEEPHOLE_JUMP_TO_NEXT] = rule_jump_to_next,
+    [PEEPHOLE_ADD_LEA] = rule_add_lea,
+    [PEEPHOLE_ZERO_XOR] = rule_zero_xor,
+};
+
+static size_t compact(X86Code *code) {
+    size_t kept = 0;
+    for (size_t i = 0; i < code->count; ++i) {
+        if (code->instrs[i].op != X86_NOP) {
+            code->instrs[kept++] = code->instrs[i];
+        }
+    }
+    size_t removed = code->count - kept;
+    code->count = kept;
+    return removed;
+}
+
+size_t peephole_optimize(X86Code *code, PeepholeStats *stats) {
+    size_t removed = 0;
+    for (int pass = 0; pass < PEEPHOLE_MAX_PASSES; ++pass) {
+        int changed = 0;
+        for (size_t i = 0; i < code->count; ++i) {
+            /* Keep rewriting at `i` while some rule matches; a deleted
+             * instruction ends the search. */
+            for (size_t r = 0; r < PEEPHOLE_RULE_COUNT && code->instrs[i].op != X86_NOP;) {
+                if (rules[r](code, i)) {
+                    if (stats) {
+                        stats->hits[r] += 1;
+                    }
+                    changed = 1;
+                    r = 0;
+                } else {
+                    r += 1;
+                }
+            }
+        }
+        removed += compact(code);
+        if (!changed) {
+            break;
+        }
+    }
+    return removed;
+}
@@ -0,0 +1,122 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "backend/pipeline.h"
+
+#include <pthread.h>
+#include <stdlib.h>
+
+#include "opt/fold.h"
+#include "support/intern.h"
+#include "support/queue.h"
+
+typedef struct Pipeline {
+    BoundedQueue queue;
+    int threaded;          /* 0: pthread_create failed, functions are emitted by the sink itself */
+    CodegenStream *stream;
+    CodegenOptions options; /* the caller's, with diagnostics redirected to `held` */
+    FILE *held;
+    char *held_text;
+    size_t held_length;
+    int failed; /* code generation failed; later functions are only freed */
+    PipelineStats stats;
+} Pipeline;
+
+/* Folds and emits a batch of functions, then frees it. */
+static void consume_functions(Pipeline *pipeline, AstTranslationUnit *unit) {
+    PipelineStats *stats = &pipeline->stats;
+    if (!pipeline->failed) {
+        size_t folded = 0;
+        if (pipeline->options.opt_level > 0 && fold_constants(unit, &folded) != 0) {
+            fputs("Out of memory while folding constants.\n", pipeline->held);
+            pipeline->failed = 1;
+        } else if (codegen_stream_add(pipeline->stream, unit) != 0) {
+            pipeline->failed = 1;
+        }
+        stats->folded += folded;
+    }
+
+    /* Counted after folding, like the whole-unit statistics. */
+    stats->functions += unit->functions.count;
+    stats->batches += 1;
+    stats->nodes += unit->node_count - 1;
+    stats->names += unit->name_count;
+    stats->literals += unit->literal_count;
+    size_t bytes = ast_memory(unit);
+    if (bytes > stats->largest_ast) {
+        stats->largest_ast = bytes;
+    }
+    ast_free(unit);
+}
+
+static void *codegen_thread(void *arg) {
+    Pipeline *pipeline = arg;
+    AstTranslationUnit *unit;
+    while ((unit = bounded_queue_pop(&pipeline->queue)) != NULL) {
+        consume_functions(pipeline, unit);
+    }
+    return NULL;
+}
+
+static int hand_over(void *context, AstTranslationUnit *functions) {
+    Pipeline *pipeline = context;
+    if (!pipeline->threaded) {
+        consume_functions(pipeline, functions);
+    } else if (bounded_queue_push(&pipeline->queue, functions) != 0) {
+        ast_free(functions);
+        return -1;
+    }
+    return 0;
+}
+
+int pipeline_compile(Parser *parser, FILE *out, const CodegenOptions *options, size_t depth, PipelineStats *stats) {
+    Pipeline pipeline = {0};
+    pipeline.options = *options;
+    pipeline.held = open_memstream(&pipeline.held_text, &pipeline.held_length);
+    pipeline.options.diagnostics = pipeline.held;
+    Interner *interner = interner_create();
+    int queued = bounded_queue_init(&pipeline.queue, depth ? depth : PIPELINE_DEFAULT_DEPTH) == 0;
+    if (pipeline.held) {
+        pipeline.stream = codegen_stream_open(out, &pipeline.options);
+    }
+    if (!pipeline.stream || !interner || !queued) {
+        codegen_stream_close(pipeline.stream);
+        if (queued) {
+            bounded_queue_destroy(&pipeline.queue);
+        }
+        interner_destroy(interner);
+        if (pipeline.held) {
+            fclose(pipeline.held);
+        }
+        free(pipeline.held_text);
+        return -1;
+    }
+
+    pthread_t consumer;
+    pipeline.threaded = pthread_create(&consumer, NULL, codegen_thread, &pipeline) == 0;
+    int parsed = parser_parse_functions(parser, interner, PIPELINE_BATCH_NODES, hand_over, &pipeline);
+    if (pipeline.threaded) {
+        bounded_queue_close(&pipeline.queue);
+        pthread_join(consumer, NULL);
+    }
+    bounded_queue_destroy(&pipeline.queue);
+    pipeline.stats.symbols = interner->count;
+    interner_destroy(interner);
+
+    /* A parse error wins: code generation would not have started. */
+    int status = codegen_stream_close(pipeline.stream);
+    fclose(pipeline.held);
+    if (parsed != 0) {
+        status = -1;
+    } else if (pipeline.held_length > 0 && options->diagnostics) {
+        fwrite(pipeline.held_text, 1, pipeline.held_length, options->diagnostics);
+    }
+    if (pipeline.failed) {
+        status = -1;
+    }
+    free(pipeline.held_text);
+
+    if (stats) {
+        *stats = pipeline.stats;
+    }
+    return status;
+}
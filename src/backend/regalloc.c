@@ -0,0 +1,83 @@
+#include "backend/regalloc.h"
+
+#include <stdlib.h>
+
+/* Intervals currently holding a register, ordered by increasing end. */
+typedef struct ActiveSet {
+    size_t *items; /* indices into the interval array */
+    size_t count;
+} ActiveSet;
+
+static void active_insert(ActiveSet *active, const LiveInterval *intervals, size_t index) {
+    size_t position = active->count;
+    while (position > 0 && intervals[active->items[position - 1]].end > intervals[index].end) {
+        active->items[position] = active->items[position - 1];
+        position -= 1;
+    }
+    active->items[position] = index;
+    active->count += 1;
+}
+
+long regalloc_linear_scan(LiveInterval *intervals, size_t count, size_t register_count) {
+    if (register_count == 0) {
+        for (size_t i = 0; i < count; ++i) {
+            intervals[i].reg = REGALLOC_SPILLED;
+        }
+        return (long)count;
+    }
+
+    ActiveSet active = {malloc(register_count * sizeof(size_t)), 0};
+    int *free_registers = malloc(register_count * sizeof(int));
+    if (!active.items || !free_registers) {
+        free(active.items);
+        free(free_registers);
+        return -1;
+    }
+
+    /* Hand out low register numbers first so small functions use few registers. */
+    size_t free_count = register_count;
+    for (size_t i = 0; i < register_count; ++i) {
+        free_registers[i] = (int)(register_count - 1 - i);
+    }
+
+    long spilled = 0;
+    for (size_t i = 0; i < count; ++i) {
+        LiveInterval *current = &intervals[i];
+
+        /* Expire intervals that end before (or where) the current one starts. */
+        size_t expired = 0;
+        while (expired < active.count && intervals[active.items[expired]].end <= current->start) {
+            free_registers[free_count++] = intervals[active.items[expired]].reg;
+            expired += 1;
+        }
+        if (expired > 0) {
+            for (size_t j = expired; j < active.count; ++j) {
+                active.items[j - expired] = active.items[j];
+            }
+            active.count -= expired;
+        }
+
+        if (free_count > 0) {
+            current->reg = free_registers[--free_count];
+            active_insert(&active, intervals, i);
+            continue;
+        }
+
+        /* Spill whichever of the current and the longest-lived active interval
+         * ends last; it blocks the register for the longest time. */
+        LiveInterval *last = &intervals[active.items[active.count - 1]];
+        if (last->end > current->end) {
+            current->reg = last->reg;
+            last->reg = REGALLOC_SPILLED;
+            active.count -= 1;
+            active_insert(&active, intervals, i);
+        } else {
+            current->reg = REGALLOC_SPILLED;
+        }
+        spilled += 1;
+    }
+
+    free(active.items);
+    free(free_registers);
+    return spilled;
+}
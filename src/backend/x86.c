@@ -0,0 +1,203 @@
+#include "backend/x86.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#define X86_CODE_INITIAL_CAPACITY ((size_t)256)
+
+void x86_code_init(X86Code *code) {
+    code->instrs = NULL;
+    code->count = 0;
+    code->capacity = 0;
+    code->failed = 0;
+}
+
+void x86_code_free(X86Code *code) {
+    free(code->instrs);
+    x86_code_init(code);
+}
+
+void x86_code_reset(X86Code *code) {
+    code->count = 0;
+    code->failed = 0;
+}
+
+int x86_code_reserve_slow(X86Code *code) {
+    if (code->failed) {
+        return -1;
+    }
+    if (code->count < code->capacity) {
+        return 0;
+    }
+    size_t capacity = code->capacity ? code->capacity * 2 : X86_CODE_INITIAL_CAPACITY;
+    X86Instr *resized = realloc(code->instrs, capacity * sizeof(X86Instr));
+    if (!resized) {
+        code->failed = 1;
+        return -1;
+    }
+    code->instrs = resized;
+    code->capacity = capacity;
+    return 0;
+}
+
+int x86_operand_equal(const X86Operand *lhs, const X86Operand *rhs) {
+    if (lhs->kind != rhs->kind) {
+        return 0;
+    }
+    switch (lhs->kind) {
+    case X86_OPERAND_NONE:
+        return 1;
+    case X86_OPERAND_REG:
+        return lhs->reg == rhs->reg;
+    case X86_OPERAND_IMM:
+        return lhs->u.imm == rhs->u.imm;
+    case X86_OPERAND_MEM:
+        return lhs->reg == rhs->reg && lhs->u.disp == rhs->u.disp && lhs->scale == rhs->scale &&
+               (lhs->scale == 0 || lhs->index == rhs->index);
+    case X86_OPERAND_GLOBAL:
+        return lhs->length == rhs->length && memcmp(lhs->u.name, rhs->u.name, lhs->length) == 0;
+    case X86_OPERAND_LABEL:
+        return lhs->u.label == rhs->u.label;
+    default:
+        return 0;
+    }
+}
+
+int x86_operand_uses(const X86Operand *operand, X86Reg reg) {
+    if (operand->kind == X86_OPERAND_MEM && operand->scale != 0 && operand->index == reg) {
+        return 1;
+    }
+    return (operand->kind == X86_OPERAND_REG || operand->kind == X86_OPERAND_MEM) && operand->reg == reg;
+}
+
+static void print_label(Emitter *out, const char *function_name, size_t name_length, uint32_t label) {
+    emitter_text(out, ".L");
+    emitter_view(out, function_name, name_length);
+    if (label == X86_RETURN_LABEL) {
+        emitter_text(out, "_return");
+    } else {
+        emitter_text(out, "_bb");
+        emitter_int(out, (long)label);
+    }
+}
+
+static void print_operand(Emitter *out, const X86Operand *operand, unsigned width, const char *function_name, size_t name_length) {
+    switch (operand->kind) {
+    case X86_OPERAND_REG:
+        if (width == 8) {
+            emitter_reg64(out, (X86Reg)operand->reg);
+        } else {
+            emitter_reg32(out, (X86Reg)operand->reg);
+        }
+        break;
+    case X86_OPERAND_IMM:
+        emitter_char(out, '$');
+        emitter_int(out, (long)operand->u.imm);
+        break;
+    case X86_OPERAND_MEM:
+        if (operand->u.disp != 0) {
+            emitter_int(out, operand->u.disp);
+        }
+        emitter_char(out, '(');
+        emitter_reg64(out, (X86Reg)operand->reg);
+        if (operand->scale != 0) {
+            emitter_char(out, ',');
+            emitter_reg64(out, (X86Reg)operand->index);
+            emitter_char(out, ',');
+            emitter_int(out, operand->scale);
+        }
+        emitter_char(out, ')');
+        break;
+    case X86_OPERAND_GLOBAL:
+        emitter_view(out, operand->u.name, operand->length);
+        emitter_text(out, "(%rip)");
+        break;
+    case X86_OPERAND_LABEL:
+        print_label(out, function_name, name_length, operand->u.label);
+        break;
+    default:
+        break;
+    }
+}
+
+/* 32-bit moves keep the explicit `l` suffix the backend has always printed,
+ * except for RIP-relative loads; pushes and divisions of anything but a
+ * register need a size suffix. */
+static const char *mnemonic(const X86Instr *instr) {
+    switch ((X86Opcode)instr->op) {
+    case X86_MOV:
+        return (instr->width == 4 && instr->src.kind != X86_OPERAND_GLOBAL) ? "movl" : "mov";
+    case X86_ADD:
+        return "add";
+    case X86_SUB:
+        return "sub";
+    case X86_XOR:
+        return "xor";
+    case X86_AND:
+        return "and";
+    case X86_IMUL:
+        return "imul";
+    case X86_SHL:
+        return "shl";
+    case X86_SAR:
+        return "sar";
+    case X86_SHR:
+        return "shr";
+    case X86_LEA:
+        return "lea";
+    case X86_MOVSXD:
+        return "movslq";
+    case X86_CDQ:
+        return "cltd";
+    case X86_IDIV:
+        return (instr->src.kind == X86_OPERAND_REG) ? "idiv" : "idivl";
+    case X86_NEG:
+        return "neg";
+    case X86_TEST:
+        return "test";
+    case X86_PUSH:
+        return (instr->src.kind == X86_OPERAND_REG) ? "push" : "pushq";
+    case X86_POP:
+        return "pop";
+    case X86_JMP:
+        return "jmp";
+    case X86_JNE:
+        return "jne";
+    case X86_LEAVE:
+        return "leave";
+    case X86_RET:
+        return "ret";
+    default:
+        return NULL;
+    }
+}
+
+void x86_print_code(const X86Code *code, const char *function_name, size_t name_length, Emitter *out) {
+    for (size_t i = 0; i < code->count; ++i) {
+        const X86Instr *instr = &code->instrs[i];
+        if (instr->op == X86_LABEL) {
+            print_label(out, function_name, name_length, instr->src.u.label);
+            emitter_char(out, ':');
+            emitter_newline(out);
+            continue;
+        }
+        const char *name = mnemonic(instr);
+        if (!name) {
+            continue;
+        }
+
+        emitter_text(out, "    ");
+        emitter_text(out, name);
+        if (instr->src.kind != X86_OPERAND_NONE) {
+            /* movslq reads a 32-bit register into a 64-bit one. */
+            unsigned src_width = (instr->op == X86_MOVSXD) ? 4 : instr->width;
+            emitter_char(out, ' ');
+            print_operand(out, &instr->src, src_width, function_name, name_length);
+        }
+        if (instr->dst.kind != X86_OPERAND_NONE) {
+            emitter_text(out, (instr->src.kind != X86_OPERAND_NONE) ? ", " : " ");
+            print_operand(out, &instr->dst, instr->width, function_name, name_length);
+        }
+        emitter_newline(out);
+    }
+}
@@ -0,0 +1,576 @@
+#include "backend/x86_encode.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#define X86_MAX_INSTR_LENGTH 15
+#define X86_SHORT_JUMP_LENGTH 2
+
+typedef struct Encoding {
+    uint8_t bytes[X86_MAX_INSTR_LENGTH];
+    size_t length;
+    int reloc_at;             /* index of a RIP-relative disp32, or -1 */
+    const X86Operand *global; /* the operand that disp32 addresses */
+} Encoding;
+
+void x86_object_init(X86Object *object) {
+    memset(object, 0, sizeof(*object));
+}
+
+void x86_object_free(X86Object *object) {
+    free(object->text);
+    free(object->relocs);
+    free(object->symbols);
+    free(object->offsets);
+    free(object->sizes);
+    x86_object_init(object);
+}
+
+/* Grows `*data` to hold at least `needed` elements. */
+static int reserve(X86Object *object, void **data, size_t *capacity, size_t needed, size_t element) {
+    if (object->failed) {
+        return -1;
+    }
+    if (needed <= *capacity) {
+        return 0;
+    }
+    size_t grown = *capacity ? *capacity : 64;
+    while (grown < needed) {
+        grown *= 2;
+    }
+    void *resized = realloc(*data, grown * element);
+    if (!resized) {
+        object->failed = 1;
+        return -1;
+    }
+    *data = resized;
+    *capacity = grown;
+    return 0;
+}
+
+static void put(Encoding *enc, uint8_t byte) {
+    enc->bytes[enc->length++] = byte;
+}
+
+static void put32(Encoding *enc, uint32_t value) {
+    for (int k = 0; k < 4; ++k) {
+        put(enc, (uint8_t)(value >> (8 * k)));
+    }
+}
+
+static int fits_int8(int64_t value) {
+    return value >= INT8_MIN && value <= INT8_MAX;
+}
+
+static int fits_int32(int64_t value) {
+    return value >= INT32_MIN && value <= INT32_MAX;
+}
+
+static int is_rm(const X86Operand *operand) {
+    return operand->kind == X86_OPERAND_REG || operand->kind == X86_OPERAND_MEM || operand->kind == X86_OPERAND_GLOBAL;
+}
+
+/* Immediates of 32-bit instructions are taken modulo 2^32; 64-bit ones are
+ * sign-extended from 32 bits by the CPU, so they must fit. */
+static int immediate(const X86Instr *instr, int64_t *value) {
+    *value = (instr->width == 8) ? instr->src.u.imm : (int64_t)(int32_t)instr->src.u.imm;
+    return fits_int32(*value) ? 0 : -1;
+}
+
+/* REX prefix, opcode, then ModRM with `reg` in its reg field and `rm` as the
+ * register or memory operand, plus any SIB byte and displacement. */
+static int encode_modrm(Encoding *enc, int wide, const uint8_t *opcode, size_t opcode_length, unsigned reg, const X86Operand *rm) {
+    if (!is_rm(rm)) {
+        return -1;
+    }
+    unsigned base = rm->reg;
+    int indexed = rm->kind == X86_OPERAND_MEM && rm->scale != 0;
+    uint8_t rex = (uint8_t)(0x40 | (wide ? 0x08 : 0) | ((reg & 8) ? 0x04 : 0));
+    if (rm->kind != X86_OPERAND_GLOBAL && (base & 8)) {
+        rex |= 0x01;
+    }
+    if (indexed && (rm->index & 8)) {
+        rex |= 0x02;
+    }
+    if (rex != 0x40) {
+        put(enc, rex);
+    }
+    for (size_t i = 0; i < opcode_length; ++i) {
+        put(enc, opcode[i]);
+    }
+
+    reg &= 7;
+    base &= 7;
+    if (rm->kind == X86_OPERAND_REG) {
+        put(enc, (uint8_t)(0xC0 | reg << 3 | base));
+        return 0;
+    }
+    if (rm->kind == X86_OPERAND_GLOBAL) {
+        put(enc, (uint8_t)(0x05 | reg << 3));
+        enc->reloc_at = (int)enc->length;
+        enc->global = rm;
+        put32(enc, 0);
+        return 0;
+    }
+
+    /* %rbp/%r13 as a base always need a displacement; %rsp/%r12 need a SIB,
+     * as does any index (%rsp cannot be one). */
+    int32_t disp = rm->u.disp;
+    uint8_t mod = (disp == 0 && base != 5) ? 0x00 : fits_int8(disp) ? 0x40 : 0x80;
+    if (indexed) {
+        static const uint8_t scale_bits[9] = {[1] = 0, [2] = 1, [4] = 2, [8] = 3};
+        if (rm->scale > 8 || (rm->scale & (rm->scale - 1)) != 0 || rm->index == X86_RSP) {
+            return -1;
+        }
+        put(enc, (uint8_t)(mod | reg << 3 | 4));
+        put(enc, (uint8_t)(scale_bits[rm->scale] << 6 | (rm->index & 7) << 3 | base));
+    } else {
+        put(enc, (uint8_t)(mod | reg << 3 | base));
+        if (base == 4) {
+            put(enc, 0x24);
+        }
+    }
+    if (mod == 0x40) {
+        put(enc, (uint8_t)disp);
+    } else if (mod == 0x80) {
+        put32(enc, (uint32_t)disp);
+    }
+    return 0;
+}
+
+static int encode_single(Encoding *enc, int wide, uint8_t opcode, unsigned extension, const X86Operand *rm) {
+    return encode_modrm(enc, wide, &opcode, 1, extension, rm);
+}
+
+/* add/sub/xor: `store` is the `op reg, r/m` opcode, `load` the `op r/m, reg`
+ * one and `extension` the ModRM reg field of the immediate forms. */
+static int encode_alu(Encoding *enc, const X86Instr *instr, uint8_t store, uint8_t load, unsigned extension) {
+    int wide = instr->width == 8;
+    if (instr->src.kind == X86_OPERAND_IMM) {
+        int64_t value;
+        if (immediate(instr, &value) != 0) {
+            return -1;
+        }
+        if (fits_int8(value)) {
+            if (encode_single(enc, wide, 0x83, extension, &instr->dst) != 0) {
+                return -1;
+            }
+            put(enc, (uint8_t)value);
+            return 0;
+        }
+        if (instr->dst.kind == X86_OPERAND_REG && instr->dst.reg == X86_RAX) {
+            /* The accumulator has a form without ModRM, one byte shorter. */
+            if (wide) {
+                put(enc, 0x48);
+            }
+            put(enc, (uint8_t)((store & 0xF8) | 0x05));
+        } else if (encode_single(enc, wide, 0x81, extension, &instr->dst) != 0) {
+            return -1;
+        }
+        put32(enc, (uint32_t)value);
+        return 0;
+    }
+    if (instr->src.kind == X86_OPERAND_REG) {
+        return encode_single(enc, wide, store, instr->src.reg, &instr->dst);
+    }
+    if (instr->dst.kind == X86_OPERAND_REG) {
+        return encode_single(enc, wide, load, instr->dst.reg, &instr->src);
+    }
+    return -1;
+}
+
+static int encode_mov(Encoding *enc, const X86Instr *instr) {
+    int wide = instr->width == 8;
+    if (instr->src.kind != X86_OPERAND_IMM) {
+        return encode_alu(enc, instr, 0x89, 0x8B, 0);
+    }
+
+    int64_t value = (instr->width == 8) ? instr->src.u.imm : (int64_t)(int32_t)instr->src.u.imm;
+    if (instr->dst.kind == X86_OPERAND_REG && (!wide || !fits_int32(value))) {
+        /* mov $imm32, %r32 zero-extends; movabs takes a full 64-bit immediate. */
+        unsigned reg = instr->dst.reg;
+        uint8_t rex = (uint8_t)(0x40 | (wide ? 0x08 : 0) | ((reg & 8) ? 0x01 : 0));
+        if (rex != 0x40) {
+            put(enc, rex);
+        }
+        put(enc, (uint8_t)(0xB8 + (reg & 7)));
+        put32(enc, (uint32_t)value);
+        if (wide) {
+            put32(enc, (uint32_t)((uint64_t)value >> 32));
+        }
+        return 0;
+    }
+    if (!fits_int32(value) || encode_single(enc, wide, 0xC7, 0, &instr->dst) != 0) {
+        return -1;
+    }
+    put32(enc, (uint32_t)value);
+    return 0;
+}
+
+/* imul r/m, reg (0F AF) or, with an immediate, imul $imm, reg, reg. */
+static int encode_imul(Encoding *enc, const X86Instr *instr) {
+    int wide = instr->width == 8;
+    if (instr->dst.kind != X86_OPERAND_REG) {
+        return -1;
+    }
+    if (instr->src.kind != X86_OPERAND_IMM) {
+        static const uint8_t opcode[2] = {0x0F, 0xAF};
+        return encode_modrm(enc, wide, opcode, 2, instr->dst.reg, &instr->src);
+    }
+    int64_t value;
+    if (immediate(instr, &value) != 0 ||
+        encode_single(enc, wide, fits_int8(value) ? 0x6B : 0x69, instr->dst.reg, &instr->dst) != 0) {
+        return -1;
+    }
+    if (fits_int8(value)) {
+        put(enc, (uint8_t)value);
+    } else {
+        put32(enc, (uint32_t)value);
+    }
+    return 0;
+}
+
+/* shl/sar/shr by an immediate count; a count of one has its own opcode. */
+static int encode_shift(Encoding *enc, const X86Instr *instr, unsigned extension) {
+    int wide = instr->width == 8;
+    if (instr->src.kind != X86_OPERAND_IMM) {
+        return -1;
+    }
+    uint8_t count = (uint8_t)(instr->src.u.imm & (wide ? 63 : 31));
+    if (encode_single(enc, wide, (count == 1) ? 0xD1 : 0xC1, extension, &instr->dst) != 0) {
+        return -1;
+    }
+    if (count != 1) {
+        put(enc, count);
+    }
+    return 0;
+}
+
+/* push/pop of a register: the register is in the opcode's low bits. */
+static void encode_stack_reg(Encoding *enc, uint8_t opcode, unsigned reg) {
+    if (reg & 8) {
+        put(enc, 0x41);
+    }
+    put(enc, (uint8_t)(opcode + (reg & 7)));
+}
+
+/* Jumps are sized by the caller: `rel` is measured from the end of the form
+ * chosen by `long_jump`. */
+static int encode_jump(Encoding *enc, const X86Instr *instr, int long_jump, int32_t rel) {
+    int conditional = instr->op == X86_JNE;
+    if (!long_jump) {
+        put(enc, conditional ? 0x75 : 0xEB);
+        put(enc, (uint8_t)rel);
+        return 0;
+    }
+    if (conditional) {
+        put(enc, 0x0F);
+        put(enc, 0x85);
+    } else {
+        put(enc, 0xE9);
+    }
+    put32(enc, (uint32_t)rel);
+    return 0;
+}
+
+static int encode_instr(Encoding *enc, const X86Instr *instr, int long_jump, int32_t rel) {
+    enc->length = 0;
+    enc->reloc_at = -1;
+    enc->global = NULL;
+    int wide = instr->width == 8;
+    switch ((X86Opcode)instr->op) {
+    case X86_NOP:
+    case X86_LABEL:
+        return 0;
+    case X86_MOV:
+        return encode_mov(enc, instr);
+    case X86_ADD:
+        return encode_alu(enc, instr, 0x01, 0x03, 0);
+    case X86_SUB:
+        return encode_alu(enc, instr, 0x29, 0x2B, 5);
+    case X86_XOR:
+        return encode_alu(enc, instr, 0x31, 0x33, 6);
+    case X86_AND:
+        return encode_alu(enc, instr, 0x21, 0x23, 4);
+    case X86_IMUL:
+        return encode_imul(enc, instr);
+    case X86_SHL:
+        return encode_shift(enc, instr, 4);
+    case X86_SAR:
+        return encode_shift(enc, instr, 7);
+    case X86_SHR:
+        return encode_shift(enc, instr, 5);
+    case X86_MOVSXD:
+        if (instr->dst.kind != X86_OPERAND_REG) {
+            return -1;
+        }
+        return encode_single(enc, 1, 0x63, instr->dst.reg, &instr->src);
+    case X86_CDQ:
+        put(enc, 0x99);
+        return 0;
+    case X86_IDIV:
+        return encode_single(enc, 0, 0xF7, 7, &instr->src);
+    case X86_LEA:
+        if (instr->dst.kind != X86_OPERAND_REG || instr->src.kind == X86_OPERAND_REG) {
+            return -1;
+        }
+        return encode_single(enc, wide, 0x8D, instr->dst.reg, &instr->src);
+    case X86_NEG:
+        return encode_single(enc, wide, 0xF7, 3, &instr->dst);
+    case X86_TEST:
+        if (instr->src.kind == X86_OPERAND_IMM) {
+            int64_t value;
+            if (immediate(instr, &value) != 0 || encode_single(enc, wide, 0xF7, 0, &instr->dst) != 0) {
+                return -1;
+            }
+            put32(enc, (uint32_t)value);
+            return 0;
+        }
+        if (instr->src.kind != X86_OPERAND_REG) {
+            return -1;
+        }
+        return encode_single(enc, wide, 0x85, instr->src.reg, &instr->dst);
+    case X86_PUSH:
+        if (instr->src.kind == X86_OPERAND_REG) {
+            encode_stack_reg(enc, 0x50, instr->src.reg);
+            return 0;
+        }
+        if (instr->src.kind == X86_OPERAND_IMM) {
+            int64_t value = instr->src.u.imm;
+            if (!fits_int32(value)) {
+                return -1;
+            }
+            put(enc, fits_int8(value) ? 0x6A : 0x68);
+            if (fits_int8(value)) {
+                put(enc, (uint8_t)value);
+            } else {
+                put32(enc, (uint32_t)value);
+            }
+            return 0;
+        }
+        return encode_single(enc, 0, 0xFF, 6, &instr->src);
+    case X86_POP:
+        if (instr->dst.kind == X86_OPERAND_REG) {
+            encode_stack_reg(enc, 0x58, instr->dst.reg);
+            return 0;
+        }
+        return encode_single(enc, 0, 0x8F, 0, &instr->dst);
+    case X86_JMP:
+    case X86_JNE:
+        return encode_jump(enc, instr, long_jump, rel);
+    case X86_LEAVE:
+        put(enc, 0xC9);
+        return 0;
+    case X86_RET:
+        put(enc, 0xC3);
+        return 0;
+    default:
+        return -1;
+    }
+}
+
+static int is_jump(const X86Instr *instr) {
+    return instr->op == X86_JMP || instr->op == X86_JNE;
+}
+
+static int long_jump_length(const X86Instr *instr) {
+    return instr->op == X86_JNE ? 6 : 5;
+}
+
+int x86_encode_function(X86Object *object, const X86Code *code, const char *name, size_t name_length) {
+    if (object->failed || code->failed) {
+        return -1;
+    }
+
+    /* Labels are block ids; the return label takes the slot after the largest. */
+    uint32_t return_slot = 0;
+    for (size_t i = 0; i < code->count; ++i) {
+        const X86Instr *instr = &code->instrs[i];
+        if (instr->op == X86_LABEL && instr->src.u.label != X86_RETURN_LABEL && instr->src.u.label >= return_slot) {
+            return_slot = instr->src.u.label + 1;
+        }
+    }
+    size_t label_count = (size_t)return_slot + 1;
+    if (reserve(object, (void **)&object->offsets, &object->offset_capacity, code->count + 1 + label_count, sizeof(uint32_t)) != 0 ||
+        reserve(object, (void **)&object->sizes, &object->size_capacity, code->count, sizeof(uint8_t)) != 0) {
+        return -1;
+    }
+    uint32_t *starts = object->offsets;
+    uint32_t *labels = object->offsets + code->count + 1;
+    uint8_t *sizes = object->sizes;
+    for (size_t l = 0; l < label_count; ++l) {
+        labels[l] = UINT32_MAX;
+    }
+
+    Encoding enc;
+    for (size_t i = 0; i < code->count; ++i) {
+        const X86Instr *instr = &code->instrs[i];
+        if (is_jump(instr)) {
+            if (instr->src.kind != X86_OPERAND_LABEL) {
+                return -1;
+            }
+            sizes[i] = X86_SHORT_JUMP_LENGTH;
+        } else if (encode_instr(&enc, instr, 0, 0) != 0) {
+            return -1;
+        } else {
+            sizes[i] = (uint8_t)enc.length;
+        }
+    }
+
+    /* Every jump starts short; widen those whose target is out of rel8 range
+     * and lay out again. Widening only moves code apart, so this settles. */
+    int changed;
+    do {
+        changed = 0;
+        uint32_t at = 0;
+        for (size_t i = 0; i < code->count; ++i) {
+            const X86Instr *instr = &code->instrs[i];
+            starts[i] = at;
+            if (instr->op == X86_LABEL) {
+                labels[instr->src.u.label == X86_RETURN_LABEL ? return_slot : instr->src.u.label] = at;
+            }
+            at += sizes[i];
+        }
+        starts[code->count] = at;
+
+        for (size_t i = 0; i < code->count; ++i) {
+            const X86Instr *instr = &code->instrs[i];
+            if (!is_jump(instr) || sizes[i] != X86_SHORT_JUMP_LENGTH) {
+                continue;
+            }
+            uint32_t label = instr->src.u.label == X86_RETURN_LABEL ? return_slot : instr->src.u.label;
+            if (label >= label_count || labels[label] == UINT32_MAX) {
+                return -1;
+            }
+            if (!fits_int8((int64_t)labels[label] - (int64_t)(starts[i] + X86_SHORT_JUMP_LENGTH))) {
+                sizes[i] = (uint8_t)long_jump_length(instr);
+                changed = 1;
+            }
+        }
+    } while (changed);
+
+    size_t base = object->text_length;
+    size_t length = starts[code->count];
+    if (base + length > UINT32_MAX ||
+        reserve(object, (void **)&object->text, &object->text_capacity, base + length, sizeof(uint8_t)) != 0 ||
+        reserve(object, (void **)&object->symbols, &object->symbol_capacity, object->symbol_count + 1, sizeof(X86Symbol)) != 0) {
+        return -1;
+    }
+
+    for (size_t i = 0; i < code->count; ++i) {
+        const X86Instr *instr = &code->instrs[i];
+        int32_t rel = 0;
+        if (is_jump(instr)) {
+            uint32_t label = instr->src.u.label == X86_RETURN_LABEL ? return_slot : instr->src.u.label;
+            rel = (int32_t)((int64_t)labels[label] - (int64_t)(starts[i] + sizes[i]));
+        }
+        if (encode_instr(&enc, instr, sizes[i] != X86_SHORT_JUMP_LENGTH, rel) != 0 || enc.length != sizes[i]) {
+            return -1;
+        }
+        memcpy(object->text + base + starts[i], enc.bytes, enc.length);
+        if (enc.reloc_at >= 0) {
+            if (reserve(object, (void **)&object->relocs, &object->reloc_capacity, object->reloc_count + 1, sizeof(X86Reloc)) != 0) {
+                return -1;
+            }
+            X86Reloc *reloc = &object->relocs[object->reloc_count++];
+            reloc->offset = (uint32_t)(base + starts[i] + (size_t)enc.reloc_at);
+            reloc->addend = enc.reloc_at - (int32_t)enc.length;
+            reloc->name = enc.global->u.name;
+            reloc->length = enc.global->length;
+        }
+    }
+
+    object->text_length = base + length;
+    X86Symbol *symbol = &object->symbols[object->symbol_count++];
+    symbol->offset = (uint32_t)base;
+    symbol->size = (uint32_t)length;
+    symbol->name = name;
+    symbol->length = (uint32_t)name_length;
+    return 0;
+}
+
+int x86_object_append(X86Object *object, const X86Object *source) {
+    size_t base = object->text_length;
+    if (source->failed || base + source->text_length > UINT32_MAX ||
+        reserve(object, (void **)&object->text, &object->text_capacity, base + source->text_length, sizeof(uint8_t)) != 0 ||
+        reserve(object, (void **)&object->relocs, &object->reloc_capacity, object->reloc_count + source->reloc_count, sizeof(X86Reloc)) != 0 ||
+        reserve(object, (void **)&object->symbols, &object->symbol_capacity, object->symbol_count + source->symbol_count, sizeof(X86Symbol)) != 0) {
+        return -1;
+    }
+    if (source->text_length > 0) {
+        memcpy(object->text + base, source->text, source->text_length);
+    }
+    object->text_length += source->text_length;
+    for (size_t i = 0; i < source->reloc_count; ++i) {
+        X86Reloc *reloc = &object->relocs[object->reloc_count++];
+        *reloc = source->relocs[i];
+        reloc->offset += (uint32_t)base;
+    }
+    for (size_t i = 0; i < source->symbol_count; ++i) {
+        X86Symbol *symbol = &object->symbols[object->symbol_count++];
+        *symbol = source->symbols[i];
+        symbol->offset += (uint32_t)base;
+    }
+    return 0;
+}
+
+static uint32_t hash_name(const char *name, size_t length) {
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < length; ++i) {
+        hash = (hash ^ (uint8_t)name[i]) * 16777619u;
+    }
+    return hash;
+}
+
+/* Open addressing over `slots`, which hold name number + 1 (0 = empty); the
+ * number indexes `names`. Returns the slot holding `name` or where it belongs. */
+static uint32_t *find_name(uint32_t *slots, size_t mask, const X86Symbol *names, const char *name, size_t length) {
+    size_t index = hash_name(name, length) & mask;
+    for (;;) {
+        uint32_t *slot = &slots[index];
+        if (*slot == 0) {
+            return slot;
+        }
+        const X86Symbol *entry = &names[*slot - 1];
+        if (entry->length == length && memcmp(entry->name, name, length) == 0) {
+            return slot;
+        }
+        index = (index + 1) & mask;
+    }
+}
+
+long x86_object_number_names(const X86Object *object, uint32_t *reloc_targets) {
+    size_t capacity = object->symbol_count + object->reloc_count;
+    size_t table_size = 16;
+    while (table_size < 2 * capacity) {
+        table_size *= 2;
+    }
+    uint32_t *slots = calloc(table_size, sizeof(uint32_t));
+    X86Symbol *names = malloc((capacity + 1) * sizeof(X86Symbol));
+    long count = (slots && names) ? 0 : -1;
+
+    for (size_t i = 0; i < object->symbol_count && count >= 0; ++i) {
+        const X86Symbol *symbol = &object->symbols[i];
+        uint32_t *slot = find_name(slots, table_size - 1, names, symbol->name, symbol->length);
+        if (*slot != 0) {
+            count = -1;
+        } else {
+            names[count] = *symbol;
+            *slot = (uint32_t)++count;
+        }
+    }
+    for (size_t i = 0; i < object->reloc_count && count >= 0; ++i) {
+        const X86Reloc *reloc = &object->relocs[i];
+        uint32_t *slot = find_name(slots, table_size - 1, names, reloc->name, reloc->length);
+        if (*slot == 0) {
+            names[count].name = reloc->name;
+            names[count].length = reloc->length;
+            *slot = (uint32_t)++count;
+        }
+        reloc_targets[i] = *slot - 1;
+    }
+
+    free(slots);
+    free(names);
+    return count;
+}
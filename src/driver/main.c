@@ -1,127 +1,730 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <errno.h>
+#include <pthread.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 
+#include "backend/code_cache.h"
 #include "backend/codegen.h"
+#include "backend/jit.h"
+#include "backend/pipeline.h"
 #include "frontend/parser.h"
+#include "ir/lower.h"
+#include "opt/fold.h"
+#include "support/parallel.h"
+#include "support/source_file.h"
 
-static void dump_block(const AstNode *block, int indent);
+static void dump_block(FILE *out, const AstTranslationUnit *unit, AstRange statements, int indent);
 
-static void dump_function(const AstNode *func) {
-    if (!func || func->kind != AST_FUNCTION_DECL) {
-        puts("<not a function>");
+static void dump_function(FILE *out, const AstTranslationUnit *unit, AstNodeId id) {
+    const AstNode *func = ast_node(unit, id);
+    if (func->kind != AST_FUNCTION_DECL) {
+        fputs("<not a function>\n", out);
         return;
     }
 
-    printf("Function: %.*s\n", (int)func->value.function_decl.name.length, func->value.function_decl.name.name);
+    const AstIdentifier *name = ast_name(unit, func->value.function_decl.name);
+    fprintf(out, "Function: %.*s\n", (int)name->length, name->name);
 
-    const AstNode *body = func->value.function_decl.body;
-    if (!body || body->kind != AST_BLOCK) {
-        puts("  <body not parsed>");
+    const AstNode *body = ast_node(unit, func->value.function_decl.body);
+    if (body->kind != AST_BLOCK) {
+        fputs("  <body not parsed>\n", out);
         return;
     }
 
-    dump_block(body, 2);
+    dump_block(out, unit, body->value.block, 2);
 }
 
-static void dump_expression_summary(const AstNode *expr) {
-    if (!expr) {
-        printf("<empty>");
-        return;
-    }
-
+static void dump_expression_summary(FILE *out, const AstTranslationUnit *unit, AstNodeId id) {
+    const AstNode *expr = ast_node(unit, id);
     switch (expr->kind) {
-    case AST_NUMBER_LITERAL:
-        printf("literal %.*s", (int)expr->value.number_literal.length, expr->value.number_literal.lexeme);
+    case AST_NONE:
+        fprintf(out, "<empty>");
+        break;
+    case AST_NUMBER_LITERAL: {
+        const AstNumberLiteral *literal = ast_literal(unit, expr->value.number_literal);
+        fprintf(out, "literal %.*s", (int)literal->length, literal->lexeme);
         break;
-    case AST_IDENTIFIER:
-        printf("identifier %.*s", (int)expr->value.identifier.length, expr->value.identifier.name);
+    }
+    case AST_IDENTIFIER: {
+        const AstIdentifier *identifier = ast_name(unit, expr->value.identifier);
+        fprintf(out, "identifier %.*s", (int)identifier->length, identifier->name);
         break;
+    }
     case AST_UNARY_EXPR:
-        printf("unary %s ", expr->value.unary_expr.op == AST_UNARY_MINUS ? "-" : "+");
-        dump_expression_summary(expr->value.unary_expr.operand);
+        fprintf(out, "unary %s ", expr->op == AST_UNARY_MINUS ? "-" : "+");
+        dump_expression_summary(out, unit, expr->value.unary_expr);
         break;
     case AST_BINARY_EXPR:
-        dump_expression_summary(expr->value.binary_expr.left);
-        printf(" %s ", expr->value.binary_expr.op == AST_BIN_ADD ? "+" : "-");
-        dump_expression_summary(expr->value.binary_expr.right);
+        dump_expression_summary(out, unit, expr->value.binary_expr.left);
+        fprintf(out, " %c ", "+-*/%"[expr->op]);
+        dump_expression_summary(out, unit, expr->value.binary_expr.right);
         break;
     default:
-        printf("<expr>");
+        fprintf(out, "<expr>");
         break;
     }
 }
 
-static void dump_block(const AstNode *block, int indent) {
-    if (!block || block->kind != AST_BLOCK) {
-        return;
-    }
-
-    for (size_t i = 0; i < block->value.block.statement_count; ++i) {
-        const AstNode *stmt = block->value.block.statements[i];
-        printf("%*s- ", indent, "");
+/* Statements are a contiguous run of ids, walked in order. */
+static void dump_block(FILE *out, const AstTranslationUnit *unit, AstRange statements, int indent) {
+    const AstNodeId *ids = ast_children(unit, statements);
+    for (uint32_t i = 0; i < statements.count; ++i) {
+        const AstNode *stmt = ast_node(unit, ids[i]);
+        fprintf(out, "%*s- ", indent, "");
         switch (stmt->kind) {
-        case AST_VAR_DECL:
-            printf("var %.*s = ", (int)stmt->value.var_decl.name.length, stmt->value.var_decl.name.name);
-            dump_expression_summary(stmt->value.var_decl.initializer);
-            printf("\n");
+        case AST_VAR_DECL: {
+            const AstIdentifier *name = ast_name(unit, stmt->value.var_decl.name);
+            fprintf(out, "var %.*s = ", (int)name->length, name->name);
+            dump_expression_summary(out, unit, stmt->value.var_decl.initializer);
+            fputc('\n', out);
             break;
-        case AST_ASSIGNMENT:
-            printf("assign %.*s = ", (int)stmt->value.assignment.target.length, stmt->value.assignment.target.name);
-            dump_expression_summary(stmt->value.assignment.value);
-            printf("\n");
+        }
+        case AST_ASSIGNMENT: {
+            const AstIdentifier *target = ast_name(unit, stmt->value.assignment.target);
+            fprintf(out, "assign %.*s = ", (int)target->length, target->name);
+            dump_expression_summary(out, unit, stmt->value.assignment.value);
+            fputc('\n', out);
             break;
+        }
         case AST_RETURN_STMT:
-            printf("return ");
-            dump_expression_summary(stmt->value.return_stmt.expression);
-            printf("\n");
+            fprintf(out, "return ");
+            dump_expression_summary(out, unit, stmt->value.return_stmt);
+            fputc('\n', out);
             break;
         case AST_BLOCK:
-            printf("block\n");
-            dump_block(stmt, indent + 2);
+            fprintf(out, "block\n");
+            dump_block(out, unit, stmt->value.block, indent + 2);
             break;
         default:
-            printf("stmt kind %d\n", stmt->kind);
+            fprintf(out, "stmt kind %d\n", stmt->kind);
             break;
         }
     }
 }
 
-int main(void) {
-    const char *demo = "int main() { return 42; }\n";
+typedef struct DriverOptions {
+    const char **inputs; /* empty runs the built-in demo */
+    size_t input_count;
+    const char *output_path; /* single input only */
+    const char *output_dir;  /* NULL writes <input>.s next to each input in batch mode */
+    int dump_ast;
+    int dump_ir;
+    int print_stats;
+    int allow_mmap;
+    int prelex; /* --prelex: lex each file completely before parsing it */
+    int pipeline; /* --pipeline: generate code for each function while parsing the next */
+    int opt_level; /* 0 disables folding, dead code elimination and register allocation */
+    int keep_frame_pointer;
+    int emit_object; /* -c: write ELF objects instead of assembly */
+    int run;         /* --run: JIT the single input and exit with main's value */
+    const char *cache_dir;  /* --cache-dir: reuse per-function code across runs */
+    const CodeCache *cache; /* opened from cache_dir, shared by every file */
+    unsigned threads; /* worker threads (files in batch mode, functions otherwise), 0 = one per CPU */
+} DriverOptions;
+
+static void print_usage(FILE *stream) {
+    fputs("usage: fungcc_driver [options] [input.c... | -]\n"
+          "  -o <path>           write output to <path> (single input, default build/fungcc_output.s/.o)\n"
+          "  --output-dir <dir>  write <dir>/<input basename>.s for every input\n"
+          "  -c                  encode machine code and write ELF relocatable objects (.o)\n"
+          "                      directly instead of assembly\n"
+          "  --run               compile into memory, call main and exit with its value\n"
+          "                      (single input, no output file; globals start at zero)\n"
+          "  --cache-dir <dir>   keep each function's code in <dir>, keyed by a hash of its\n"
+          "                      AST, the options and the compiler, and only lower the\n"
+          "                      functions not found there; safe to share between\n"
+          "                      concurrent compiler processes\n"
+          "  --dump-ast          print a summary of each parsed function\n"
+          "  --dump-ir           print the IR each function is lowered to\n"
+          "  --stats             print AST size, dead code and peephole rule counters\n"
+          "  --no-mmap           read inputs into heap buffers instead of mapping them\n"
+          "  --prelex            lex the whole input into a token buffer before parsing\n"
+          "                      (about 13 bytes a token) instead of one token at a time\n"
+          "  --pipeline          generate code on a second thread while parsing, freeing\n"
+          "                      each batch of functions' AST once it is emitted, so memory\n"
+          "                      follows the largest function rather than the file (ignored with\n"
+          "                      --run, --dump-ast and --dump-ir; lowers on one thread)\n"
+          "  -O0 | -O1           disable/enable constant folding, dead code elimination,\n"
+          "                      register allocation and peephole rewriting (default -O1)\n"
+          "  -fno-omit-frame-pointer\n"
+          "                      keep %rbp frames at -O1 (for profilers); by default\n"
+          "                      locals are addressed from %rsp, in the red zone if they fit\n"
+          "  -j <n>              use <n> threads (0 = one per CPU, default 1); with several\n"
+          "                      inputs files are compiled concurrently, otherwise the\n"
+          "                      functions of the single input are lowered concurrently\n"
+          "With several inputs and no --output-dir, each a.c is compiled to a.s (a.o) beside it.\n",
+          stream);
+}
+
+static int parse_arguments(int argc, char **argv, DriverOptions *options) {
+    options->inputs = malloc((size_t)argc * sizeof(const char *));
+    options->input_count = 0;
+    options->output_path = NULL;
+    options->output_dir = NULL;
+    options->dump_ast = 0;
+    options->dump_ir = 0;
+    options->print_stats = 0;
+    options->allow_mmap = 1;
+    options->prelex = 0;
+    options->pipeline = 0;
+    options->opt_level = 1;
+    options->keep_frame_pointer = 0;
+    options->emit_object = 0;
+    options->run = 0;
+    options->cache_dir = NULL;
+    options->cache = NULL;
+    options->threads = 1;
+    if (!options->inputs) {
+        fputs("fungcc_driver: out of memory\n", stderr);
+        return -1;
+    }
+
+    for (int i = 1; i < argc; ++i) {
+        const char *arg = argv[i];
+        if (strcmp(arg, "-o") == 0 || strcmp(arg, "--output-dir") == 0 || strcmp(arg, "--cache-dir") == 0) {
+            if (i + 1 >= argc) {
+                fprintf(stderr, "fungcc_driver: %s requires a path\n", arg);
+                return -1;
+            }
+            if (arg[1] == 'o') {
+                options->output_path = argv[++i];
+            } else if (arg[2] == 'o') {
+                options->output_dir = argv[++i];
+            } else {
+                options->cache_dir = argv[++i];
+            }
+        } else if (strcmp(arg, "-j") == 0) {
+            char *end = NULL;
+            if (i + 1 >= argc) {
+                fputs("fungcc_driver: -j requires a thread count\n", stderr);
+                return -1;
+            }
+            unsigned long threads = strtoul(argv[++i], &end, 10);
+            if (*end != '\0' || threads > 1024) {
+                fprintf(stderr, "fungcc_driver: invalid thread count '%s'\n", argv[i]);
+                return -1;
+            }
+            options->threads = (unsigned)threads;
+        } else if (strcmp(arg, "-c") == 0) {
+            options->emit_object = 1;
+        } else if (strcmp(arg, "--run") == 0) {
+            options->run = 1;
+        } else if (strcmp(arg, "--dump-ast") == 0) {
+            options->dump_ast = 1;
+        } else if (strcmp(arg, "--dump-ir") == 0) {
+            options->dump_ir = 1;
+        } else if (strcmp(arg, "--stats") == 0) {
+            options->print_stats = 1;
+        } else if (strcmp(arg, "--no-mmap") == 0) {
+            options->allow_mmap = 0;
+        } else if (strcmp(arg, "--prelex") == 0) {
+            options->prelex = 1;
+        } else if (strcmp(arg, "--pipeline") == 0) {
+            options->pipeline = 1;
+        } else if (strcmp(arg, "-O0") == 0) {
+            options->opt_level = 0;
+        } else if (strcmp(arg, "-O") == 0 || strcmp(arg, "-O1") == 0) {
+            options->opt_level = 1;
+        } else if (strcmp(arg, "-fno-omit-frame-pointer") == 0) {
+            options->keep_frame_pointer = 1;
+        } else if (strcmp(arg, "-fomit-frame-pointer") == 0) {
+            options->keep_frame_pointer = 0;
+        } else if (strcmp(arg, "-h") == 0 || strcmp(arg, "--help") == 0) {
+            print_usage(stdout);
+            exit(0);
+        } else if (arg[0] == '-' && arg[1] != '\0') {
+            fprintf(stderr, "fungcc_driver: unknown option '%s'\n", arg);
+            return -1;
+        } else {
+            options->inputs[options->input_count++] = arg;
+        }
+    }
 
+    if (options->output_path && options->output_dir) {
+        fputs("fungcc_driver: -o and --output-dir are mutually exclusive\n", stderr);
+        return -1;
+    }
+    if (options->run && (options->input_count > 1 || options->output_dir || options->output_path || options->emit_object)) {
+        fputs("fungcc_driver: --run takes a single input and writes no output\n", stderr);
+        return -1;
+    }
+    if (options->output_path && options->input_count > 1) {
+        fputs("fungcc_driver: -o takes a single input; use --output-dir for several\n", stderr);
+        return -1;
+    }
+    if (options->input_count > 1 || options->output_dir) {
+        for (size_t i = 0; i < options->input_count; ++i) {
+            if (strcmp(options->inputs[i], "-") == 0) {
+                fputs("fungcc_driver: stdin cannot be combined with batch output naming\n", stderr);
+                return -1;
+            }
+        }
+    }
+
+    return 0;
+}
+
+/* Maps an input path to its batch output: "dir/x.c" becomes "dir/x.s", or
+ * "<output_dir>/x.s" when an output directory is given; `extension` is ".s"
+ * or ".o". */
+static char *batch_output_path(const char *input, const char *output_dir, const char *extension) {
+    const char *stem = input;
+    if (output_dir) {
+        const char *slash = strrchr(input, '/');
+        stem = slash ? slash + 1 : input;
+    }
+
+    size_t stem_length = strlen(stem);
+    if (stem_length > 2 && strcmp(stem + stem_length - 2, ".c") == 0) {
+        stem_length -= 2;
+    }
+
+    size_t dir_length = output_dir ? strlen(output_dir) : 0;
+    char *path = malloc(dir_length + 1 + stem_length + 3);
+    if (!path) {
+        return NULL;
+    }
+
+    size_t used = 0;
+    if (output_dir) {
+        memcpy(path, output_dir, dir_length);
+        used = dir_length;
+        if (used > 0 && path[used - 1] != '/') {
+            path[used++] = '/';
+        }
+    }
+    memcpy(path + used, stem, stem_length);
+    memcpy(path + used + stem_length, extension, 3);
+    return path;
+}
+
+static int compare_paths(const void *lhs, const void *rhs) {
+    return strcmp(*(const char *const *)lhs, *(const char *const *)rhs);
+}
+
+/* Two inputs writing the same output would race, so reject that up front. */
+static int check_unique_outputs(char **outputs, size_t count) {
+    char **sorted = malloc(count * sizeof(char *));
+    if (!sorted) {
+        fputs("fungcc_driver: out of memory\n", stderr);
+        return -1;
+    }
+    memcpy(sorted, outputs, count * sizeof(char *));
+    qsort(sorted, count, sizeof(char *), compare_paths);
+
+    int status = 0;
+    for (size_t i = 1; i < count; ++i) {
+        if (strcmp(sorted[i - 1], sorted[i]) == 0) {
+            fprintf(stderr, "fungcc_driver: several inputs would write '%s'\n", sorted[i]);
+            status = -1;
+            break;
+        }
+    }
+    free(sorted);
+    return status;
+}
+
+/* Prints each function's IR as codegen will see it. Functions that fail to
+ * lower are skipped here; codegen reports their errors. */
+static void dump_ir(FILE *out, const AstTranslationUnit *unit, int opt_level) {
+    IrLocalMode mode = (opt_level > 0) ? IR_LOCALS_AS_VALUES : IR_LOCALS_IN_SLOTS;
+    for (uint32_t i = 0; i < unit->functions.count; ++i) {
+        Arena *arena = arena_create(0);
+        Emitter diag;
+        emitter_init(&diag, NULL);
+        IrFunction *function = arena ? ir_lower_function(unit, ast_function(unit, i), arena, mode, &diag) : NULL;
+        if (function && (opt_level <= 0 || eliminate_dead_code(function, NULL) == 0)) {
+            ir_dump_function(function, out);
+        }
+        emitter_free(&diag);
+        arena_destroy(arena);
+    }
+}
+
+static void print_codegen_stats(FILE *out, const DriverOptions *options, const DceStats *dce, const PeepholeStats *peephole) {
+    if (options->print_stats && options->opt_level > 0) {
+        fprintf(out, "Dead code: %zu instruction(s), %zu frame slot(s) removed\n", dce->instructions, dce->slots);
+        fputs("Peephole:", out);
+        for (size_t r = 0; r < PEEPHOLE_RULE_COUNT; ++r) {
+            fprintf(out, "%s %s %zu", r ? "," : "", peephole_rule_name((PeepholeRule)r), peephole->hits[r]);
+        }
+        fputc('\n', out);
+    }
+}
+
+static void print_cache_stats(FILE *out, const DriverOptions *options, const CodeCacheStats *stats) {
+    if (options->cache) {
+        fprintf(out, "Code cache: %zu hit(s), %zu miss(es)\n", stats->hits, stats->misses);
+    }
+}
+
+/* --run: calls the loaded unit's main, whose value (modulo 256, like a
+ * process exit status) becomes the driver's status. */
+static int run_main(JitModule *module, FILE *out, FILE *err) {
+    int result = 0;
+    int status = jit_run_main(module, &result);
+    jit_unload(module);
+    if (status != 0) {
+        fputs("No main function to run.\n", err);
+        return 1;
+    }
+    fprintf(out, "main returned %d\n", result);
+    return result & 0xFF;
+}
+
+/* --pipeline: the output file is written while the input is still being
+ * parsed, so unlike the two-pass path it exists, and is removed, after a
+ * parse error too. */
+static int compile_pipelined(Parser *parser,
+                             const char *output_path,
+                             const CodegenOptions *codegen_options,
+                             const DriverOptions *options,
+                             const DceStats *dce,
+                             const PeepholeStats *peephole,
+                             const CodeCacheStats *cache_stats,
+                             FILE *out,
+                             FILE *err) {
+    FILE *asm_file = fopen(output_path, options->emit_object ? "wb" : "w");
+    if (!asm_file) {
+        fprintf(err, "%s: %s\n", output_path, strerror(errno));
+        return 1;
+    }
+
+    PipelineStats stats;
+    if (pipeline_compile(parser, asm_file, codegen_options, 0, &stats) != 0) {
+        fputs(parser_status(parser) != PARSER_OK ? "Parse failed.\n" : "Code generation failed.\n", err);
+        fclose(asm_file);
+        remove(output_path);
+        return 1;
+    }
+    if (fclose(asm_file) != 0) {
+        fprintf(err, "%s: %s\n", output_path, strerror(errno));
+        return 1;
+    }
+
+    if (options->print_stats) {
+        fprintf(out,
+                "AST: %zu nodes, %zu names, %zu literals in %zu function(s), %zu batch(es) of at most %zu bytes\n",
+                stats.nodes,
+                stats.names,
+                stats.literals,
+                stats.functions,
+                stats.batches,
+                stats.largest_ast);
+        fprintf(out, "Symbols: %zu interned\n", stats.symbols);
+        fprintf(out, "Folded: %zu constant operator(s)\n", stats.folded);
+    }
+    print_codegen_stats(out, options, dce, peephole);
+    print_cache_stats(out, options, cache_stats);
+    fprintf(out, "%s written to %s\n", options->emit_object ? "Object" : "Assembly", output_path);
+    return 0;
+}
+
+/* Compiles one buffer. Informational output goes to `out`, errors to `err`. */
+static int compile_source(const char *source,
+                          size_t length,
+                          const char *output_path,
+                          unsigned codegen_threads,
+                          const DriverOptions *options,
+                          FILE *out,
+                          FILE *err) {
     Parser parser;
-    parser_init(&parser, demo, strlen(demo));
+    parser_init(&parser, source, length);
+    parser.prelex = options->prelex;
+    parser.diagnostics = err;
 
-    AstNode *unit = parser_parse_translation_unit(&parser);
+    PeepholeStats peephole = {{0}};
+    DceStats dce = {0};
+    CodeCacheStats cache_stats = {0};
+    CodegenOptions codegen_options;
+    codegen_options_init(&codegen_options);
+    codegen_options.threads = codegen_threads;
+    codegen_options.opt_level = options->opt_level;
+    codegen_options.keep_frame_pointer = options->keep_frame_pointer;
+    codegen_options.format = options->emit_object ? CODEGEN_OBJECT : CODEGEN_ASSEMBLY;
+    codegen_options.diagnostics = err;
+    codegen_options.peephole_stats = options->print_stats ? &peephole : NULL;
+    codegen_options.dce_stats = options->print_stats ? &dce : NULL;
+    codegen_options.cache = options->cache;
+    codegen_options.cache_stats = &cache_stats;
+
+    if (options->pipeline && !options->run && !options->dump_ast && !options->dump_ir) {
+        return compile_pipelined(&parser, output_path, &codegen_options, options, &dce, &peephole, &cache_stats, out, err);
+    }
+
+    AstTranslationUnit *unit = parser_parse_translation_unit(&parser);
     if (parser_status(&parser) != PARSER_OK) {
-        fputs("Parse failed.\n", stderr);
+        fputs("Parse failed.\n", err);
+        ast_free(unit);
+        return 1;
+    }
+
+    size_t folded = 0;
+    if (options->opt_level > 0 && fold_constants(unit, &folded) != 0) {
+        fputs("Out of memory while folding constants.\n", err);
         ast_free(unit);
         return 1;
     }
 
-    puts("fungcc parser demo:");
-    for (size_t i = 0; i < unit->value.translation_unit.function_count; ++i) {
-        dump_function(unit->value.translation_unit.functions[i]);
+    if (options->dump_ast) {
+        for (uint32_t i = 0; i < unit->functions.count; ++i) {
+            dump_function(out, unit, ast_function(unit, i));
+        }
+    }
+
+    if (options->dump_ir) {
+        dump_ir(out, unit, options->opt_level);
+    }
+
+    if (options->print_stats) {
+        fprintf(out,
+                "AST: %u nodes, %u names, %u literals in %zu bytes\n",
+                (unsigned)(unit->node_count - 1),
+                (unsigned)unit->name_count,
+                (unsigned)unit->literal_count,
+                ast_memory(unit));
+        fprintf(out, "Symbols: %u interned\n", (unsigned)unit->interner->count);
+        fprintf(out, "Folded: %zu constant operator(s)\n", folded);
+    }
+
+    if (options->run) {
+        /* The module copies the names it needs, so the AST can go first. */
+        JitModule module;
+        int status = jit_load_translation_unit(&module, unit, &codegen_options);
+        ast_free(unit);
+        if (status != 0) {
+            fputs("JIT compilation failed.\n", err);
+            return 1;
+        }
+        print_codegen_stats(out, options, &dce, &peephole);
+        print_cache_stats(out, options, &cache_stats);
+        fflush(out);
+        return run_main(&module, out, err);
     }
 
-    const char *asm_path = "build/fungcc_output.s";
-    FILE *asm_file = fopen(asm_path, "w");
+    FILE *asm_file = fopen(output_path, options->emit_object ? "wb" : "w");
     if (!asm_file) {
-        perror("fopen");
+        fprintf(err, "%s: %s\n", output_path, strerror(errno));
         ast_free(unit);
         return 1;
     }
 
-    if (codegen_emit_translation_unit(unit, asm_file) != 0) {
-        fputs("Code generation failed.\n", stderr);
+    if (codegen_emit_translation_unit_with_options(unit, asm_file, &codegen_options) != 0) {
+        fputs("Code generation failed.\n", err);
         fclose(asm_file);
+        remove(output_path); /* do not leave a truncated file for the build to pick up */
         ast_free(unit);
         return 1;
     }
 
-    fclose(asm_file);
-    printf("Assembly written to %s\n", asm_path);
+    if (fclose(asm_file) != 0) {
+        fprintf(err, "%s: %s\n", output_path, strerror(errno));
+        ast_free(unit);
+        return 1;
+    }
+    print_codegen_stats(out, options, &dce, &peephole);
+    print_cache_stats(out, options, &cache_stats);
+    fprintf(out, "%s written to %s\n", options->emit_object ? "Object" : "Assembly", output_path);
 
     ast_free(unit);
     return 0;
 }
+
+static int compile_file(const char *input_path,
+                        const char *output_path,
+                        unsigned codegen_threads,
+                        const DriverOptions *options,
+                        FILE *out,
+                        FILE *err) {
+    SourceFile file;
+    if (source_file_open(&file, input_path, options->allow_mmap) != 0) {
+        fprintf(err, "fungcc_driver: cannot read '%s': %s\n", input_path, strerror(errno));
+        return 1;
+    }
+
+    /* The AST references the source text directly, so the mapping must outlive it. */
+    int status = compile_source(file.data, file.length, output_path, codegen_threads, options, out, err);
+    source_file_close(&file);
+    return status;
+}
+
+/* Batch mode: one task per input. Each task captures its stdout/stderr text in
+ * memory; finished tasks are reported strictly in command-line order, as soon
+ * as every earlier input has been reported. */
+typedef struct BatchFile {
+    const char *input_path;
+    char *output_path;
+    char *out_text;
+    size_t out_length;
+    char *err_text;
+    size_t err_length;
+    int status;
+    int finished;
+} BatchFile;
+
+typedef struct Batch {
+    BatchFile *files;
+    size_t count;
+    const DriverOptions *options;
+    pthread_mutex_t report_lock;
+    size_t next_report;
+    size_t failures;
+} Batch;
+
+/* Prefixes every line of `text` with the input path, like a compiler would. */
+static void write_prefixed(FILE *stream, const char *prefix, const char *text, size_t length) {
+    size_t start = 0;
+    while (start < length) {
+        const char *newline = memchr(text + start, '\n', length - start);
+        size_t end = newline ? (size_t)(newline - text) + 1 : length;
+        fprintf(stream, "%s: %.*s", prefix, (int)(end - start), text + start);
+        if (!newline) {
+            fputc('\n', stream);
+        }
+        start = end;
+    }
+}
+
+static void report_ready_files(Batch *batch) {
+    while (batch->next_report < batch->count && batch->files[batch->next_report].finished) {
+        BatchFile *file = &batch->files[batch->next_report];
+        if (file->out_length > 0) {
+            fwrite(file->out_text, 1, file->out_length, stdout);
+        }
+        /* stderr is unbuffered: flush first so a shared pipe keeps file order. */
+        fflush(stdout);
+        write_prefixed(stderr, file->input_path, file->err_text, file->err_length);
+        if (file->status != 0) {
+            batch->failures += 1;
+        }
+        free(file->out_text);
+        free(file->err_text);
+        file->out_text = NULL;
+        file->err_text = NULL;
+        batch->next_report += 1;
+    }
+}
+
+static void compile_batch_file(void *context, size_t index) {
+    Batch *batch = context;
+    BatchFile *file = &batch->files[index];
+
+    FILE *out = open_memstream(&file->out_text, &file->out_length);
+    FILE *err = open_memstream(&file->err_text, &file->err_length);
+    if (out && err) {
+        file->status = compile_file(file->input_path, file->output_path, 1, batch->options, out, err);
+    } else {
+        file->status = 1;
+    }
+    if (out) {
+        fclose(out);
+    }
+    if (err) {
+        fclose(err);
+    }
+    if (!err) {
+        static const char message[] = "fungcc_driver: out of memory\n";
+        file->err_text = malloc(sizeof(message));
+        file->err_length = file->err_text ? sizeof(message) - 1 : 0;
+        if (file->err_text) {
+            memcpy(file->err_text, message, sizeof(message));
+        }
+    }
+
+    pthread_mutex_lock(&batch->report_lock);
+    file->finished = 1;
+    report_ready_files(batch);
+    pthread_mutex_unlock(&batch->report_lock);
+}
+
+static int compile_batch(const DriverOptions *options) {
+    Batch batch;
+    batch.files = calloc(options->input_count, sizeof(BatchFile));
+    batch.count = options->input_count;
+    batch.options = options;
+    batch.next_report = 0;
+    batch.failures = 0;
+    char **outputs = malloc(options->input_count * sizeof(char *));
+    if (!batch.files || !outputs) {
+        fputs("fungcc_driver: out of memory\n", stderr);
+        free(batch.files);
+        free(outputs);
+        return 1;
+    }
+
+    int status = 0;
+    for (size_t i = 0; i < batch.count; ++i) {
+        batch.files[i].input_path = options->inputs[i];
+        batch.files[i].output_path = batch_output_path(options->inputs[i], options->output_dir, options->emit_object ? ".o" : ".s");
+        outputs[i] = batch.files[i].output_path;
+        if (!outputs[i]) {
+            fputs("fungcc_driver: out of memory\n", stderr);
+            status = 1;
+        }
+    }
+    if (status == 0 && check_unique_outputs(outputs, batch.count) != 0) {
+        status = 1;
+    }
+
+    if (status == 0) {
+        unsigned threads = options->threads ? options->threads : parallel_default_threads();
+        pthread_mutex_init(&batch.report_lock, NULL);
+        parallel_for(batch.count, threads, compile_batch_file, &batch);
+        pthread_mutex_destroy(&batch.report_lock);
+
+        if (batch.failures > 0) {
+            fprintf(stderr, "fungcc_driver: %zu of %zu file(s) failed\n", batch.failures, batch.count);
+            status = 1;
+        }
+    }
+
+    for (size_t i = 0; i < batch.count; ++i) {
+        free(batch.files[i].output_path);
+    }
+    free(outputs);
+    free(batch.files);
+    return status;
+}
+
+int main(int argc, char **argv) {
+    DriverOptions options;
+    if (parse_arguments(argc, argv, &options) != 0) {
+        print_usage(stderr);
+        free(options.inputs);
+        return 1;
+    }
+
+    CodeCache cache;
+    if (options.cache_dir) {
+        if (code_cache_open(&cache, options.cache_dir) != 0) {
+            fprintf(stderr, "fungcc_driver: cannot use cache directory '%s': %s\n", options.cache_dir, strerror(errno));
+            free(options.inputs);
+            return 1;
+        }
+        options.cache = &cache;
+    }
+
+    const char *default_output = options.emit_object ? "build/fungcc_output.o" : "build/fungcc_output.s";
+    int status;
+    if (options.input_count == 0) {
+        const char *demo = "int main() { return 42; }\n";
+        options.dump_ast = 1;
+        options.print_stats = 1;
+        puts("fungcc parser demo:");
+        status = compile_source(demo, strlen(demo), default_output, options.threads, &options, stdout, stderr);
+    } else if (options.input_count > 1 || options.output_dir) {
+        status = compile_batch(&options);
+    } else {
+        const char *output_path = options.output_path ? options.output_path : default_output;
+        status = compile_file(options.inputs[0], output_path, options.threads, &options, stdout, stderr);
+    }
+
+    if (options.cache) {
+        code_cache_close(&cache);
+    }
+    free(options.inputs);
+    return status;
+}
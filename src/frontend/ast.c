@@ -2,47 +2,128 @@
 
 #include <stdlib.h>
 
-void ast_free(AstNode *node) {
-    if (!node) {
+/* Makes room for one more element in a doubling array of `size`-byte items. */
+static int reserve_one(void **items, uint32_t count, uint32_t *capacity, size_t size) {
+    if (count < *capacity) {
+        return 0;
+    }
+    if (count == UINT32_MAX) {
+        return -1;
+    }
+    uint32_t grown = *capacity ? *capacity * 2 : 64;
+    if (grown <= *capacity) {
+        grown = UINT32_MAX;
+    }
+    void *resized = realloc(*items, (size_t)grown * size);
+    if (!resized) {
+        return -1;
+    }
+    *items = resized;
+    *capacity = grown;
+    return 0;
+}
+
+AstTranslationUnit *ast_create(void) {
+    Interner *interner = interner_create();
+    AstTranslationUnit *unit = interner ? ast_create_shared(interner) : NULL;
+    if (!unit) {
+        interner_destroy(interner);
+        return NULL;
+    }
+    unit->owns_interner = 1;
+    return unit;
+}
+
+AstTranslationUnit *ast_create_shared(Interner *interner) {
+    AstTranslationUnit *unit = calloc(1, sizeof(*unit));
+    if (!unit) {
+        return NULL;
+    }
+    unit->arena = arena_create(0);
+    unit->interner = interner;
+    if (!unit->arena || !unit->interner || ast_add_node(unit, AST_NONE) != AST_NODE_NONE) {
+        ast_free(unit);
+        return NULL;
+    }
+    return unit;
+}
+
+void ast_free(AstTranslationUnit *unit) {
+    if (!unit) {
         return;
     }
+    free(unit->nodes);
+    free(unit->children);
+    free(unit->names);
+    free(unit->literals);
+    if (unit->owns_interner) {
+        interner_destroy(unit->interner);
+    }
+    arena_destroy(unit->arena);
+    free(unit);
+}
 
-    switch (node->kind) {
-    case AST_TRANSLATION_UNIT:
-        for (size_t i = 0; i < node->value.translation_unit.function_count; ++i) {
-            ast_free(node->value.translation_unit.functions[i]);
-        }
-        free(node->value.translation_unit.functions);
-        break;
-    case AST_FUNCTION_DECL:
-        ast_free(node->value.function_decl.body);
-        break;
-    case AST_RETURN_STMT:
-        ast_free(node->value.return_stmt.expression);
-        break;
-    case AST_NUMBER_LITERAL:
-    case AST_IDENTIFIER:
-        break;
-    case AST_UNARY_EXPR:
-        ast_free(node->value.unary_expr.operand);
-        break;
-    case AST_BINARY_EXPR:
-        ast_free(node->value.binary_expr.left);
-        ast_free(node->value.binary_expr.right);
-        break;
-    case AST_BLOCK:
-        for (size_t i = 0; i < node->value.block.statement_count; ++i) {
-            ast_free(node->value.block.statements[i]);
+AstNodeId ast_add_node(AstTranslationUnit *unit, AstNodeKind kind) {
+    if (reserve_one((void **)&unit->nodes, unit->node_count, &unit->node_capacity, sizeof(AstNode)) != 0) {
+        return AST_NODE_NONE;
+    }
+    AstNodeId id = unit->node_count++;
+    unit->nodes[id] = (AstNode){.kind = (uint8_t)kind};
+    return id;
+}
+
+int ast_add_name(AstTranslationUnit *unit, AstIdentifier name, uint32_t *index) {
+    if (reserve_one((void **)&unit->names, unit->name_count, &unit->name_capacity, sizeof(AstIdentifier)) != 0) {
+        return -1;
+    }
+    *index = unit->name_count++;
+    unit->names[*index] = name;
+    return 0;
+}
+
+int ast_add_literal(AstTranslationUnit *unit, AstNumberLiteral literal, uint32_t *index) {
+    if (reserve_one((void **)&unit->literals, unit->literal_count, &unit->literal_capacity, sizeof(AstNumberLiteral)) != 0) {
+        return -1;
+    }
+    *index = unit->literal_count++;
+    unit->literals[*index] = literal;
+    return 0;
+}
+
+int ast_add_children(AstTranslationUnit *unit, const AstNodeId *ids, uint32_t count, AstRange *range) {
+    range->first = unit->child_count;
+    range->count = count;
+    for (uint32_t i = 0; i < count; ++i) {
+        if (reserve_one((void **)&unit->children, unit->child_count, &unit->child_capacity, sizeof(AstNodeId)) != 0) {
+            unit->child_count = range->first;
+            return -1;
         }
-        free(node->value.block.statements);
-        break;
-    case AST_VAR_DECL:
-        ast_free(node->value.var_decl.initializer);
-        break;
-    case AST_ASSIGNMENT:
-        ast_free(node->value.assignment.value);
-        break;
+        unit->children[unit->child_count++] = ids[i];
     }
+    return 0;
+}
+
+/* Shrinking realloc cannot lose the data, so a failure just keeps the slack. */
+static void shrink_to(void **items, uint32_t count, uint32_t *capacity, size_t size) {
+    if (count == 0 || count == *capacity) {
+        return;
+    }
+    void *resized = realloc(*items, (size_t)count * size);
+    if (resized) {
+        *items = resized;
+        *capacity = count;
+    }
+}
+
+void ast_shrink(AstTranslationUnit *unit) {
+    shrink_to((void **)&unit->nodes, unit->node_count, &unit->node_capacity, sizeof(AstNode));
+    shrink_to((void **)&unit->children, unit->child_count, &unit->child_capacity, sizeof(AstNodeId));
+    shrink_to((void **)&unit->names, unit->name_count, &unit->name_capacity, sizeof(AstIdentifier));
+    shrink_to((void **)&unit->literals, unit->literal_count, &unit->literal_capacity, sizeof(AstNumberLiteral));
+}
 
-    free(node);
+size_t ast_memory(const AstTranslationUnit *unit) {
+    return (size_t)unit->node_capacity * sizeof(AstNode) + (size_t)unit->child_capacity * sizeof(AstNodeId) +
+           (size_t)unit->name_capacity * sizeof(AstIdentifier) +
+           (size_t)unit->literal_capacity * sizeof(AstNumberLiteral) + arena_stats(unit->arena).bytes_reserved;
 }
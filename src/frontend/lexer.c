@@ -1,9 +1,10 @@
 #include "frontend/lexer.h"
 
-#include <ctype.h>
-#include <stdbool.h>
+#include <stdlib.h>
 #include <string.h>
 
+#include "frontend/lexer_scan.h"
+
 static char lexer_peek_char(const Lexer *lexer, size_t offset) {
     size_t pos = lexer->index + offset;
     if (pos >= lexer->length) {
@@ -32,84 +33,148 @@ static void lexer_advance(Lexer *lexer) {
     }
 }
 
-static bool is_identifier_start(char c) {
-    return (c == '_') || isalpha((unsigned char)c);
+/* Character classes, indexed by byte. Bytes >= 0x80 and unused ASCII map to 0,
+ * which keeps classification independent of the C locale. */
+enum {
+    CHAR_IDENT = 1u << 0, /* may continue an identifier */
+    CHAR_IDENT_START = 1u << 1,
+    CHAR_DIGIT = 1u << 2,
+    CHAR_PUNCT = 1u << 3, /* complete single-character token, see punct_kinds */
+    CHAR_BLANK = 1u << 4, /* space, tab, carriage return, newline */
+    CHAR_ALPHA = CHAR_IDENT | CHAR_IDENT_START,
+    CHAR_NUMERIC = CHAR_IDENT | CHAR_DIGIT
+};
+
+static const unsigned char char_classes[256] = {
+    ['A'] = CHAR_ALPHA, ['B'] = CHAR_ALPHA, ['C'] = CHAR_ALPHA, ['D'] = CHAR_ALPHA, ['E'] = CHAR_ALPHA, ['F'] = CHAR_ALPHA,
+    ['G'] = CHAR_ALPHA, ['H'] = CHAR_ALPHA, ['I'] = CHAR_ALPHA, ['J'] = CHAR_ALPHA, ['K'] = CHAR_ALPHA, ['L'] = CHAR_ALPHA,
+    ['M'] = CHAR_ALPHA, ['N'] = CHAR_ALPHA, ['O'] = CHAR_ALPHA, ['P'] = CHAR_ALPHA, ['Q'] = CHAR_ALPHA, ['R'] = CHAR_ALPHA,
+    ['S'] = CHAR_ALPHA, ['T'] = CHAR_ALPHA, ['U'] = CHAR_ALPHA, ['V'] = CHAR_ALPHA, ['W'] = CHAR_ALPHA, ['X'] = CHAR_ALPHA,
+    ['Y'] = CHAR_ALPHA, ['Z'] = CHAR_ALPHA,
+    ['a'] = CHAR_ALPHA, ['b'] = CHAR_ALPHA, ['c'] = CHAR_ALPHA, ['d'] = CHAR_ALPHA, ['e'] = CHAR_ALPHA, ['f'] = CHAR_ALPHA,
+    ['g'] = CHAR_ALPHA, ['h'] = CHAR_ALPHA, ['i'] = CHAR_ALPHA, ['j'] = CHAR_ALPHA, ['k'] = CHAR_ALPHA, ['l'] = CHAR_ALPHA,
+    ['m'] = CHAR_ALPHA, ['n'] = CHAR_ALPHA, ['o'] = CHAR_ALPHA, ['p'] = CHAR_ALPHA, ['q'] = CHAR_ALPHA, ['r'] = CHAR_ALPHA,
+    ['s'] = CHAR_ALPHA, ['t'] = CHAR_ALPHA, ['u'] = CHAR_ALPHA, ['v'] = CHAR_ALPHA, ['w'] = CHAR_ALPHA, ['x'] = CHAR_ALPHA,
+    ['y'] = CHAR_ALPHA, ['z'] = CHAR_ALPHA,
+    ['_'] = CHAR_ALPHA,
+    ['0'] = CHAR_NUMERIC, ['1'] = CHAR_NUMERIC, ['2'] = CHAR_NUMERIC, ['3'] = CHAR_NUMERIC, ['4'] = CHAR_NUMERIC,
+    ['5'] = CHAR_NUMERIC, ['6'] = CHAR_NUMERIC, ['7'] = CHAR_NUMERIC, ['8'] = CHAR_NUMERIC, ['9'] = CHAR_NUMERIC,
+    ['('] = CHAR_PUNCT, [')'] = CHAR_PUNCT, ['{'] = CHAR_PUNCT, ['}'] = CHAR_PUNCT, [';'] = CHAR_PUNCT,
+    [','] = CHAR_PUNCT, ['*'] = CHAR_PUNCT, ['+'] = CHAR_PUNCT, ['-'] = CHAR_PUNCT, ['/'] = CHAR_PUNCT,
+    ['%'] = CHAR_PUNCT,
+    [' '] = CHAR_BLANK, ['\t'] = CHAR_BLANK, ['\r'] = CHAR_BLANK, ['\n'] = CHAR_BLANK,
+};
+
+static const unsigned char punct_kinds[256] = {
+    ['('] = TOKEN_L_PAREN,
+    [')'] = TOKEN_R_PAREN,
+    ['{'] = TOKEN_L_BRACE,
+    ['}'] = TOKEN_R_BRACE,
+    [';'] = TOKEN_SEMICOLON,
+    [','] = TOKEN_COMMA,
+    ['*'] = TOKEN_ASTERISK,
+    ['+'] = TOKEN_PLUS,
+    ['-'] = TOKEN_MINUS,
+    ['/'] = TOKEN_SLASH,
+    ['%'] = TOKEN_PERCENT,
+};
+
+static unsigned char char_class(char c) {
+    return char_classes[(unsigned char)c];
 }
 
-static bool is_identifier_part(char c) {
-    return (c == '_') || isalnum((unsigned char)c);
+/* Returns the end of the run of bytes starting at `index` whose class has any of `mask`. */
+static size_t scan_class_run(const Lexer *lexer, size_t index, unsigned char mask) {
+    const char *source = lexer->source;
+    size_t length = lexer->length;
+    while (index < length && (char_class(source[index]) & mask)) {
+        index += 1;
+    }
+    return index;
 }
 
+/* Advances over bytes known not to contain a newline. */
+static void lexer_skip_inline(Lexer *lexer, size_t end_index) {
+    lexer->column += end_index - lexer->index;
+    lexer->index = end_index;
+}
+
+typedef struct KeywordEntry {
+    const char *text;
+    size_t length;
+    TokenKind kind;
+} KeywordEntry;
+
+/* Perfect hash over the keyword set: (first byte + last byte) & 7 is distinct for
+ * every keyword, so a lookup is one probe plus one compare. Adding a keyword
+ * means re-checking that the slots stay distinct. */
+#define KEYWORD_HASH(first, last) (((unsigned)(unsigned char)(first) + (unsigned)(unsigned char)(last)) & 7u)
+
+static const KeywordEntry keyword_table[8] = {
+    [KEYWORD_HASH('i', 't')] = {"int", 3, TOKEN_KW_INT},
+    [KEYWORD_HASH('r', 'n')] = {"return", 6, TOKEN_KW_RETURN},
+    [KEYWORD_HASH('i', 'f')] = {"if", 2, TOKEN_KW_IF},
+    [KEYWORD_HASH('e', 'e')] = {"else", 4, TOKEN_KW_ELSE},
+    [KEYWORD_HASH('w', 'e')] = {"while", 5, TOKEN_KW_WHILE},
+};
+
 static TokenKind keyword_lookup(const char *start, size_t length) {
-    if (length == 0) {
-        return TOKEN_IDENTIFIER;
+    const KeywordEntry *entry = &keyword_table[KEYWORD_HASH(start[0], start[length - 1])];
+    if (entry->length == length && memcmp(entry->text, start, length) == 0) {
+        return entry->kind;
     }
+    return TOKEN_IDENTIFIER;
+}
 
-    switch (start[0]) {
-    case 'e':
-        if (length == 4 && strncmp(start, "else", length) == 0) {
-            return TOKEN_KW_ELSE;
-        }
-        break;
-    case 'i':
-        if (length == 2 && strncmp(start, "if", length) == 0) {
-            return TOKEN_KW_IF;
-        }
-        if (length == 3 && strncmp(start, "int", length) == 0) {
-            return TOKEN_KW_INT;
-        }
-        break;
-    case 'r':
-        if (length == 6 && strncmp(start, "return", length) == 0) {
-            return TOKEN_KW_RETURN;
-        }
-        break;
-    case 'w':
-        if (length == 5 && strncmp(start, "while", length) == 0) {
-            return TOKEN_KW_WHILE;
-        }
-        break;
-    default:
-        break;
+/* Moves the lexer to `index` after a bulk scan, fixing up line/column from the
+ * newlines the scan reported instead of inspecting every byte again. */
+static void lexer_jump(Lexer *lexer, size_t index, const ScanLines *lines) {
+    if (lines->newlines > 0) {
+        lexer->line += lines->newlines;
+        lexer->column = index - lines->last_newline;
+    } else {
+        lexer->column += index - lexer->index;
     }
-
-    return TOKEN_IDENTIFIER;
+    lexer->index = index;
 }
 
 static void skip_whitespace_and_comments(Lexer *lexer) {
+    const char *source = lexer->source;
+    size_t length = lexer->length;
+
     for (;;) {
-        char c = lexer_current_char(lexer);
-        if (c == '\0') {
+        /* Tokens are usually separated by at most one space: settle that inline and
+         * only call into the bulk scanners for longer runs or comments. */
+        size_t index = lexer->index;
+        if (index < length && source[index] == ' ') {
+            index += 1;
+        }
+        if (index < length && !(char_class(source[index]) & CHAR_BLANK) && source[index] != '/') {
+            lexer_skip_inline(lexer, index);
             return;
         }
 
-        if (c == ' ' || c == '\t' || c == '\r' || c == '\n') {
-            lexer_advance(lexer);
-            continue;
+        ScanLines lines = {0, 0};
+        index = scan_skip_blanks(source, index, length, &lines);
+        lexer_jump(lexer, index, &lines);
+
+        if (index + 1 >= length || source[index] != '/') {
+            return;
         }
 
-        if (c == '/' && lexer_peek_char(lexer, 1) == '/') {
-            while (lexer_current_char(lexer) != '\0' && lexer_current_char(lexer) != '\n') {
-                lexer_advance(lexer);
-            }
+        if (source[index + 1] == '/') {
+            ScanLines none = {0, 0};
+            lexer_jump(lexer, scan_find_newline(source, index + 2, length), &none);
             continue;
         }
 
-        if (c == '/' && lexer_peek_char(lexer, 1) == '*') {
-            lexer_advance(lexer); // '/'
-            lexer_advance(lexer); // '*'
-            while (lexer_current_char(lexer) != '\0') {
-                if (lexer_current_char(lexer) == '*' && lexer_peek_char(lexer, 1) == '/') {
-                    lexer_advance(lexer);
-                    lexer_advance(lexer);
-                    break;
-                }
-                lexer_advance(lexer);
-            }
+        if (source[index + 1] == '*') {
+            lines.newlines = 0;
+            lexer_jump(lexer, scan_skip_block_comment(source, index + 2, length, &lines), &lines);
             continue;
         }
 
-        break;
+        return;
     }
 }
 
@@ -121,31 +186,30 @@ static Token make_token(const Lexer *lexer, TokenKind kind, size_t start_index,
     token.length = end_index - start_index;
     token.line = start_line;
     token.column = start_column;
+    token.symbol = SYMBOL_NONE;
     return token;
 }
 
 static Token scan_identifier_or_keyword(Lexer *lexer, size_t start_index, size_t start_line, size_t start_column) {
-    while (is_identifier_part(lexer_current_char(lexer))) {
-        lexer_advance(lexer);
-    }
+    lexer_skip_inline(lexer, scan_class_run(lexer, lexer->index, CHAR_IDENT));
 
     size_t length = lexer->index - start_index;
     TokenKind kind = keyword_lookup(lexer->source + start_index, length);
-    return make_token(lexer, kind, start_index, start_line, start_column);
+    Token token = make_token(lexer, kind, start_index, start_line, start_column);
+    if (kind == TOKEN_IDENTIFIER && lexer->interner) {
+        token.symbol = interner_intern(lexer->interner, token.lexeme, token.length);
+    }
+    return token;
 }
 
 static Token scan_number(Lexer *lexer, size_t start_index, size_t start_line, size_t start_column) {
-    while (isdigit((unsigned char)lexer_current_char(lexer))) {
-        lexer_advance(lexer);
-    }
+    size_t end = scan_class_run(lexer, lexer->index, CHAR_DIGIT);
 
-    if (lexer_current_char(lexer) == '.' && isdigit((unsigned char)lexer_peek_char(lexer, 1))) {
-        lexer_advance(lexer);
-        while (isdigit((unsigned char)lexer_current_char(lexer))) {
-            lexer_advance(lexer);
-        }
+    if (end + 1 < lexer->length && lexer->source[end] == '.' && (char_class(lexer->source[end + 1]) & CHAR_DIGIT)) {
+        end = scan_class_run(lexer, end + 1, CHAR_DIGIT);
     }
 
+    lexer_skip_inline(lexer, end);
     return make_token(lexer, TOKEN_NUMBER, start_index, start_line, start_column);
 }
 
@@ -175,6 +239,11 @@ void lexer_init(Lexer *lexer, const char *source, size_t length) {
     lexer->index = 0;
     lexer->line = 1;
     lexer->column = 1;
+    lexer->interner = NULL;
+}
+
+void lexer_set_interner(Lexer *lexer, Interner *interner) {
+    lexer->interner = interner;
 }
 
 Token lexer_peek_token(const Lexer *lexer) {
@@ -194,53 +263,150 @@ Token lexer_next_token(Lexer *lexer) {
         return make_token(lexer, TOKEN_EOF, start_index, start_line, start_column);
     }
 
-    if (is_identifier_start(c)) {
-        lexer_advance(lexer);
+    /* Newlines were consumed above, so every remaining start byte is on this line. */
+    unsigned char cls = char_class(c);
+    lexer_skip_inline(lexer, start_index + 1);
+
+    if (cls & CHAR_IDENT_START) {
         return scan_identifier_or_keyword(lexer, start_index, start_line, start_column);
     }
 
-    if (isdigit((unsigned char)c)) {
-        lexer_advance(lexer);
+    if (cls & CHAR_DIGIT) {
         return scan_number(lexer, start_index, start_line, start_column);
     }
 
+    if (cls & CHAR_PUNCT) {
+        return make_token(lexer, (TokenKind)punct_kinds[(unsigned char)c], start_index, start_line, start_column);
+    }
+
     if (c == '"') {
-        lexer_advance(lexer);
         return scan_string(lexer, start_index, start_line, start_column);
     }
 
-    lexer_advance(lexer);
-
-    switch (c) {
-    case '(':
-        return make_token(lexer, TOKEN_L_PAREN, start_index, start_line, start_column);
-    case ')':
-        return make_token(lexer, TOKEN_R_PAREN, start_index, start_line, start_column);
-    case '{':
-        return make_token(lexer, TOKEN_L_BRACE, start_index, start_line, start_column);
-    case '}':
-        return make_token(lexer, TOKEN_R_BRACE, start_index, start_line, start_column);
-    case ';':
-        return make_token(lexer, TOKEN_SEMICOLON, start_index, start_line, start_column);
-    case ',':
-        return make_token(lexer, TOKEN_COMMA, start_index, start_line, start_column);
-    case '*':
-        return make_token(lexer, TOKEN_ASTERISK, start_index, start_line, start_column);
-    case '+':
-        return make_token(lexer, TOKEN_PLUS, start_index, start_line, start_column);
-    case '-':
-        return make_token(lexer, TOKEN_MINUS, start_index, start_line, start_column);
-    case '/':
-        return make_token(lexer, TOKEN_SLASH, start_index, start_line, start_column);
-    case '=':
+    if (c == '=') {
         if (lexer_current_char(lexer) == '=') {
-            lexer_advance(lexer);
+            lexer_skip_inline(lexer, lexer->index + 1);
             return make_token(lexer, TOKEN_EQUAL_EQUAL, start_index, start_line, start_column);
         }
         return make_token(lexer, TOKEN_EQUAL, start_index, start_line, start_column);
-    default:
-        break;
     }
 
     return make_token(lexer, TOKEN_UNKNOWN, start_index, start_line, start_column);
 }
+
+int lexer_number_value(const char *lexeme, size_t length, int64_t *value) {
+    if (length == 0) {
+        return -1;
+    }
+    uint64_t magnitude = 0;
+    for (size_t i = 0; i < length; ++i) {
+        unsigned digit = (unsigned)(lexeme[i] - '0');
+        if (digit > 9) {
+            return -1;
+        }
+        magnitude = magnitude * 10u + digit;
+    }
+    *value = (magnitude > (uint64_t)INT64_MAX) ? -(int64_t)(~magnitude) - 1 : (int64_t)magnitude;
+    return 0;
+}
+
+/* Grows `*items` (existing contents kept) to `count` elements of `size` bytes. */
+static int grow_array(void **items, uint32_t count, size_t size) {
+    void *resized = realloc(*items, (size_t)count * size);
+    if (!resized) {
+        return -1;
+    }
+    *items = resized;
+    return 0;
+}
+
+static int token_buffer_reserve(TokenBuffer *tokens, uint32_t capacity) {
+    if (grow_array((void **)&tokens->kinds, capacity, sizeof(uint8_t)) != 0 ||
+        grow_array((void **)&tokens->offsets, capacity, sizeof(uint32_t)) != 0 ||
+        grow_array((void **)&tokens->lengths, capacity, sizeof(uint32_t)) != 0 ||
+        grow_array((void **)&tokens->payloads, capacity, sizeof(uint32_t)) != 0) {
+        return -1;
+    }
+    tokens->capacity = capacity;
+    return 0;
+}
+
+/* Sets `*payload` to the index of the number token's decoded value, or to
+ * TOKEN_NO_VALUE. Returns -1 on allocation failure. */
+static int add_number_value(TokenBuffer *tokens, const Token *token, uint32_t *payload) {
+    int64_t value = 0;
+    *payload = TOKEN_NO_VALUE;
+    if (lexer_number_value(token->lexeme, token->length, &value) != 0) {
+        return 0;
+    }
+    if (tokens->value_count == tokens->value_capacity) {
+        uint32_t capacity = tokens->value_capacity ? tokens->value_capacity * 2 : 256;
+        if (grow_array((void **)&tokens->values, capacity, sizeof(int64_t)) != 0) {
+            return -1;
+        }
+        tokens->value_capacity = capacity;
+    }
+    tokens->values[tokens->value_count] = value;
+    *payload = tokens->value_count++;
+    return 0;
+}
+
+int lexer_tokenize(Lexer *lexer, TokenBuffer *tokens) {
+    memset(tokens, 0, sizeof(*tokens));
+    tokens->source = lexer->source;
+    /* A first guess: generated code averages well over four bytes a token. */
+    if (lexer->length >= UINT32_MAX || token_buffer_reserve(tokens, (uint32_t)(lexer->length / 4) + 16) != 0) {
+        token_buffer_free(tokens);
+        return -1;
+    }
+
+    for (;;) {
+        Token token = lexer_next_token(lexer);
+        if (tokens->count == tokens->capacity) {
+            uint32_t capacity = tokens->capacity * 2;
+            if (capacity <= tokens->count || token_buffer_reserve(tokens, capacity) != 0) {
+                token_buffer_free(tokens);
+                return -1;
+            }
+        }
+
+        uint32_t payload = 0;
+        if (token.kind == TOKEN_IDENTIFIER) {
+            payload = token.symbol;
+        } else if (token.kind == TOKEN_NUMBER && add_number_value(tokens, &token, &payload) != 0) {
+            token_buffer_free(tokens);
+            return -1;
+        }
+        uint32_t index = tokens->count++;
+        tokens->kinds[index] = (uint8_t)token.kind;
+        tokens->offsets[index] = (uint32_t)(token.lexeme - lexer->source);
+        tokens->lengths[index] = (uint32_t)token.length;
+        tokens->payloads[index] = payload;
+        if (token.kind == TOKEN_EOF) {
+            return 0;
+        }
+    }
+}
+
+void token_buffer_free(TokenBuffer *tokens) {
+    free(tokens->kinds);
+    free(tokens->offsets);
+    free(tokens->lengths);
+    free(tokens->payloads);
+    free(tokens->values);
+    memset(tokens, 0, sizeof(*tokens));
+}
+
+void token_buffer_position(const TokenBuffer *tokens, uint32_t index, size_t *line, size_t *column) {
+    const char *source = tokens->source;
+    size_t offset = tokens->offsets[index];
+    size_t line_start = 0;
+    *line = 1;
+    for (size_t i = 0; i < offset; ++i) {
+        if (source[i] == '\n') {
+            *line += 1;
+            line_start = i + 1;
+        }
+    }
+    *column = offset - line_start + 1;
+}
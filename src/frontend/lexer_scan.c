@@ -0,0 +1,271 @@
+#include "frontend/lexer_scan.h"
+
+#include <stdatomic.h>
+#include <stdint.h>
+
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__))
+#define FUNGCC_SCAN_X86 1
+#include <immintrin.h>
+#else
+#define FUNGCC_SCAN_X86 0
+#endif
+
+typedef size_t (*SkipFn)(const char *text, size_t index, size_t length, ScanLines *lines);
+typedef size_t (*FindFn)(const char *text, size_t index, size_t length);
+
+typedef struct ScanOps {
+    SkipFn skip_blanks;
+    SkipFn skip_block_comment;
+    FindFn find_newline;
+} ScanOps;
+
+static int is_blank(char c) {
+    return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+}
+
+static void note_newline(ScanLines *lines, size_t index) {
+    lines->newlines += 1;
+    lines->last_newline = index;
+}
+
+/* ---- Scalar reference implementation (also handles vector tails) ---- */
+
+static size_t skip_blanks_scalar(const char *text, size_t index, size_t length, ScanLines *lines) {
+    while (index < length && is_blank(text[index])) {
+        if (text[index] == '\n') {
+            note_newline(lines, index);
+        }
+        index += 1;
+    }
+    return index;
+}
+
+static size_t skip_block_comment_scalar(const char *text, size_t index, size_t length, ScanLines *lines) {
+    while (index < length) {
+        char c = text[index];
+        if (c == '*' && index + 1 < length && text[index + 1] == '/') {
+            return index + 2;
+        }
+        if (c == '\n') {
+            note_newline(lines, index);
+        }
+        index += 1;
+    }
+    return length;
+}
+
+static size_t find_newline_scalar(const char *text, size_t index, size_t length) {
+    while (index < length && text[index] != '\n') {
+        index += 1;
+    }
+    return index;
+}
+
+#if FUNGCC_SCAN_X86
+
+/* Records the newlines of one vector block; `mask` holds one bit per byte, already
+ * truncated to the bytes that were actually consumed. */
+static inline void note_newline_mask(ScanLines *lines, size_t base, uint32_t mask) {
+    if (mask) {
+        lines->newlines += (size_t)__builtin_popcount(mask);
+        lines->last_newline = base + 31u - (size_t)__builtin_clz(mask);
+    }
+}
+
+static inline uint32_t bits_below(unsigned position) {
+    return (position >= 32) ? UINT32_MAX : ((1u << position) - 1u);
+}
+
+/* ---- SSE2: 16 bytes per step, always available on x86-64 ---- */
+
+__attribute__((target("sse2")))
+static size_t skip_blanks_sse2(const char *text, size_t index, size_t length, ScanLines *lines) {
+    const __m128i space = _mm_set1_epi8(' ');
+    const __m128i tab = _mm_set1_epi8('\t');
+    const __m128i cr = _mm_set1_epi8('\r');
+    const __m128i nl = _mm_set1_epi8('\n');
+
+    while (index + 16 <= length) {
+        __m128i chunk = _mm_loadu_si128((const __m128i *)(const void *)(text + index));
+        __m128i newline = _mm_cmpeq_epi8(chunk, nl);
+        __m128i blank = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(chunk, space), _mm_cmpeq_epi8(chunk, tab)),
+                                     _mm_or_si128(_mm_cmpeq_epi8(chunk, cr), newline));
+        uint32_t stop = ~(uint32_t)_mm_movemask_epi8(blank) & 0xFFFFu;
+        uint32_t newlines = (uint32_t)_mm_movemask_epi8(newline);
+        if (stop) {
+            unsigned position = (unsigned)__builtin_ctz(stop);
+            note_newline_mask(lines, index, newlines & bits_below(position));
+            return index + position;
+        }
+        note_newline_mask(lines, index, newlines);
+        index += 16;
+    }
+    return skip_blanks_scalar(text, index, length, lines);
+}
+
+__attribute__((target("sse2")))
+static size_t skip_block_comment_sse2(const char *text, size_t index, size_t length, ScanLines *lines) {
+    const __m128i star = _mm_set1_epi8('*');
+    const __m128i slash = _mm_set1_epi8('/');
+    const __m128i nl = _mm_set1_epi8('\n');
+
+    /* Compare the block against itself shifted by one byte to find a star-slash pair. */
+    while (index + 17 <= length) {
+        __m128i chunk = _mm_loadu_si128((const __m128i *)(const void *)(text + index));
+        __m128i next = _mm_loadu_si128((const __m128i *)(const void *)(text + index + 1));
+        uint32_t close = (uint32_t)_mm_movemask_epi8(
+            _mm_and_si128(_mm_cmpeq_epi8(chunk, star), _mm_cmpeq_epi8(next, slash)));
+        uint32_t newlines = (uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(chunk, nl));
+        if (close) {
+            unsigned position = (unsigned)__builtin_ctz(close);
+            note_newline_mask(lines, index, newlines & bits_below(position));
+            return index + position + 2;
+        }
+        note_newline_mask(lines, index, newlines);
+        index += 16;
+    }
+    return skip_block_comment_scalar(text, index, length, lines);
+}
+
+__attribute__((target("sse2")))
+static size_t find_newline_sse2(const char *text, size_t index, size_t length) {
+    const __m128i nl = _mm_set1_epi8('\n');
+    while (index + 16 <= length) {
+        __m128i chunk = _mm_loadu_si128((const __m128i *)(const void *)(text + index));
+        uint32_t found = (uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(chunk, nl));
+        if (found) {
+            return index + (size_t)__builtin_ctz(found);
+        }
+        index += 16;
+    }
+    return find_newline_scalar(text, index, length);
+}
+
+/* ---- AVX2: 32 bytes per step, selected at runtime ---- */
+
+__attribute__((target("avx2,popcnt")))
+static size_t skip_blanks_avx2(const char *text, size_t index, size_t length, ScanLines *lines) {
+    const __m256i space = _mm256_set1_epi8(' ');
+    const __m256i tab = _mm256_set1_epi8('\t');
+    const __m256i cr = _mm256_set1_epi8('\r');
+    const __m256i nl = _mm256_set1_epi8('\n');
+
+    while (index + 32 <= length) {
+        __m256i chunk = _mm256_loadu_si256((const __m256i *)(const void *)(text + index));
+        __m256i newline = _mm256_cmpeq_epi8(chunk, nl);
+        __m256i blank = _mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi8(chunk, space), _mm256_cmpeq_epi8(chunk, tab)),
+                                        _mm256_or_si256(_mm256_cmpeq_epi8(chunk, cr), newline));
+        uint32_t stop = ~(uint32_t)_mm256_movemask_epi8(blank);
+        uint32_t newlines = (uint32_t)_mm256_movemask_epi8(newline);
+        if (stop) {
+            unsigned position = (unsigned)__builtin_ctz(stop);
+            note_newline_mask(lines, index, newlines & bits_below(position));
+            return index + position;
+        }
+        note_newline_mask(lines, index, newlines);
+        index += 32;
+    }
+    return skip_blanks_sse2(text, index, length, lines);
+}
+
+__attribute__((target("avx2,popcnt")))
+static size_t skip_block_comment_avx2(const char *text, size_t index, size_t length, ScanLines *lines) {
+    const __m256i star = _mm256_set1_epi8('*');
+    const __m256i slash = _mm256_set1_epi8('/');
+    const __m256i nl = _mm256_set1_epi8('\n');
+
+    while (index + 33 <= length) {
+        __m256i chunk = _mm256_loadu_si256((const __m256i *)(const void *)(text + index));
+        __m256i next = _mm256_loadu_si256((const __m256i *)(const void *)(text + index + 1));
+        uint32_t close = (uint32_t)_mm256_movemask_epi8(
+            _mm256_and_si256(_mm256_cmpeq_epi8(chunk, star), _mm256_cmpeq_epi8(next, slash)));
+        uint32_t newlines = (uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(chunk, nl));
+        if (close) {
+            unsigned position = (unsigned)__builtin_ctz(close);
+            note_newline_mask(lines, index, newlines & bits_below(position));
+            return index + position + 2;
+        }
+        note_newline_mask(lines, index, newlines);
+        index += 32;
+    }
+    return skip_block_comment_sse2(text, index, length, lines);
+}
+
+__attribute__((target("avx2")))
+static size_t find_newline_avx2(const char *text, size_t index, size_t length) {
+    const __m256i nl = _mm256_set1_epi8('\n');
+    while (index + 32 <= length) {
+        __m256i chunk = _mm256_loadu_si256((const __m256i *)(const void *)(text + index));
+        uint32_t found = (uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(chunk, nl));
+        if (found) {
+            return index + (size_t)__builtin_ctz(found);
+        }
+        index += 32;
+    }
+    return find_newline_sse2(text, index, length);
+}
+
+#endif /* FUNGCC_SCAN_X86 */
+
+static const ScanOps scan_ops[] = {
+    [SCAN_ISA_SCALAR] = {skip_blanks_scalar, skip_block_comment_scalar, find_newline_scalar},
+#if FUNGCC_SCAN_X86
+    [SCAN_ISA_SSE2] = {skip_blanks_sse2, skip_block_comment_sse2, find_newline_sse2},
+    [SCAN_ISA_AVX2] = {skip_blanks_avx2, skip_block_comment_avx2, find_newline_avx2},
+#endif
+};
+
+static atomic_int selected_isa = -1;
+
+static ScanIsa detect_isa(void) {
+#if FUNGCC_SCAN_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        return SCAN_ISA_AVX2;
+    }
+    if (__builtin_cpu_supports("sse2")) {
+        return SCAN_ISA_SSE2;
+    }
+#endif
+    return SCAN_ISA_SCALAR;
+}
+
+ScanIsa scan_active_isa(void) {
+    int isa = atomic_load_explicit(&selected_isa, memory_order_relaxed);
+    if (isa < 0) {
+        isa = (int)detect_isa();
+        atomic_store_explicit(&selected_isa, isa, memory_order_relaxed);
+    }
+    return (ScanIsa)isa;
+}
+
+ScanIsa scan_force_isa(ScanIsa isa) {
+    ScanIsa supported = detect_isa();
+    if (isa > supported) {
+        isa = supported;
+    }
+    atomic_store_explicit(&selected_isa, (int)isa, memory_order_relaxed);
+    return isa;
+}
+
+size_t scan_skip_blanks(const char *text, size_t index, size_t length, ScanLines *lines) {
+    /* Most gaps between tokens are a single space; avoid the vector setup for them. */
+    if (index < length && !is_blank(text[index])) {
+        return index;
+    }
+    if (index + 1 < length && !is_blank(text[index + 1])) {
+        if (text[index] == '\n') {
+            note_newline(lines, index);
+        }
+        return index + 1;
+    }
+    return scan_ops[scan_active_isa()].skip_blanks(text, index, length, lines);
+}
+
+size_t scan_skip_block_comment(const char *text, size_t index, size_t length, ScanLines *lines) {
+    return scan_ops[scan_active_isa()].skip_block_comment(text, index, length, lines);
+}
+
+size_t scan_find_newline(const char *text, size_t index, size_t length) {
+    return scan_ops[scan_active_isa()].find_newline(text, index, length);
+}
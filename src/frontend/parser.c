@@ -1,20 +1,75 @@
 #include "frontend/parser.h"
 
+#include <stdarg.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
-static Token parser_advance(Parser *parser) {
-    parser->current = lexer_next_token(&parser->lexer);
-    return parser->current;
+static void parser_advance(Parser *parser) {
+    if (parser->prelex) {
+        if (parser->kind != TOKEN_EOF) {
+            parser->position += 1;
+        }
+        parser->kind = (TokenKind)parser->tokens.kinds[parser->position];
+    } else {
+        parser->current = lexer_next_token(&parser->lexer);
+        parser->kind = parser->current.kind;
+    }
 }
 
-static Token parser_peek(Parser *parser) {
-    return parser->current;
+/* The current token's spelling, as an identifier with its interned symbol. */
+static AstIdentifier parser_identifier(const Parser *parser) {
+    AstIdentifier identifier;
+    if (parser->prelex) {
+        const TokenBuffer *tokens = &parser->tokens;
+        identifier.name = tokens->source + tokens->offsets[parser->position];
+        identifier.length = tokens->lengths[parser->position];
+        identifier.symbol = tokens->payloads[parser->position];
+    } else {
+        identifier.name = parser->current.lexeme;
+        identifier.length = parser->current.length;
+        identifier.symbol = parser->current.symbol;
+    }
+    return identifier;
+}
+
+static void parser_location(const Parser *parser, size_t *line, size_t *column) {
+    if (parser->prelex) {
+        token_buffer_position(&parser->tokens, parser->position, line, column);
+    } else {
+        *line = parser->current.line;
+        *column = parser->current.column;
+    }
+}
+
+/* Decoded value of the current TOKEN_NUMBER; -1 when it is not an integer. */
+static int parser_number(const Parser *parser, int64_t *value) {
+    if (!parser->prelex) {
+        return lexer_number_value(parser->current.lexeme, parser->current.length, value);
+    }
+    uint32_t payload = parser->tokens.payloads[parser->position];
+    if (payload == TOKEN_NO_VALUE) {
+        return -1;
+    }
+    *value = parser->tokens.values[payload];
+    return 0;
+}
+
+static void parser_error(Parser *parser, const char *format, ...) {
+    size_t line = 0;
+    size_t column = 0;
+    parser_location(parser, &line, &column);
+    fprintf(parser->diagnostics, "Parser error at line %zu col %zu: ", line, column);
+    va_list args;
+    va_start(args, format);
+    vfprintf(parser->diagnostics, format, args);
+    va_end(args);
+    fputc('\n', parser->diagnostics);
+    parser->status = PARSER_ERROR;
 }
 
 static int parser_match(Parser *parser, TokenKind kind) {
-    if (parser->current.kind == kind) {
+    if (parser->kind == kind) {
         parser_advance(parser);
         return 1;
     }
@@ -23,209 +78,264 @@ static int parser_match(Parser *parser, TokenKind kind) {
 
 static void parser_expect(Parser *parser, TokenKind kind, const char *message) {
     if (!parser_match(parser, kind)) {
-        fprintf(stderr, "Parser error at line %zu col %zu: expected %s\n",
-                parser->current.line,
-                parser->current.column,
-                message);
+        parser_error(parser, "expected %s", message);
+    }
+}
+
+/* Adds a node of `kind`; on failure the parse fails and AST_NODE_NONE is returned. */
+static AstNodeId parser_add_node(Parser *parser, AstNodeKind kind) {
+    AstNodeId id = ast_add_node(parser->unit, kind);
+    if (id == AST_NODE_NONE) {
         parser->status = PARSER_ERROR;
     }
+    return id;
 }
 
-static AstNode *ast_new_node(AstNodeKind kind) {
-    AstNode *node = calloc(1, sizeof(AstNode));
-    if (!node) {
-        return NULL;
+static AstNode *parser_node(Parser *parser, AstNodeId id) {
+    return &parser->unit->nodes[id];
+}
+
+/* Records `name` in the unit; returns -1 (and fails the parse) when out of memory. */
+static int parser_add_name(Parser *parser, AstIdentifier name, uint32_t *index) {
+    if (ast_add_name(parser->unit, name, index) != 0) {
+        parser->status = PARSER_ERROR;
+        return -1;
     }
-    node->kind = kind;
-    return node;
+    return 0;
 }
 
-static AstNode *parse_expression(Parser *parser);
-static AstNode *parse_unary(Parser *parser);
-static AstNode *parse_statement(Parser *parser);
-static AstNode *parse_block(Parser *parser);
+/* Statements (and functions) wait on this stack until their block closes and
+ * they can be copied into `children` as one range. */
+static int parser_push_pending(Parser *parser, AstNodeId id) {
+    if (parser->pending_count == parser->pending_capacity) {
+        uint32_t capacity = parser->pending_capacity ? parser->pending_capacity * 2 : 64;
+        AstNodeId *items = capacity > parser->pending_capacity
+                               ? realloc(parser->pending, (size_t)capacity * sizeof(AstNodeId))
+                               : NULL;
+        if (!items) {
+            parser->status = PARSER_ERROR;
+            return -1;
+        }
+        parser->pending = items;
+        parser->pending_capacity = capacity;
+    }
+    parser->pending[parser->pending_count++] = id;
+    return 0;
+}
+
+/* Moves everything pushed since `base` into `children`. */
+static void parser_pop_pending(Parser *parser, uint32_t base, AstRange *range) {
+    if (ast_add_children(parser->unit, parser->pending + base, parser->pending_count - base, range) != 0) {
+        parser->status = PARSER_ERROR;
+        *range = (AstRange){0, 0};
+    }
+    parser->pending_count = base;
+}
 
-static AstNode *parse_primary(Parser *parser) {
-    Token token = parser_peek(parser);
-    if (token.kind == TOKEN_NUMBER) {
-        AstNode *literal = ast_new_node(AST_NUMBER_LITERAL);
-        if (!literal) {
+static AstNodeId parse_expression(Parser *parser);
+static AstNodeId parse_unary(Parser *parser);
+static AstNodeId parse_statement(Parser *parser);
+static AstNodeId parse_block(Parser *parser);
+
+static AstNodeId parse_primary(Parser *parser) {
+    if (parser->kind == TOKEN_NUMBER) {
+        AstIdentifier spelling = parser_identifier(parser);
+        int64_t value = 0;
+        if (parser_number(parser, &value) != 0) {
+            parser_error(parser, "unsupported number literal '%.*s'", (int)spelling.length, spelling.name);
+            parser_advance(parser); /* consumed, so the statement still ends cleanly */
+            return AST_NODE_NONE;
+        }
+
+        uint32_t index = 0;
+        AstNumberLiteral literal = {spelling.name, spelling.length, value};
+        if (ast_add_literal(parser->unit, literal, &index) != 0) {
             parser->status = PARSER_ERROR;
-            return NULL;
+            return AST_NODE_NONE;
+        }
+        AstNodeId id = parser_add_node(parser, AST_NUMBER_LITERAL);
+        if (id == AST_NODE_NONE) {
+            return AST_NODE_NONE;
         }
-        literal->value.number_literal.lexeme = token.lexeme;
-        literal->value.number_literal.length = token.length;
+        parser_node(parser, id)->value.number_literal = index;
         parser_advance(parser);
-        return literal;
+        return id;
     }
 
-    if (token.kind == TOKEN_IDENTIFIER) {
-        AstNode *ident = ast_new_node(AST_IDENTIFIER);
-        if (!ident) {
-            parser->status = PARSER_ERROR;
-            return NULL;
+    if (parser->kind == TOKEN_IDENTIFIER) {
+        uint32_t index = 0;
+        if (parser_add_name(parser, parser_identifier(parser), &index) != 0) {
+            return AST_NODE_NONE;
+        }
+        AstNodeId id = parser_add_node(parser, AST_IDENTIFIER);
+        if (id == AST_NODE_NONE) {
+            return AST_NODE_NONE;
         }
-        ident->value.identifier.name = token.lexeme;
-        ident->value.identifier.length = token.length;
+        parser_node(parser, id)->value.identifier = index;
         parser_advance(parser);
-        return ident;
+        return id;
     }
 
-    if (token.kind == TOKEN_L_PAREN) {
+    if (parser->kind == TOKEN_L_PAREN) {
         parser_advance(parser);
-        AstNode *expr = parse_expression(parser);
+        AstNodeId expr = parse_expression(parser);
         parser_expect(parser, TOKEN_R_PAREN, "')'");
         if (parser->status == PARSER_ERROR) {
-            ast_free(expr);
-            return NULL;
+            return AST_NODE_NONE;
         }
         return expr;
     }
 
-    fprintf(stderr, "Parser error at line %zu col %zu: unexpected token %d\n",
-            token.line,
-            token.column,
-            token.kind);
-    parser->status = PARSER_ERROR;
-    return NULL;
+    parser_error(parser, "unexpected token %d", parser->kind);
+    return AST_NODE_NONE;
 }
 
-static AstNode *parse_unary(Parser *parser) {
-    Token token = parser_peek(parser);
-    if (token.kind == TOKEN_PLUS || token.kind == TOKEN_MINUS) {
+static AstNodeId parse_unary(Parser *parser) {
+    TokenKind kind = parser->kind;
+    if (kind == TOKEN_PLUS || kind == TOKEN_MINUS) {
         parser_advance(parser);
-        AstNode *operand = parse_unary(parser);
-        if (!operand) {
-            return NULL;
+        AstNodeId operand = parse_unary(parser);
+        if (operand == AST_NODE_NONE) {
+            return AST_NODE_NONE;
         }
 
-        AstNode *node = ast_new_node(AST_UNARY_EXPR);
-        if (!node) {
-            parser->status = PARSER_ERROR;
-            ast_free(operand);
-            return NULL;
+        AstNodeId id = parser_add_node(parser, AST_UNARY_EXPR);
+        if (id == AST_NODE_NONE) {
+            return AST_NODE_NONE;
         }
 
-        node->value.unary_expr.op = (token.kind == TOKEN_PLUS) ? AST_UNARY_PLUS : AST_UNARY_MINUS;
-        node->value.unary_expr.operand = operand;
-        return node;
+        AstNode *node = parser_node(parser, id);
+        node->op = (kind == TOKEN_PLUS) ? AST_UNARY_PLUS : AST_UNARY_MINUS;
+        node->value.unary_expr = operand;
+        return id;
     }
 
     return parse_primary(parser);
 }
 
-static AstNode *parse_expression(Parser *parser) {
-    AstNode *left = parse_unary(parser);
-    if (!left) {
-        return NULL;
+/* Binary operator of `kind` at one precedence level, or -1. */
+static int binary_operator(TokenKind kind, int multiplicative) {
+    if (multiplicative) {
+        switch (kind) {
+        case TOKEN_ASTERISK:
+            return AST_BIN_MUL;
+        case TOKEN_SLASH:
+            return AST_BIN_DIV;
+        case TOKEN_PERCENT:
+            return AST_BIN_MOD;
+        default:
+            return -1;
+        }
+    }
+    switch (kind) {
+    case TOKEN_PLUS:
+        return AST_BIN_ADD;
+    case TOKEN_MINUS:
+        return AST_BIN_SUB;
+    default:
+        return -1;
+    }
+}
+
+/* Left-associative chain of `*`, `/`, `%` over unary operands when
+ * `multiplicative` is set, otherwise of `+`, `-` over multiplicative terms. */
+static AstNodeId parse_binary(Parser *parser, int multiplicative) {
+    AstNodeId left = multiplicative ? parse_unary(parser) : parse_binary(parser, 1);
+    if (left == AST_NODE_NONE) {
+        return AST_NODE_NONE;
     }
 
-    while (parser->current.kind == TOKEN_PLUS || parser->current.kind == TOKEN_MINUS) {
-        Token op = parser->current;
+    int op;
+    while ((op = binary_operator(parser->kind, multiplicative)) >= 0) {
         parser_advance(parser);
 
-        AstNode *right = parse_unary(parser);
-        if (!right) {
-            ast_free(left);
-            return NULL;
+        AstNodeId right = multiplicative ? parse_unary(parser) : parse_binary(parser, 1);
+        if (right == AST_NODE_NONE) {
+            return AST_NODE_NONE;
         }
 
-        AstNode *binary = ast_new_node(AST_BINARY_EXPR);
-        if (!binary) {
-            parser->status = PARSER_ERROR;
-            ast_free(left);
-            ast_free(right);
-            return NULL;
+        AstNodeId id = parser_add_node(parser, AST_BINARY_EXPR);
+        if (id == AST_NODE_NONE) {
+            return AST_NODE_NONE;
         }
 
+        AstNode *binary = parser_node(parser, id);
+        binary->op = (uint8_t)op;
         binary->value.binary_expr.left = left;
         binary->value.binary_expr.right = right;
-        binary->value.binary_expr.op = (op.kind == TOKEN_PLUS) ? AST_BIN_ADD : AST_BIN_SUB;
-        left = binary;
+        left = id;
     }
 
     return left;
 }
 
-static AstNode *parse_return_statement(Parser *parser) {
+static AstNodeId parse_expression(Parser *parser) {
+    return parse_binary(parser, 0);
+}
+
+static AstNodeId parse_return_statement(Parser *parser) {
     parser_expect(parser, TOKEN_KW_RETURN, "'return'");
-    AstNode *expr = parse_expression(parser);
+    AstNodeId expr = parse_expression(parser);
     parser_expect(parser, TOKEN_SEMICOLON, "';'");
     if (parser->status == PARSER_ERROR) {
-        ast_free(expr);
-        return NULL;
+        return AST_NODE_NONE;
     }
 
-    AstNode *node = ast_new_node(AST_RETURN_STMT);
-    if (!node) {
-        parser->status = PARSER_ERROR;
-        ast_free(expr);
-        return NULL;
+    AstNodeId id = parser_add_node(parser, AST_RETURN_STMT);
+    if (id != AST_NODE_NONE) {
+        parser_node(parser, id)->value.return_stmt = expr;
     }
-    node->value.return_stmt.expression = expr;
-    return node;
+    return id;
 }
 
-static AstNode *parse_var_declaration(Parser *parser) {
+static AstNodeId parse_var_declaration(Parser *parser) {
     parser_expect(parser, TOKEN_KW_INT, "'int'");
 
-    Token name = parser_peek(parser);
+    AstIdentifier name = parser_identifier(parser);
     parser_expect(parser, TOKEN_IDENTIFIER, "identifier");
 
-    AstNode *initializer = NULL;
-    if (parser->current.kind == TOKEN_EQUAL) {
+    AstNodeId initializer = AST_NODE_NONE;
+    if (parser->kind == TOKEN_EQUAL) {
         parser_advance(parser);
         initializer = parse_expression(parser);
     }
 
     parser_expect(parser, TOKEN_SEMICOLON, "';'");
 
-    if (parser->status == PARSER_ERROR) {
-        ast_free(initializer);
-        return NULL;
+    uint32_t index = 0;
+    if (parser->status == PARSER_ERROR || parser_add_name(parser, name, &index) != 0) {
+        return AST_NODE_NONE;
     }
 
-    AstNode *node = ast_new_node(AST_VAR_DECL);
-    if (!node) {
-        parser->status = PARSER_ERROR;
-        ast_free(initializer);
-        return NULL;
+    AstNodeId id = parser_add_node(parser, AST_VAR_DECL);
+    if (id != AST_NODE_NONE) {
+        parser_node(parser, id)->value.var_decl = (AstVarDecl){index, initializer};
     }
-
-    node->value.var_decl.name.name = name.lexeme;
-    node->value.var_decl.name.length = name.length;
-    node->value.var_decl.initializer = initializer;
-    return node;
+    return id;
 }
 
-static AstNode *parse_assignment_statement(Parser *parser) {
-    Token name = parser_peek(parser);
+static AstNodeId parse_assignment_statement(Parser *parser) {
+    AstIdentifier name = parser_identifier(parser);
     parser_expect(parser, TOKEN_IDENTIFIER, "identifier");
     parser_expect(parser, TOKEN_EQUAL, "'='");
 
-    AstNode *value = parse_expression(parser);
+    AstNodeId value = parse_expression(parser);
     parser_expect(parser, TOKEN_SEMICOLON, "';'");
 
-    if (parser->status == PARSER_ERROR) {
-        ast_free(value);
-        return NULL;
+    uint32_t index = 0;
+    if (parser->status == PARSER_ERROR || parser_add_name(parser, name, &index) != 0) {
+        return AST_NODE_NONE;
     }
 
-    AstNode *node = ast_new_node(AST_ASSIGNMENT);
-    if (!node) {
-        parser->status = PARSER_ERROR;
-        ast_free(value);
-        return NULL;
+    AstNodeId id = parser_add_node(parser, AST_ASSIGNMENT);
+    if (id != AST_NODE_NONE) {
+        parser_node(parser, id)->value.assignment = (AstAssignment){index, value};
     }
-
-    node->value.assignment.target.name = name.lexeme;
-    node->value.assignment.target.length = name.length;
-    node->value.assignment.value = value;
-    return node;
+    return id;
 }
 
-static AstNode *parse_statement(Parser *parser) {
-    switch (parser->current.kind) {
+static AstNodeId parse_statement(Parser *parser) {
+    switch (parser->kind) {
     case TOKEN_KW_INT:
         return parse_var_declaration(parser);
     case TOKEN_KW_RETURN:
@@ -236,129 +346,165 @@ static AstNode *parse_statement(Parser *parser) {
         parser_advance(parser); /* consume '{' */
         return parse_block(parser);
     default:
-        fprintf(stderr, "Parser error at line %zu col %zu: unexpected token %d in statement\n",
-                parser->current.line,
-                parser->current.column,
-                parser->current.kind);
-        parser->status = PARSER_ERROR;
-        return NULL;
+        parser_error(parser, "unexpected token %d in statement", parser->kind);
+        return AST_NODE_NONE;
     }
 }
 
-static AstNode *parse_block(Parser *parser) {
-    AstNode *block = ast_new_node(AST_BLOCK);
-    if (!block) {
-        parser->status = PARSER_ERROR;
-        return NULL;
-    }
-
-    size_t capacity = 4;
-    block->value.block.statements = calloc(capacity, sizeof(AstNode *));
-    if (!block->value.block.statements) {
-        parser->status = PARSER_ERROR;
-        return block;
+static AstNodeId parse_block(Parser *parser) {
+    AstNodeId id = parser_add_node(parser, AST_BLOCK);
+    if (id == AST_NODE_NONE) {
+        return AST_NODE_NONE;
     }
 
-    block->value.block.statement_count = 0;
-
-    while (parser->current.kind != TOKEN_R_BRACE && parser->current.kind != TOKEN_EOF && parser->status == PARSER_OK) {
-        AstNode *statement = parse_statement(parser);
-        if (!statement) {
+    uint32_t base = parser->pending_count;
+    while (parser->kind != TOKEN_R_BRACE && parser->kind != TOKEN_EOF && parser->status == PARSER_OK) {
+        AstNodeId statement = parse_statement(parser);
+        if (statement == AST_NODE_NONE || parser_push_pending(parser, statement) != 0) {
             break;
         }
-
-        if (block->value.block.statement_count == capacity) {
-            capacity *= 2;
-            AstNode **resized = realloc(block->value.block.statements, capacity * sizeof(AstNode *));
-            if (!resized) {
-                parser->status = PARSER_ERROR;
-                ast_free(statement);
-                break;
-            }
-            block->value.block.statements = resized;
-        }
-
-        block->value.block.statements[block->value.block.statement_count++] = statement;
     }
 
+    AstRange statements;
+    parser_pop_pending(parser, base, &statements);
+    parser_node(parser, id)->value.block = statements;
     parser_expect(parser, TOKEN_R_BRACE, "'}'");
-    return block;
+    return id;
 }
 
-static AstNode *parse_function_declaration(Parser *parser) {
+static AstNodeId parse_function_declaration(Parser *parser) {
     parser_expect(parser, TOKEN_KW_INT, "'int'");
 
-    Token name = parser_peek(parser);
+    AstIdentifier name = parser_identifier(parser);
     parser_expect(parser, TOKEN_IDENTIFIER, "function name");
 
     parser_expect(parser, TOKEN_L_PAREN, "'('");
     parser_expect(parser, TOKEN_R_PAREN, "')'");
 
     parser_expect(parser, TOKEN_L_BRACE, "'{' ");
-    AstNode *body = parse_block(parser);
+    AstNodeId body = parse_block(parser);
 
-    if (parser->status == PARSER_ERROR) {
-        ast_free(body);
-        return NULL;
+    uint32_t index = 0;
+    if (parser->status == PARSER_ERROR || parser_add_name(parser, name, &index) != 0) {
+        return AST_NODE_NONE;
     }
 
-    AstNode *func = ast_new_node(AST_FUNCTION_DECL);
-    if (!func) {
-        parser->status = PARSER_ERROR;
-        ast_free(body);
-        return NULL;
+    AstNodeId id = parser_add_node(parser, AST_FUNCTION_DECL);
+    if (id != AST_NODE_NONE) {
+        parser_node(parser, id)->value.function_decl = (AstFunctionDecl){index, body};
+    }
+    return id;
+}
+
+/* Identifiers are interned as they are lexed, so the first token is primed
+ * only once the interner is known. */
+static void parser_start(Parser *parser, Interner *interner) {
+    lexer_set_interner(&parser->lexer, interner);
+    if (parser->prelex && lexer_tokenize(&parser->lexer, &parser->tokens) != 0) {
+        /* Too large for 32-bit offsets, or out of memory: stream instead. */
+        lexer_init(&parser->lexer, parser->lexer.source, parser->lexer.length);
+        lexer_set_interner(&parser->lexer, interner);
+        parser->prelex = 0;
+    }
+    if (parser->prelex) {
+        parser->position = 0;
+        parser->kind = (TokenKind)parser->tokens.kinds[0];
+    } else {
+        parser_advance(parser);
     }
+}
 
-    func->value.function_decl.name.name = name.lexeme;
-    func->value.function_decl.name.length = name.length;
-    func->value.function_decl.body = body;
-    return func;
+static void parser_finish(Parser *parser) {
+    token_buffer_free(&parser->tokens);
+    free(parser->pending);
+    parser->pending = NULL;
+    parser->pending_count = parser->pending_capacity = 0;
 }
 
-static AstNode *parse_translation_unit(Parser *parser) {
-    AstNode *unit = ast_new_node(AST_TRANSLATION_UNIT);
+static AstTranslationUnit *parse_translation_unit(Parser *parser) {
+    AstTranslationUnit *unit = ast_create();
     if (!unit) {
         parser->status = PARSER_ERROR;
         return NULL;
     }
+    parser->unit = unit;
+    parser_start(parser, unit->interner);
+
+    while (parser->kind != TOKEN_EOF && parser->status == PARSER_OK) {
+        AstNodeId func = parse_function_declaration(parser);
+        if (func == AST_NODE_NONE || parser_push_pending(parser, func) != 0) {
+            break;
+        }
+    }
+    parser_pop_pending(parser, 0, &unit->functions);
+    ast_shrink(unit);
 
-    const size_t initial_capacity = 4;
-    unit->value.translation_unit.functions = calloc(initial_capacity, sizeof(AstNode *));
-    unit->value.translation_unit.function_count = 0;
-    size_t capacity = initial_capacity;
+    parser_finish(parser);
+    return unit;
+}
 
-    while (parser->current.kind != TOKEN_EOF && parser->status == PARSER_OK) {
-        if (unit->value.translation_unit.function_count == capacity) {
-            capacity *= 2;
-            AstNode **resized = realloc(unit->value.translation_unit.functions,
-                                        capacity * sizeof(AstNode *));
-            if (!resized) {
-                parser->status = PARSER_ERROR;
+/* Each batch gets a unit of its own, so the one handed to the sink is never
+ * touched by the parser again and can be freed as soon as it is consumed. */
+static int parse_functions(Parser *parser,
+                           Interner *interner,
+                           uint32_t batch_nodes,
+                           ParserFunctionSink sink,
+                           void *context) {
+    parser_start(parser, interner);
+
+    int stopped = 0;
+    while (parser->kind != TOKEN_EOF && parser->status == PARSER_OK && !stopped) {
+        AstTranslationUnit *unit = ast_create_shared(interner);
+        if (!unit) {
+            parser->status = PARSER_ERROR;
+            break;
+        }
+        parser->unit = unit;
+        do {
+            AstNodeId func = parse_function_declaration(parser);
+            if (func == AST_NODE_NONE || parser_push_pending(parser, func) != 0) {
                 break;
             }
-            unit->value.translation_unit.functions = resized;
-        }
-
-        AstNode *func = parse_function_declaration(parser);
-        if (!func) {
+        } while (parser->kind != TOKEN_EOF && unit->node_count < batch_nodes);
+        parser_pop_pending(parser, 0, &unit->functions);
+        parser->unit = NULL;
+        if (parser->status != PARSER_OK) {
+            ast_free(unit);
             break;
         }
-        unit->value.translation_unit.functions[unit->value.translation_unit.function_count++] = func;
+        stopped = sink(context, unit) != 0;
     }
 
-    return unit;
+    parser_finish(parser);
+    return parser->status == PARSER_OK ? 0 : -1;
 }
 
 void parser_init(Parser *parser, const char *source, size_t length) {
+    parser->prelex = 0;
+    parser->kind = TOKEN_EOF;
+    memset(&parser->tokens, 0, sizeof(parser->tokens));
+    parser->position = 0;
     parser->status = PARSER_OK;
+    parser->unit = NULL;
+    parser->pending = NULL;
+    parser->pending_count = 0;
+    parser->pending_capacity = 0;
+    parser->diagnostics = stderr;
     lexer_init(&parser->lexer, source, length);
-    parser_advance(parser);
 }
 
-AstNode *parser_parse_translation_unit(Parser *parser) {
+AstTranslationUnit *parser_parse_translation_unit(Parser *parser) {
     return parse_translation_unit(parser);
 }
 
+int parser_parse_functions(Parser *parser,
+                           Interner *interner,
+                           uint32_t batch_nodes,
+                           ParserFunctionSink sink,
+                           void *context) {
+    return parse_functions(parser, interner, batch_nodes, sink, context);
+}
+
 ParserStatus parser_status(const Parser *parser) {
     return parser->status;
 }
@@ -0,0 +1,468 @@
+#include "ir/ir.h"
+
+#include <inttypes.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Makes room for one more element in an arena-backed array. */
+static void *reserve_one(Arena *arena, void *data, size_t count, size_t *capacity, size_t element_size) {
+    if (count < *capacity) {
+        return data;
+    }
+    size_t grown = *capacity ? *capacity * 2 : 8;
+    void *resized = arena_grow(arena, data, *capacity * element_size, grown * element_size);
+    if (resized) {
+        *capacity = grown;
+    }
+    return resized;
+}
+
+IrFunction *ir_function_create(Arena *arena, const char *name, size_t name_length) {
+    IrFunction *function = arena_alloc(arena, sizeof(IrFunction));
+    if (!function) {
+        return NULL;
+    }
+    function->name = name;
+    function->name_length = name_length;
+    function->arena = arena;
+    return function;
+}
+
+IrBlock *ir_block_create(IrFunction *function) {
+    IrBlock **blocks = reserve_one(function->arena, function->blocks, function->block_count,
+                                   &function->block_capacity, sizeof(IrBlock *));
+    IrBlock *block = arena_alloc(function->arena, sizeof(IrBlock));
+    if (!blocks || !block) {
+        return NULL;
+    }
+    function->blocks = blocks;
+    block->id = (uint32_t)function->block_count;
+    function->blocks[function->block_count++] = block;
+    return block;
+}
+
+uint32_t ir_slot_create(IrFunction *function) {
+    return function->slot_count++;
+}
+
+static IrValue new_value(IrBuilder *builder) {
+    IrFunction *function = builder->function;
+    uint32_t *vars = reserve_one(function->arena, function->value_vars, function->value_count,
+                                 &function->value_capacity, sizeof(uint32_t));
+    if (!vars || function->value_count == IR_NO_VALUE - 1) {
+        builder->failed = 1;
+        return IR_NO_VALUE;
+    }
+    function->value_vars = vars;
+    vars[function->value_count] = IR_NO_VAR;
+    return function->value_count++;
+}
+
+static IrInstr *append(IrBuilder *builder, IrOp op) {
+    IrBlock *block = builder->block;
+    if (builder->failed || !block) {
+        builder->failed = 1;
+        return NULL;
+    }
+    IrInstr *instrs = reserve_one(builder->function->arena, block->instrs, block->count, &block->capacity, sizeof(IrInstr));
+    if (!instrs) {
+        builder->failed = 1;
+        return NULL;
+    }
+    block->instrs = instrs;
+
+    IrInstr *instr = &block->instrs[block->count++];
+    memset(instr, 0, sizeof(*instr));
+    instr->op = op;
+    instr->dest = IR_NO_VALUE;
+    instr->args[0] = IR_NO_VALUE;
+    instr->args[1] = IR_NO_VALUE;
+    return instr;
+}
+
+/* Appends an instruction that defines a new value. */
+static IrInstr *append_value(IrBuilder *builder, IrOp op) {
+    IrInstr *instr = append(builder, op);
+    if (!instr) {
+        return NULL;
+    }
+    instr->dest = new_value(builder);
+    if (instr->dest == IR_NO_VALUE) {
+        builder->block->count -= 1;
+        return NULL;
+    }
+    return instr;
+}
+
+static void add_pred(IrBuilder *builder, IrBlock *block, uint32_t pred) {
+    uint32_t *preds = reserve_one(builder->function->arena, block->preds, block->pred_count,
+                                  &block->pred_capacity, sizeof(uint32_t));
+    if (!preds) {
+        builder->failed = 1;
+        return;
+    }
+    block->preds = preds;
+    block->preds[block->pred_count++] = pred;
+}
+
+int ir_builder_init(IrBuilder *builder, IrFunction *function) {
+    memset(builder, 0, sizeof(*builder));
+    builder->function = function;
+    builder->block = function->block_count ? function->blocks[0] : ir_block_create(function);
+    return builder->block ? 0 : -1;
+}
+
+void ir_builder_free(IrBuilder *builder) {
+    free(builder->def_keys);
+    free(builder->def_values);
+    builder->def_keys = NULL;
+    builder->def_values = NULL;
+    builder->def_mask = 0;
+    builder->def_count = 0;
+}
+
+void ir_builder_set_block(IrBuilder *builder, IrBlock *block) {
+    builder->block = block;
+}
+
+int ir_block_terminated(const IrBlock *block) {
+    if (block->count == 0) {
+        return 0;
+    }
+    IrOp last = block->instrs[block->count - 1].op;
+    return last == IR_JUMP || last == IR_BRANCH || last == IR_RET;
+}
+
+IrValue ir_build_const(IrBuilder *builder, int64_t value) {
+    IrInstr *instr = append_value(builder, IR_CONST);
+    if (!instr) {
+        return IR_NO_VALUE;
+    }
+    instr->u.imm = value;
+    return instr->dest;
+}
+
+IrValue ir_build_global(IrBuilder *builder, const char *name, size_t length) {
+    IrInstr *instr = append_value(builder, IR_GLOBAL);
+    if (!instr) {
+        return IR_NO_VALUE;
+    }
+    instr->u.global.name = name;
+    instr->u.global.length = length;
+    return instr->dest;
+}
+
+IrValue ir_build_binary(IrBuilder *builder, IrOp op, IrValue left, IrValue right) {
+    if (left == IR_NO_VALUE || right == IR_NO_VALUE) {
+        builder->failed = 1;
+        return IR_NO_VALUE;
+    }
+    IrInstr *instr = append_value(builder, op);
+    if (!instr) {
+        return IR_NO_VALUE;
+    }
+    instr->args[0] = left;
+    instr->args[1] = right;
+    return instr->dest;
+}
+
+IrValue ir_build_neg(IrBuilder *builder, IrValue operand) {
+    if (operand == IR_NO_VALUE) {
+        builder->failed = 1;
+        return IR_NO_VALUE;
+    }
+    IrInstr *instr = append_value(builder, IR_NEG);
+    if (!instr) {
+        return IR_NO_VALUE;
+    }
+    instr->args[0] = operand;
+    return instr->dest;
+}
+
+IrValue ir_build_load_slot(IrBuilder *builder, uint32_t slot) {
+    IrInstr *instr = append_value(builder, IR_LOAD_SLOT);
+    if (!instr) {
+        return IR_NO_VALUE;
+    }
+    instr->u.slot = slot;
+    return instr->dest;
+}
+
+void ir_build_store_slot(IrBuilder *builder, uint32_t slot, IrValue value) {
+    IrInstr *instr = (value == IR_NO_VALUE) ? NULL : append(builder, IR_STORE_SLOT);
+    if (!instr) {
+        builder->failed = 1;
+        return;
+    }
+    instr->args[0] = value;
+    instr->u.slot = slot;
+}
+
+void ir_build_jump(IrBuilder *builder, IrBlock *target) {
+    IrInstr *instr = append(builder, IR_JUMP);
+    if (!instr) {
+        return;
+    }
+    instr->u.targets[0] = target->id;
+    add_pred(builder, target, builder->block->id);
+}
+
+void ir_build_branch(IrBuilder *builder, IrValue condition, IrBlock *if_true, IrBlock *if_false) {
+    IrInstr *instr = (condition == IR_NO_VALUE) ? NULL : append(builder, IR_BRANCH);
+    if (!instr) {
+        builder->failed = 1;
+        return;
+    }
+    instr->args[0] = condition;
+    instr->u.targets[0] = if_true->id;
+    instr->u.targets[1] = if_false->id;
+    add_pred(builder, if_true, builder->block->id);
+    add_pred(builder, if_false, builder->block->id);
+}
+
+void ir_build_ret(IrBuilder *builder, IrValue value) {
+    IrInstr *instr = append(builder, IR_RET);
+    if (instr) {
+        instr->args[0] = value;
+    }
+}
+
+/* ---- SSA construction ---- */
+
+uint32_t ir_variable_create(IrBuilder *builder, const char *name, size_t length) {
+    IrFunction *function = builder->function;
+    IrVariable *vars = reserve_one(function->arena, function->vars, function->var_count,
+                                   &function->var_capacity, sizeof(IrVariable));
+    if (!vars) {
+        builder->failed = 1;
+        return IR_NO_VAR;
+    }
+    function->vars = vars;
+    vars[function->var_count].name = name;
+    vars[function->var_count].length = length;
+    return function->var_count++;
+}
+
+static uint64_t def_key(uint32_t block, uint32_t var) {
+    return (((uint64_t)block << 32) | var) + 1;
+}
+
+static size_t def_slot(const IrBuilder *builder, uint64_t key) {
+    size_t slot = (size_t)(key * 0x9E3779B97F4A7C15ull) & builder->def_mask;
+    while (builder->def_keys[slot] && builder->def_keys[slot] != key) {
+        slot = (slot + 1) & builder->def_mask;
+    }
+    return slot;
+}
+
+static void set_def(IrBuilder *builder, uint32_t block, uint32_t var, IrValue value) {
+    if (!builder->def_keys || (builder->def_count + 1) * 2 > builder->def_mask + 1) {
+        size_t capacity = builder->def_keys ? (builder->def_mask + 1) * 2 : 64;
+        IrBuilder grown = *builder;
+        grown.def_keys = calloc(capacity, sizeof(uint64_t));
+        grown.def_values = malloc(capacity * sizeof(IrValue));
+        grown.def_mask = capacity - 1;
+        if (!grown.def_keys || !grown.def_values) {
+            free(grown.def_keys);
+            free(grown.def_values);
+            builder->failed = 1;
+            return;
+        }
+        for (size_t i = 0; builder->def_keys && i <= builder->def_mask; ++i) {
+            if (builder->def_keys[i]) {
+                size_t slot = def_slot(&grown, builder->def_keys[i]);
+                grown.def_keys[slot] = builder->def_keys[i];
+                grown.def_values[slot] = builder->def_values[i];
+            }
+        }
+        free(builder->def_keys);
+        free(builder->def_values);
+        builder->def_keys = grown.def_keys;
+        builder->def_values = grown.def_values;
+        builder->def_mask = grown.def_mask;
+    }
+
+    uint64_t key = def_key(block, var);
+    size_t slot = def_slot(builder, key);
+    if (!builder->def_keys[slot]) {
+        builder->def_keys[slot] = key;
+        builder->def_count += 1;
+    }
+    builder->def_values[slot] = value;
+}
+
+static IrValue get_def(const IrBuilder *builder, uint32_t block, uint32_t var) {
+    if (builder->def_count == 0) {
+        return IR_NO_VALUE;
+    }
+    size_t slot = def_slot(builder, def_key(block, var));
+    return builder->def_keys[slot] ? builder->def_values[slot] : IR_NO_VALUE;
+}
+
+void ir_write_variable(IrBuilder *builder, uint32_t var, IrValue value) {
+    if (value == IR_NO_VALUE || var == IR_NO_VAR || !builder->block) {
+        builder->failed = 1;
+        return;
+    }
+    /* The first variable a value is assigned to names it; `b = a` keeps `a`. */
+    if (builder->function->value_vars[value] == IR_NO_VAR) {
+        builder->function->value_vars[value] = var;
+    }
+    set_def(builder, builder->block->id, var, value);
+}
+
+static IrValue read_in_block(IrBuilder *builder, IrBlock *block, uint32_t var) {
+    IrValue value = get_def(builder, block->id, var);
+    if (value != IR_NO_VALUE || builder->failed) {
+        return value;
+    }
+
+    IrFunction *function = builder->function;
+    if (block->pred_count == 0) {
+        builder->failed = 1;
+        return IR_NO_VALUE;
+    }
+    if (block->pred_count == 1) {
+        value = read_in_block(builder, function->blocks[block->preds[0]], var);
+    } else {
+        /* Without back edges every operand is final now, so a phi is only
+         * created when the predecessors actually disagree. */
+        IrValue *args = arena_alloc(function->arena, block->pred_count * sizeof(IrValue));
+        if (!args) {
+            builder->failed = 1;
+            return IR_NO_VALUE;
+        }
+        int same = 1;
+        for (size_t i = 0; i < block->pred_count; ++i) {
+            args[i] = read_in_block(builder, function->blocks[block->preds[i]], var);
+            if (args[i] == IR_NO_VALUE) {
+                return IR_NO_VALUE;
+            }
+            same &= args[i] == args[0];
+        }
+        value = args[0];
+        if (!same) {
+            IrInstr *phis = reserve_one(function->arena, block->phis, block->phi_count, &block->phi_capacity, sizeof(IrInstr));
+            value = new_value(builder);
+            if (!phis || value == IR_NO_VALUE) {
+                builder->failed = 1;
+                return IR_NO_VALUE;
+            }
+            block->phis = phis;
+            IrInstr *phi = &block->phis[block->phi_count++];
+            memset(phi, 0, sizeof(*phi));
+            phi->op = IR_PHI;
+            phi->dest = value;
+            phi->args[0] = IR_NO_VALUE;
+            phi->args[1] = IR_NO_VALUE;
+            phi->u.phi_args = args;
+            function->value_vars[value] = var;
+        }
+    }
+
+    if (value != IR_NO_VALUE) {
+        set_def(builder, block->id, var, value); /* later reads stop here */
+    }
+    return value;
+}
+
+IrValue ir_read_variable(IrBuilder *builder, uint32_t var) {
+    if (var == IR_NO_VAR || !builder->block) {
+        builder->failed = 1;
+        return IR_NO_VALUE;
+    }
+    return read_in_block(builder, builder->block, var);
+}
+
+/* ---- Text dump ---- */
+
+const char *ir_op_name(IrOp op) {
+    static const char *const names[] = {
+        [IR_CONST] = "const",
+        [IR_GLOBAL] = "global",
+        [IR_ADD] = "add",
+        [IR_SUB] = "sub",
+        [IR_MUL] = "mul",
+        [IR_DIV] = "div",
+        [IR_MOD] = "mod",
+        [IR_NEG] = "neg",
+        [IR_PHI] = "phi",
+        [IR_LOAD_SLOT] = "load",
+        [IR_STORE_SLOT] = "store",
+        [IR_JUMP] = "jmp",
+        [IR_BRANCH] = "br",
+        [IR_RET] = "ret",
+    };
+    return ((unsigned)op < sizeof(names) / sizeof(names[0])) ? names[op] : "?";
+}
+
+static void dump_instr(const IrFunction *function, const IrBlock *block, const IrInstr *instr, FILE *out) {
+    fputs("  ", out);
+    if (instr->dest != IR_NO_VALUE) {
+        fprintf(out, "%%%" PRIu32 " = ", instr->dest);
+    }
+    fputs(ir_op_name(instr->op), out);
+
+    switch (instr->op) {
+    case IR_CONST:
+        fprintf(out, " %" PRId64, instr->u.imm);
+        break;
+    case IR_GLOBAL:
+        fprintf(out, " %.*s", (int)instr->u.global.length, instr->u.global.name);
+        break;
+    case IR_ADD:
+    case IR_SUB:
+    case IR_MUL:
+    case IR_DIV:
+    case IR_MOD:
+        fprintf(out, " %%%" PRIu32 ", %%%" PRIu32, instr->args[0], instr->args[1]);
+        break;
+    case IR_NEG:
+    case IR_RET:
+        if (instr->args[0] != IR_NO_VALUE) {
+            fprintf(out, " %%%" PRIu32, instr->args[0]);
+        }
+        break;
+    case IR_PHI:
+        for (size_t i = 0; i < block->pred_count; ++i) {
+            fprintf(out, "%s [%%%" PRIu32 ", bb%" PRIu32 "]", i ? "," : "", instr->u.phi_args[i], block->preds[i]);
+        }
+        break;
+    case IR_LOAD_SLOT:
+        fprintf(out, " s%" PRIu32, instr->u.slot);
+        break;
+    case IR_STORE_SLOT:
+        fprintf(out, " s%" PRIu32 ", %%%" PRIu32, instr->u.slot, instr->args[0]);
+        break;
+    case IR_JUMP:
+        fprintf(out, " bb%" PRIu32, instr->u.targets[0]);
+        break;
+    case IR_BRANCH:
+        fprintf(out, " %%%" PRIu32 ", bb%" PRIu32 ", bb%" PRIu32, instr->args[0], instr->u.targets[0], instr->u.targets[1]);
+        break;
+    }
+
+    if (instr->dest != IR_NO_VALUE && function->value_vars[instr->dest] != IR_NO_VAR) {
+        const IrVariable *var = &function->vars[function->value_vars[instr->dest]];
+        fprintf(out, "  ; %.*s", (int)var->length, var->name);
+    }
+    fputc('\n', out);
+}
+
+void ir_dump_function(const IrFunction *function, FILE *out) {
+    fprintf(out, "function %.*s\n", (int)function->name_length, function->name);
+    for (size_t b = 0; b < function->block_count; ++b) {
+        const IrBlock *block = function->blocks[b];
+        fprintf(out, "bb%" PRIu32 ":", block->id);
+        for (size_t i = 0; i < block->pred_count; ++i) {
+            fprintf(out, "%s bb%" PRIu32, i ? "," : "  ; preds", block->preds[i]);
+        }
+        fputc('\n', out);
+        for (size_t i = 0; i < block->phi_count; ++i) {
+            dump_instr(function, block, &block->phis[i], out);
+        }
+        for (size_t i = 0; i < block->count; ++i) {
+            dump_instr(function, block, &block->instrs[i], out);
+        }
+    }
+}
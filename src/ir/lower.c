@@ -0,0 +1,228 @@
+#include "ir/lower.h"
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "support/scope_table.h"
+
+typedef struct LowerContext {
+    const AstTranslationUnit *unit;
+    IrBuilder builder;
+    IrLocalMode mode;
+    ScopeTable scopes; /* symbol -> variable (SSA mode) or slot (slot mode) */
+    Emitter *diag;
+    uint32_t initializing; /* variable whose own initializer is being lowered */
+    int reachable;         /* cleared after `return`: the rest is checked only */
+    AstNodeId *spine;      /* binary operators whose left operand is being lowered */
+    size_t spine_count;
+    size_t spine_capacity;
+} LowerContext;
+
+static void lower_error(LowerContext *ctx, const char *format, ...) {
+    char message[256];
+    va_list args;
+    va_start(args, format);
+    int length = vsnprintf(message, sizeof(message), format, args);
+    va_end(args);
+
+    if (length < 0) {
+        return;
+    }
+    if ((size_t)length >= sizeof(message)) {
+        length = (int)sizeof(message) - 1;
+    }
+    emitter_text(ctx->diag, "Codegen error: ");
+    emitter_view(ctx->diag, message, (size_t)length);
+    emitter_char(ctx->diag, '\n');
+}
+
+static IrValue lower_expression(LowerContext *ctx, AstNodeId id) {
+    IrBuilder *builder = &ctx->builder;
+    const AstNode *node = ast_node(ctx->unit, id);
+    switch (node->kind) {
+    case AST_NUMBER_LITERAL:
+        return ir_build_const(builder, ast_literal(ctx->unit, node->value.number_literal)->value);
+    case AST_IDENTIFIER: {
+        const AstIdentifier *name = ast_name(ctx->unit, node->value.identifier);
+        long local = 0;
+        if (!scope_table_lookup(&ctx->scopes, name->symbol, &local)) {
+            return ir_build_global(builder, name->name, name->length);
+        }
+        if (ctx->mode == IR_LOCALS_IN_SLOTS) {
+            return ir_build_load_slot(builder, (uint32_t)local);
+        }
+        if ((uint32_t)local == ctx->initializing) {
+            return ir_build_const(builder, 0); /* `int x = x;` reads an indeterminate value */
+        }
+        return ir_read_variable(builder, (uint32_t)local);
+    }
+    case AST_UNARY_EXPR: {
+        IrValue operand = lower_expression(ctx, node->value.unary_expr);
+        if (node->op == AST_UNARY_MINUS) {
+            return ir_build_neg(builder, operand);
+        }
+        return operand;
+    }
+    case AST_BINARY_EXPR: {
+        /* Operators are left-associative, so a long `a + b - c ...` nests down
+         * the left: walk that spine with a stack instead of recursing. */
+        size_t base = ctx->spine_count;
+        while (node->kind == AST_BINARY_EXPR) {
+            if (ctx->spine_count == ctx->spine_capacity) {
+                size_t capacity = ctx->spine_capacity ? ctx->spine_capacity * 2 : 64;
+                AstNodeId *spine = realloc(ctx->spine, capacity * sizeof(*spine));
+                if (!spine) {
+                    builder->failed = 1;
+                    ctx->spine_count = base;
+                    return IR_NO_VALUE;
+                }
+                ctx->spine = spine;
+                ctx->spine_capacity = capacity;
+            }
+            ctx->spine[ctx->spine_count++] = id;
+            id = node->value.binary_expr.left;
+            node = ast_node(ctx->unit, id);
+        }
+
+        IrValue value = lower_expression(ctx, id);
+        static const IrOp ops[] = {
+            [AST_BIN_ADD] = IR_ADD, [AST_BIN_SUB] = IR_SUB, [AST_BIN_MUL] = IR_MUL, [AST_BIN_DIV] = IR_DIV, [AST_BIN_MOD] = IR_MOD,
+        };
+        while (ctx->spine_count > base) {
+            const AstNode *binary = ast_node(ctx->unit, ctx->spine[--ctx->spine_count]);
+            IrValue right = lower_expression(ctx, binary->value.binary_expr.right);
+            value = ir_build_binary(builder, ops[binary->op], value, right);
+        }
+        return value;
+    }
+    default:
+        return IR_NO_VALUE;
+    }
+}
+
+/* Gives `local` the value of `expr` (AST_NODE_NONE means zero). */
+static int lower_store(LowerContext *ctx, long local, AstNodeId expr) {
+    IrBuilder *builder = &ctx->builder;
+    IrValue value = (expr != AST_NODE_NONE) ? lower_expression(ctx, expr) : ir_build_const(builder, 0);
+    if (value == IR_NO_VALUE) {
+        return -1;
+    }
+    if (ctx->mode == IR_LOCALS_IN_SLOTS) {
+        ir_build_store_slot(builder, (uint32_t)local, value);
+    } else {
+        ir_write_variable(builder, (uint32_t)local, value);
+    }
+    return builder->failed ? -1 : 0;
+}
+
+static int lower_statement(LowerContext *ctx, AstNodeId id) {
+    IrBuilder *builder = &ctx->builder;
+    const AstNode *node = ast_node(ctx->unit, id);
+    switch (node->kind) {
+    case AST_RETURN_STMT:
+        if (ctx->reachable) {
+            IrValue value = lower_expression(ctx, node->value.return_stmt);
+            if (value == IR_NO_VALUE) {
+                return -1;
+            }
+            ir_build_ret(builder, value);
+            ctx->reachable = 0;
+        }
+        return builder->failed ? -1 : 0;
+    case AST_VAR_DECL: {
+        const AstIdentifier *name = ast_name(ctx->unit, node->value.var_decl.name);
+        long local = (ctx->mode == IR_LOCALS_IN_SLOTS) ? (long)ir_slot_create(builder->function)
+                                                        : (long)ir_variable_create(builder, name->name, name->length);
+        if (builder->failed) {
+            return -1;
+        }
+        /* The name is in scope from its declarator on, including its own initializer. */
+        int declared = scope_table_declare(&ctx->scopes, name->symbol, local);
+        if (declared != 0) {
+            if (declared > 0) {
+                lower_error(ctx, "redeclaration of %.*s in the same scope", (int)name->length, name->name);
+            }
+            return -1;
+        }
+        if (!ctx->reachable) {
+            return 0;
+        }
+        ctx->initializing = (uint32_t)local;
+        int status = lower_store(ctx, local, node->value.var_decl.initializer);
+        ctx->initializing = IR_NO_VAR;
+        return status;
+    }
+    case AST_ASSIGNMENT: {
+        const AstIdentifier *target = ast_name(ctx->unit, node->value.assignment.target);
+        long local = 0;
+        if (!scope_table_lookup(&ctx->scopes, target->symbol, &local)) {
+            lower_error(ctx, "assignment to undeclared identifier %.*s", (int)target->length, target->name);
+            return -1;
+        }
+        return ctx->reachable ? lower_store(ctx, local, node->value.assignment.value) : 0;
+    }
+    case AST_BLOCK: {
+        if (scope_table_push(&ctx->scopes) != 0) {
+            return -1;
+        }
+        int status = 0;
+        const AstNodeId *statements = ast_children(ctx->unit, node->value.block);
+        for (uint32_t i = 0; i < node->value.block.count && status == 0; ++i) {
+            status = lower_statement(ctx, statements[i]);
+        }
+        scope_table_pop(&ctx->scopes);
+        return status;
+    }
+    default:
+        lower_error(ctx, "unsupported statement kind %d", node->kind);
+        return -1;
+    }
+}
+
+IrFunction *ir_lower_function(const AstTranslationUnit *unit,
+                              AstNodeId function,
+                              Arena *arena,
+                              IrLocalMode mode,
+                              Emitter *diag) {
+    const AstNode *node = ast_node(unit, function);
+    if (function == AST_NODE_NONE || node->kind != AST_FUNCTION_DECL) {
+        return NULL;
+    }
+    const AstIdentifier *name = ast_name(unit, node->value.function_decl.name);
+    IrFunction *ir = ir_function_create(arena, name->name, name->length);
+    if (!ir) {
+        return NULL;
+    }
+
+    LowerContext ctx;
+    ctx.unit = unit;
+    ctx.mode = mode;
+    ctx.diag = diag;
+    ctx.initializing = IR_NO_VAR;
+    ctx.reachable = 1;
+    ctx.spine = NULL;
+    ctx.spine_count = 0;
+    ctx.spine_capacity = 0;
+    scope_table_init(&ctx.scopes);
+    if (ir_builder_init(&ctx.builder, ir) != 0) {
+        return NULL;
+    }
+
+    int status = 0;
+    AstNodeId body = node->value.function_decl.body;
+    if (body != AST_NODE_NONE) {
+        status = lower_statement(&ctx, body);
+    }
+    if (status == 0 && ctx.reachable) {
+        ir_build_ret(&ctx.builder, IR_NO_VALUE); /* fell off the end */
+    }
+    if (ctx.builder.failed) {
+        status = -1;
+    }
+
+    ir_builder_free(&ctx.builder);
+    scope_table_free(&ctx.scopes);
+    free(ctx.spine);
+    return (status == 0) ? ir : NULL;
+}
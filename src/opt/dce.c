@@ -0,0 +1,295 @@
+#include "opt/dce.h"
+
+#include <stdint.h>
+#include <string.h>
+
+typedef struct DceState {
+    IrFunction *function;
+    uint8_t *reachable;      /* per block */
+    uint32_t *block_stack;   /* reachability worklist */
+    const IrInstr **defs;    /* per value: its instruction or phi, NULL when gone */
+    uint32_t *def_blocks;    /* per value: the block of `defs` */
+    uint8_t *live;           /* per value */
+    IrValue *worklist;
+    uint32_t *loads;         /* per slot: loads left in the function */
+    uint32_t *slot_state;    /* per slot: generation << 1 | overwritten before any load */
+    uint32_t generation;
+    uint8_t *keep;           /* per instruction of the block being swept */
+    DceStats stats;
+} DceState;
+
+static const IrInstr *terminator(const IrBlock *block) {
+    return ir_block_terminated(block) ? &block->instrs[block->count - 1] : NULL;
+}
+
+/* Marks every block reachable from the entry through terminator targets. */
+static void find_reachable(DceState *state) {
+    IrFunction *function = state->function;
+    size_t depth = 0;
+    state->reachable[0] = 1;
+    state->block_stack[depth++] = 0;
+    while (depth > 0) {
+        const IrInstr *last = terminator(function->blocks[state->block_stack[--depth]]);
+        if (!last || (last->op != IR_JUMP && last->op != IR_BRANCH)) {
+            continue;
+        }
+        for (int t = 0; t < (last->op == IR_BRANCH ? 2 : 1); ++t) {
+            uint32_t target = last->u.targets[t];
+            if (target < function->block_count && !state->reachable[target]) {
+                state->reachable[target] = 1;
+                state->block_stack[depth++] = target;
+            }
+        }
+    }
+}
+
+/* Nothing runs in an unreachable block, so only a terminator is kept, and it
+ * becomes `ret` so that it no longer names values or successors. */
+static void empty_unreachable_blocks(DceState *state) {
+    IrFunction *function = state->function;
+    for (size_t b = 0; b < function->block_count; ++b) {
+        IrBlock *block = function->blocks[b];
+        if (state->reachable[b] || !ir_block_terminated(block)) {
+            continue;
+        }
+        state->stats.instructions += block->phi_count + block->count - 1;
+        block->phi_count = 0;
+        block->count = 1;
+        memset(&block->instrs[0], 0, sizeof(IrInstr));
+        block->instrs[0].op = IR_RET;
+        block->instrs[0].dest = IR_NO_VALUE;
+        block->instrs[0].args[0] = IR_NO_VALUE;
+        block->instrs[0].args[1] = IR_NO_VALUE;
+    }
+}
+
+/* Deletes stores whose slot is never loaded again before being overwritten or
+ * before the function returns. Per block, walking backwards: a store kills the
+ * slot for earlier stores, a load revives it. At a block's end a slot counts as
+ * dead only when the block returns, or when the slot has no load anywhere. */
+static void remove_dead_stores(DceState *state) {
+    IrFunction *function = state->function;
+    memset(state->loads, 0, function->slot_count * sizeof(uint32_t));
+    for (size_t b = 0; b < function->block_count; ++b) {
+        const IrBlock *block = function->blocks[b];
+        for (size_t i = 0; i < block->count; ++i) {
+            if (block->instrs[i].op == IR_LOAD_SLOT) {
+                state->loads[block->instrs[i].u.slot] += 1;
+            }
+        }
+    }
+
+    for (size_t b = 0; b < function->block_count; ++b) {
+        IrBlock *block = function->blocks[b];
+        if (!state->reachable[b] || block->count == 0) {
+            continue;
+        }
+        state->generation += 1;
+        int returns = block->instrs[block->count - 1].op == IR_RET;
+        size_t removed = 0;
+        for (size_t i = block->count; i-- > 0;) {
+            const IrInstr *instr = &block->instrs[i];
+            state->keep[i] = 1;
+            if (instr->op != IR_LOAD_SLOT && instr->op != IR_STORE_SLOT) {
+                continue;
+            }
+            uint32_t slot = instr->u.slot;
+            if (instr->op == IR_LOAD_SLOT) {
+                state->slot_state[slot] = state->generation << 1;
+                continue;
+            }
+            uint32_t seen = state->slot_state[slot];
+            int overwritten = ((seen >> 1) == state->generation) ? (int)(seen & 1u) : returns;
+            if (overwritten || state->loads[slot] == 0) {
+                state->keep[i] = 0;
+                removed += 1;
+            }
+            state->slot_state[slot] = state->generation << 1 | 1u;
+        }
+
+        if (removed > 0) {
+            size_t kept = 0;
+            for (size_t i = 0; i < block->count; ++i) {
+                if (state->keep[i]) {
+                    block->instrs[kept++] = block->instrs[i];
+                }
+            }
+            block->count = kept;
+            state->stats.instructions += removed;
+        }
+    }
+}
+
+static void mark_live(DceState *state, size_t *pending, IrValue value) {
+    if (value != IR_NO_VALUE && !state->live[value]) {
+        state->live[value] = 1;
+        state->worklist[(*pending)++] = value;
+    }
+}
+
+/* Live values are the ones a store, a branch or a return reads, and everything
+ * those are computed from; phis only read the operands of reachable edges. */
+static void mark_live_values(DceState *state) {
+    IrFunction *function = state->function;
+    memset(state->live, 0, function->value_count);
+    memset(state->defs, 0, function->value_count * sizeof(*state->defs));
+
+    size_t pending = 0;
+    for (size_t b = 0; b < function->block_count; ++b) {
+        const IrBlock *block = function->blocks[b];
+        if (!state->reachable[b]) {
+            continue;
+        }
+        for (size_t i = 0; i < block->phi_count; ++i) {
+            state->defs[block->phis[i].dest] = &block->phis[i];
+            state->def_blocks[block->phis[i].dest] = (uint32_t)b;
+        }
+        for (size_t i = 0; i < block->count; ++i) {
+            const IrInstr *instr = &block->instrs[i];
+            if (instr->dest != IR_NO_VALUE) {
+                state->defs[instr->dest] = instr;
+            } else {
+                mark_live(state, &pending, instr->args[0]); /* store, branch or ret */
+            }
+        }
+    }
+
+    while (pending > 0) {
+        IrValue value = state->worklist[--pending];
+        const IrInstr *def = state->defs[value];
+        if (!def) {
+            continue;
+        }
+        if (def->op != IR_PHI) {
+            mark_live(state, &pending, def->args[0]);
+            mark_live(state, &pending, def->args[1]);
+            continue;
+        }
+        const IrBlock *block = function->blocks[state->def_blocks[value]];
+        for (size_t p = 0; p < block->pred_count; ++p) {
+            if (block->preds[p] < function->block_count && state->reachable[block->preds[p]]) {
+                mark_live(state, &pending, def->u.phi_args[p]);
+            }
+        }
+    }
+}
+
+/* Drops instructions and phis defining dead values. Returns how many loads went,
+ * since each one may leave a store behind it dead. */
+static size_t sweep_dead_values(DceState *state) {
+    IrFunction *function = state->function;
+    size_t loads_removed = 0;
+    for (size_t b = 0; b < function->block_count; ++b) {
+        IrBlock *block = function->blocks[b];
+        if (!state->reachable[b]) {
+            continue;
+        }
+        size_t kept = 0;
+        for (size_t i = 0; i < block->phi_count; ++i) {
+            if (state->live[block->phis[i].dest]) {
+                block->phis[kept++] = block->phis[i];
+            }
+        }
+        state->stats.instructions += block->phi_count - kept;
+        block->phi_count = kept;
+
+        kept = 0;
+        for (size_t i = 0; i < block->count; ++i) {
+            const IrInstr *instr = &block->instrs[i];
+            if (instr->dest == IR_NO_VALUE || state->live[instr->dest]) {
+                block->instrs[kept++] = *instr;
+            } else if (instr->op == IR_LOAD_SLOT) {
+                loads_removed += 1;
+            }
+        }
+        state->stats.instructions += block->count - kept;
+        block->count = kept;
+    }
+    return loads_removed;
+}
+
+/* Renumbers the slots still referenced densely, in their original order. */
+static void compact_slots(DceState *state) {
+    IrFunction *function = state->function;
+    uint32_t *map = state->slot_state;
+    for (uint32_t s = 0; s < function->slot_count; ++s) {
+        map[s] = UINT32_MAX;
+    }
+    for (size_t b = 0; b < function->block_count; ++b) {
+        const IrBlock *block = function->blocks[b];
+        for (size_t i = 0; i < block->count; ++i) {
+            if (block->instrs[i].op == IR_LOAD_SLOT || block->instrs[i].op == IR_STORE_SLOT) {
+                map[block->instrs[i].u.slot] = 0;
+            }
+        }
+    }
+
+    uint32_t used = 0;
+    for (uint32_t s = 0; s < function->slot_count; ++s) {
+        if (map[s] == 0) {
+            map[s] = used++;
+        }
+    }
+    for (size_t b = 0; b < function->block_count; ++b) {
+        IrBlock *block = function->blocks[b];
+        for (size_t i = 0; i < block->count; ++i) {
+            if (block->instrs[i].op == IR_LOAD_SLOT || block->instrs[i].op == IR_STORE_SLOT) {
+                block->instrs[i].u.slot = map[block->instrs[i].u.slot];
+            }
+        }
+    }
+    state->stats.slots += function->slot_count - used;
+    function->slot_count = used;
+}
+
+int eliminate_dead_code(IrFunction *function, DceStats *stats) {
+    if (!function || function->block_count == 0) {
+        return 0;
+    }
+
+    size_t longest_block = 0;
+    for (size_t b = 0; b < function->block_count; ++b) {
+        if (function->blocks[b]->count > longest_block) {
+            longest_block = function->blocks[b]->count;
+        }
+    }
+
+    Arena *arena = function->arena;
+    DceState state;
+    memset(&state, 0, sizeof(state));
+    state.function = function;
+    state.reachable = arena_alloc(arena, function->block_count);
+    state.block_stack = arena_alloc(arena, function->block_count * sizeof(uint32_t));
+    state.defs = arena_alloc(arena, function->value_count * sizeof(*state.defs));
+    state.def_blocks = arena_alloc(arena, function->value_count * sizeof(uint32_t));
+    state.live = arena_alloc(arena, function->value_count);
+    state.worklist = arena_alloc(arena, function->value_count * sizeof(IrValue));
+    state.loads = arena_alloc(arena, function->slot_count * sizeof(uint32_t));
+    state.slot_state = arena_alloc(arena, function->slot_count * sizeof(uint32_t));
+    state.keep = arena_alloc(arena, longest_block);
+    if (!state.reachable || !state.block_stack || !state.defs || !state.def_blocks || !state.live || !state.worklist || !state.loads ||
+        !state.slot_state || !state.keep) {
+        return -1;
+    }
+
+    find_reachable(&state);
+    empty_unreachable_blocks(&state);
+
+    /* Removing a dead load can leave the store before it dead, so repeat until
+     * no loads go; without slots (SSA locals) one round is enough. */
+    do {
+        if (function->slot_count > 0) {
+            remove_dead_stores(&state);
+        }
+        mark_live_values(&state);
+    } while (sweep_dead_values(&state) > 0);
+
+    if (function->slot_count > 0) {
+        compact_slots(&state);
+    }
+    if (stats) {
+        stats->instructions += state.stats.instructions;
+        stats->slots += state.stats.slots;
+    }
+    return 0;
+}
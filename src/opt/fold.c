@@ -0,0 +1,206 @@
+#include "opt/fold.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "support/arena.h"
+
+typedef struct FoldContext {
+    AstTranslationUnit *unit;
+    size_t folded;
+    int failed;
+    AstNodeId *spine; /* binary operators whose left operand is being folded */
+    size_t spine_count;
+    size_t spine_capacity;
+} FoldContext;
+
+/* Converts modulo 2^32 without relying on implementation-defined casts. */
+static int32_t wrap_int32(uint32_t value) {
+    if (value <= (uint32_t)INT32_MAX) {
+        return (int32_t)value;
+    }
+    return -(int32_t)(~value) - 1;
+}
+
+int32_t fold_literal_value(const AstNumberLiteral *literal) {
+    return wrap_int32((uint32_t)(uint64_t)literal->value);
+}
+
+/* Renders `value` into the arena and turns node `id` into a literal in place. */
+static void make_literal(FoldContext *ctx, AstNodeId id, int32_t value) {
+    char digits[12];
+    uint32_t length = 0;
+    uint32_t magnitude = (value < 0) ? 0u - (uint32_t)value : (uint32_t)value;
+    do {
+        digits[sizeof(digits) - 1 - length] = (char)('0' + magnitude % 10u);
+        magnitude /= 10u;
+        length += 1;
+    } while (magnitude != 0);
+    if (value < 0) {
+        digits[sizeof(digits) - 1 - length] = '-';
+        length += 1;
+    }
+
+    char *lexeme = arena_alloc(ctx->unit->arena, length);
+    uint32_t index = 0;
+    if (!lexeme || ast_add_literal(ctx->unit, (AstNumberLiteral){lexeme, length, value}, &index) != 0) {
+        ctx->failed = 1;
+        return;
+    }
+    memcpy(lexeme, digits + sizeof(digits) - length, length);
+
+    AstNode *node = &ctx->unit->nodes[id];
+    node->kind = AST_NUMBER_LITERAL;
+    node->op = 0;
+    node->value.number_literal = index;
+    ctx->folded += 1;
+}
+
+/* The 32-bit value of node `id` when it is a literal. */
+static int literal_value(const FoldContext *ctx, AstNodeId id, int32_t *value) {
+    const AstNode *node = ast_node(ctx->unit, id);
+    if (id == AST_NODE_NONE || node->kind != AST_NUMBER_LITERAL) {
+        return 0;
+    }
+    *value = fold_literal_value(ast_literal(ctx->unit, node->value.number_literal));
+    return 1;
+}
+
+int fold_binary(AstBinaryOp op, int32_t lhs, int32_t rhs, int32_t *value) {
+    uint32_t a = (uint32_t)lhs;
+    uint32_t b = (uint32_t)rhs;
+    switch (op) {
+    case AST_BIN_ADD:
+        *value = wrap_int32(a + b);
+        return 0;
+    case AST_BIN_SUB:
+        *value = wrap_int32(a - b);
+        return 0;
+    case AST_BIN_MUL:
+        *value = wrap_int32(a * b);
+        return 0;
+    case AST_BIN_DIV:
+    case AST_BIN_MOD:
+        if (rhs == 0) {
+            return -1; /* left for run time, where it traps like C's */
+        }
+        /* In 64 bits INT32_MIN / -1 cannot overflow; it wraps back to INT32_MIN. */
+        if (op == AST_BIN_DIV) {
+            *value = wrap_int32((uint32_t)((int64_t)lhs / rhs));
+        } else {
+            *value = (int32_t)((int64_t)lhs % rhs);
+        }
+        return 0;
+    default:
+        return -1;
+    }
+}
+
+/* Folds bottom-up, so `-(3 - 5)` collapses the subtraction before the negation. */
+static void fold_expression(FoldContext *ctx, AstNodeId id) {
+    if (id == AST_NODE_NONE || ctx->failed) {
+        return;
+    }
+
+    /* Copied: folding a child appends literals but never moves `nodes`. */
+    AstNode node = *ast_node(ctx->unit, id);
+    switch (node.kind) {
+    case AST_UNARY_EXPR: {
+        int32_t operand = 0;
+        fold_expression(ctx, node.value.unary_expr);
+        if (!literal_value(ctx, node.value.unary_expr, &operand)) {
+            return;
+        }
+        uint32_t value = (uint32_t)operand;
+        if (node.op == AST_UNARY_MINUS) {
+            value = 0u - value;
+        }
+        make_literal(ctx, id, wrap_int32(value));
+        return;
+    }
+    case AST_BINARY_EXPR: {
+        /* A long left-associative chain nests down the left: walk that spine
+         * with a stack instead of recursing. */
+        size_t base = ctx->spine_count;
+        while (node.kind == AST_BINARY_EXPR) {
+            if (ctx->spine_count == ctx->spine_capacity) {
+                size_t capacity = ctx->spine_capacity ? ctx->spine_capacity * 2 : 64;
+                AstNodeId *spine = realloc(ctx->spine, capacity * sizeof(*spine));
+                if (!spine) {
+                    ctx->failed = 1;
+                    ctx->spine_count = base;
+                    return;
+                }
+                ctx->spine = spine;
+                ctx->spine_capacity = capacity;
+            }
+            ctx->spine[ctx->spine_count++] = id;
+            id = node.value.binary_expr.left;
+            node = *ast_node(ctx->unit, id);
+        }
+        fold_expression(ctx, id);
+
+        while (ctx->spine_count > base) {
+            id = ctx->spine[--ctx->spine_count];
+            node = *ast_node(ctx->unit, id);
+            int32_t left = 0;
+            int32_t right = 0;
+            fold_expression(ctx, node.value.binary_expr.right);
+            if (!literal_value(ctx, node.value.binary_expr.left, &left) ||
+                !literal_value(ctx, node.value.binary_expr.right, &right)) {
+                continue;
+            }
+            int32_t value = 0;
+            if (fold_binary((AstBinaryOp)node.op, left, right, &value) == 0) {
+                make_literal(ctx, id, value);
+            }
+        }
+        return;
+    }
+    default:
+        return;
+    }
+}
+
+static void fold_statements(FoldContext *ctx, AstRange statements) {
+    const AstTranslationUnit *unit = ctx->unit;
+    for (uint32_t i = 0; i < statements.count; ++i) {
+        const AstNode *node = ast_node(unit, unit->children[statements.first + i]);
+        switch (node->kind) {
+        case AST_RETURN_STMT:
+            fold_expression(ctx, node->value.return_stmt);
+            break;
+        case AST_VAR_DECL:
+            fold_expression(ctx, node->value.var_decl.initializer);
+            break;
+        case AST_ASSIGNMENT:
+            fold_expression(ctx, node->value.assignment.value);
+            break;
+        case AST_BLOCK:
+            fold_statements(ctx, node->value.block);
+            break;
+        default:
+            break;
+        }
+    }
+}
+
+int fold_constants(AstTranslationUnit *unit, size_t *folded) {
+    if (!unit) {
+        return -1;
+    }
+
+    FoldContext ctx = {unit, 0, 0, NULL, 0, 0};
+    for (uint32_t i = 0; i < unit->functions.count; ++i) {
+        const AstNode *func = ast_node(unit, ast_function(unit, i));
+        if (func->kind == AST_FUNCTION_DECL) {
+            fold_statements(&ctx, ast_node(unit, func->value.function_decl.body)->value.block);
+        }
+    }
+
+    free(ctx.spine);
+    if (folded) {
+        *folded = ctx.folded;
+    }
+    return ctx.failed ? -1 : 0;
+}
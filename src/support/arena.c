@@ -0,0 +1,139 @@
+#include "support/arena.h"
+
+#include <stdalign.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define ARENA_DEFAULT_CHUNK_SIZE ((size_t)64 * 1024)
+#define ARENA_ALIGNMENT alignof(max_align_t)
+
+struct ArenaChunk {
+    ArenaChunk *next;
+    size_t capacity;
+    alignas(max_align_t) char data[];
+};
+
+static size_t align_up(size_t value) {
+    return (value + (ARENA_ALIGNMENT - 1)) & ~(size_t)(ARENA_ALIGNMENT - 1);
+}
+
+static int arena_add_chunk(Arena *arena, size_t min_size) {
+    size_t capacity = arena->chunk_size;
+    if (capacity < min_size) {
+        capacity = min_size;
+    }
+
+    /* calloc keeps the "zero-initialised" promise without a memset per allocation;
+     * fresh chunks usually come straight from zeroed pages. */
+    ArenaChunk *chunk = calloc(1, sizeof(ArenaChunk) + capacity);
+    if (!chunk) {
+        return -1;
+    }
+
+    chunk->next = arena->head;
+    chunk->capacity = capacity;
+    arena->head = chunk;
+    arena->cursor = chunk->data;
+    arena->limit = chunk->data + capacity;
+    arena->last = NULL;
+    arena->stats.bytes_reserved += capacity;
+    arena->stats.chunk_count += 1;
+    return 0;
+}
+
+Arena *arena_create(size_t chunk_size) {
+    Arena *arena = calloc(1, sizeof(Arena));
+    if (!arena) {
+        return NULL;
+    }
+    arena->chunk_size = chunk_size ? align_up(chunk_size) : ARENA_DEFAULT_CHUNK_SIZE;
+    return arena;
+}
+
+void arena_destroy(Arena *arena) {
+    if (!arena) {
+        return;
+    }
+
+    ArenaChunk *chunk = arena->head;
+    while (chunk) {
+        ArenaChunk *next = chunk->next;
+        free(chunk);
+        chunk = next;
+    }
+    free(arena);
+}
+
+void *arena_alloc(Arena *arena, size_t size) {
+    if (!arena) {
+        return NULL;
+    }
+
+    size_t rounded = align_up(size ? size : 1);
+    if ((size_t)(arena->limit - arena->cursor) < rounded) {
+        if (arena_add_chunk(arena, rounded) != 0) {
+            return NULL;
+        }
+    }
+
+    void *result = arena->cursor;
+    arena->cursor += rounded;
+    arena->last = result;
+    arena->stats.allocations += 1;
+    arena->stats.bytes_requested += size;
+    return result;
+}
+
+void *arena_grow(Arena *arena, void *ptr, size_t old_size, size_t new_size) {
+    if (!ptr) {
+        return arena_alloc(arena, new_size);
+    }
+    if (new_size <= old_size) {
+        return ptr;
+    }
+
+    /* The newest allocation can simply bump the cursor further. */
+    if (ptr == arena->last) {
+        size_t rounded = align_up(new_size);
+        if ((size_t)(arena->limit - (char *)ptr) >= rounded) {
+            arena->cursor = (char *)ptr + rounded;
+            arena->stats.allocations += 1;
+            arena->stats.bytes_requested += new_size - old_size;
+            return ptr;
+        }
+    }
+
+    void *moved = arena_alloc(arena, new_size);
+    if (!moved) {
+        return NULL;
+    }
+    memcpy(moved, ptr, old_size);
+    return moved;
+}
+
+void arena_reset(Arena *arena) {
+    if (!arena || !arena->head) {
+        return;
+    }
+
+    ArenaChunk *keep = arena->head;
+    ArenaChunk *chunk = keep->next;
+    while (chunk) {
+        ArenaChunk *next = chunk->next;
+        free(chunk);
+        chunk = next;
+    }
+    keep->next = NULL;
+
+    memset(keep->data, 0, (size_t)(arena->cursor - keep->data));
+    arena->cursor = keep->data;
+    arena->last = NULL;
+    memset(&arena->stats, 0, sizeof(arena->stats));
+    arena->stats.bytes_reserved = keep->capacity;
+    arena->stats.chunk_count = 1;
+}
+
+ArenaStats arena_stats(const Arena *arena) {
+    ArenaStats empty = {0};
+    return arena ? arena->stats : empty;
+}
@@ -0,0 +1,72 @@
+#include "support/hash.h"
+
+#include <string.h>
+
+static uint64_t rotate_left(uint64_t x, int r) {
+    return (x << r) | (x >> (64 - r));
+}
+
+static uint64_t final_mix(uint64_t k) {
+    k ^= k >> 33;
+    k *= 0xff51afd7ed558ccdull;
+    k ^= k >> 33;
+    k *= 0xc4ceb9fe1a85ec53ull;
+    k ^= k >> 33;
+    return k;
+}
+
+/* Little-endian load of `count` (< 8) trailing bytes. */
+static uint64_t load_tail(const uint8_t *bytes, size_t count) {
+    uint64_t value = 0;
+    for (size_t i = count; i-- > 0;) {
+        value = value << 8 | bytes[i];
+    }
+    return value;
+}
+
+static uint64_t load_block(const uint8_t *bytes) {
+    return load_tail(bytes, 4) | load_tail(bytes + 4, 4) << 32;
+}
+
+Hash128 hash128(const void *data, size_t length, uint64_t seed) {
+    static const uint64_t c1 = 0x87c37b91114253d5ull;
+    static const uint64_t c2 = 0x4cf5ad432745937full;
+    const uint8_t *bytes = data;
+    uint64_t h1 = seed;
+    uint64_t h2 = seed;
+
+    size_t blocks = length / 16;
+    for (size_t i = 0; i < blocks; ++i) {
+        uint64_t k1 = load_block(bytes + 16 * i);
+        uint64_t k2 = load_block(bytes + 16 * i + 8);
+
+        k1 = rotate_left(k1 * c1, 31) * c2;
+        h1 ^= k1;
+        h1 = (rotate_left(h1, 27) + h2) * 5 + 0x52dce729;
+
+        k2 = rotate_left(k2 * c2, 33) * c1;
+        h2 ^= k2;
+        h2 = (rotate_left(h2, 31) + h1) * 5 + 0x38495ab5;
+    }
+
+    const uint8_t *tail = bytes + 16 * blocks;
+    size_t rest = length & 15;
+    if (rest > 8) {
+        uint64_t k2 = load_tail(tail + 8, rest - 8);
+        h2 ^= rotate_left(k2 * c2, 33) * c1;
+    }
+    if (rest > 0) {
+        uint64_t k1 = load_tail(tail, rest < 8 ? rest : 8);
+        h1 ^= rotate_left(k1 * c1, 31) * c2;
+    }
+
+    h1 ^= (uint64_t)length;
+    h2 ^= (uint64_t)length;
+    h1 += h2;
+    h2 += h1;
+    h1 = final_mix(h1);
+    h2 = final_mix(h2);
+    h1 += h2;
+    h2 += h1;
+    return (Hash128){h1, h2};
+}
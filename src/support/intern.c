@@ -0,0 +1,119 @@
+#include "support/intern.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#define INTERN_INITIAL_SLOTS 256u
+
+static uint32_t hash_bytes(const char *text, size_t length) {
+    /* FNV-1a: identifiers are short, so a simple byte hash is cheapest. */
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < length; ++i) {
+        hash ^= (unsigned char)text[i];
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+static int interner_rehash(Interner *interner, uint32_t slot_count) {
+    SymbolId *slots = calloc(slot_count, sizeof(SymbolId));
+    if (!slots) {
+        return -1;
+    }
+
+    uint32_t mask = slot_count - 1;
+    for (SymbolId id = 1; id <= interner->count; ++id) {
+        uint32_t slot = interner->entries[id].hash & mask;
+        while (slots[slot] != SYMBOL_NONE) {
+            slot = (slot + 1) & mask;
+        }
+        slots[slot] = id;
+    }
+
+    free(interner->slots);
+    interner->slots = slots;
+    interner->slot_mask = mask;
+    return 0;
+}
+
+Interner *interner_create(void) {
+    Interner *interner = calloc(1, sizeof(Interner));
+    if (!interner) {
+        return NULL;
+    }
+
+    if (interner_rehash(interner, INTERN_INITIAL_SLOTS) != 0) {
+        free(interner);
+        return NULL;
+    }
+    return interner;
+}
+
+void interner_destroy(Interner *interner) {
+    if (!interner) {
+        return;
+    }
+    free(interner->entries);
+    free(interner->slots);
+    free(interner);
+}
+
+SymbolId interner_intern(Interner *interner, const char *text, size_t length) {
+    uint32_t hash = hash_bytes(text, length);
+    uint32_t slot = hash & interner->slot_mask;
+
+    for (;;) {
+        SymbolId id = interner->slots[slot];
+        if (id == SYMBOL_NONE) {
+            break;
+        }
+        const InternEntry *entry = &interner->entries[id];
+        if (entry->hash == hash && entry->length == length && memcmp(entry->text, text, length) == 0) {
+            return id;
+        }
+        slot = (slot + 1) & interner->slot_mask;
+    }
+
+    if (length > UINT32_MAX || interner->count == UINT32_MAX - 1) {
+        return SYMBOL_NONE;
+    }
+
+    /* Keep the load factor at or below one half so probe runs stay short. */
+    if ((uint64_t)(interner->count + 1) * 2 > (uint64_t)interner->slot_mask + 1) {
+        if (interner_rehash(interner, (interner->slot_mask + 1) * 2) != 0) {
+            return SYMBOL_NONE;
+        }
+        slot = hash & interner->slot_mask;
+        while (interner->slots[slot] != SYMBOL_NONE) {
+            slot = (slot + 1) & interner->slot_mask;
+        }
+    }
+
+    SymbolId id = interner->count + 1;
+    if (id >= interner->entry_capacity) {
+        uint32_t capacity = interner->entry_capacity ? interner->entry_capacity * 2 : 256;
+        InternEntry *entries = realloc(interner->entries, (size_t)capacity * sizeof(InternEntry));
+        if (!entries) {
+            return SYMBOL_NONE;
+        }
+        interner->entries = entries;
+        interner->entry_capacity = capacity;
+    }
+
+    interner->entries[id].text = text;
+    interner->entries[id].length = (uint32_t)length;
+    interner->entries[id].hash = hash;
+    interner->slots[slot] = id;
+    interner->count = id;
+    return id;
+}
+
+const char *interner_text(const Interner *interner, SymbolId symbol, size_t *length) {
+    if (!interner || symbol == SYMBOL_NONE || symbol > interner->count) {
+        return NULL;
+    }
+    if (length) {
+        *length = interner->entries[symbol].length;
+    }
+    return interner->entries[symbol].text;
+}
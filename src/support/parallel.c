@@ -0,0 +1,169 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "support/parallel.h"
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+/* Each worker owns a contiguous slice of the index space. The owner takes
+ * indices from the front; an idle worker steals the back half of someone
+ * else's slice, so a worker stuck on one huge task sheds the rest of its
+ * queue while workers with cheap tasks keep going. */
+typedef struct WorkQueue {
+    pthread_mutex_t lock;
+    size_t begin;
+    size_t end;
+    char padding[64]; /* keep neighbouring queues off the same cache line */
+} WorkQueue;
+
+typedef struct ParallelJob {
+    WorkQueue *queues;
+    unsigned queue_count;
+    ParallelWorkerFn fn;
+    void *context;
+} ParallelJob;
+
+typedef struct WorkerArgs {
+    ParallelJob *job;
+    unsigned self;
+} WorkerArgs;
+
+static int queue_take_front(WorkQueue *queue, size_t *index) {
+    int found = 0;
+    pthread_mutex_lock(&queue->lock);
+    if (queue->begin < queue->end) {
+        *index = queue->begin++;
+        found = 1;
+    }
+    pthread_mutex_unlock(&queue->lock);
+    return found;
+}
+
+/* Moves the back half of the first non-empty victim queue into `self`. */
+static int steal_work(ParallelJob *job, unsigned self) {
+    for (unsigned offset = 1; offset < job->queue_count; ++offset) {
+        WorkQueue *victim = &job->queues[(self + offset) % job->queue_count];
+        size_t begin = 0;
+        size_t end = 0;
+
+        pthread_mutex_lock(&victim->lock);
+        size_t remaining = victim->end - victim->begin;
+        if (remaining > 0) {
+            end = victim->end;
+            begin = end - (remaining + 1) / 2;
+            victim->end = begin;
+        }
+        pthread_mutex_unlock(&victim->lock);
+
+        if (begin < end) {
+            WorkQueue *own = &job->queues[self];
+            pthread_mutex_lock(&own->lock);
+            own->begin = begin;
+            own->end = end;
+            pthread_mutex_unlock(&own->lock);
+            return 1;
+        }
+    }
+    return 0;
+}
+
+static void run_worker(ParallelJob *job, unsigned self) {
+    /* Work only ever moves between queues, so once a full sweep finds every
+     * other queue empty the remaining tasks are already owned by someone. */
+    do {
+        size_t index;
+        while (queue_take_front(&job->queues[self], &index)) {
+            job->fn(job->context, self, index);
+        }
+    } while (steal_work(job, self));
+}
+
+static void *parallel_worker(void *arg) {
+    WorkerArgs *args = arg;
+    run_worker(args->job, args->self);
+    return NULL;
+}
+
+static void run_sequential(size_t count, ParallelWorkerFn fn, void *context) {
+    for (size_t i = 0; i < count; ++i) {
+        fn(context, 0, i);
+    }
+}
+
+unsigned parallel_worker_count(size_t count, unsigned threads) {
+    if (threads > count) {
+        threads = (unsigned)count;
+    }
+    return threads ? threads : 1u;
+}
+
+void parallel_for_workers(size_t count, unsigned threads, ParallelWorkerFn fn, void *context) {
+    threads = parallel_worker_count(count, threads);
+    if (threads <= 1) {
+        run_sequential(count, fn, context);
+        return;
+    }
+
+    WorkQueue *queues = malloc(threads * sizeof(WorkQueue));
+    pthread_t *workers = malloc((threads - 1) * sizeof(pthread_t));
+    WorkerArgs *args = malloc(threads * sizeof(WorkerArgs));
+    if (!queues || !workers || !args) {
+        free(queues);
+        free(workers);
+        free(args);
+        run_sequential(count, fn, context);
+        return;
+    }
+
+    ParallelJob job = {queues, threads, fn, context};
+    for (unsigned i = 0; i < threads; ++i) {
+        pthread_mutex_init(&queues[i].lock, NULL);
+        queues[i].begin = count * i / threads;
+        queues[i].end = count * (i + 1) / threads;
+        args[i].job = &job;
+        args[i].self = i;
+    }
+
+    /* Queue 0 belongs to the caller; a worker that fails to start simply leaves
+     * its slice to be stolen. */
+    unsigned started = 0;
+    for (unsigned i = 1; i < threads; ++i) {
+        if (pthread_create(&workers[started], NULL, parallel_worker, &args[i]) == 0) {
+            started += 1;
+        }
+    }
+
+    run_worker(&job, 0);
+
+    for (unsigned i = 0; i < started; ++i) {
+        pthread_join(workers[i], NULL);
+    }
+    for (unsigned i = 0; i < threads; ++i) {
+        pthread_mutex_destroy(&queues[i].lock);
+    }
+    free(queues);
+    free(workers);
+    free(args);
+}
+
+typedef struct IndexTask {
+    ParallelTaskFn fn;
+    void *context;
+} IndexTask;
+
+static void run_index_task(void *context, unsigned worker, size_t index) {
+    (void)worker;
+    IndexTask *task = context;
+    task->fn(task->context, index);
+}
+
+void parallel_for(size_t count, unsigned threads, ParallelTaskFn fn, void *context) {
+    IndexTask task = {fn, context};
+    parallel_for_workers(count, threads, run_index_task, &task);
+}
+
+unsigned parallel_default_threads(void) {
+    long online = sysconf(_SC_NPROCESSORS_ONLN);
+    return (online > 0) ? (unsigned)online : 1u;
+}
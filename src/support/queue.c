@@ -0,0 +1,68 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "support/queue.h"
+
+#include <stdlib.h>
+
+int bounded_queue_init(BoundedQueue *queue, size_t capacity) {
+    queue->items = malloc((capacity ? capacity : 1) * sizeof(void *));
+    if (!queue->items) {
+        return -1;
+    }
+    queue->capacity = capacity ? capacity : 1;
+    queue->head = 0;
+    queue->count = 0;
+    queue->closed = 0;
+    pthread_mutex_init(&queue->lock, NULL);
+    pthread_cond_init(&queue->not_empty, NULL);
+    pthread_cond_init(&queue->not_full, NULL);
+    return 0;
+}
+
+void bounded_queue_destroy(BoundedQueue *queue) {
+    pthread_cond_destroy(&queue->not_full);
+    pthread_cond_destroy(&queue->not_empty);
+    pthread_mutex_destroy(&queue->lock);
+    free(queue->items);
+    queue->items = NULL;
+}
+
+int bounded_queue_push(BoundedQueue *queue, void *item) {
+    pthread_mutex_lock(&queue->lock);
+    while (queue->count == queue->capacity && !queue->closed) {
+        pthread_cond_wait(&queue->not_full, &queue->lock);
+    }
+    int status = -1;
+    if (!queue->closed) {
+        queue->items[(queue->head + queue->count) % queue->capacity] = item;
+        queue->count += 1;
+        status = 0;
+        pthread_cond_signal(&queue->not_empty);
+    }
+    pthread_mutex_unlock(&queue->lock);
+    return status;
+}
+
+void *bounded_queue_pop(BoundedQueue *queue) {
+    pthread_mutex_lock(&queue->lock);
+    while (queue->count == 0 && !queue->closed) {
+        pthread_cond_wait(&queue->not_empty, &queue->lock);
+    }
+    void *item = NULL;
+    if (queue->count > 0) {
+        item = queue->items[queue->head];
+        queue->head = (queue->head + 1) % queue->capacity;
+        queue->count -= 1;
+        pthread_cond_signal(&queue->not_full);
+    }
+    pthread_mutex_unlock(&queue->lock);
+    return item;
+}
+
+void bounded_queue_close(BoundedQueue *queue) {
+    pthread_mutex_lock(&queue->lock);
+    queue->closed = 1;
+    pthread_cond_broadcast(&queue->not_empty);
+    pthread_cond_broadcast(&queue->not_full);
+    pthread_mutex_unlock(&queue->lock);
+}
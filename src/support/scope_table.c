@@ -0,0 +1,151 @@
+#include "support/scope_table.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#define SCOPE_INITIAL_SLOTS 16u
+
+static uint32_t scope_hash(SymbolId symbol) {
+    /* Symbols are dense small integers; Fibonacci hashing spreads neighbours apart. */
+    uint32_t hash = symbol * 2654435761u;
+    return hash ^ (hash >> 16);
+}
+
+static uint32_t scope_probe(const Scope *scope, SymbolId symbol, int *found) {
+    uint32_t slot = scope_hash(symbol) & scope->slot_mask;
+    for (;;) {
+        uint32_t index = scope->slots[slot];
+        if (index == 0) {
+            *found = 0;
+            return slot;
+        }
+        if (scope->entries[index - 1].symbol == symbol) {
+            *found = 1;
+            return slot;
+        }
+        slot = (slot + 1) & scope->slot_mask;
+    }
+}
+
+static int scope_resize(Scope *scope, uint32_t slot_count) {
+    uint32_t *slots = calloc(slot_count, sizeof(uint32_t));
+    if (!slots) {
+        return -1;
+    }
+
+    free(scope->slots);
+    scope->slots = slots;
+    scope->slot_mask = slot_count - 1;
+
+    for (size_t i = 0; i < scope->entry_count; ++i) {
+        int found = 0;
+        uint32_t slot = scope_probe(scope, scope->entries[i].symbol, &found);
+        scope->slots[slot] = (uint32_t)i + 1;
+        scope->entries[i].slot = slot;
+    }
+    return 0;
+}
+
+void scope_table_init(ScopeTable *table) {
+    table->scopes = NULL;
+    table->depth = 0;
+    table->capacity = 0;
+}
+
+void scope_table_free(ScopeTable *table) {
+    for (size_t i = 0; i < table->capacity; ++i) {
+        free(table->scopes[i].entries);
+        free(table->scopes[i].slots);
+    }
+    free(table->scopes);
+    scope_table_init(table);
+}
+
+int scope_table_push(ScopeTable *table) {
+    if (table->depth == table->capacity) {
+        size_t new_capacity = table->capacity ? table->capacity * 2 : 8;
+        Scope *resized = realloc(table->scopes, new_capacity * sizeof(Scope));
+        if (!resized) {
+            return -1;
+        }
+        memset(resized + table->capacity, 0, (new_capacity - table->capacity) * sizeof(Scope));
+        table->scopes = resized;
+        table->capacity = new_capacity;
+    }
+
+    Scope *scope = &table->scopes[table->depth];
+    if (!scope->slots && scope_resize(scope, SCOPE_INITIAL_SLOTS) != 0) {
+        return -1;
+    }
+    table->depth += 1;
+    return 0;
+}
+
+void scope_table_pop(ScopeTable *table) {
+    if (table->depth == 0) {
+        return;
+    }
+
+    /* Clear only the slots this scope used, so popping costs O(locals) rather
+     * than O(table size) even after a large block grew the table. */
+    Scope *scope = &table->scopes[--table->depth];
+    for (size_t i = 0; i < scope->entry_count; ++i) {
+        scope->slots[scope->entries[i].slot] = 0;
+    }
+    scope->entry_count = 0;
+}
+
+int scope_table_declare(ScopeTable *table, SymbolId symbol, long value) {
+    if (table->depth == 0) {
+        return -1;
+    }
+
+    Scope *scope = &table->scopes[table->depth - 1];
+    int found = 0;
+    uint32_t slot = scope_probe(scope, symbol, &found);
+    if (found) {
+        return 1;
+    }
+
+    if (scope->entry_count == scope->entry_capacity) {
+        size_t new_capacity = scope->entry_capacity ? scope->entry_capacity * 2 : 8;
+        ScopeEntry *resized = realloc(scope->entries, new_capacity * sizeof(ScopeEntry));
+        if (!resized) {
+            return -1;
+        }
+        scope->entries = resized;
+        scope->entry_capacity = new_capacity;
+    }
+
+    /* Grow before the table passes half full; re-probe since slots moved. */
+    if ((scope->entry_count + 1) * 2 > (size_t)scope->slot_mask + 1) {
+        if (scope_resize(scope, (scope->slot_mask + 1) * 2) != 0) {
+            return -1;
+        }
+        slot = scope_probe(scope, symbol, &found);
+    }
+
+    ScopeEntry *entry = &scope->entries[scope->entry_count];
+    entry->symbol = symbol;
+    entry->slot = slot;
+    entry->value = value;
+    scope->entry_count += 1;
+    scope->slots[slot] = (uint32_t)scope->entry_count;
+    return 0;
+}
+
+int scope_table_lookup(const ScopeTable *table, SymbolId symbol, long *value) {
+    for (size_t depth = table->depth; depth > 0; --depth) {
+        const Scope *scope = &table->scopes[depth - 1];
+        if (scope->entry_count == 0) {
+            continue;
+        }
+        int found = 0;
+        uint32_t slot = scope_probe(scope, symbol, &found);
+        if (found) {
+            *value = scope->entries[scope->slots[slot] - 1].value;
+            return 1;
+        }
+    }
+    return 0;
+}
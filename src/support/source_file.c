@@ -0,0 +1,132 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "support/source_file.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+static int read_all(int fd, size_t size_hint, SourceFile *file) {
+    size_t capacity = size_hint ? size_hint + 1 : 64 * 1024;
+    size_t length = 0;
+    char *buffer = malloc(capacity);
+    if (!buffer) {
+        return -1;
+    }
+
+    for (;;) {
+        if (length == capacity) {
+            size_t new_capacity = capacity * 2;
+            char *resized = realloc(buffer, new_capacity);
+            if (!resized) {
+                free(buffer);
+                errno = ENOMEM;
+                return -1;
+            }
+            buffer = resized;
+            capacity = new_capacity;
+        }
+
+        ssize_t got = read(fd, buffer + length, capacity - length);
+        if (got < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            int saved = errno;
+            free(buffer);
+            errno = saved;
+            return -1;
+        }
+        if (got == 0) {
+            break;
+        }
+        length += (size_t)got;
+    }
+
+    file->data = buffer;
+    file->length = length;
+    file->mode = SOURCE_FILE_BUFFERED;
+    return 0;
+}
+
+static int map_file(int fd, size_t size, SourceFile *file) {
+    if (size == 0) {
+        /* mmap rejects zero-length mappings; an empty source needs no storage. */
+        file->data = "";
+        file->length = 0;
+        file->mode = SOURCE_FILE_MAPPED;
+        return 0;
+    }
+
+    void *view = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (view == MAP_FAILED) {
+        return -1;
+    }
+    posix_madvise(view, size, POSIX_MADV_SEQUENTIAL);
+
+    file->data = view;
+    file->length = size;
+    file->mode = SOURCE_FILE_MAPPED;
+    return 0;
+}
+
+int source_file_open(SourceFile *file, const char *path, int allow_mmap) {
+    memset(file, 0, sizeof(*file));
+    file->path = path;
+
+    if (strcmp(path, "-") == 0) {
+        return read_all(STDIN_FILENO, 0, file);
+    }
+
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        return -1;
+    }
+
+    struct stat info;
+    if (fstat(fd, &info) != 0) {
+        int saved = errno;
+        close(fd);
+        errno = saved;
+        return -1;
+    }
+
+    int status = -1;
+    if (S_ISREG(info.st_mode)) {
+        size_t size = (size_t)info.st_size;
+        if (allow_mmap) {
+            status = map_file(fd, size, file);
+        }
+        if (status != 0) {
+            status = read_all(fd, size, file);
+        }
+    } else {
+        status = read_all(fd, 0, file);
+    }
+
+    int saved = errno;
+    close(fd); /* a mapping stays valid after its descriptor is closed */
+    errno = saved;
+    return status;
+}
+
+void source_file_close(SourceFile *file) {
+    if (!file || !file->data) {
+        return;
+    }
+
+    if (file->mode == SOURCE_FILE_MAPPED) {
+        if (file->length > 0) {
+            munmap((void *)file->data, file->length);
+        }
+    } else {
+        free((void *)file->data);
+    }
+
+    file->data = NULL;
+    file->length = 0;
+}
@@ -1,9 +1,21 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <dirent.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <unistd.h>
 
+#include "backend/code_cache.h"
 #include "backend/codegen.h"
+#include "backend/emitter.h"
+#include "backend/jit.h"
+#include "backend/pipeline.h"
+#include "backend/regalloc.h"
 #include "frontend/parser.h"
+#include "ir/lower.h"
+#include "opt/fold.h"
+#include "support/parallel.h"
 
 #define ASSERT_TRUE(cond, msg)                                                                   \
     do {                                                                                          \
@@ -30,7 +42,7 @@ static int test_codegen_return_literal(void) {
 
     Parser parser;
     parser_init(&parser, source, strlen(source));
-    AstNode *unit = parser_parse_translation_unit(&parser);
+    AstTranslationUnit *unit = parser_parse_translation_unit(&parser);
 
     ASSERT_TRUE(parser_status(&parser) == PARSER_OK, "Parser should succeed");
 
@@ -56,7 +68,7 @@ static int test_codegen_return_identifier(void) {
     const char *source = "int foo() { return bar; }";
     Parser parser;
     parser_init(&parser, source, strlen(source));
-    AstNode *unit = parser_parse_translation_unit(&parser);
+    AstTranslationUnit *unit = parser_parse_translation_unit(&parser);
 
     ASSERT_TRUE(parser_status(&parser) == PARSER_OK, "Parser should succeed");
     FILE *tmp = tmpfile();
@@ -77,7 +89,7 @@ static int test_codegen_binary_expression(void) {
     const char *source = "int main() { return 20 + 22 - 2; }";
     Parser parser;
     parser_init(&parser, source, strlen(source));
-    AstNode *unit = parser_parse_translation_unit(&parser);
+    AstTranslationUnit *unit = parser_parse_translation_unit(&parser);
     ASSERT_TRUE(parser_status(&parser) == PARSER_OK, "Parser should succeed");
 
     FILE *tmp = tmpfile();
@@ -86,9 +98,82 @@ static int test_codegen_binary_expression(void) {
 
     char buffer[1024];
     ASSERT_TRUE(read_file_to_buffer(tmp, buffer, sizeof(buffer)) > 0, "Expected output");
-    ASSERT_TRUE(strstr(buffer, "push %rax") != NULL, "Push missing");
-    ASSERT_TRUE(strstr(buffer, "add %edx, %eax") != NULL, "Add instruction missing");
-    ASSERT_TRUE(strstr(buffer, "sub %edx, %eax") != NULL, "Sub instruction missing");
+    ASSERT_TRUE(strstr(buffer, "    movl $20, %eax\n    add $22, %eax\n    sub $2, %eax\n") != NULL,
+                "Literal operands should be used as immediates");
+    ASSERT_TRUE(strstr(buffer, "push %rax") == NULL, "No temporaries on the stack");
+
+    fclose(tmp);
+    ast_free(unit);
+    return EXIT_SUCCESS;
+}
+
+static int test_codegen_expression_uses_registers(void) {
+    const char *source = "int main() { int a = 1; int b = 2; return (a - b) - (g - (b + a)); }";
+    Parser parser;
+    parser_init(&parser, source, strlen(source));
+    AstTranslationUnit *unit = parser_parse_translation_unit(&parser);
+    ASSERT_TRUE(parser_status(&parser) == PARSER_OK, "Parser should succeed");
+
+    FILE *tmp = tmpfile();
+    ASSERT_TRUE(tmp != NULL, "tmpfile should succeed");
+    ASSERT_TRUE(codegen_emit_translation_unit(unit, tmp) == 0, "Codegen should succeed");
+
+    char buffer[2048];
+    ASSERT_TRUE(read_file_to_buffer(tmp, buffer, sizeof(buffer)) > 0, "Expected output");
+    /* The right operand needs two registers and the left one, so the right is
+     * built first in %ecx (using %eax as scratch) and the left lands in %eax. */
+    ASSERT_TRUE(strstr(buffer,
+                       "    mov g(%rip), %ecx\n"
+                       "    movl -16(%rbp), %eax\n"
+                       "    add -8(%rbp), %eax\n"
+                       "    sub %eax, %ecx\n"
+                       "    movl -8(%rbp), %eax\n"
+                       "    sub -16(%rbp), %eax\n"
+                       "    sub %ecx, %eax\n") != NULL,
+                "Expected register-only evaluation");
+    ASSERT_TRUE(strstr(buffer, "push %rax") == NULL && strstr(buffer, "(%rsp)") == NULL, "No spills expected");
+
+    fclose(tmp);
+    ast_free(unit);
+    return EXIT_SUCCESS;
+}
+
+/* A complete binary tree of subtractions needs one register per level. */
+static size_t append_balanced_tree(char *buffer, size_t used, size_t size, int depth, int *leaf) {
+    if (depth == 0) {
+        return used + (size_t)snprintf(buffer + used, size - used, "%d", (*leaf)++ % 7);
+    }
+    used += (size_t)snprintf(buffer + used, size - used, "(");
+    used = append_balanced_tree(buffer, used, size, depth - 1, leaf);
+    used += (size_t)snprintf(buffer + used, size - used, " - ");
+    used = append_balanced_tree(buffer, used, size, depth - 1, leaf);
+    return used + (size_t)snprintf(buffer + used, size - used, ")");
+}
+
+static int test_codegen_spills_only_deep_trees(void) {
+    static char source[32768];
+    int leaf = 0;
+    size_t used = (size_t)snprintf(source, sizeof(source), "int main() { return ");
+    used = append_balanced_tree(source, used, sizeof(source), 10, &leaf);
+    snprintf(source + used, sizeof(source) - used, "; }");
+
+    Parser parser;
+    parser_init(&parser, source, strlen(source));
+    AstTranslationUnit *unit = parser_parse_translation_unit(&parser);
+    ASSERT_TRUE(parser_status(&parser) == PARSER_OK, "Parser should succeed");
+
+    FILE *tmp = tmpfile();
+    ASSERT_TRUE(tmp != NULL, "tmpfile should succeed");
+    ASSERT_TRUE(codegen_emit_translation_unit(unit, tmp) == 0, "Codegen should succeed");
+
+    static char buffer[262144];
+    ASSERT_TRUE(read_file_to_buffer(tmp, buffer, sizeof(buffer)) > 0, "Expected output");
+    /* Depth 10 needs ten registers but only nine are scratch: exactly one spill. */
+    const char *spill = strstr(buffer, "    push %rax\n");
+    ASSERT_TRUE(spill != NULL, "Expected one spill");
+    ASSERT_TRUE(strstr(spill + 1, "    push %rax\n") == NULL, "Only one spill");
+    ASSERT_TRUE(strstr(buffer, "    sub (%rsp), %eax\n    add $8, %rsp\n") != NULL, "Spilled value used from memory");
+    ASSERT_TRUE(strstr(buffer, "%r11d") != NULL, "Every scratch register should be in use");
 
     fclose(tmp);
     ast_free(unit);
@@ -99,7 +184,7 @@ static int test_codegen_unary_minus(void) {
     const char *source = "int foo() { return -5; }";
     Parser parser;
     parser_init(&parser, source, strlen(source));
-    AstNode *unit = parser_parse_translation_unit(&parser);
+    AstTranslationUnit *unit = parser_parse_translation_unit(&parser);
     ASSERT_TRUE(parser_status(&parser) == PARSER_OK, "Parser should succeed");
 
     FILE *tmp = tmpfile();
@@ -116,11 +201,40 @@ static int test_codegen_unary_minus(void) {
     return EXIT_SUCCESS;
 }
 
+static int test_codegen_strength_reduces_constants(void) {
+    const char *source = "int m() { return g * 10; }\n"
+                         "int d() { return g / 8; }\n"
+                         "int r() { return g % 10; }\n"
+                         "int v() { return g / h; }\n";
+    Parser parser;
+    parser_init(&parser, source, strlen(source));
+    AstTranslationUnit *unit = parser_parse_translation_unit(&parser);
+    ASSERT_TRUE(parser_status(&parser) == PARSER_OK, "Parser should succeed");
+
+    FILE *tmp = tmpfile();
+    ASSERT_TRUE(tmp != NULL, "tmpfile should succeed");
+    ASSERT_TRUE(codegen_emit_translation_unit(unit, tmp) == 0, "Codegen should succeed");
+
+    char buffer[2048];
+    ASSERT_TRUE(read_file_to_buffer(tmp, buffer, sizeof(buffer)) > 0, "Expected output");
+    ASSERT_TRUE(strstr(buffer, "    lea (%rax,%rax,4), %eax\n    shl $1, %eax\n") != NULL, "x * 10 is a lea and a shift");
+    ASSERT_TRUE(strstr(buffer, "    sar $31, %ecx\n    shr $29, %ecx\n    add %ecx, %eax\n    sar $3, %eax\n") != NULL,
+                "x / 8 rounds negative dividends toward zero before shifting");
+    ASSERT_TRUE(strstr(buffer, "    movslq %eax, %rcx\n    imul $1717986919, %rcx\n    sar $34, %rcx\n") != NULL,
+                "x % 10 takes the quotient from a multiply-high");
+    ASSERT_TRUE(strstr(buffer, "    cltd\n    idivl h(%rip)\n") != NULL, "Only the unknown divisor uses idiv");
+    ASSERT_TRUE(strstr(buffer, "idiv") == strstr(buffer, "idivl h(%rip)"), "No other idiv");
+
+    fclose(tmp);
+    ast_free(unit);
+    return EXIT_SUCCESS;
+}
+
 static int test_codegen_locals(void) {
     const char *source = "int main() { int x = 1; x = x + 2; return x; }";
     Parser parser;
     parser_init(&parser, source, strlen(source));
-    AstNode *unit = parser_parse_translation_unit(&parser);
+    AstTranslationUnit *unit = parser_parse_translation_unit(&parser);
     ASSERT_TRUE(parser_status(&parser) == PARSER_OK, "Parser should succeed");
 
     FILE *tmp = tmpfile();
@@ -139,6 +253,979 @@ static int test_codegen_locals(void) {
     return EXIT_SUCCESS;
 }
 
+static int test_codegen_shadowed_locals(void) {
+    const char *source = "int main() { int x = 1; { int x = 2; x = x + 5; } return x; }";
+    Parser parser;
+    parser_init(&parser, source, strlen(source));
+    AstTranslationUnit *unit = parser_parse_translation_unit(&parser);
+    ASSERT_TRUE(parser_status(&parser) == PARSER_OK, "Parser should succeed");
+
+    FILE *tmp = tmpfile();
+    ASSERT_TRUE(tmp != NULL, "tmpfile should succeed");
+    ASSERT_TRUE(codegen_emit_translation_unit(unit, tmp) == 0, "Codegen should succeed");
+
+    char buffer[2048];
+    ASSERT_TRUE(read_file_to_buffer(tmp, buffer, sizeof(buffer)) > 0, "Expected output");
+    ASSERT_TRUE(strstr(buffer, "movl $2, %eax\n    movl %eax, -16(%rbp)") != NULL, "Inner x needs its own slot");
+    ASSERT_TRUE(strstr(buffer, "movl -16(%rbp), %eax") != NULL, "Inner uses should read the inner slot");
+    ASSERT_TRUE(strstr(buffer, "movl -8(%rbp), %eax\n    jmp") != NULL, "Return should read the outer x");
+
+    fclose(tmp);
+    ast_free(unit);
+    return EXIT_SUCCESS;
+}
+
+static int test_codegen_rejects_redeclaration(void) {
+    const char *source = "int main() { int x = 1; int x = 2; return x; }";
+    Parser parser;
+    parser_init(&parser, source, strlen(source));
+    AstTranslationUnit *unit = parser_parse_translation_unit(&parser);
+    ASSERT_TRUE(parser_status(&parser) == PARSER_OK, "Parser should succeed");
+
+    FILE *tmp = tmpfile();
+    ASSERT_TRUE(tmp != NULL, "tmpfile should succeed");
+    ASSERT_TRUE(codegen_emit_translation_unit(unit, tmp) != 0, "Redeclaration in one scope should fail");
+
+    fclose(tmp);
+    ast_free(unit);
+    return EXIT_SUCCESS;
+}
+
+static int test_codegen_rejects_duplicate_function(void) {
+    const char *source = "int f() { return 1; } int g() { return 2; } int f() { return 3; } int main() { return f; }";
+    Parser parser;
+    parser_init(&parser, source, strlen(source));
+    AstTranslationUnit *unit = parser_parse_translation_unit(&parser);
+    ASSERT_TRUE(parser_status(&parser) == PARSER_OK, "Parser should succeed");
+
+    /* Both formats, lowered sequentially and in parallel, name the function. */
+    for (int variant = 0; variant < 4; ++variant) {
+        FILE *diagnostics = tmpfile();
+        FILE *out = tmpfile();
+        ASSERT_TRUE(diagnostics != NULL && out != NULL, "tmpfile should succeed");
+        CodegenOptions options;
+        codegen_options_init(&options);
+        options.diagnostics = diagnostics;
+        options.format = (variant & 1) ? CODEGEN_OBJECT : CODEGEN_ASSEMBLY;
+        options.threads = (variant & 2) ? 4 : 1;
+        ASSERT_TRUE(codegen_emit_translation_unit_with_options(unit, out, &options) != 0,
+                    "A second definition of f should fail");
+
+        char buffer[256];
+        ASSERT_TRUE(read_file_to_buffer(diagnostics, buffer, sizeof(buffer)) > 0, "Expected a diagnostic");
+        ASSERT_TRUE(strcmp(buffer, "Codegen error: duplicate definition of function 'f'\n") == 0,
+                    "The duplicate is reported once, by name");
+        fclose(out);
+        fclose(diagnostics);
+    }
+    ast_free(unit);
+
+    /* Pipelined, the two definitions land in different units. */
+    size_t capacity = 2000 * 40;
+    char *spread = malloc(capacity);
+    ASSERT_TRUE(spread != NULL, "malloc should succeed");
+    size_t used = (size_t)snprintf(spread, capacity, "int f() { return 1; }\n");
+    for (int i = 0; i < 2000; ++i) {
+        used += (size_t)snprintf(spread + used, capacity - used, "int f%d() { return %d; }\n", i, i);
+    }
+    used += (size_t)snprintf(spread + used, capacity - used, "int f() { return 2; }\n");
+
+    FILE *diagnostics = tmpfile();
+    FILE *out = tmpfile();
+    ASSERT_TRUE(diagnostics != NULL && out != NULL, "tmpfile should succeed");
+    CodegenOptions options;
+    codegen_options_init(&options);
+    options.diagnostics = diagnostics;
+    PipelineStats stats;
+    parser_init(&parser, spread, used);
+    ASSERT_TRUE(pipeline_compile(&parser, out, &options, 0, &stats) != 0, "The pipeline should fail");
+    ASSERT_TRUE(stats.batches > 1, "The definitions are in different batches");
+    char buffer[256];
+    ASSERT_TRUE(read_file_to_buffer(diagnostics, buffer, sizeof(buffer)) > 0, "Expected a diagnostic");
+    ASSERT_TRUE(strcmp(buffer, "Codegen error: duplicate definition of function 'f'\n") == 0,
+                "A stream remembers names from earlier units");
+    fclose(out);
+    fclose(diagnostics);
+    free(spread);
+    return EXIT_SUCCESS;
+}
+
+static int test_codegen_many_locals(void) {
+    const int local_count = 3000;
+    size_t capacity = (size_t)local_count * 48 + 64;
+    char *source = malloc(capacity);
+    ASSERT_TRUE(source != NULL, "malloc should succeed");
+
+    size_t used = (size_t)snprintf(source, capacity, "int main() {");
+    for (int i = 0; i < local_count; ++i) {
+        used += (size_t)snprintf(source + used, capacity - used, " int t%d = %d;", i, i);
+    }
+    snprintf(source + used, capacity - used, " return t0 + t%d; }", local_count - 1);
+
+    Parser parser;
+    parser_init(&parser, source, strlen(source));
+    AstTranslationUnit *unit = parser_parse_translation_unit(&parser);
+    ASSERT_TRUE(parser_status(&parser) == PARSER_OK, "Parser should succeed");
+
+    FILE *tmp = tmpfile();
+    ASSERT_TRUE(tmp != NULL, "tmpfile should succeed");
+    ASSERT_TRUE(codegen_emit_translation_unit(unit, tmp) == 0, "Codegen should succeed");
+
+    ASSERT_TRUE(fflush(tmp) == 0 && fseek(tmp, 0, SEEK_END) == 0, "seek should succeed");
+    long size = ftell(tmp);
+    ASSERT_TRUE(size > 0 && fseek(tmp, 0, SEEK_SET) == 0, "Expected output");
+    char *buffer = malloc((size_t)size + 1);
+    ASSERT_TRUE(buffer != NULL, "malloc should succeed");
+    ASSERT_TRUE(read_file_to_buffer(tmp, buffer, (size_t)size + 1) == (int)size, "Read back output");
+    ASSERT_TRUE(strstr(buffer, "sub $24000, %rsp") != NULL, "Frame should hold every local");
+    ASSERT_TRUE(strstr(buffer, "add -24000(%rbp), %eax") != NULL, "Last local should resolve to its slot");
+
+    free(buffer);
+    fclose(tmp);
+    ast_free(unit);
+    free(source);
+    return EXIT_SUCCESS;
+}
+
+/* Emits `unit` with `threads` workers into a heap string the caller frees. */
+static char *emit_with_threads(const AstTranslationUnit *unit, unsigned threads, FILE *diagnostics, int *status) {
+    FILE *tmp = tmpfile();
+    if (!tmp) {
+        return NULL;
+    }
+
+    CodegenOptions options;
+    codegen_options_init(&options);
+    options.threads = threads;
+    options.diagnostics = diagnostics;
+    *status = codegen_emit_translation_unit_with_options(unit, tmp, &options);
+
+    char *text = NULL;
+    if (fflush(tmp) == 0 && fseek(tmp, 0, SEEK_END) == 0) {
+        long size = ftell(tmp);
+        text = malloc((size_t)size + 1);
+        if (text && read_file_to_buffer(tmp, text, (size_t)size + 1) != (int)size) {
+            free(text);
+            text = NULL;
+        }
+    }
+    fclose(tmp);
+    return text;
+}
+
+/* Parses `source` and emits it with `options` into a heap string the caller frees. */
+static char *emit_with_options(const char *source, const CodegenOptions *options) {
+    Parser parser;
+    parser_init(&parser, source, strlen(source));
+    AstTranslationUnit *unit = parser_parse_translation_unit(&parser);
+    if (parser_status(&parser) != PARSER_OK) {
+        ast_free(unit);
+        return NULL;
+    }
+
+    FILE *tmp = tmpfile();
+    char *text = NULL;
+    if (tmp) {
+        if (codegen_emit_translation_unit_with_options(unit, tmp, options) == 0 && fflush(tmp) == 0 &&
+            fseek(tmp, 0, SEEK_END) == 0) {
+            long size = ftell(tmp);
+            text = malloc((size_t)size + 1);
+            if (text && read_file_to_buffer(tmp, text, (size_t)size + 1) != (int)size) {
+                free(text);
+                text = NULL;
+            }
+        }
+        fclose(tmp);
+    }
+    ast_free(unit);
+    return text;
+}
+
+static char *emit_at_level(const char *source, int opt_level) {
+    CodegenOptions options;
+    codegen_options_init(&options);
+    options.opt_level = opt_level;
+    return emit_with_options(source, &options);
+}
+
+static int test_regalloc_locals_live_in_registers(void) {
+    char *text = emit_at_level("int main() { int a = g; int x = 1; x = x + 1; a = a + x; return a; }", 1);
+    ASSERT_TRUE(text != NULL, "Codegen should succeed");
+
+    ASSERT_TRUE(strstr(text, "main:\n    mov %rbx, -8(%rsp)\n    mov %r12, -16(%rsp)\n") != NULL,
+                "Callee-saved registers should be saved");
+    ASSERT_TRUE(strstr(text, "    mov g(%rip), %ebx\n    movl $1, %r12d\n    add $1, %r12d\n    add %ebx, %r12d\n") != NULL,
+                "`x = x + 1` and `a = a + x` should update registers in place");
+    ASSERT_TRUE(strstr(text, "    mov -8(%rsp), %rbx\n    mov -16(%rsp), %r12\n    ret\n") != NULL,
+                "Callee-saved registers should be restored before ret");
+    ASSERT_TRUE(strstr(text, "movl %eax, -") == NULL, "No local should be stored to the frame");
+
+    free(text);
+    return EXIT_SUCCESS;
+}
+
+static int test_regalloc_rematerializes_constants(void) {
+    char *text = emit_at_level("int main() { int k = 7; int x = 1; x = x - k; return x + k; }", 1);
+    ASSERT_TRUE(text != NULL, "Codegen should succeed");
+
+    ASSERT_TRUE(strstr(text, "    sub $7, %ebx\n") != NULL, "Constant local should be used as an immediate");
+    ASSERT_TRUE(strstr(text, "    lea 7(%rbx), %eax\n") != NULL, "Constant local should be used as an immediate");
+    ASSERT_TRUE(strstr(text, "%r12") == NULL, "Constant local should not occupy a register");
+
+    free(text);
+    return EXIT_SUCCESS;
+}
+
+static int test_regalloc_reuses_expired_registers(void) {
+    char *text =
+        emit_at_level("int main() { int a = 1; a = a + 1; int b = a + 2; b = b + 1; int c = b + 3; c = c + 1; return c; }", 1);
+    ASSERT_TRUE(text != NULL, "Codegen should succeed");
+
+    ASSERT_TRUE(strstr(text, "    movl $1, %ebx\n    add $1, %ebx\n    add $2, %ebx\n    add $1, %ebx\n"
+                             "    add $3, %ebx\n    add $1, %ebx\n    movl %ebx, %eax\n") != NULL,
+                "Each local should inherit the register of the one that died before it");
+    ASSERT_TRUE(strstr(text, "%r12") == NULL, "Disjoint live ranges should share one register");
+
+    free(text);
+    return EXIT_SUCCESS;
+}
+
+static int test_regalloc_spills_longest_interval(void) {
+    const char *source = "int main() { int a = 1; a = a + 1; int b = 2; b = b + a; int c = 3; c = c + b;"
+                         " int d = 4; d = d + c; int e = 5; e = e + d; int f = 6; f = f + e;"
+                         " return a + b + c + d + e + f; }";
+    char *text = emit_at_level(source, 1);
+    ASSERT_TRUE(text != NULL, "Codegen should succeed");
+
+    ASSERT_TRUE(strstr(text, "    mov %r15, -40(%rsp)\n") != NULL, "All five registers should be in use");
+    ASSERT_TRUE(strstr(text, "    movl %eax, -44(%rsp)\n") != NULL, "The sixth live local should spill below the saves");
+    ASSERT_TRUE(strstr(text, "    add -44(%rsp), %eax\n") != NULL, "The spilled local should be read from memory");
+    ASSERT_TRUE(strstr(text, "%rbp") == NULL && strstr(text, "sub $") == NULL, "Five saves and one slot fit the red zone");
+
+    free(text);
+    return EXIT_SUCCESS;
+}
+
+static int test_frame_shares_slots_between_sibling_blocks(void) {
+    /* Nine values live at once in each block: four spill per block, and the
+     * two blocks' spills reuse the same four 4-byte slots. */
+    const char *source = "int main() { int r = 0;"
+                         " { int a = g; int b = g; int c = g; int d = g; int e = g; int f = g; int h = g; int i = g;"
+                         "   r = r + a + b + c + d + e + f + h + i; }"
+                         " { int a = g; int b = g; int c = g; int d = g; int e = g; int f = g; int h = g; int i = g;"
+                         "   r = r + a + b + c + d + e + f + h + i; }"
+                         " return r; }";
+    char *text = emit_at_level(source, 1);
+    ASSERT_TRUE(text != NULL, "Codegen should succeed");
+
+    ASSERT_TRUE(strstr(text, "-60(%rsp)") == NULL, "No slot beyond the fourth");
+    ASSERT_TRUE(strstr(text, "-44(%rsp)") != NULL && strstr(text, "-56(%rsp)") != NULL, "Slots are 4 bytes apart");
+
+    free(text);
+    return EXIT_SUCCESS;
+}
+
+static int test_frame_packs_ir_slots(void) {
+    const char *source = "int main() { int r = g; { int a = g; r = r + a; } { int b = g; r = r - b; } return r; }";
+    Parser parser;
+    parser_init(&parser, source, strlen(source));
+    AstTranslationUnit *unit = parser_parse_translation_unit(&parser);
+    ASSERT_TRUE(parser_status(&parser) == PARSER_OK, "Parser should succeed");
+
+    Arena *arena = arena_create(0);
+    Emitter diag;
+    emitter_init(&diag, NULL);
+    IrFunction *function = ir_lower_function(unit, ast_function(unit, 0), arena, IR_LOCALS_IN_SLOTS, &diag);
+    ASSERT_TRUE(function != NULL && function->slot_count == 3, "One slot per local");
+
+    FILE *tmp = tmpfile();
+    ASSERT_TRUE(tmp != NULL, "tmpfile should succeed");
+    CodegenOptions options;
+    codegen_options_init(&options);
+    options.opt_level = 1;
+    options.keep_frame_pointer = 1;
+    ASSERT_TRUE(codegen_emit_ir_function(function, tmp, &options) == 0, "Codegen should succeed");
+    char buffer[2048];
+    ASSERT_TRUE(read_file_to_buffer(tmp, buffer, sizeof(buffer)) > 0, "Expected assembly");
+
+    ASSERT_TRUE(strstr(buffer, "    sub $16, %rsp\n") != NULL, "Two 4-byte slots fit one aligned frame");
+    ASSERT_TRUE(strstr(buffer, "    movl %eax, -4(%rbp)\n") != NULL, "r takes the first slot");
+    ASSERT_TRUE(strstr(buffer, "    add -8(%rbp), %eax\n") != NULL, "a takes the second slot");
+    ASSERT_TRUE(strstr(buffer, "    sub -8(%rbp), %eax\n") != NULL, "b reuses a's slot");
+    ASSERT_TRUE(strstr(buffer, "-12(%rbp)") == NULL, "No third slot");
+
+    fclose(tmp);
+    emitter_free(&diag);
+    arena_destroy(arena);
+    ast_free(unit);
+    return EXIT_SUCCESS;
+}
+
+static int test_frame_omitted_without_locals(void) {
+    char *text = emit_at_level("int main() { return 42; }", 1);
+    ASSERT_TRUE(text != NULL, "Codegen should succeed");
+    ASSERT_TRUE(strstr(text, "main:\n    movl $42, %eax\n.Lmain_return:\n    ret\n") != NULL, "No prologue or epilogue");
+    free(text);
+
+    text = emit_at_level("int main() { return 42; }", 0);
+    ASSERT_TRUE(text != NULL, "Codegen should succeed");
+    ASSERT_TRUE(strstr(text, "main:\n    push %rbp\n    mov %rsp, %rbp\n") != NULL, "-O0 keeps the frame pointer");
+    free(text);
+    return EXIT_SUCCESS;
+}
+
+static int test_frame_pointer_kept_on_request(void) {
+    CodegenOptions options;
+    codegen_options_init(&options);
+    options.opt_level = 1;
+    options.keep_frame_pointer = 1;
+    char *text = emit_with_options("int main() { int a = g; int x = 1; x = x + 1; a = a + x; return a; }", &options);
+    ASSERT_TRUE(text != NULL, "Codegen should succeed");
+
+    ASSERT_TRUE(strstr(text, "main:\n    push %rbp\n    mov %rsp, %rbp\n    sub $16, %rsp\n    mov %rbx, -8(%rbp)\n") != NULL,
+                "The %rbp frame should be set up as before");
+    ASSERT_TRUE(strstr(text, "    mov -16(%rbp), %r12\n    leave\n    ret\n") != NULL, "And torn down with leave");
+    ASSERT_TRUE(strstr(text, "(%rsp)") == NULL, "Nothing addressed from %rsp");
+    free(text);
+    return EXIT_SUCCESS;
+}
+
+static int test_frame_beyond_red_zone_moves_rsp(void) {
+    /* Thirty globals live at once: five registers plus 25 spill slots, 140 bytes. */
+    static char source[4096];
+    size_t used = (size_t)snprintf(source, sizeof(source), "int main() {");
+    for (int i = 0; i < 30; ++i) {
+        used += (size_t)snprintf(source + used, sizeof(source) - used, " int a%d = g;", i);
+    }
+    used += (size_t)snprintf(source + used, sizeof(source) - used, " return a0");
+    for (int i = 1; i < 30; ++i) {
+        used += (size_t)snprintf(source + used, sizeof(source) - used, " + a%d", i);
+    }
+    snprintf(source + used, sizeof(source) - used, "; }");
+
+    char *text = emit_at_level(source, 1);
+    ASSERT_TRUE(text != NULL, "Codegen should succeed");
+    ASSERT_TRUE(strstr(text, "main:\n    sub $144, %rsp\n    mov %rbx, 136(%rsp)\n") != NULL,
+                "A frame past the red zone should be allocated");
+    ASSERT_TRUE(strstr(text, "    movl %eax, 4(%rsp)\n") != NULL, "The deepest slot sits just above %rsp");
+    ASSERT_TRUE(strstr(text, "    mov 104(%rsp), %r15\n    add $144, %rsp\n    ret\n") != NULL, "And released before ret");
+    ASSERT_TRUE(strstr(text, "%rbp") == NULL, "No frame pointer");
+    free(text);
+    return EXIT_SUCCESS;
+}
+
+static int test_frame_with_pushes_leaves_red_zone(void) {
+    /* The depth-10 tree spills with a push, which would clobber red-zone slots. */
+    static char source[32768];
+    int leaf = 0;
+    size_t used = (size_t)snprintf(source, sizeof(source), "int main() { int x = g; x = x + 1; return x - ");
+    used = append_balanced_tree(source, used, sizeof(source), 10, &leaf);
+    snprintf(source + used, sizeof(source) - used, "; }");
+
+    char *text = emit_at_level(source, 1);
+    ASSERT_TRUE(text != NULL, "Codegen should succeed");
+    ASSERT_TRUE(strstr(text, "main:\n    sub $16, %rsp\n    mov %rbx, 8(%rsp)\n") != NULL, "The frame should be allocated");
+    ASSERT_TRUE(strstr(text, "    push %rax\n") != NULL, "The tree still spills");
+    ASSERT_TRUE(strstr(text, "    mov 8(%rsp), %rbx\n    add $16, %rsp\n    ret\n") != NULL, "Restored relative to %rsp");
+    free(text);
+    return EXIT_SUCCESS;
+}
+
+/* Runs `source` in this process with global `g` set to `g_value`. */
+static int run_with_options(const char *source, const CodegenOptions *options, int32_t g_value, int *result) {
+    Parser parser;
+    parser_init(&parser, source, strlen(source));
+    AstTranslationUnit *unit = parser_parse_translation_unit(&parser);
+    if (parser_status(&parser) != PARSER_OK) {
+        ast_free(unit);
+        return -1;
+    }
+    JitModule module;
+    int status = jit_load_translation_unit(&module, unit, options);
+    ast_free(unit);
+    if (status != 0) {
+        return -1;
+    }
+    int32_t *g = jit_global(&module, "g");
+    if (g) {
+        *g = g_value;
+    }
+    status = jit_run_main(&module, result);
+    jit_unload(&module);
+    return status;
+}
+
+/* Runs `source` at -O0, -O1 and -O1 with a frame pointer; 0 when all three
+ * return `expected`. */
+static int run_matches(const char *source, int32_t g_value, int expected) {
+    for (int variant = 0; variant < 3; ++variant) {
+        CodegenOptions options;
+        codegen_options_init(&options);
+        options.opt_level = variant > 0;
+        options.keep_frame_pointer = variant == 2;
+        int result = 0;
+        if (run_with_options(source, &options, g_value, &result) != 0 || result != expected) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+static int evaluate_balanced_tree(int depth, int *leaf) {
+    if (depth == 0) {
+        return (*leaf)++ % 7;
+    }
+    int left = evaluate_balanced_tree(depth - 1, leaf);
+    return left - evaluate_balanced_tree(depth - 1, leaf);
+}
+
+static int test_jit_runs_locals_and_globals(void) {
+    ASSERT_TRUE(run_matches("int main() { return 42; }", 0, 42) == 0, "A literal should be returned");
+    ASSERT_TRUE(run_matches("int main() { int a = g; int x = 1; x = x + 1; a = a + x; return a; }", 40, 42) == 0,
+                "Register-allocated locals should compute the same value at every level");
+    ASSERT_TRUE(run_matches("int main() { int r = g; { int a = g; r = r + a; } { int b = g; r = r - b; } return -r; }", 7, -7) == 0,
+                "Shadowed block locals should share slots without clobbering each other");
+
+    int result = 0;
+    CodegenOptions options;
+    codegen_options_init(&options);
+    ASSERT_TRUE(run_with_options("int helper() { return 1; }", &options, 0, &result) == -1, "A unit without main cannot run");
+    return EXIT_SUCCESS;
+}
+
+static int test_jit_runs_spilled_values(void) {
+    static char source[32768];
+    int leaf = 0;
+    size_t used = (size_t)snprintf(source, sizeof(source), "int main() { int x = g; x = x + 1; return x - ");
+    used = append_balanced_tree(source, used, sizeof(source), 10, &leaf);
+    snprintf(source + used, sizeof(source) - used, "; }");
+    leaf = 0;
+    int tree = evaluate_balanced_tree(10, &leaf);
+    ASSERT_TRUE(run_matches(source, 99, 100 - tree) == 0, "A pushed spill should be popped back correctly");
+
+    const char *siblings = "int main() { int r = 0;"
+                           " { int a = g; int b = g; int c = g; int d = g; int e = g; int f = g; int h = g; int i = g;"
+                           "   r = r + a + b + c + d + e + f + h + i; }"
+                           " { int a = g; int b = g; int c = g; int d = g; int e = g; int f = g; int h = g; int i = g;"
+                           "   r = r + a + b + c + d + e + f + h + i; }"
+                           " return r; }";
+    ASSERT_TRUE(run_matches(siblings, 3, 48) == 0, "Spill slots shared by sibling blocks should hold their values");
+    return EXIT_SUCCESS;
+}
+
+static int test_jit_runs_frames_beyond_red_zone(void) {
+    static char source[4096];
+    size_t used = (size_t)snprintf(source, sizeof(source), "int main() {");
+    for (int i = 0; i < 30; ++i) {
+        used += (size_t)snprintf(source + used, sizeof(source) - used, " int a%d = g - %d;", i, i);
+    }
+    used += (size_t)snprintf(source + used, sizeof(source) - used, " return a0");
+    for (int i = 1; i < 30; ++i) {
+        used += (size_t)snprintf(source + used, sizeof(source) - used, " + a%d", i);
+    }
+    snprintf(source + used, sizeof(source) - used, "; }");
+    /* 30 * 100 - (0 + 1 + ... + 29) */
+    ASSERT_TRUE(run_matches(source, 100, 3000 - 435) == 0, "Every spill slot should keep its own value");
+    return EXIT_SUCCESS;
+}
+
+/* A chain far deeper than the C stack would allow one frame per operator for:
+ * folding, lowering and emission all walk its left spine iteratively. */
+static int test_jit_runs_long_chains(void) {
+    static const char *const terms[] = {" + x", " - 2", " + x * 3", " - (x - g) * (x + g)"};
+    const int32_t g = 5;
+    const int32_t x = g + 1;
+    const int32_t values[] = {x, -2, x * 3, -(x - g) * (x + g)};
+    const size_t count = 100000;
+    size_t size = 64 + count * 24;
+    char *source = malloc(size);
+    ASSERT_TRUE(source != NULL, "The source buffer should be allocated");
+    size_t used = (size_t)snprintf(source, size, "int main() { int x = g + 1; return x");
+    int32_t expected = x;
+    for (size_t i = 1; i < count; ++i) {
+        used += (size_t)snprintf(source + used, size - used, "%s", terms[i % 4]);
+        expected += values[i % 4];
+    }
+    snprintf(source + used, size - used, "; }");
+
+    Parser parser;
+    parser_init(&parser, source, strlen(source));
+    AstTranslationUnit *unit = parser_parse_translation_unit(&parser);
+    size_t folded = 0;
+    int status = (parser_status(&parser) == PARSER_OK) ? fold_constants(unit, &folded) : -1;
+    ast_free(unit);
+    ASSERT_TRUE(status == 0, "A long chain should parse and fold");
+
+    int matches = run_matches(source, g, expected);
+    free(source);
+    ASSERT_TRUE(matches == 0, "A long chain should compile and compute its value at every level");
+    return EXIT_SUCCESS;
+}
+
+/* C semantics, with products wrapping as under -fwrapv. */
+static int32_t reference_binary(char op, int32_t lhs, int32_t rhs) {
+    switch (op) {
+    case '*':
+        return (int32_t)((uint32_t)lhs * (uint32_t)rhs);
+    case '/':
+        return lhs / rhs;
+    default:
+        return lhs % rhs;
+    }
+}
+
+static int test_jit_runs_multiplicative_operators(void) {
+    static const int32_t constants[] = {1, -1, 2, -2, 3, 6, 7, -7, 8, 10, -16, 25, 100, 641, 65536, INT32_MAX, INT32_MIN};
+    static const int32_t values[] = {0, 5, -5, 123456789, -987654321, INT32_MAX, INT32_MIN};
+    char source[256];
+    for (size_t c = 0; c < sizeof(constants) / sizeof(constants[0]); ++c) {
+        for (int op = 0; op < 3; ++op) {
+            /* INT32_MIN has no literal; spell it as an expression the parser accepts. */
+            char literal[32];
+            snprintf(literal, sizeof(literal), constants[c] == INT32_MIN ? "(-2147483647 - 1)" : "%d", (int)constants[c]);
+            snprintf(source, sizeof(source), "int main() { int x = g; x = x %c %s; return x + 1; }", "*/%"[op], literal);
+            for (size_t v = 0; v < sizeof(values) / sizeof(values[0]); ++v) {
+                if (op != 0 && values[v] == INT32_MIN && constants[c] == -1) {
+                    continue; /* undefined in C; -O0 does not fold the -1 and idiv traps */
+                }
+                int32_t expected = (int32_t)((uint32_t)reference_binary("*/%"[op], values[v], constants[c]) + 1u);
+                ASSERT_TRUE(run_matches(source, values[v], expected) == 0, "Constant operands should match C");
+            }
+        }
+    }
+
+    /* An unknown divisor goes through idiv, which traps only where C is undefined. */
+    for (size_t c = 0; c < sizeof(constants) / sizeof(constants[0]); ++c) {
+        int32_t lhs = (constants[c] == INT32_MIN) ? 5 : (int32_t)((uint32_t)constants[c] * 3u);
+        for (int op = 0; op < 3; ++op) {
+            snprintf(source, sizeof(source), "int main() { return %d %c g; }", (int)lhs, "*/%"[op]);
+            for (size_t v = 0; v < sizeof(values) / sizeof(values[0]); ++v) {
+                if (values[v] == 0 && op != 0) {
+                    continue;
+                }
+                ASSERT_TRUE(run_matches(source, values[v], reference_binary("*/%"[op], lhs, values[v])) == 0,
+                            "Variable operands should match C");
+            }
+        }
+    }
+    return EXIT_SUCCESS;
+}
+
+static int test_regalloc_linear_scan(void) {
+    LiveInterval intervals[] = {
+        {0, 10, 0}, /* lives longest: spilled when the third interval arrives */
+        {1, 3, 0},
+        {2, 4, 0},
+        {4, 6, 0}, /* starts as [1, 3] and [2, 4] end, so it reuses a register */
+    };
+    long spilled = regalloc_linear_scan(intervals, 4, 2);
+    ASSERT_TRUE(spilled == 1, "Exactly one interval should spill");
+    ASSERT_TRUE(intervals[0].reg == REGALLOC_SPILLED, "The interval ending last should spill");
+    ASSERT_TRUE(intervals[1].reg >= 0 && intervals[2].reg >= 0 && intervals[1].reg != intervals[2].reg,
+                "Overlapping intervals need distinct registers");
+    ASSERT_TRUE(intervals[3].reg >= 0, "A register should be free again after expiry");
+    return EXIT_SUCCESS;
+}
+
+static int test_regalloc_disabled_at_o0(void) {
+    const char *source = "int main() { int x = 1; x = x + 2; return x; }";
+    char *text = emit_at_level(source, 0);
+    ASSERT_TRUE(text != NULL, "Codegen should succeed");
+
+    ASSERT_TRUE(strstr(text, "    movl %eax, -8(%rbp)\n") != NULL, "-O0 should keep locals in frame slots");
+    ASSERT_TRUE(strstr(text, "%rbx") == NULL, "-O0 should not touch callee-saved registers");
+
+    free(text);
+    return EXIT_SUCCESS;
+}
+
+static int test_codegen_parallel_output_is_deterministic(void) {
+    char source[16384];
+    size_t used = 0;
+    for (int i = 0; i < 64; ++i) {
+        used += (size_t)snprintf(source + used, sizeof(source) - used,
+                                 "int f%d() { int a = %d; { int b = a + %d; a = b - 1; } return a + g; }\n",
+                                 i, i, i * 7);
+    }
+
+    Parser parser;
+    parser_init(&parser, source, strlen(source));
+    AstTranslationUnit *unit = parser_parse_translation_unit(&parser);
+    ASSERT_TRUE(parser_status(&parser) == PARSER_OK, "Parser should succeed");
+
+    int status = -1;
+    char *reference = emit_with_threads(unit, 1, stderr, &status);
+    ASSERT_TRUE(reference != NULL && status == 0, "Sequential codegen should succeed");
+    ASSERT_TRUE(strstr(reference, "    jmp .Lf7_return\n") != NULL, "Return label scoped by function");
+    ASSERT_TRUE(strstr(reference, ".Lf63_return:\n") != NULL, "Last function label");
+
+    const unsigned thread_counts[] = {2, 3, 8, 0};
+    for (size_t i = 0; i < sizeof(thread_counts) / sizeof(thread_counts[0]); ++i) {
+        char *text = emit_with_threads(unit, thread_counts[i], stderr, &status);
+        ASSERT_TRUE(text != NULL && status == 0, "Parallel codegen should succeed");
+        ASSERT_TRUE(strcmp(text, reference) == 0, "Output must not depend on the thread count");
+        free(text);
+    }
+
+    free(reference);
+    ast_free(unit);
+    return EXIT_SUCCESS;
+}
+
+static int test_codegen_parallel_reports_first_error(void) {
+    const char *source =
+        "int a() { return 1; }"
+        "int b() { y = 2; return 0; }"
+        "int c() { z = 3; return 0; }";
+
+    Parser parser;
+    parser_init(&parser, source, strlen(source));
+    AstTranslationUnit *unit = parser_parse_translation_unit(&parser);
+    ASSERT_TRUE(parser_status(&parser) == PARSER_OK, "Parser should succeed");
+
+    FILE *diagnostics = tmpfile();
+    ASSERT_TRUE(diagnostics != NULL, "tmpfile should succeed");
+
+    int status = 0;
+    char *text = emit_with_threads(unit, 4, diagnostics, &status);
+    ASSERT_TRUE(status != 0, "Codegen should fail");
+    free(text);
+
+    char buffer[512];
+    ASSERT_TRUE(read_file_to_buffer(diagnostics, buffer, sizeof(buffer)) > 0, "Expected a diagnostic");
+    ASSERT_TRUE(strcmp(buffer, "Codegen error: assignment to undeclared identifier y\n") == 0,
+                "Only the first failing function should be reported");
+
+    fclose(diagnostics);
+    ast_free(unit);
+    return EXIT_SUCCESS;
+}
+
+/* Reads everything written to `file` into a heap string; `*size` gets its
+ * length, which may include NUL bytes for object output. */
+static char *read_back(FILE *file, size_t *size) {
+    char *bytes = NULL;
+    if (fflush(file) == 0 && fseek(file, 0, SEEK_END) == 0) {
+        *size = (size_t)ftell(file);
+        bytes = malloc(*size + 1);
+        rewind(file);
+        if (bytes && fread(bytes, 1, *size, file) != *size) {
+            free(bytes);
+            bytes = NULL;
+        }
+    }
+    return bytes;
+}
+
+static int test_pipeline_matches_two_pass(void) {
+    /* Enough functions for several batches, with constants for -O1 to fold. */
+    size_t capacity = 600 * 128;
+    char *source = malloc(capacity);
+    ASSERT_TRUE(source != NULL, "malloc should succeed");
+    size_t used = 0;
+    for (int i = 0; i < 600; ++i) {
+        used += (size_t)snprintf(source + used, capacity - used,
+                                 "int f%d() { int a = %d * 4 + 2; { int b = a - (3 - 1); a = b %% 7; } return a + g; }\n",
+                                 i, i);
+    }
+
+    for (int variant = 0; variant < 4; ++variant) {
+        CodegenOptions options;
+        codegen_options_init(&options);
+        options.opt_level = variant & 1;
+        options.format = (variant & 2) ? CODEGEN_OBJECT : CODEGEN_ASSEMBLY;
+
+        Parser parser;
+        parser_init(&parser, source, used);
+        AstTranslationUnit *unit = parser_parse_translation_unit(&parser);
+        ASSERT_TRUE(parser_status(&parser) == PARSER_OK, "Parser should succeed");
+        size_t folded = 0;
+        ASSERT_TRUE(options.opt_level == 0 || fold_constants(unit, &folded) == 0, "Folding should succeed");
+        FILE *two_pass = tmpfile();
+        ASSERT_TRUE(two_pass != NULL, "tmpfile should succeed");
+        ASSERT_TRUE(codegen_emit_translation_unit_with_options(unit, two_pass, &options) == 0,
+                    "Two-pass codegen should succeed");
+        ast_free(unit);
+
+        /* A depth of 1 makes the parser wait for nearly every batch. */
+        FILE *pipelined = tmpfile();
+        ASSERT_TRUE(pipelined != NULL, "tmpfile should succeed");
+        PipelineStats stats;
+        parser_init(&parser, source, used);
+        ASSERT_TRUE(pipeline_compile(&parser, pipelined, &options, 1, &stats) == 0, "Pipeline should succeed");
+        ASSERT_TRUE(stats.functions == 600 && stats.batches > 1, "Functions are handed over in batches");
+        ASSERT_TRUE(stats.folded == folded && (folded > 0) == (options.opt_level > 0),
+                    "Folding runs on the codegen thread");
+
+        size_t expected_size = 0;
+        size_t actual_size = 0;
+        char *expected = read_back(two_pass, &expected_size);
+        char *actual = read_back(pipelined, &actual_size);
+        ASSERT_TRUE(expected && actual, "Reading the outputs should succeed");
+        ASSERT_TRUE(expected_size == actual_size && memcmp(expected, actual, actual_size) == 0,
+                    "Pipelined output is byte-identical to the two-pass output");
+        free(expected);
+        free(actual);
+        fclose(two_pass);
+        fclose(pipelined);
+    }
+    free(source);
+    return EXIT_SUCCESS;
+}
+
+static int test_pipeline_holds_codegen_errors_behind_parse_errors(void) {
+    /* The padding puts the bad function in a later batch than b, so b has
+     * already failed code generation when the parse error is found. */
+    size_t capacity = 2000 * 48;
+    char *source = malloc(capacity);
+    ASSERT_TRUE(source != NULL, "malloc should succeed");
+    for (int broken = 0; broken < 2; ++broken) {
+        size_t used = (size_t)snprintf(source, capacity, "int a() { return 1; } int b() { y = 2; return 0; }\n");
+        for (int i = 0; i < 2000; ++i) {
+            used += (size_t)snprintf(source + used, capacity - used, "int f%d() { return %d + a; }\n", i, i);
+        }
+        used += (size_t)snprintf(source + used, capacity - used, "%s",
+                                 broken ? "int c() { return ; }" : "int c() { z = 3; return 0; }");
+
+        FILE *diagnostics = tmpfile();
+        FILE *out = tmpfile();
+        ASSERT_TRUE(diagnostics != NULL && out != NULL, "tmpfile should succeed");
+        CodegenOptions options;
+        codegen_options_init(&options);
+        options.diagnostics = diagnostics;
+
+        Parser parser;
+        parser_init(&parser, source, used);
+        parser.diagnostics = diagnostics;
+        PipelineStats stats;
+        ASSERT_TRUE(pipeline_compile(&parser, out, &options, 0, &stats) != 0, "Pipeline should fail");
+        ASSERT_TRUE(stats.batches > 1, "The error spans batches");
+
+        char buffer[512];
+        ASSERT_TRUE(read_file_to_buffer(diagnostics, buffer, sizeof(buffer)) > 0, "Expected a diagnostic");
+        if (!broken) {
+            ASSERT_TRUE(parser_status(&parser) == PARSER_OK, "Parsing succeeded");
+            ASSERT_TRUE(strcmp(buffer, "Codegen error: assignment to undeclared identifier y\n") == 0,
+                        "Only the first failing function should be reported");
+        } else {
+            ASSERT_TRUE(parser_status(&parser) == PARSER_ERROR, "Parsing failed");
+            ASSERT_TRUE(strncmp(buffer, "Parser error", 12) == 0 && strstr(buffer, "Codegen error") == NULL,
+                        "A parse error hides code generation diagnostics, as in two-pass mode");
+        }
+        fclose(out);
+        fclose(diagnostics);
+    }
+    free(source);
+    return EXIT_SUCCESS;
+}
+
+/* Calls `visit` on every entry file of a cache directory, then on the shard
+ * directories when `shards` is set. */
+static void walk_cache(const char *directory, int shards, void (*visit)(const char *path)) {
+    DIR *top = opendir(directory);
+    struct dirent *shard;
+    while (top && (shard = readdir(top)) != NULL) {
+        if (shard->d_name[0] == '.') {
+            continue;
+        }
+        char path[1024];
+        snprintf(path, sizeof(path), "%s/%s", directory, shard->d_name);
+        DIR *inner = opendir(path);
+        struct dirent *entry;
+        while (inner && (entry = readdir(inner)) != NULL) {
+            if (entry->d_name[0] != '.' || entry->d_name[1] == 't') {
+                char file[2048];
+                snprintf(file, sizeof(file), "%s/%s", path, entry->d_name);
+                visit(file);
+            }
+        }
+        if (inner) {
+            closedir(inner);
+        }
+        if (shards) {
+            visit(path);
+        }
+    }
+    if (top) {
+        closedir(top);
+    }
+}
+
+static void remove_path(const char *path) {
+    if (unlink(path) != 0) {
+        rmdir(path);
+    }
+}
+
+/* Flips the last payload byte, as a torn write or a bad disk would. */
+static void corrupt_entry(const char *path) {
+    FILE *file = fopen(path, "r+b");
+    if (file && fseek(file, -1, SEEK_END) == 0) {
+        int c = fgetc(file);
+        fseek(file, -1, SEEK_END);
+        fputc(c ^ 0x5A, file);
+    }
+    if (file) {
+        fclose(file);
+    }
+}
+
+static int test_codegen_cache_reuses_unchanged_functions(void) {
+    char directory[] = "/tmp/fungcc_cache_XXXXXX";
+    ASSERT_TRUE(mkdtemp(directory) != NULL, "mkdtemp should succeed");
+    CodeCache cache;
+    ASSERT_TRUE(code_cache_open(&cache, directory) == 0, "The cache should open");
+
+    const char *first = "int a() { return g + 1; } int b() { int x = 2; return x * g; } int main() { return 3; }";
+    /* b changes; a and main only move. */
+    const char *second = "/* moved */ int a() { return g + 1; }\nint b() { int x = 5; return x * g; } int main() { return 3; }";
+
+    CodegenOptions options;
+    codegen_options_init(&options);
+    options.opt_level = 1;
+    char *reference = emit_with_options(first, &options);
+    char *edited_reference = emit_with_options(second, &options);
+    ASSERT_TRUE(reference && edited_reference, "Uncached codegen should succeed");
+
+    CodeCacheStats stats = {0};
+    options.cache = &cache;
+    options.cache_stats = &stats;
+    char *cold = emit_with_options(first, &options);
+    ASSERT_TRUE(cold && strcmp(cold, reference) == 0, "A cold cache should not change the output");
+    ASSERT_TRUE(stats.hits == 0 && stats.misses == 3, "Every function misses a cold cache");
+
+    stats = (CodeCacheStats){0};
+    options.threads = 4;
+    char *warm = emit_with_options(first, &options);
+    ASSERT_TRUE(warm && strcmp(warm, reference) == 0, "Cached code should be identical");
+    ASSERT_TRUE(stats.hits == 3 && stats.misses == 0, "Every function hits a warm cache, from any thread");
+
+    stats = (CodeCacheStats){0};
+    options.threads = 1;
+    char *edited = emit_with_options(second, &options);
+    ASSERT_TRUE(edited && strcmp(edited, edited_reference) == 0, "An edited unit should match an uncached compile");
+    ASSERT_TRUE(stats.hits == 2 && stats.misses == 1, "Only the changed function is lowered again");
+
+    stats = (CodeCacheStats){0};
+    options.opt_level = 0;
+    char *unoptimized = emit_with_options(first, &options);
+    ASSERT_TRUE(unoptimized && stats.hits == 0 && stats.misses == 3, "Other options must not reuse the code");
+
+    free(reference);
+    free(edited_reference);
+    free(cold);
+    free(warm);
+    free(edited);
+    free(unoptimized);
+    code_cache_close(&cache);
+    walk_cache(directory, 1, remove_path);
+    ASSERT_TRUE(rmdir(directory) == 0, "Only cache entries should be left behind");
+    return EXIT_SUCCESS;
+}
+
+static int test_codegen_cache_relocates_cached_objects(void) {
+    char directory[] = "/tmp/fungcc_cache_XXXXXX";
+    ASSERT_TRUE(mkdtemp(directory) != NULL, "mkdtemp should succeed");
+    CodeCache cache;
+    ASSERT_TRUE(code_cache_open(&cache, directory) == 0, "The cache should open");
+
+    const char *first = "int helper() { return h; } int main() { int a = g * 3; return a - h + g; }";
+    const char *second = "int helper() { return 0; }   int main() { int a = g * 3; return a - h + g; }";
+
+    CodeCacheStats stats = {0};
+    CodegenOptions options;
+    codegen_options_init(&options);
+    options.opt_level = 1;
+    options.cache = &cache;
+    options.cache_stats = &stats;
+    int result = 0;
+    ASSERT_TRUE(run_with_options(first, &options, 5, &result) == 0 && result == 20, "A cold cache runs correctly");
+    ASSERT_TRUE(stats.misses == 2, "Both functions are encoded");
+
+    /* main now starts at another offset in the source and in the text, and
+     * its relocations must name the new source's globals. */
+    stats = (CodeCacheStats){0};
+    ASSERT_TRUE(run_with_options(second, &options, 7, &result) == 0 && result == 28, "A cached main runs correctly");
+    ASSERT_TRUE(stats.hits == 1 && stats.misses == 1, "main comes from the cache");
+
+    walk_cache(directory, 0, corrupt_entry);
+    stats = (CodeCacheStats){0};
+    ASSERT_TRUE(run_with_options(second, &options, 7, &result) == 0 && result == 28, "Corrupt entries are ignored");
+    ASSERT_TRUE(stats.hits == 0 && stats.misses == 2, "A corrupt entry is a miss");
+
+    stats = (CodeCacheStats){0};
+    ASSERT_TRUE(run_with_options(second, &options, 7, &result) == 0 && result == 28, "Rewritten entries run");
+    ASSERT_TRUE(stats.hits == 2 && stats.misses == 0, "Misses rewrite the entries");
+
+    code_cache_close(&cache);
+    walk_cache(directory, 1, remove_path);
+    ASSERT_TRUE(rmdir(directory) == 0, "Only cache entries should be left behind");
+    return EXIT_SUCCESS;
+}
+
+typedef struct CountingTasks {
+    unsigned char hits[4096];
+} CountingTasks;
+
+static void count_task(void *context, size_t index) {
+    CountingTasks *tasks = context;
+    /* Make the first few tasks much more expensive so other workers must steal. */
+    volatile unsigned long spin = (index < 4) ? 200000ul : 10ul;
+    while (spin > 0) {
+        spin -= 1;
+    }
+    tasks->hits[index] += 1;
+}
+
+static int test_parallel_for_runs_every_index_once(void) {
+    const unsigned thread_counts[] = {1, 2, 5, 16};
+    for (size_t t = 0; t < sizeof(thread_counts) / sizeof(thread_counts[0]); ++t) {
+        static CountingTasks tasks;
+        memset(tasks.hits, 0, sizeof(tasks.hits));
+        parallel_for(sizeof(tasks.hits), thread_counts[t], count_task, &tasks);
+        for (size_t i = 0; i < sizeof(tasks.hits); ++i) {
+            ASSERT_TRUE(tasks.hits[i] == 1, "Every index should run exactly once");
+        }
+    }
+    return EXIT_SUCCESS;
+}
+
+static int test_emitter_appends_and_flushes(void) {
+    FILE *tmp = tmpfile();
+    ASSERT_TRUE(tmp != NULL, "tmpfile should succeed");
+
+    Emitter emitter;
+    emitter_init(&emitter, tmp);
+    emitter.flush_threshold = 64; /* force several block writes */
+
+    for (int i = 0; i < 50; ++i) {
+        emitter_text(&emitter, "    add ");
+        emitter_reg32(&emitter, X86_R10);
+        emitter_text(&emitter, ", ");
+        emitter_reg64(&emitter, X86_RAX);
+        emitter_newline(&emitter);
+    }
+    emitter_int(&emitter, 0);
+    emitter_char(&emitter, ' ');
+    emitter_int(&emitter, -2147483647L - 1);
+    emitter_char(&emitter, ' ');
+    emitter_int(&emitter, 1234567890L);
+    emitter_newline(&emitter);
+
+    ASSERT_TRUE(emitter.bytes_written > 0, "Emitter should have flushed before finishing");
+    ASSERT_TRUE(emitter_finish(&emitter) == 0, "Emitter should finish cleanly");
+    emitter_free(&emitter);
+
+    char buffer[2048];
+    ASSERT_TRUE(read_file_to_buffer(tmp, buffer, sizeof(buffer)) > 0, "Expected output");
+    ASSERT_TRUE(strncmp(buffer, "    add %r10d, %rax\n", 20) == 0, "First line");
+    ASSERT_TRUE(strstr(buffer, "0 -2147483648 1234567890\n") != NULL, "Integer formatting");
+    ASSERT_TRUE(strlen(buffer) == 50 * 20 + 25, "Every line should be written exactly once");
+
+    fclose(tmp);
+    return EXIT_SUCCESS;
+}
+
 int main(void) {
     typedef int (*test_fn)(void);
     struct {
@@ -149,7 +1236,39 @@ int main(void) {
         {"codegen_return_identifier", test_codegen_return_identifier},
         {"codegen_binary_expression", test_codegen_binary_expression},
         {"codegen_unary_minus", test_codegen_unary_minus},
+        {"codegen_strength_reduces_constants", test_codegen_strength_reduces_constants},
+        {"codegen_expression_uses_registers", test_codegen_expression_uses_registers},
+        {"codegen_spills_only_deep_trees", test_codegen_spills_only_deep_trees},
         {"codegen_locals", test_codegen_locals},
+        {"codegen_shadowed_locals", test_codegen_shadowed_locals},
+        {"codegen_rejects_redeclaration", test_codegen_rejects_redeclaration},
+        {"codegen_rejects_duplicate_function", test_codegen_rejects_duplicate_function},
+        {"codegen_many_locals", test_codegen_many_locals},
+        {"regalloc_locals_live_in_registers", test_regalloc_locals_live_in_registers},
+        {"regalloc_rematerializes_constants", test_regalloc_rematerializes_constants},
+        {"regalloc_reuses_expired_registers", test_regalloc_reuses_expired_registers},
+        {"regalloc_spills_longest_interval", test_regalloc_spills_longest_interval},
+        {"regalloc_linear_scan", test_regalloc_linear_scan},
+        {"frame_shares_slots_between_sibling_blocks", test_frame_shares_slots_between_sibling_blocks},
+        {"frame_packs_ir_slots", test_frame_packs_ir_slots},
+        {"frame_omitted_without_locals", test_frame_omitted_without_locals},
+        {"frame_pointer_kept_on_request", test_frame_pointer_kept_on_request},
+        {"frame_beyond_red_zone_moves_rsp", test_frame_beyond_red_zone_moves_rsp},
+        {"frame_with_pushes_leaves_red_zone", test_frame_with_pushes_leaves_red_zone},
+        {"regalloc_disabled_at_o0", test_regalloc_disabled_at_o0},
+        {"jit_runs_locals_and_globals", test_jit_runs_locals_and_globals},
+        {"jit_runs_spilled_values", test_jit_runs_spilled_values},
+        {"jit_runs_frames_beyond_red_zone", test_jit_runs_frames_beyond_red_zone},
+        {"jit_runs_multiplicative_operators", test_jit_runs_multiplicative_operators},
+        {"jit_runs_long_chains", test_jit_runs_long_chains},
+        {"emitter_appends_and_flushes", test_emitter_appends_and_flushes},
+        {"codegen_parallel_output_is_deterministic", test_codegen_parallel_output_is_deterministic},
+        {"codegen_parallel_reports_first_error", test_codegen_parallel_reports_first_error},
+        {"pipeline_matches_two_pass", test_pipeline_matches_two_pass},
+        {"pipeline_holds_codegen_errors_behind_parse_errors", test_pipeline_holds_codegen_errors_behind_parse_errors},
+        {"codegen_cache_reuses_unchanged_functions", test_codegen_cache_reuses_unchanged_functions},
+        {"codegen_cache_relocates_cached_objects", test_codegen_cache_relocates_cached_objects},
+        {"parallel_for_runs_every_index_once", test_parallel_for_runs_every_index_once},
     };
 
     size_t count = sizeof(tests) / sizeof(tests[0]);
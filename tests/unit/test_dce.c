@@ -0,0 +1,243 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "backend/codegen.h"
+#include "frontend/parser.h"
+#include "ir/ir.h"
+#include "ir/lower.h"
+#include "opt/dce.h"
+
+#define ASSERT_TRUE(cond, msg)                                                                   \
+    do {                                                                                          \
+        if (!(cond)) {                                                                            \
+            fprintf(stderr, "Assertion failed: %s (line %d): %s\n", __FILE__, __LINE__, msg);   \
+            return EXIT_FAILURE;                                                                  \
+        }                                                                                         \
+    } while (0)
+
+static int dump_to_buffer(const IrFunction *function, char *buffer, size_t size) {
+    FILE *tmp = tmpfile();
+    if (!tmp) {
+        return -1;
+    }
+    ir_dump_function(function, tmp);
+    size_t read = 0;
+    if (fflush(tmp) == 0 && fseek(tmp, 0, SEEK_SET) == 0) {
+        read = fread(buffer, 1, size - 1, tmp);
+    }
+    buffer[read] = '\0';
+    fclose(tmp);
+    return read > 0 ? 0 : -1;
+}
+
+/* Lowers the first function of `source`, removes its dead code and dumps the
+ * result into `buffer`. */
+static int eliminate_and_dump(const char *source, IrLocalMode mode, DceStats *stats, uint32_t *slots, char *buffer, size_t size) {
+    Parser parser;
+    parser_init(&parser, source, strlen(source));
+    AstTranslationUnit *unit = parser_parse_translation_unit(&parser);
+    if (parser_status(&parser) != PARSER_OK) {
+        ast_free(unit);
+        return -1;
+    }
+
+    Arena *arena = arena_create(0);
+    Emitter diag;
+    emitter_init(&diag, NULL);
+    IrFunction *function = arena ? ir_lower_function(unit, ast_function(unit, 0), arena, mode, &diag) : NULL;
+
+    int status = -1;
+    if (function && eliminate_dead_code(function, stats) == 0) {
+        *slots = function->slot_count;
+        status = dump_to_buffer(function, buffer, size);
+    }
+    emitter_free(&diag);
+    arena_destroy(arena);
+    ast_free(unit);
+    return status;
+}
+
+static int test_dce_removes_unused_values(void) {
+    char buffer[1024];
+    DceStats stats = {0};
+    uint32_t slots = 0;
+    ASSERT_TRUE(eliminate_and_dump("int main() { int a = g + 1; int b = a + g; int c = 5; { int d = b - 2; } a = 7; return c; }",
+                                   IR_LOCALS_AS_VALUES, &stats, &slots, buffer, sizeof(buffer)) == 0,
+                "Lowering should succeed");
+    ASSERT_TRUE(strcmp(buffer, "function main\nbb0:\n  %5 = const 5  ; c\n  ret %5\n") == 0,
+                "Only the returned value should remain");
+    ASSERT_TRUE(stats.instructions == 8 && stats.slots == 0, "Eight instructions removed");
+    return EXIT_SUCCESS;
+}
+
+static int test_dce_keeps_values_feeding_the_result(void) {
+    char buffer[1024];
+    DceStats stats = {0};
+    uint32_t slots = 0;
+    ASSERT_TRUE(eliminate_and_dump("int main() { int a = g; a = a - 1; return -a; }", IR_LOCALS_AS_VALUES, &stats, &slots,
+                                   buffer, sizeof(buffer)) == 0,
+                "Lowering should succeed");
+    ASSERT_TRUE(stats.instructions == 0, "Nothing is dead");
+    ASSERT_TRUE(strstr(buffer, "global g") != NULL && strstr(buffer, "neg") != NULL, "The whole chain stays");
+    return EXIT_SUCCESS;
+}
+
+static int test_dce_removes_dead_stores_and_slots(void) {
+    char buffer[1024];
+    DceStats stats = {0};
+    uint32_t slots = 0;
+    ASSERT_TRUE(eliminate_and_dump("int main() { int a = 1; int b = 2; a = 3; { int c = a; } return a; }",
+                                   IR_LOCALS_IN_SLOTS, &stats, &slots, buffer, sizeof(buffer)) == 0,
+                "Lowering should succeed");
+    const char *expected = "function main\n"
+                           "bb0:\n"
+                           "  %2 = const 3\n"
+                           "  store s0, %2\n"
+                           "  %4 = load s0\n"
+                           "  ret %4\n";
+    ASSERT_TRUE(strcmp(buffer, expected) == 0, "Overwritten and never-read stores should go");
+    ASSERT_TRUE(stats.instructions == 6, "Two constants, three stores and a load removed");
+    ASSERT_TRUE(slots == 1 && stats.slots == 2, "Only a's slot should remain");
+    return EXIT_SUCCESS;
+}
+
+static int test_dce_keeps_stores_read_later(void) {
+    char buffer[1024];
+    DceStats stats = {0};
+    uint32_t slots = 0;
+    ASSERT_TRUE(eliminate_and_dump("int main() { int a = 1; int b = a; a = b + a; return a; }", IR_LOCALS_IN_SLOTS, &stats,
+                                   &slots, buffer, sizeof(buffer)) == 0,
+                "Lowering should succeed");
+    ASSERT_TRUE(stats.instructions == 0 && slots == 2, "Every store is read");
+    return EXIT_SUCCESS;
+}
+
+/* bb0 jumps straight to bb2, so bb1 never runs; both reach bb2 with their own
+ * x and y. Only x is returned. */
+static IrFunction *build_skipped_block(Arena *arena) {
+    IrFunction *function = ir_function_create(arena, "skip", 4);
+    IrBuilder builder;
+    if (!function || ir_builder_init(&builder, function) != 0) {
+        return NULL;
+    }
+    uint32_t x = ir_variable_create(&builder, "x", 1);
+    uint32_t y = ir_variable_create(&builder, "y", 1);
+    IrBlock *skipped = ir_block_create(function);
+    IrBlock *join = ir_block_create(function);
+
+    ir_write_variable(&builder, x, ir_build_const(&builder, 1));
+    ir_write_variable(&builder, y, ir_build_const(&builder, 2));
+    ir_build_jump(&builder, join);
+    ir_builder_set_block(&builder, skipped);
+    ir_write_variable(&builder, x, ir_build_global(&builder, "a", 1));
+    ir_write_variable(&builder, y, ir_build_global(&builder, "b", 1));
+    ir_build_jump(&builder, join);
+    ir_builder_set_block(&builder, join);
+    IrValue result = ir_read_variable(&builder, x);
+    (void)ir_read_variable(&builder, y);
+    ir_build_ret(&builder, result);
+
+    int failed = builder.failed;
+    ir_builder_free(&builder);
+    return failed ? NULL : function;
+}
+
+static int test_dce_empties_unreachable_blocks(void) {
+    Arena *arena = arena_create(0);
+    IrFunction *function = build_skipped_block(arena);
+    ASSERT_TRUE(function != NULL, "Building the function should succeed");
+    ASSERT_TRUE(function->blocks[2]->phi_count == 2, "Both variables meet in a phi");
+
+    DceStats stats = {0};
+    ASSERT_TRUE(eliminate_dead_code(function, &stats) == 0, "Elimination should succeed");
+    char buffer[1024];
+    ASSERT_TRUE(dump_to_buffer(function, buffer, sizeof(buffer)) == 0, "Expected a dump");
+    ASSERT_TRUE(strstr(buffer, "bb1:\n  ret\nbb2:") != NULL, "The skipped block should only return");
+    ASSERT_TRUE(strstr(buffer, "const 2") == NULL, "y is never read");
+    ASSERT_TRUE(function->blocks[2]->phi_count == 1, "Only x's phi is live");
+    ASSERT_TRUE(stats.instructions == 4, "Two globals, a constant and a phi removed");
+
+    FILE *tmp = tmpfile();
+    ASSERT_TRUE(tmp != NULL, "tmpfile should succeed");
+    CodegenOptions options;
+    codegen_options_init(&options);
+    options.opt_level = 1;
+    ASSERT_TRUE(codegen_emit_ir_function(function, tmp, &options) == 0, "Codegen should accept the result");
+    fclose(tmp);
+
+    arena_destroy(arena);
+    return EXIT_SUCCESS;
+}
+
+/* Emits `source` at -O`opt_level` into `buffer`. */
+static int emit_source(const char *source, int opt_level, DceStats *stats, char *buffer, size_t size) {
+    Parser parser;
+    parser_init(&parser, source, strlen(source));
+    AstTranslationUnit *unit = parser_parse_translation_unit(&parser);
+    if (parser_status(&parser) != PARSER_OK) {
+        ast_free(unit);
+        return -1;
+    }
+
+    CodegenOptions options;
+    codegen_options_init(&options);
+    options.opt_level = opt_level;
+    options.dce_stats = stats;
+
+    FILE *tmp = tmpfile();
+    int status = (tmp && codegen_emit_translation_unit_with_options(unit, tmp, &options) == 0) ? 0 : -1;
+    if (status == 0) {
+        rewind(tmp);
+        size_t read = fread(buffer, 1, size - 1, tmp);
+        buffer[read] = '\0';
+    }
+    if (tmp) {
+        fclose(tmp);
+    }
+    ast_free(unit);
+    return status;
+}
+
+static int test_dce_shrinks_code_and_frame(void) {
+    const char *source = "int main() { int a = g + 1; int b = a + g; int c = 5; { int d = b - 2; } return c; }";
+    char optimized[4096];
+    char plain[4096];
+    DceStats stats = {0};
+    ASSERT_TRUE(emit_source(source, 1, &stats, optimized, sizeof(optimized)) == 0, "-O1 should succeed");
+    ASSERT_TRUE(emit_source(source, 0, NULL, plain, sizeof(plain)) == 0, "-O0 should succeed");
+
+    ASSERT_TRUE(strstr(plain, "    sub $32, %rsp\n") != NULL, "-O0 keeps a slot per local");
+    ASSERT_TRUE(strstr(optimized, "main:\n    movl $5, %eax\n") != NULL,
+                "-O1 should need no frame and no saved registers");
+    ASSERT_TRUE(strstr(optimized, "g(%rip)") == NULL, "Dead loads of g removed");
+    ASSERT_TRUE(stats.instructions > 0, "Removals should be counted");
+    return EXIT_SUCCESS;
+}
+
+int main(void) {
+    typedef int (*test_fn)(void);
+    struct {
+        const char *name;
+        test_fn fn;
+    } tests[] = {
+        {"dce_removes_unused_values", test_dce_removes_unused_values},
+        {"dce_keeps_values_feeding_the_result", test_dce_keeps_values_feeding_the_result},
+        {"dce_removes_dead_stores_and_slots", test_dce_removes_dead_stores_and_slots},
+        {"dce_keeps_stores_read_later", test_dce_keeps_stores_read_later},
+        {"dce_empties_unreachable_blocks", test_dce_empties_unreachable_blocks},
+        {"dce_shrinks_code_and_frame", test_dce_shrinks_code_and_frame},
+    };
+
+    size_t count = sizeof(tests) / sizeof(tests[0]);
+    for (size_t i = 0; i < count; ++i) {
+        int result = tests[i].fn();
+        if (result != EXIT_SUCCESS) {
+            fprintf(stderr, "Test '%s' failed.\n", tests[i].name);
+            return result;
+        }
+    }
+
+    printf("All dead code tests passed (%zu cases).\n", count);
+    return EXIT_SUCCESS;
+}
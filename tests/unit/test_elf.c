@@ -0,0 +1,300 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+
+#include "backend/codegen.h"
+#include "backend/elf.h"
+#include "backend/x86.h"
+#include "backend/x86_encode.h"
+#include "frontend/parser.h"
+
+#define ASSERT_TRUE(cond, msg)                                                                   \
+    do {                                                                                          \
+        if (!(cond)) {                                                                            \
+            fprintf(stderr, "Assertion failed: %s (line %d): %s\n", __FILE__, __LINE__, msg);   \
+            return EXIT_FAILURE;                                                                  \
+        }                                                                                         \
+    } while (0)
+
+static int test_encode_matches_assembler(void) {
+    X86Code code;
+    x86_code_init(&code);
+    x86_emit(&code, X86_MOV, 8, x86_reg(X86_RBX), x86_mem(X86_RSP, -8));
+    x86_emit(&code, X86_MOV, 4, x86_imm(42), x86_reg(X86_RAX));
+    x86_emit(&code, X86_ADD, 4, x86_imm(1), x86_reg(X86_R12));
+    x86_emit(&code, X86_SUB, 4, x86_imm(2147483647), x86_reg(X86_RAX));
+    x86_emit(&code, X86_MOV, 4, x86_reg(X86_RAX), x86_mem(X86_R13, 0));
+    x86_emit(&code, X86_LEA, 4, x86_mem(X86_RBX, 7), x86_reg(X86_RAX));
+    x86_emit(&code, X86_PUSH, 8, x86_reg(X86_R12), x86_none());
+    x86_emit(&code, X86_POP, 8, x86_none(), x86_reg(X86_RBX));
+    x86_emit(&code, X86_PUSH, 8, x86_mem(X86_RSP, 16), x86_none());
+    x86_emit(&code, X86_NEG, 4, x86_none(), x86_reg(X86_RAX));
+    x86_emit(&code, X86_TEST, 4, x86_reg(X86_RAX), x86_reg(X86_RAX));
+    x86_emit(&code, X86_XOR, 4, x86_reg(X86_RAX), x86_reg(X86_RAX));
+    x86_emit(&code, X86_SUB, 4, x86_mem(X86_RBP, -300), x86_reg(X86_R15));
+    x86_emit(&code, X86_MOV, 8, x86_imm(-1), x86_reg(X86_RAX));
+    x86_emit(&code, X86_LEAVE, 8, x86_none(), x86_none());
+    x86_emit(&code, X86_RET, 8, x86_none(), x86_none());
+
+    /* What GNU as produces for the same instructions. */
+    static const uint8_t expected[] = {
+        0x48, 0x89, 0x5c, 0x24, 0xf8, 0xb8, 0x2a, 0x00, 0x00, 0x00, 0x41, 0x83, 0xc4, 0x01, 0x2d, 0xff, 0xff, 0xff, 0x7f,
+        0x41, 0x89, 0x45, 0x00, 0x8d, 0x43, 0x07, 0x41, 0x54, 0x5b, 0xff, 0x74, 0x24, 0x10, 0xf7, 0xd8, 0x85, 0xc0,
+        0x31, 0xc0, 0x44, 0x2b, 0xbd, 0xd4, 0xfe, 0xff, 0xff, 0x48, 0xc7, 0xc0, 0xff, 0xff, 0xff, 0xff, 0xc9, 0xc3,
+    };
+
+    X86Object object;
+    x86_object_init(&object);
+    ASSERT_TRUE(x86_encode_function(&object, &code, "f", 1) == 0, "Encoding should succeed");
+    ASSERT_TRUE(object.text_length == sizeof(expected), "Same length as the assembler");
+    ASSERT_TRUE(memcmp(object.text, expected, sizeof(expected)) == 0, "Same bytes as the assembler");
+    ASSERT_TRUE(object.symbol_count == 1 && object.symbols[0].size == sizeof(expected), "One symbol covering the code");
+    ASSERT_TRUE(object.reloc_count == 0, "No globals referenced");
+
+    x86_object_free(&object);
+    x86_code_free(&code);
+    return EXIT_SUCCESS;
+}
+
+static int test_encode_multiply_divide_matches_assembler(void) {
+    X86Code code;
+    x86_code_init(&code);
+    x86_emit(&code, X86_IMUL, 4, x86_reg(X86_R12), x86_reg(X86_RAX));
+    x86_emit(&code, X86_IMUL, 4, x86_imm(10), x86_reg(X86_RCX));
+    x86_emit(&code, X86_IMUL, 4, x86_imm(100000), x86_reg(X86_R9));
+    x86_emit(&code, X86_IMUL, 8, x86_imm(1717986919), x86_reg(X86_RAX));
+    x86_emit(&code, X86_IMUL, 4, x86_mem(X86_RSP, -4), x86_reg(X86_RDX));
+    x86_emit(&code, X86_LEA, 4, x86_mem_index(X86_R13, X86_R13, 8, 0), x86_reg(X86_R13));
+    x86_emit(&code, X86_LEA, 4, x86_mem_index(X86_RAX, X86_R9, 4, 0), x86_reg(X86_RCX));
+    x86_emit(&code, X86_LEA, 4, x86_mem_index(X86_RBP, X86_RBX, 2, 0), x86_reg(X86_RAX));
+    x86_emit(&code, X86_SHL, 4, x86_imm(3), x86_reg(X86_RDX));
+    x86_emit(&code, X86_SAR, 4, x86_imm(1), x86_reg(X86_RAX));
+    x86_emit(&code, X86_SHR, 4, x86_imm(31), x86_reg(X86_R11));
+    x86_emit(&code, X86_SAR, 8, x86_imm(34), x86_reg(X86_RAX));
+    x86_emit(&code, X86_AND, 4, x86_imm(-8), x86_reg(X86_RCX));
+    x86_emit(&code, X86_AND, 4, x86_reg(X86_RAX), x86_reg(X86_R8));
+    x86_emit(&code, X86_MOVSXD, 8, x86_reg(X86_R10), x86_reg(X86_RAX));
+    x86_emit(&code, X86_CDQ, 4, x86_none(), x86_none());
+    x86_emit(&code, X86_IDIV, 4, x86_reg(X86_R14), x86_none());
+    x86_emit(&code, X86_IDIV, 4, x86_mem(X86_RSP, -8), x86_none());
+
+    /* GNU as, including the disp8 it needs for an %rbp or %r13 base. */
+    static const uint8_t expected[] = {
+        0x41, 0x0f, 0xaf, 0xc4, 0x6b, 0xc9, 0x0a, 0x45, 0x69, 0xc9, 0xa0, 0x86, 0x01, 0x00, 0x48, 0x69, 0xc0, 0x67,
+        0x66, 0x66, 0x66, 0x0f, 0xaf, 0x54, 0x24, 0xfc, 0x47, 0x8d, 0x6c, 0xed, 0x00, 0x42, 0x8d, 0x0c, 0x88, 0x8d,
+        0x44, 0x5d, 0x00, 0xc1, 0xe2, 0x03, 0xd1, 0xf8, 0x41, 0xc1, 0xeb, 0x1f, 0x48, 0xc1, 0xf8, 0x22, 0x83, 0xe1,
+        0xf8, 0x41, 0x21, 0xc0, 0x49, 0x63, 0xc2, 0x99, 0x41, 0xf7, 0xfe, 0xf7, 0x7c, 0x24, 0xf8,
+    };
+
+    X86Object object;
+    x86_object_init(&object);
+    ASSERT_TRUE(x86_encode_function(&object, &code, "f", 1) == 0, "Encoding should succeed");
+    ASSERT_TRUE(object.text_length == sizeof(expected), "Same length as the assembler");
+    ASSERT_TRUE(memcmp(object.text, expected, sizeof(expected)) == 0, "Same bytes as the assembler");
+
+    x86_object_free(&object);
+    x86_code_free(&code);
+    return EXIT_SUCCESS;
+}
+
+static int test_encode_relaxes_far_jumps(void) {
+    X86Code code;
+    x86_code_init(&code);
+    x86_emit(&code, X86_TEST, 4, x86_reg(X86_RAX), x86_reg(X86_RAX));
+    x86_emit(&code, X86_JNE, 4, x86_label(1), x86_none());
+    x86_emit(&code, X86_JMP, 4, x86_label(X86_RETURN_LABEL), x86_none());
+    x86_emit(&code, X86_LABEL, 4, x86_label(1), x86_none());
+    for (int i = 0; i < 40; ++i) {
+        x86_emit(&code, X86_ADD, 4, x86_imm(1000), x86_reg(X86_RBX)); /* 6 bytes each */
+    }
+    x86_emit(&code, X86_LABEL, 4, x86_label(X86_RETURN_LABEL), x86_none());
+    x86_emit(&code, X86_RET, 8, x86_none(), x86_none());
+
+    X86Object object;
+    x86_object_init(&object);
+    ASSERT_TRUE(x86_encode_function(&object, &code, "f", 1) == 0, "Encoding should succeed");
+    /* test (2), jne rel8 over the jmp, jmp rel32 over the 240 bytes of adds. */
+    ASSERT_TRUE(object.text[2] == 0x75 && object.text[3] == 5, "The near jne stays short");
+    ASSERT_TRUE(object.text[4] == 0xE9 && object.text[5] == 240 && object.text[6] == 0, "The far jmp is widened");
+    ASSERT_TRUE(object.text_length == 2 + 2 + 5 + 240 + 1, "Laid out once the jmp was widened");
+
+    x86_object_free(&object);
+    x86_code_free(&code);
+    return EXIT_SUCCESS;
+}
+
+static int test_encode_records_relocations(void) {
+    static const char *const names = "g h";
+    X86Code code;
+    x86_code_init(&code);
+    x86_emit(&code, X86_MOV, 4, x86_global(names, 1), x86_reg(X86_RAX));
+    x86_emit(&code, X86_ADD, 4, x86_imm(5), x86_global(names + 2, 1));
+    x86_emit(&code, X86_RET, 8, x86_none(), x86_none());
+
+    X86Object first;
+    X86Object object;
+    x86_object_init(&first);
+    x86_object_init(&object);
+    ASSERT_TRUE(x86_encode_function(&first, &code, "f", 1) == 0, "Encoding should succeed");
+    ASSERT_TRUE(first.reloc_count == 2, "One relocation per global operand");
+    ASSERT_TRUE(first.relocs[0].offset == 2 && first.relocs[0].addend == -4, "The load's field ends the instruction");
+    ASSERT_TRUE(first.relocs[1].offset == 8 && first.relocs[1].addend == -5, "An imm8 follows the add's field");
+    ASSERT_TRUE(first.relocs[1].name == names + 2 && first.relocs[1].length == 1, "Relocations name the global");
+
+    ASSERT_TRUE(x86_encode_function(&object, &code, "a", 1) == 0 && x86_object_append(&object, &first) == 0,
+                "Objects should concatenate");
+    ASSERT_TRUE(object.symbol_count == 2 && object.symbols[1].offset == first.text_length, "Appended symbols are shifted");
+    ASSERT_TRUE(object.reloc_count == 4 && object.relocs[2].offset == first.text_length + 2, "Appended relocations too");
+
+    x86_object_free(&first);
+    x86_object_free(&object);
+    x86_code_free(&code);
+    return EXIT_SUCCESS;
+}
+
+static uint64_t read_le(const unsigned char *bytes, size_t size) {
+    uint64_t value = 0;
+    for (size_t i = size; i-- > 0;) {
+        value = value << 8 | bytes[i];
+    }
+    return value;
+}
+
+/* Emits `source` in `format` into `out`; returns 0 on success. */
+static int emit_source(const char *source, CodegenFormat format, int opt_level, FILE *out) {
+    Parser parser;
+    parser_init(&parser, source, strlen(source));
+    AstTranslationUnit *unit = parser_parse_translation_unit(&parser);
+    if (parser_status(&parser) != PARSER_OK) {
+        ast_free(unit);
+        return -1;
+    }
+    CodegenOptions options;
+    codegen_options_init(&options);
+    options.format = format;
+    options.opt_level = opt_level;
+    int status = codegen_emit_translation_unit_with_options(unit, out, &options);
+    ast_free(unit);
+    return status;
+}
+
+static int test_elf_object_layout(void) {
+    FILE *tmp = tmpfile();
+    ASSERT_TRUE(tmp != NULL, "tmpfile should succeed");
+    ASSERT_TRUE(emit_source("int first() { return g; } int main() { return g + 1; }", CODEGEN_OBJECT, 1, tmp) == 0,
+                "Codegen should succeed");
+
+    static unsigned char file[4096];
+    rewind(tmp);
+    size_t size = fread(file, 1, sizeof(file), tmp);
+    fclose(tmp);
+    ASSERT_TRUE(size > 64 && memcmp(file, "\x7f" "ELF\x02\x01\x01", 7) == 0, "ELF64 little-endian header");
+    ASSERT_TRUE(read_le(file + 16, 2) == 1 && read_le(file + 18, 2) == 62, "Relocatable x86-64 file");
+
+    uint64_t section_headers = read_le(file + 40, 8);
+    size_t section_count = (size_t)read_le(file + 60, 2);
+    const unsigned char *shstrtab_header = file + section_headers + 64 * read_le(file + 62, 2);
+    ASSERT_TRUE(section_headers + 64 * section_count <= size, "Section headers inside the file");
+    const char *section_names = (const char *)file + read_le(shstrtab_header + 24, 8);
+
+    int found_note = 0;
+    uint64_t rela_size = 0;
+    uint64_t symtab_size = 0;
+    for (size_t s = 0; s < section_count; ++s) {
+        const unsigned char *header = file + section_headers + 64 * s;
+        const char *name = section_names + read_le(header, 4);
+        if (strcmp(name, ".note.GNU-stack") == 0) {
+            found_note = read_le(header + 32, 8) == 0 && read_le(header + 8, 8) == 0;
+        } else if (strcmp(name, ".rela.text") == 0) {
+            rela_size = read_le(header + 32, 8);
+        } else if (strcmp(name, ".symtab") == 0) {
+            symtab_size = read_le(header + 32, 8);
+        }
+    }
+    ASSERT_TRUE(found_note, "An empty, non-executable .note.GNU-stack");
+    ASSERT_TRUE(rela_size == 2 * 24, "One relocation per load of g");
+    ASSERT_TRUE(symtab_size == 4 * 24, "Null symbol, two functions and g, referenced twice but listed once");
+    return EXIT_SUCCESS;
+}
+
+/* Builds `source` through both output paths with the C compiler as linker,
+ * next to a definition of `g`, and returns whether both programs exit alike. */
+static int link_and_compare(const char *source, int opt_level) {
+    const char *dir = FUNGCC_TEST_DIR;
+    char path[1024];
+    int statuses[2];
+    for (int object = 0; object < 2; ++object) {
+        snprintf(path, sizeof(path), "%s/link_test.%s", dir, object ? "o" : "s");
+        FILE *out = fopen(path, "wb");
+        if (!out) {
+            return 0;
+        }
+        int status = emit_source(source, object ? CODEGEN_OBJECT : CODEGEN_ASSEMBLY, opt_level, out);
+        if (fclose(out) != 0 || status != 0) {
+            return 0;
+        }
+
+        char command[4096];
+        snprintf(command, sizeof(command), "%s -o %s/link_test_%d %s/link_test_global.c %s", FUNGCC_TEST_CC, dir, object, dir, path);
+        if (system(command) != 0) {
+            return 0;
+        }
+        snprintf(command, sizeof(command), "%s/link_test_%d", dir, object);
+        int result = system(command);
+        if (result == -1 || !WIFEXITED(result)) {
+            return 0;
+        }
+        statuses[object] = WEXITSTATUS(result);
+    }
+    return statuses[0] == statuses[1];
+}
+
+static int test_elf_links_like_assembly(void) {
+    char path[1024];
+    snprintf(path, sizeof(path), "%s/link_test_global.c", FUNGCC_TEST_DIR);
+    FILE *global = fopen(path, "w");
+    ASSERT_TRUE(global != NULL, "Should write the global's definition");
+    fputs("int g = 19;\n", global);
+    ASSERT_TRUE(fclose(global) == 0, "Should write the global's definition");
+
+    static const char *const sources[] = {
+        "int main() { return 42; }",
+        "int main() { int a = g; a = a + 1; { int b = a - 3; a = a + b; } return a - -g; }",
+        "int helper() { return g; } int main() { int x = g + g; x = x - 1; return (x + 3) - (g - 50); }",
+    };
+    for (size_t i = 0; i < sizeof(sources) / sizeof(sources[0]); ++i) {
+        for (int level = 0; level <= 1; ++level) {
+            ASSERT_TRUE(link_and_compare(sources[i], level), "The object should behave like the assembled output");
+        }
+    }
+    return EXIT_SUCCESS;
+}
+
+int main(void) {
+    typedef int (*test_fn)(void);
+    struct {
+        const char *name;
+        test_fn fn;
+    } tests[] = {
+        {"encode_matches_assembler", test_encode_matches_assembler},
+        {"encode_multiply_divide_matches_assembler", test_encode_multiply_divide_matches_assembler},
+        {"encode_relaxes_far_jumps", test_encode_relaxes_far_jumps},
+        {"encode_records_relocations", test_encode_records_relocations},
+        {"elf_object_layout", test_elf_object_layout},
+        {"elf_links_like_assembly", test_elf_links_like_assembly},
+    };
+
+    size_t count = sizeof(tests) / sizeof(tests[0]);
+    for (size_t i = 0; i < count; ++i) {
+        int result = tests[i].fn();
+        if (result != EXIT_SUCCESS) {
+            fprintf(stderr, "Test '%s' failed.\n", tests[i].name);
+            return result;
+        }
+    }
+
+    printf("All ELF tests passed (%zu cases).\n", count);
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,175 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "backend/codegen.h"
+#include "frontend/parser.h"
+#include "opt/fold.h"
+
+#define ASSERT_TRUE(cond, msg)                                                                   \
+    do {                                                                                          \
+        if (!(cond)) {                                                                            \
+            fprintf(stderr, "Assertion failed: %s (line %d): %s\n", __FILE__, __LINE__, msg);   \
+            return EXIT_FAILURE;                                                                  \
+        }                                                                                         \
+    } while (0)
+
+/* Parses, folds and lowers `source`; `buffer` receives the assembly. */
+static int fold_and_emit(const char *source, size_t *folded, char *buffer, size_t size) {
+    Parser parser;
+    parser_init(&parser, source, strlen(source));
+    AstTranslationUnit *unit = parser_parse_translation_unit(&parser);
+    if (parser_status(&parser) != PARSER_OK || fold_constants(unit, folded) != 0) {
+        ast_free(unit);
+        return -1;
+    }
+
+    FILE *tmp = tmpfile();
+    int status = (tmp && codegen_emit_translation_unit(unit, tmp) == 0) ? 0 : -1;
+    if (status == 0) {
+        rewind(tmp);
+        size_t read = fread(buffer, 1, size - 1, tmp);
+        buffer[read] = '\0';
+    }
+    if (tmp) {
+        fclose(tmp);
+    }
+    ast_free(unit);
+    return status;
+}
+
+static int test_fold_binary_literals(void) {
+    char buffer[1024];
+    size_t folded = 0;
+    ASSERT_TRUE(fold_and_emit("int main() { return 40 + 2; }", &folded, buffer, sizeof(buffer)) == 0,
+                "Pipeline should succeed");
+    ASSERT_TRUE(folded == 1, "One operator folded");
+    ASSERT_TRUE(strstr(buffer, "    movl $42, %eax\n    jmp .Lmain_return\n") != NULL, "Expected folded literal");
+    ASSERT_TRUE(strstr(buffer, "push %rax") == NULL, "No operand stack traffic left");
+    return EXIT_SUCCESS;
+}
+
+static int test_fold_unary_of_binary(void) {
+    char buffer[1024];
+    size_t folded = 0;
+    ASSERT_TRUE(fold_and_emit("int main() { int x = -(3 - 5); return x; }", &folded, buffer, sizeof(buffer)) == 0,
+                "Pipeline should succeed");
+    ASSERT_TRUE(folded == 2, "Subtraction and negation folded");
+    ASSERT_TRUE(strstr(buffer, "    movl $2, %eax\n    movl %eax, -8(%rbp)\n") != NULL, "Expected folded initializer");
+    ASSERT_TRUE(strstr(buffer, "neg") == NULL, "No negation left");
+    return EXIT_SUCCESS;
+}
+
+static int test_fold_negative_result(void) {
+    char buffer[1024];
+    ASSERT_TRUE(fold_and_emit("int main() { return 1 - 2 - 3; }", NULL, buffer, sizeof(buffer)) == 0,
+                "Pipeline should succeed");
+    ASSERT_TRUE(strstr(buffer, "    movl $-4, %eax\n") != NULL, "Expected negative literal");
+    return EXIT_SUCCESS;
+}
+
+static int test_fold_wraps_at_32_bits(void) {
+    char buffer[1024];
+    ASSERT_TRUE(fold_and_emit("int main() { return 2147483647 + 1; }", NULL, buffer, sizeof(buffer)) == 0,
+                "Pipeline should succeed");
+    ASSERT_TRUE(strstr(buffer, "    movl $-2147483648, %eax\n") != NULL, "INT_MAX + 1 wraps to INT_MIN");
+
+    ASSERT_TRUE(fold_and_emit("int main() { return -(0 - 2147483647 - 1); }", NULL, buffer, sizeof(buffer)) == 0,
+                "Pipeline should succeed");
+    ASSERT_TRUE(strstr(buffer, "    movl $-2147483648, %eax\n") != NULL, "-INT_MIN wraps to INT_MIN");
+
+    ASSERT_TRUE(fold_and_emit("int main() { return 0 - 2147483647 - 2; }", NULL, buffer, sizeof(buffer)) == 0,
+                "Pipeline should succeed");
+    ASSERT_TRUE(strstr(buffer, "    movl $2147483647, %eax\n") != NULL, "INT_MIN - 1 wraps to INT_MAX");
+
+    ASSERT_TRUE(fold_and_emit("int main() { return 4294967296 + 5; }", NULL, buffer, sizeof(buffer)) == 0,
+                "Pipeline should succeed");
+    ASSERT_TRUE(strstr(buffer, "    movl $5, %eax\n") != NULL, "Oversized literals truncate to 32 bits");
+    return EXIT_SUCCESS;
+}
+
+static int test_fold_multiplicative(void) {
+    char buffer[1024];
+    size_t folded = 0;
+    ASSERT_TRUE(fold_and_emit("int main() { return 7 * 6 / 4 % 3; }", &folded, buffer, sizeof(buffer)) == 0,
+                "Pipeline should succeed");
+    ASSERT_TRUE(folded == 3, "Every operator folded");
+    ASSERT_TRUE(strstr(buffer, "    movl $1, %eax\n") != NULL, "Expected folded literal");
+
+    int32_t value = 0;
+    ASSERT_TRUE(fold_binary(AST_BIN_DIV, -7, 2, &value) == 0 && value == -3, "Division truncates toward zero");
+    ASSERT_TRUE(fold_binary(AST_BIN_MOD, -7, 2, &value) == 0 && value == -1, "Remainder takes the dividend's sign");
+    ASSERT_TRUE(fold_binary(AST_BIN_MOD, 7, -2, &value) == 0 && value == 1, "Remainder ignores the divisor's sign");
+    ASSERT_TRUE(fold_binary(AST_BIN_MUL, 65536, 65536, &value) == 0 && value == 0, "Products wrap at 32 bits");
+    ASSERT_TRUE(fold_binary(AST_BIN_DIV, INT32_MIN, -1, &value) == 0 && value == INT32_MIN, "INT_MIN / -1 wraps");
+    ASSERT_TRUE(fold_binary(AST_BIN_MOD, INT32_MIN, -1, &value) == 0 && value == 0, "INT_MIN % -1 is zero");
+    ASSERT_TRUE(fold_binary(AST_BIN_DIV, 1, 0, &value) != 0, "Division by zero does not fold");
+    ASSERT_TRUE(fold_binary(AST_BIN_MOD, 1, 0, &value) != 0, "Modulo by zero does not fold");
+
+    ASSERT_TRUE(fold_and_emit("int main() { return 2 * 3 + 1 / 0; }", &folded, buffer, sizeof(buffer)) == 0,
+                "Pipeline should succeed");
+    ASSERT_TRUE(folded == 1, "Only the product folds");
+    ASSERT_TRUE(strstr(buffer, "idiv") != NULL, "Division by zero is left to trap at run time");
+    return EXIT_SUCCESS;
+}
+
+static int test_fold_keeps_non_constant_operands(void) {
+    const char *source = "int main() { int a = 1; a = a + (2 + 3); { a = -(+4) - a; } return a; }";
+    char buffer[2048];
+    size_t folded = 0;
+    ASSERT_TRUE(fold_and_emit(source, &folded, buffer, sizeof(buffer)) == 0, "Pipeline should succeed");
+    ASSERT_TRUE(folded == 3, "Only the literal subtrees fold");
+    ASSERT_TRUE(strstr(buffer, "    movl -8(%rbp), %eax\n    add $5, %eax\n") != NULL,
+                "Parenthesised constant folded into an immediate");
+    ASSERT_TRUE(strstr(buffer, "    movl $-4, %eax\n    sub -8(%rbp), %eax\n") != NULL,
+                "Nested-block constant folded");
+    return EXIT_SUCCESS;
+}
+
+static int test_fold_rewrites_ast_in_place(void) {
+    const char *source = "int main() { return -7 + 10; }";
+    Parser parser;
+    parser_init(&parser, source, strlen(source));
+    AstTranslationUnit *unit = parser_parse_translation_unit(&parser);
+    ASSERT_TRUE(parser_status(&parser) == PARSER_OK, "Parser should succeed");
+
+    ASSERT_TRUE(fold_constants(unit, NULL) == 0, "Folding should succeed");
+    const AstNode *body = ast_node(unit, ast_node(unit, ast_function(unit, 0))->value.function_decl.body);
+    const AstNode *ret = ast_node(unit, ast_children(unit, body->value.block)[0]);
+    const AstNode *expr = ast_node(unit, ret->value.return_stmt);
+    ASSERT_TRUE(expr->kind == AST_NUMBER_LITERAL, "Return expression is a literal");
+    const AstNumberLiteral *literal = ast_literal(unit, expr->value.number_literal);
+    ASSERT_TRUE(literal->length == 1 && literal->lexeme[0] == '3', "Folded lexeme");
+    ASSERT_TRUE(fold_literal_value(literal) == 3, "Folded value");
+
+    ast_free(unit);
+    return EXIT_SUCCESS;
+}
+
+int main(void) {
+    typedef int (*test_fn)(void);
+    struct {
+        const char *name;
+        test_fn fn;
+    } tests[] = {
+        {"fold_binary_literals", test_fold_binary_literals},
+        {"fold_unary_of_binary", test_fold_unary_of_binary},
+        {"fold_negative_result", test_fold_negative_result},
+        {"fold_wraps_at_32_bits", test_fold_wraps_at_32_bits},
+        {"fold_multiplicative", test_fold_multiplicative},
+        {"fold_keeps_non_constant_operands", test_fold_keeps_non_constant_operands},
+        {"fold_rewrites_ast_in_place", test_fold_rewrites_ast_in_place},
+    };
+
+    size_t count = sizeof(tests) / sizeof(tests[0]);
+    for (size_t i = 0; i < count; ++i) {
+        int result = tests[i].fn();
+        if (result != EXIT_SUCCESS) {
+            fprintf(stderr, "Test '%s' failed.\n", tests[i].name);
+            return result;
+        }
+    }
+
+    printf("All fold tests passed (%zu cases).\n", count);
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,255 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "backend/codegen.h"
+#include "backend/emitter.h"
+#include "frontend/parser.h"
+#include "ir/ir.h"
+#include "ir/lower.h"
+
+#define ASSERT_TRUE(cond, msg)                                                                   \
+    do {                                                                                          \
+        if (!(cond)) {                                                                            \
+            fprintf(stderr, "Assertion failed: %s (line %d): %s\n", __FILE__, __LINE__, msg);   \
+            return EXIT_FAILURE;                                                                  \
+        }                                                                                         \
+    } while (0)
+
+static int read_back(FILE *file, char *buffer, size_t size) {
+    if (fflush(file) != 0 || fseek(file, 0, SEEK_SET) != 0) {
+        return -1;
+    }
+    size_t read = fread(buffer, 1, size - 1, file);
+    buffer[read] = '\0';
+    return (int)read;
+}
+
+/* Lowers the first function of `source` and dumps it into `buffer`. */
+static int lower_and_dump(const char *source, IrLocalMode mode, char *buffer, size_t size) {
+    Parser parser;
+    parser_init(&parser, source, strlen(source));
+    AstTranslationUnit *unit = parser_parse_translation_unit(&parser);
+    if (parser_status(&parser) != PARSER_OK) {
+        ast_free(unit);
+        return -1;
+    }
+
+    Arena *arena = arena_create(0);
+    Emitter diag;
+    emitter_init(&diag, NULL);
+    IrFunction *function = arena ? ir_lower_function(unit, ast_function(unit, 0), arena, mode, &diag) : NULL;
+
+    int status = -1;
+    FILE *tmp = tmpfile();
+    if (function && tmp) {
+        ir_dump_function(function, tmp);
+        status = (read_back(tmp, buffer, size) > 0) ? 0 : -1;
+    }
+    if (tmp) {
+        fclose(tmp);
+    }
+    emitter_free(&diag);
+    arena_destroy(arena);
+    ast_free(unit);
+    return status;
+}
+
+static int test_ir_lowers_locals_to_values(void) {
+    char buffer[1024];
+    ASSERT_TRUE(lower_and_dump("int main() { int x = g; x = x + 1; return x; }", IR_LOCALS_AS_VALUES, buffer,
+                               sizeof(buffer)) == 0,
+                "Lowering should succeed");
+    const char *expected = "function main\n"
+                           "bb0:\n"
+                           "  %0 = global g  ; x\n"
+                           "  %1 = const 1\n"
+                           "  %2 = add %0, %1  ; x\n"
+                           "  ret %2\n";
+    ASSERT_TRUE(strcmp(buffer, expected) == 0, "Each assignment should define a new value");
+    return EXIT_SUCCESS;
+}
+
+static int test_ir_lowers_multiplicative_operators(void) {
+    char buffer[1024];
+    ASSERT_TRUE(lower_and_dump("int main() { return g * 3 / h % 7; }", IR_LOCALS_AS_VALUES, buffer, sizeof(buffer)) == 0,
+                "Lowering should succeed");
+    const char *expected = "function main\n"
+                           "bb0:\n"
+                           "  %0 = global g\n"
+                           "  %1 = const 3\n"
+                           "  %2 = mul %0, %1\n"
+                           "  %3 = global h\n"
+                           "  %4 = div %2, %3\n"
+                           "  %5 = const 7\n"
+                           "  %6 = mod %4, %5\n"
+                           "  ret %6\n";
+    ASSERT_TRUE(strcmp(buffer, expected) == 0, "Operators lower left to right");
+    return EXIT_SUCCESS;
+}
+
+static int test_ir_lowers_locals_to_slots(void) {
+    char buffer[1024];
+    ASSERT_TRUE(lower_and_dump("int main() { int x = 2; { int x = 3; } return x; }", IR_LOCALS_IN_SLOTS, buffer,
+                               sizeof(buffer)) == 0,
+                "Lowering should succeed");
+    const char *expected = "function main\n"
+                           "bb0:\n"
+                           "  %0 = const 2\n"
+                           "  store s0, %0\n"
+                           "  %1 = const 3\n"
+                           "  store s1, %1\n"
+                           "  %2 = load s0\n"
+                           "  ret %2\n";
+    ASSERT_TRUE(strcmp(buffer, expected) == 0, "Shadowing locals should get their own slots");
+    return EXIT_SUCCESS;
+}
+
+static int test_ir_drops_code_after_return(void) {
+    char buffer[1024];
+    ASSERT_TRUE(lower_and_dump("int main() { return 1; int y = 2; y = y - 1; }", IR_LOCALS_AS_VALUES, buffer,
+                               sizeof(buffer)) == 0,
+                "Lowering should succeed");
+    ASSERT_TRUE(strcmp(buffer, "function main\nbb0:\n  %0 = const 1\n  ret %0\n") == 0,
+                "Unreachable statements should produce no IR");
+
+    ASSERT_TRUE(lower_and_dump("int main() { int y = 2; }", IR_LOCALS_AS_VALUES, buffer, sizeof(buffer)) == 0,
+                "Lowering should succeed");
+    ASSERT_TRUE(strstr(buffer, "  ret\n") != NULL, "Falling off the end should return no value");
+    return EXIT_SUCCESS;
+}
+
+static int test_ir_rejects_unknown_assignment(void) {
+    const char *source = "int main() { y = 1; return 0; }";
+    Parser parser;
+    parser_init(&parser, source, strlen(source));
+    AstTranslationUnit *unit = parser_parse_translation_unit(&parser);
+    ASSERT_TRUE(parser_status(&parser) == PARSER_OK, "Parser should succeed");
+
+    Arena *arena = arena_create(0);
+    Emitter diag;
+    emitter_init(&diag, NULL);
+    IrFunction *function = ir_lower_function(unit, ast_function(unit, 0), arena, IR_LOCALS_AS_VALUES, &diag);
+    ASSERT_TRUE(function == NULL, "Lowering should fail");
+    emitter_char(&diag, '\0');
+    ASSERT_TRUE(diag.length > 1 && strstr(diag.data, "assignment to undeclared identifier y") != NULL,
+                "Expected a diagnostic");
+
+    emitter_free(&diag);
+    arena_destroy(arena);
+    ast_free(unit);
+    return EXIT_SUCCESS;
+}
+
+/* if (c) x = a; else x = 2; return x;  built by hand, since the language has
+ * no control flow yet. */
+static IrFunction *build_diamond(Arena *arena) {
+    IrFunction *function = ir_function_create(arena, "pick", 4);
+    IrBuilder builder;
+    if (!function || ir_builder_init(&builder, function) != 0) {
+        return NULL;
+    }
+    uint32_t x = ir_variable_create(&builder, "x", 1);
+    IrBlock *then_block = ir_block_create(function);
+    IrBlock *else_block = ir_block_create(function);
+    IrBlock *join = ir_block_create(function);
+
+    ir_build_branch(&builder, ir_build_global(&builder, "c", 1), then_block, else_block);
+    ir_builder_set_block(&builder, then_block);
+    ir_write_variable(&builder, x, ir_build_global(&builder, "a", 1));
+    ir_build_jump(&builder, join);
+    ir_builder_set_block(&builder, else_block);
+    ir_write_variable(&builder, x, ir_build_const(&builder, 2));
+    ir_build_jump(&builder, join);
+    ir_builder_set_block(&builder, join);
+    ir_build_ret(&builder, ir_read_variable(&builder, x));
+
+    int failed = builder.failed;
+    ir_builder_free(&builder);
+    return failed ? NULL : function;
+}
+
+static int test_ir_places_phi_at_join(void) {
+    Arena *arena = arena_create(0);
+    IrFunction *function = build_diamond(arena);
+    ASSERT_TRUE(function != NULL, "Building the diamond should succeed");
+
+    FILE *tmp = tmpfile();
+    ASSERT_TRUE(tmp != NULL, "tmpfile should succeed");
+    ir_dump_function(function, tmp);
+    char buffer[1024];
+    ASSERT_TRUE(read_back(tmp, buffer, sizeof(buffer)) > 0, "Expected a dump");
+    const char *expected = "function pick\n"
+                           "bb0:\n"
+                           "  %0 = global c\n"
+                           "  br %0, bb1, bb2\n"
+                           "bb1:  ; preds bb0\n"
+                           "  %1 = global a  ; x\n"
+                           "  jmp bb3\n"
+                           "bb2:  ; preds bb0\n"
+                           "  %2 = const 2  ; x\n"
+                           "  jmp bb3\n"
+                           "bb3:  ; preds bb1, bb2\n"
+                           "  %3 = phi [%1, bb1], [%2, bb2]  ; x\n"
+                           "  ret %3\n";
+    ASSERT_TRUE(strcmp(buffer, expected) == 0, "The join should merge both definitions with a phi");
+    fclose(tmp);
+
+    ASSERT_TRUE(function->blocks[3]->phi_count == 1, "Only one phi expected");
+
+    arena_destroy(arena);
+    return EXIT_SUCCESS;
+}
+
+static int test_ir_codegen_copies_phi_operands(void) {
+    Arena *arena = arena_create(0);
+    IrFunction *function = build_diamond(arena);
+    ASSERT_TRUE(function != NULL, "Building the diamond should succeed");
+
+    for (int opt_level = 0; opt_level <= 1; ++opt_level) {
+        FILE *tmp = tmpfile();
+        ASSERT_TRUE(tmp != NULL, "tmpfile should succeed");
+        CodegenOptions options = {.diagnostics = stderr, .threads = 1, .opt_level = opt_level};
+        ASSERT_TRUE(codegen_emit_ir_function(function, tmp, &options) == 0, "Codegen should succeed");
+        char buffer[2048];
+        ASSERT_TRUE(read_back(tmp, buffer, sizeof(buffer)) > 0, "Expected assembly");
+
+        ASSERT_TRUE(strstr(buffer, "    mov c(%rip), %eax\n    test %eax, %eax\n    jne .Lpick_bb1\n") != NULL,
+                    "Expected the branch on c");
+        ASSERT_TRUE(strstr(buffer, ".Lpick_bb2:\n    pushq $2\n    pop") != NULL,
+                    "The else edge should copy the constant into the phi");
+        ASSERT_TRUE(strstr(buffer, ".Lpick_bb3:\n") != NULL, "Expected the join label");
+        fclose(tmp);
+    }
+
+    arena_destroy(arena);
+    return EXIT_SUCCESS;
+}
+
+int main(void) {
+    typedef int (*test_fn)(void);
+    struct {
+        const char *name;
+        test_fn fn;
+    } tests[] = {
+        {"ir_lowers_locals_to_values", test_ir_lowers_locals_to_values},
+        {"ir_lowers_multiplicative_operators", test_ir_lowers_multiplicative_operators},
+        {"ir_lowers_locals_to_slots", test_ir_lowers_locals_to_slots},
+        {"ir_drops_code_after_return", test_ir_drops_code_after_return},
+        {"ir_rejects_unknown_assignment", test_ir_rejects_unknown_assignment},
+        {"ir_places_phi_at_join", test_ir_places_phi_at_join},
+        {"ir_codegen_copies_phi_operands", test_ir_codegen_copies_phi_operands},
+    };
+
+    size_t count = sizeof(tests) / sizeof(tests[0]);
+    for (size_t i = 0; i < count; ++i) {
+        int result = tests[i].fn();
+        if (result != EXIT_SUCCESS) {
+            fprintf(stderr, "Test '%s' failed.\n", tests[i].name);
+            return result;
+        }
+    }
+
+    printf("All IR tests passed (%zu cases).\n", count);
+    return EXIT_SUCCESS;
+}
@@ -1,8 +1,14 @@
+#define _POSIX_C_SOURCE 200809L
+
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <unistd.h>
 
 #include "frontend/lexer.h"
+#include "frontend/lexer_scan.h"
+#include "support/intern.h"
+#include "support/source_file.h"
 
 #define ASSERT_TRUE(cond, msg)                                                                   \
     do {                                                                                          \
@@ -89,6 +95,290 @@ static int test_string_literal(void) {
     return EXIT_SUCCESS;
 }
 
+static int test_token_stream(void) {
+    const char *source = "int _tmp9 = x1+22; if(a==b)else while{return -c,*d/e%f;} @ \xc3\xa9 returns";
+
+    struct {
+        TokenKind kind;
+        const char *lexeme;
+    } expected[] = {
+        {TOKEN_KW_INT, "int"},     {TOKEN_IDENTIFIER, "_tmp9"}, {TOKEN_EQUAL, "="},
+        {TOKEN_IDENTIFIER, "x1"},  {TOKEN_PLUS, "+"},          {TOKEN_NUMBER, "22"},
+        {TOKEN_SEMICOLON, ";"},    {TOKEN_KW_IF, "if"},        {TOKEN_L_PAREN, "("},
+        {TOKEN_IDENTIFIER, "a"},   {TOKEN_EQUAL_EQUAL, "=="},  {TOKEN_IDENTIFIER, "b"},
+        {TOKEN_R_PAREN, ")"},      {TOKEN_KW_ELSE, "else"},    {TOKEN_KW_WHILE, "while"},
+        {TOKEN_L_BRACE, "{"},      {TOKEN_KW_RETURN, "return"}, {TOKEN_MINUS, "-"},
+        {TOKEN_IDENTIFIER, "c"},   {TOKEN_COMMA, ","},         {TOKEN_ASTERISK, "*"},
+        {TOKEN_IDENTIFIER, "d"},   {TOKEN_SLASH, "/"},         {TOKEN_IDENTIFIER, "e"},
+        {TOKEN_PERCENT, "%"},      {TOKEN_IDENTIFIER, "f"},    {TOKEN_SEMICOLON, ";"},
+        {TOKEN_R_BRACE, "}"},      {TOKEN_UNKNOWN, "@"},       {TOKEN_UNKNOWN, "\xc3"},
+        {TOKEN_UNKNOWN, "\xa9"},   {TOKEN_IDENTIFIER, "returns"}, {TOKEN_EOF, ""},
+    };
+
+    Lexer lexer;
+    lexer_init(&lexer, source, strlen(source));
+
+    for (size_t i = 0; i < sizeof(expected) / sizeof(expected[0]); ++i) {
+        Token token = lexer_next_token(&lexer);
+        char message[128];
+        snprintf(message, sizeof(message), "Mismatch at index %zu", i);
+        ASSERT_EQ_INT(token.kind, expected[i].kind, message);
+        ASSERT_TRUE(token.length == strlen(expected[i].lexeme) &&
+                        strncmp(token.lexeme, expected[i].lexeme, token.length) == 0,
+                    message);
+        ASSERT_TRUE(token.column == (size_t)(token.lexeme - source) + 1, "Column should track byte offset");
+    }
+
+    return EXIT_SUCCESS;
+}
+
+static int test_identifiers_are_interned(void) {
+    const char *source = "alpha beta alpha int alphabet beta if else while return whilst";
+
+    Interner *interner = interner_create();
+    ASSERT_TRUE(interner != NULL, "interner_create should succeed");
+
+    Lexer lexer;
+    lexer_init(&lexer, source, strlen(source));
+    lexer_set_interner(&lexer, interner);
+
+    Token tokens[12];
+    for (size_t i = 0; i < 12; ++i) {
+        tokens[i] = lexer_next_token(&lexer);
+    }
+
+    ASSERT_TRUE(tokens[0].symbol != SYMBOL_NONE, "Identifier should carry a symbol");
+    ASSERT_TRUE(tokens[0].symbol == tokens[2].symbol, "Same name should intern to the same symbol");
+    ASSERT_TRUE(tokens[1].symbol == tokens[5].symbol, "Same name should intern to the same symbol");
+    ASSERT_TRUE(tokens[0].symbol != tokens[1].symbol, "Different names need different symbols");
+    ASSERT_TRUE(tokens[4].symbol != tokens[0].symbol, "Prefix must not alias");
+    ASSERT_EQ_INT(tokens[3].kind, TOKEN_KW_INT, "Keyword 'int'");
+    ASSERT_TRUE(tokens[3].symbol == SYMBOL_NONE, "Keywords are not interned");
+    ASSERT_EQ_INT(tokens[6].kind, TOKEN_KW_IF, "Keyword 'if'");
+    ASSERT_EQ_INT(tokens[7].kind, TOKEN_KW_ELSE, "Keyword 'else'");
+    ASSERT_EQ_INT(tokens[8].kind, TOKEN_KW_WHILE, "Keyword 'while'");
+    ASSERT_EQ_INT(tokens[9].kind, TOKEN_KW_RETURN, "Keyword 'return'");
+    ASSERT_EQ_INT(tokens[10].kind, TOKEN_IDENTIFIER, "Keyword look-alike is an identifier");
+    ASSERT_TRUE(interner->count == 4, "Expected four distinct names");
+
+    size_t length = 0;
+    const char *text = interner_text(interner, tokens[4].symbol, &length);
+    ASSERT_TRUE(text && length == 8 && strncmp(text, "alphabet", length) == 0, "Symbol text round-trips");
+
+    /* Force a few rehashes and check ids stay stable. */
+    char names[2000][8];
+    for (int i = 0; i < 2000; ++i) {
+        snprintf(names[i], sizeof(names[i]), "v%d", i);
+        ASSERT_TRUE(interner_intern(interner, names[i], strlen(names[i])) == (SymbolId)(5 + i), "Dense ids");
+    }
+    ASSERT_TRUE(interner_intern(interner, "alpha", 5) == tokens[0].symbol, "Lookup survives rehash");
+    ASSERT_TRUE(interner_intern(interner, names[1234], strlen(names[1234])) == 5 + 1234, "Lookup survives rehash");
+
+    interner_destroy(interner);
+    return EXIT_SUCCESS;
+}
+
+static int test_token_positions_after_comments(void) {
+    const char *source =
+        "/* header line one\n"
+        " * header line two\n"
+        " */\n"
+        "int main() {\n"
+        "        return 1; // trailing\n"
+        "}\n";
+
+    Lexer lexer;
+    lexer_init(&lexer, source, strlen(source));
+
+    Token token = lexer_next_token(&lexer);
+    ASSERT_EQ_INT(token.kind, TOKEN_KW_INT, "Expected 'int' after header comment");
+    ASSERT_TRUE(token.line == 4 && token.column == 1, "'int' position");
+
+    for (int i = 0; i < 5; ++i) {
+        token = lexer_next_token(&lexer);
+    }
+    ASSERT_EQ_INT(token.kind, TOKEN_KW_RETURN, "Expected 'return'");
+    ASSERT_TRUE(token.line == 5 && token.column == 9, "'return' position after indentation");
+
+    lexer_next_token(&lexer);
+    lexer_next_token(&lexer);
+    token = lexer_next_token(&lexer);
+    ASSERT_EQ_INT(token.kind, TOKEN_R_BRACE, "Expected '}' after line comment");
+    ASSERT_TRUE(token.line == 6 && token.column == 1, "'}' position");
+
+    return EXIT_SUCCESS;
+}
+
+static int test_tokenize_matches_token_stream(void) {
+    const char *source = "int main() { /* two\n lines */ int a = 42; a = a % 7 + b;\n"
+                         "\t// note\n  return 3.5 + \"s\" + 18446744073709551617 == x; } @";
+    Interner *interner = interner_create();
+    ASSERT_TRUE(interner != NULL, "interner_create should succeed");
+
+    Lexer lexer;
+    TokenBuffer tokens;
+    lexer_init(&lexer, source, strlen(source));
+    lexer_set_interner(&lexer, interner);
+    ASSERT_TRUE(lexer_tokenize(&lexer, &tokens) == 0, "Tokenizing should succeed");
+
+    lexer_init(&lexer, source, strlen(source));
+    lexer_set_interner(&lexer, interner);
+    for (uint32_t i = 0; i < tokens.count; ++i) {
+        Token token = lexer_next_token(&lexer);
+        ASSERT_EQ_INT((int)tokens.kinds[i], (int)token.kind, "Same kinds as the token stream");
+        ASSERT_TRUE(tokens.source + tokens.offsets[i] == token.lexeme && tokens.lengths[i] == token.length,
+                    "Same spans as the token stream");
+        if (token.kind == TOKEN_IDENTIFIER) {
+            ASSERT_TRUE(tokens.payloads[i] == token.symbol, "Identifiers carry their symbol");
+        }
+        size_t line = 0;
+        size_t column = 0;
+        token_buffer_position(&tokens, i, &line, &column);
+        ASSERT_TRUE(line == token.line && column == token.column, "Positions are recomputed like the lexer's");
+        ASSERT_TRUE((i + 1 == tokens.count) == (token.kind == TOKEN_EOF), "EOF ends the buffer");
+    }
+
+    ASSERT_TRUE(tokens.value_count == 3, "Integer literals are decoded");
+    ASSERT_TRUE(tokens.values[0] == 42 && tokens.values[1] == 7, "Decoded values");
+    ASSERT_TRUE(tokens.values[2] == 1, "Oversized literals wrap modulo 2^64");
+    for (uint32_t i = 0; i < tokens.count; ++i) {
+        if (tokens.kinds[i] == TOKEN_NUMBER && tokens.source[tokens.offsets[i] + 1] == '.') {
+            ASSERT_TRUE(tokens.payloads[i] == TOKEN_NO_VALUE, "A fraction has no integer value");
+        }
+    }
+
+    token_buffer_free(&tokens);
+    interner_destroy(interner);
+    return EXIT_SUCCESS;
+}
+
+/* Lexes `source` and checks every token against the scalar reference run. */
+static int expect_same_tokens_for_all_isas(const char *source) {
+    Token reference[256];
+    size_t reference_count = 0;
+
+    scan_force_isa(SCAN_ISA_SCALAR);
+    Lexer lexer;
+    lexer_init(&lexer, source, strlen(source));
+    for (;;) {
+        ASSERT_TRUE(reference_count < 256, "Too many tokens for test buffer");
+        Token token = lexer_next_token(&lexer);
+        reference[reference_count++] = token;
+        if (token.kind == TOKEN_EOF) {
+            break;
+        }
+    }
+
+    const ScanIsa isas[] = {SCAN_ISA_SSE2, SCAN_ISA_AVX2};
+    for (size_t k = 0; k < sizeof(isas) / sizeof(isas[0]); ++k) {
+        scan_force_isa(isas[k]);
+        lexer_init(&lexer, source, strlen(source));
+        for (size_t i = 0; i < reference_count; ++i) {
+            Token token = lexer_next_token(&lexer);
+            ASSERT_EQ_INT(token.kind, reference[i].kind, "Token kind differs from scalar lexer");
+            ASSERT_TRUE(token.lexeme == reference[i].lexeme, "Token start differs from scalar lexer");
+            ASSERT_TRUE(token.line == reference[i].line, "Token line differs from scalar lexer");
+            ASSERT_TRUE(token.column == reference[i].column, "Token column differs from scalar lexer");
+        }
+    }
+
+    scan_force_isa(SCAN_ISA_AVX2);
+    return EXIT_SUCCESS;
+}
+
+static int test_vector_scan_matches_scalar(void) {
+    char source[4096];
+    size_t used = 0;
+    for (int i = 0; i < 12; ++i) {
+        used += (size_t)snprintf(source + used, sizeof(source) - used,
+                                 "/*%.*s\n * Licensed under the fun license, line %d. **/\n",
+                                 i * 3, "**********************************", i);
+    }
+    used += (size_t)snprintf(source + used, sizeof(source) - used,
+                             "int f() {\n\t\t\t\t\t\t\t\t   \r\n"
+                             "                                        return 1 +   2; // %s\n"
+                             "}\n/* unterminated \n\n comment",
+                             "a long trailing line comment that spans several vector blocks");
+
+    if (expect_same_tokens_for_all_isas(source) != EXIT_SUCCESS) {
+        return EXIT_FAILURE;
+    }
+
+    /* Short inputs exercise the scalar tails of every implementation. */
+    const char *tails[] = {"", " ", "/**/", "/* x */x", "\n\n\n}", "a//", "/", "/*"};
+    for (size_t i = 0; i < sizeof(tails) / sizeof(tails[0]); ++i) {
+        if (expect_same_tokens_for_all_isas(tails[i]) != EXIT_SUCCESS) {
+            return EXIT_FAILURE;
+        }
+    }
+    return EXIT_SUCCESS;
+}
+
+/* Writes `length` bytes to a fresh temporary file and checks that the mapped
+ * and the buffered reads both return exactly those bytes. */
+static int expect_same_source_both_ways(const char *text, size_t length) {
+    char path[] = "/tmp/fungcc_source_XXXXXX";
+    int fd = mkstemp(path);
+    ASSERT_TRUE(fd >= 0, "mkstemp should succeed");
+    ASSERT_TRUE(write(fd, text, length) == (ssize_t)length, "Writing the source should succeed");
+    close(fd);
+
+    const SourceFileMode modes[] = {SOURCE_FILE_BUFFERED, SOURCE_FILE_MAPPED};
+    for (int allow_mmap = 0; allow_mmap < 2; ++allow_mmap) {
+        SourceFile file;
+        ASSERT_TRUE(source_file_open(&file, path, allow_mmap) == 0, "source_file_open should succeed");
+        ASSERT_TRUE(file.mode == modes[allow_mmap], "Regular files are mapped only when allowed");
+        ASSERT_TRUE(file.length == length, "The whole file is read");
+        ASSERT_TRUE(file.data != NULL && memcmp(file.data, text, length) == 0, "The bytes match the file");
+        source_file_close(&file);
+        ASSERT_TRUE(file.data == NULL && file.length == 0, "Closing clears the file");
+    }
+    unlink(path);
+    return EXIT_SUCCESS;
+}
+
+static int test_source_file_mapped_matches_buffered(void) {
+    const char *source = "int main() {\n  return 42; /* comment */\n}\n";
+    if (expect_same_source_both_ways(source, strlen(source)) != EXIT_SUCCESS) {
+        return EXIT_FAILURE;
+    }
+    /* mmap rejects a zero-length mapping, so an empty file is special-cased. */
+    if (expect_same_source_both_ways("", 0) != EXIT_SUCCESS) {
+        return EXIT_FAILURE;
+    }
+
+    /* Larger than the buffered reader's default chunk. */
+    size_t length = 200 * 1024;
+    char *large = malloc(length);
+    ASSERT_TRUE(large != NULL, "malloc should succeed");
+    for (size_t i = 0; i < length; ++i) {
+        large[i] = (char)('a' + i % 26);
+    }
+    int status = expect_same_source_both_ways(large, length);
+    free(large);
+    ASSERT_TRUE(status == EXIT_SUCCESS, "A large file reads the same both ways");
+
+    /* A pipe is never mapped, whatever the caller allows. */
+    int fds[2];
+    ASSERT_TRUE(pipe(fds) == 0, "pipe should succeed");
+    const char *piped = "int f() { return 1; }";
+    ASSERT_TRUE(write(fds[1], piped, strlen(piped)) == (ssize_t)strlen(piped), "Writing the pipe should succeed");
+    close(fds[1]);
+    char pipe_path[64];
+    snprintf(pipe_path, sizeof(pipe_path), "/proc/self/fd/%d", fds[0]);
+    SourceFile from_pipe;
+    ASSERT_TRUE(source_file_open(&from_pipe, pipe_path, 1) == 0, "A pipe opens");
+    ASSERT_TRUE(from_pipe.mode == SOURCE_FILE_BUFFERED, "A pipe is read into a buffer");
+    ASSERT_TRUE(from_pipe.length == strlen(piped) && memcmp(from_pipe.data, piped, from_pipe.length) == 0,
+                "The piped bytes are read");
+    source_file_close(&from_pipe);
+    close(fds[0]);
+
+    SourceFile missing;
+    ASSERT_TRUE(source_file_open(&missing, "/nonexistent/fungcc.c", 1) != 0, "A missing file fails to open");
+    return EXIT_SUCCESS;
+}
+
 int main(void) {
     typedef int (*test_fn)(void);
 
@@ -99,6 +389,12 @@ int main(void) {
         {"skips_whitespace_and_comments", test_skips_whitespace_and_comments},
         {"number_tokens", test_number_tokens},
         {"string_literal", test_string_literal},
+        {"token_stream", test_token_stream},
+        {"identifiers_are_interned", test_identifiers_are_interned},
+        {"token_positions_after_comments", test_token_positions_after_comments},
+        {"tokenize_matches_token_stream", test_tokenize_matches_token_stream},
+        {"vector_scan_matches_scalar", test_vector_scan_matches_scalar},
+        {"source_file_mapped_matches_buffered", test_source_file_mapped_matches_buffered},
     };
 
     size_t test_count = sizeof(tests) / sizeof(tests[0]);
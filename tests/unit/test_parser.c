@@ -12,33 +12,39 @@
         }                                                                                         \
     } while (0)
 
+/* The `index`th statement of the unit's `function`th function body. */
+static const AstNode *body_statement(const AstTranslationUnit *unit, uint32_t function, uint32_t index) {
+    const AstNode *body = ast_node(unit, ast_node(unit, ast_function(unit, function))->value.function_decl.body);
+    return ast_node(unit, ast_children(unit, body->value.block)[index]);
+}
+
 static int test_parse_simple_function(void) {
     const char *source = "int main() { return 42; }";
 
     Parser parser;
     parser_init(&parser, source, strlen(source));
 
-    AstNode *unit = parser_parse_translation_unit(&parser);
+    AstTranslationUnit *unit = parser_parse_translation_unit(&parser);
     ASSERT_TRUE(parser_status(&parser) == PARSER_OK, "Parser should succeed");
     ASSERT_TRUE(unit != NULL, "Translation unit should not be NULL");
-    ASSERT_TRUE(unit->kind == AST_TRANSLATION_UNIT, "Root should be translation unit");
-    ASSERT_TRUE(unit->value.translation_unit.function_count == 1, "Expect one function");
+    ASSERT_TRUE(unit->functions.count == 1, "Expect one function");
 
-    AstNode *func = unit->value.translation_unit.functions[0];
+    const AstNode *func = ast_node(unit, ast_function(unit, 0));
     ASSERT_TRUE(func->kind == AST_FUNCTION_DECL, "Expect function decl");
-    ASSERT_TRUE(func->value.function_decl.name.length == 4, "Function name length");
-    ASSERT_TRUE(strncmp(func->value.function_decl.name.name, "main", 4) == 0, "Function name");
+    const AstIdentifier *name = ast_name(unit, func->value.function_decl.name);
+    ASSERT_TRUE(name->length == 4, "Function name length");
+    ASSERT_TRUE(strncmp(name->name, "main", 4) == 0, "Function name");
 
-    AstNode *block = func->value.function_decl.body;
-    ASSERT_TRUE(block && block->kind == AST_BLOCK, "Expect block body");
-    ASSERT_TRUE(block->value.block.statement_count == 1, "Expect one statement");
+    const AstNode *block = ast_node(unit, func->value.function_decl.body);
+    ASSERT_TRUE(block->kind == AST_BLOCK, "Expect block body");
+    ASSERT_TRUE(block->value.block.count == 1, "Expect one statement");
 
-    AstNode *ret_stmt = block->value.block.statements[0];
-    ASSERT_TRUE(ret_stmt && ret_stmt->kind == AST_RETURN_STMT, "Expect return statement");
+    const AstNode *ret_stmt = ast_node(unit, ast_children(unit, block->value.block)[0]);
+    ASSERT_TRUE(ret_stmt->kind == AST_RETURN_STMT, "Expect return statement");
 
-    AstNode *expr = ret_stmt->value.return_stmt.expression;
-    ASSERT_TRUE(expr && expr->kind == AST_NUMBER_LITERAL, "Expect number literal in return");
-    ASSERT_TRUE(strncmp(expr->value.number_literal.lexeme, "42", 2) == 0, "Literal lexeme");
+    const AstNode *expr = ast_node(unit, ret_stmt->value.return_stmt);
+    ASSERT_TRUE(expr->kind == AST_NUMBER_LITERAL, "Expect number literal in return");
+    ASSERT_TRUE(strncmp(ast_literal(unit, expr->value.number_literal)->lexeme, "42", 2) == 0, "Literal lexeme");
 
     ast_free(unit);
     return EXIT_SUCCESS;
@@ -49,20 +55,20 @@ static int test_parse_identifier_return(void) {
 
     Parser parser;
     parser_init(&parser, source, strlen(source));
-    AstNode *unit = parser_parse_translation_unit(&parser);
+    AstTranslationUnit *unit = parser_parse_translation_unit(&parser);
 
     ASSERT_TRUE(parser_status(&parser) == PARSER_OK, "Parser should succeed");
-    ASSERT_TRUE(unit->value.translation_unit.function_count == 1, "Function count");
+    ASSERT_TRUE(unit->functions.count == 1, "Function count");
 
-    AstNode *func = unit->value.translation_unit.functions[0];
-    AstNode *block = func->value.function_decl.body;
-    ASSERT_TRUE(block && block->kind == AST_BLOCK, "Expect block body");
-    ASSERT_TRUE(block->value.block.statement_count == 1, "Expect one statement");
+    const AstNode *func = ast_node(unit, ast_function(unit, 0));
+    const AstNode *block = ast_node(unit, func->value.function_decl.body);
+    ASSERT_TRUE(block->kind == AST_BLOCK, "Expect block body");
+    ASSERT_TRUE(block->value.block.count == 1, "Expect one statement");
 
-    AstNode *body = block->value.block.statements[0];
-    AstNode *expr = body->value.return_stmt.expression;
+    const AstNode *body = body_statement(unit, 0, 0);
+    const AstNode *expr = ast_node(unit, body->value.return_stmt);
     ASSERT_TRUE(expr->kind == AST_IDENTIFIER, "Return identifier");
-    ASSERT_TRUE(strncmp(expr->value.identifier.name, "bar", 3) == 0, "Identifier name");
+    ASSERT_TRUE(strncmp(ast_name(unit, expr->value.identifier)->name, "bar", 3) == 0, "Identifier name");
 
     ast_free(unit);
     return EXIT_SUCCESS;
@@ -73,7 +79,7 @@ static int test_parse_failure_on_missing_semicolon(void) {
 
     Parser parser;
     parser_init(&parser, source, strlen(source));
-    AstNode *unit = parser_parse_translation_unit(&parser);
+    AstTranslationUnit *unit = parser_parse_translation_unit(&parser);
 
     ASSERT_TRUE(parser_status(&parser) == PARSER_ERROR, "Parser should report error");
     ast_free(unit);
@@ -87,16 +93,17 @@ static int test_parse_multiple_functions(void) {
 
     Parser parser;
     parser_init(&parser, source, strlen(source));
-    AstNode *unit = parser_parse_translation_unit(&parser);
+    AstTranslationUnit *unit = parser_parse_translation_unit(&parser);
 
     ASSERT_TRUE(parser_status(&parser) == PARSER_OK, "Parser should succeed");
-    ASSERT_TRUE(unit->value.translation_unit.function_count == 2, "Expect two functions");
+    ASSERT_TRUE(unit->functions.count == 2, "Expect two functions");
 
-    AstNode *first = unit->value.translation_unit.functions[0];
-    ASSERT_TRUE(strncmp(first->value.function_decl.name.name, "main", 4) == 0, "First function name");
+    const AstNode *first = ast_node(unit, ast_function(unit, 0));
+    ASSERT_TRUE(strncmp(ast_name(unit, first->value.function_decl.name)->name, "main", 4) == 0, "First function name");
 
-    AstNode *second = unit->value.translation_unit.functions[1];
-    ASSERT_TRUE(strncmp(second->value.function_decl.name.name, "foo", 3) == 0, "Second function name");
+    const AstNode *second = ast_node(unit, ast_function(unit, 1));
+    ASSERT_TRUE(strncmp(ast_name(unit, second->value.function_decl.name)->name, "foo", 3) == 0,
+                "Second function name");
 
     ast_free(unit);
     return EXIT_SUCCESS;
@@ -107,19 +114,194 @@ static int test_parse_failure_on_bad_token(void) {
 
     Parser parser;
     parser_init(&parser, source, strlen(source));
-    AstNode *unit = parser_parse_translation_unit(&parser);
+    AstTranslationUnit *unit = parser_parse_translation_unit(&parser);
 
     ASSERT_TRUE(parser_status(&parser) == PARSER_ERROR, "Parser should report error");
     ast_free(unit);
     return EXIT_SUCCESS;
 }
 
+static int test_parse_errors_go_to_diagnostics_stream(void) {
+    const char *source = "int main() { return ; }";
+
+    FILE *diagnostics = tmpfile();
+    ASSERT_TRUE(diagnostics != NULL, "tmpfile should succeed");
+
+    Parser parser;
+    parser_init(&parser, source, strlen(source));
+    parser.diagnostics = diagnostics;
+    AstTranslationUnit *unit = parser_parse_translation_unit(&parser);
+    ASSERT_TRUE(parser_status(&parser) == PARSER_ERROR, "Parser should report error");
+
+    char buffer[256] = {0};
+    rewind(diagnostics);
+    size_t length = fread(buffer, 1, sizeof(buffer) - 1, diagnostics);
+    ASSERT_TRUE(length > 0, "Error should be written to the diagnostics stream");
+    ASSERT_TRUE(strncmp(buffer, "Parser error at line 1 col 21:", 30) == 0, "Diagnostic carries the position");
+
+    fclose(diagnostics);
+    ast_free(unit);
+    return EXIT_SUCCESS;
+}
+
+/* Both token sources must append the same nodes in the same order, with the
+ * same spans, so the pools compare equal element for element. */
+static int same_unit(const AstTranslationUnit *a, const AstTranslationUnit *b) {
+    if (a->node_count != b->node_count || a->child_count != b->child_count || a->name_count != b->name_count ||
+        a->literal_count != b->literal_count || a->functions.first != b->functions.first ||
+        a->functions.count != b->functions.count) {
+        return 0;
+    }
+    for (uint32_t i = 0; i < a->node_count; ++i) {
+        if (memcmp(&a->nodes[i], &b->nodes[i], sizeof(AstNode)) != 0) {
+            return 0;
+        }
+    }
+    for (uint32_t i = 0; i < a->name_count; ++i) {
+        if (a->names[i].name != b->names[i].name || a->names[i].length != b->names[i].length ||
+            a->names[i].symbol != b->names[i].symbol) {
+            return 0;
+        }
+    }
+    for (uint32_t i = 0; i < a->literal_count; ++i) {
+        if (a->literals[i].lexeme != b->literals[i].lexeme || a->literals[i].value != b->literals[i].value) {
+            return 0;
+        }
+    }
+    return memcmp(a->children, b->children, a->child_count * sizeof(AstNodeId)) == 0;
+}
+
+static int test_parse_streaming_matches_prelexed(void) {
+    const char *source = "int f() { int a = 4294967301; { int b = -(a * 3) % g; a = b / (a + 1); } return a - b; }\n"
+                         "/* between */ int main() { return f + 10 - -g; }";
+    AstTranslationUnit *units[2];
+    for (int prelex = 0; prelex < 2; ++prelex) {
+        Parser parser;
+        parser_init(&parser, source, strlen(source));
+        parser.prelex = prelex;
+        units[prelex] = parser_parse_translation_unit(&parser);
+        ASSERT_TRUE(parser_status(&parser) == PARSER_OK, "Parser should succeed in both modes");
+    }
+    ASSERT_TRUE(same_unit(units[0], units[1]), "Both token sources build the same tree");
+
+    const AstNode *decl = body_statement(units[1], 0, 0);
+    const AstNode *literal = ast_node(units[1], decl->value.var_decl.initializer);
+    ASSERT_TRUE(ast_literal(units[1], literal->value.number_literal)->value == 4294967301LL,
+                "Literals carry their decoded value");
+
+    ast_free(units[0]);
+    ast_free(units[1]);
+    return EXIT_SUCCESS;
+}
+
+typedef struct CollectedUnits {
+    AstTranslationUnit *units[4];
+    size_t count;
+} CollectedUnits;
+
+static int collect_unit(void *context, AstTranslationUnit *functions) {
+    CollectedUnits *collected = context;
+    if (collected->count == 4) {
+        ast_free(functions);
+        return -1;
+    }
+    collected->units[collected->count++] = functions;
+    return 0;
+}
+
+/* The `name` in `return 1 + name;`, the first statement of `unit`'s `function`. */
+static const AstIdentifier *returned_name(const AstTranslationUnit *unit, uint32_t function) {
+    const AstNode *ret = body_statement(unit, function, 0);
+    const AstNode *binary = ast_node(unit, ret->value.return_stmt);
+    return ast_name(unit, ast_node(unit, binary->value.binary_expr.right)->value.identifier);
+}
+
+static int test_parse_functions_in_batches(void) {
+    const char *source = "int a() { return 1 + g; } int b() { return 2 + g; } int c() { return 3 + g; }";
+    const uint32_t batches[] = {0, 10000};
+    for (size_t i = 0; i < 2; ++i) {
+        Interner *interner = interner_create();
+        ASSERT_TRUE(interner != NULL, "interner_create should succeed");
+        CollectedUnits collected = {{NULL}, 0};
+        Parser parser;
+        parser_init(&parser, source, strlen(source));
+        ASSERT_TRUE(parser_parse_functions(&parser, interner, batches[i], collect_unit, &collected) == 0,
+                    "Parser should succeed");
+        ASSERT_TRUE(collected.count == (batches[i] ? 1u : 3u), "One unit per function, or one batch");
+
+        uint32_t seen = 0;
+        for (size_t u = 0; u < collected.count; ++u) {
+            const AstTranslationUnit *unit = collected.units[u];
+            for (uint32_t f = 0; f < unit->functions.count; ++f, ++seen) {
+                const AstNode *func = ast_node(unit, ast_function(unit, f));
+                ASSERT_TRUE(ast_name(unit, func->value.function_decl.name)->name[0] == "abc"[seen],
+                            "Functions arrive in source order");
+                ASSERT_TRUE(returned_name(unit, f)->symbol == returned_name(collected.units[0], 0)->symbol,
+                            "Units share the interner's symbols");
+            }
+        }
+        ASSERT_TRUE(seen == 3, "Every function is handed over once");
+        for (size_t u = 0; u < collected.count; ++u) {
+            ast_free(collected.units[u]);
+        }
+        interner_destroy(interner);
+    }
+    return EXIT_SUCCESS;
+}
+
+static int test_parse_functions_stops_at_error(void) {
+    const char *source = "int a() { return 1; } int b() { return 2; } int c() { return ; } int d() { return 4; }";
+    Interner *interner = interner_create();
+    ASSERT_TRUE(interner != NULL, "interner_create should succeed");
+    FILE *diagnostics = tmpfile();
+    ASSERT_TRUE(diagnostics != NULL, "tmpfile should succeed");
+
+    CollectedUnits collected = {{NULL}, 0};
+    Parser parser;
+    parser_init(&parser, source, strlen(source));
+    parser.diagnostics = diagnostics;
+    ASSERT_TRUE(parser_parse_functions(&parser, interner, 0, collect_unit, &collected) != 0, "Parser should fail");
+    ASSERT_TRUE(parser_status(&parser) == PARSER_ERROR, "Parser should report error");
+    ASSERT_TRUE(collected.count == 2, "Functions before the error were handed over, the failing one was not");
+
+    for (size_t u = 0; u < collected.count; ++u) {
+        ast_free(collected.units[u]);
+    }
+    fclose(diagnostics);
+    interner_destroy(interner);
+    return EXIT_SUCCESS;
+}
+
+static int test_parse_rejects_non_integer_literal(void) {
+    const char *source = "int main() {\n  return 1.5;\n}";
+    for (int prelex = 0; prelex < 2; ++prelex) {
+        FILE *diagnostics = tmpfile();
+        ASSERT_TRUE(diagnostics != NULL, "tmpfile should succeed");
+
+        Parser parser;
+        parser_init(&parser, source, strlen(source));
+        parser.prelex = prelex;
+        parser.diagnostics = diagnostics;
+        AstTranslationUnit *unit = parser_parse_translation_unit(&parser);
+        ASSERT_TRUE(parser_status(&parser) == PARSER_ERROR, "Parser should report error");
+
+        char buffer[256] = {0};
+        rewind(diagnostics);
+        ASSERT_TRUE(fread(buffer, 1, sizeof(buffer) - 1, diagnostics) > 0, "Expected a diagnostic");
+        ASSERT_TRUE(strncmp(buffer, "Parser error at line 2 col 10: unsupported number literal '1.5'\n", 64) == 0,
+                    "The literal is named at its position");
+        fclose(diagnostics);
+        ast_free(unit);
+    }
+    return EXIT_SUCCESS;
+}
+
 static int test_parse_failure_on_missing_expression(void) {
     const char *source = "int main() { return ; }";
 
     Parser parser;
     parser_init(&parser, source, strlen(source));
-    AstNode *unit = parser_parse_translation_unit(&parser);
+    AstTranslationUnit *unit = parser_parse_translation_unit(&parser);
 
     ASSERT_TRUE(parser_status(&parser) == PARSER_ERROR, "Parser should report error for missing expr");
     ast_free(unit);
@@ -131,7 +313,7 @@ static int test_parse_failure_on_bad_var_decl(void) {
 
     Parser parser;
     parser_init(&parser, source, strlen(source));
-    AstNode *unit = parser_parse_translation_unit(&parser);
+    AstTranslationUnit *unit = parser_parse_translation_unit(&parser);
 
     ASSERT_TRUE(parser_status(&parser) == PARSER_ERROR, "Parser should flag bad declaration");
     ast_free(unit);
@@ -143,7 +325,7 @@ static int test_parse_failure_on_bad_assignment(void) {
 
     Parser parser;
     parser_init(&parser, source, strlen(source));
-    AstNode *unit = parser_parse_translation_unit(&parser);
+    AstTranslationUnit *unit = parser_parse_translation_unit(&parser);
 
     ASSERT_TRUE(parser_status(&parser) == PARSER_ERROR, "Parser should flag bad assignment");
     ast_free(unit);
@@ -155,20 +337,20 @@ static int test_parse_binary_expression(void) {
 
     Parser parser;
     parser_init(&parser, source, strlen(source));
-    AstNode *unit = parser_parse_translation_unit(&parser);
+    AstTranslationUnit *unit = parser_parse_translation_unit(&parser);
 
     ASSERT_TRUE(parser_status(&parser) == PARSER_OK, "Parser should succeed");
-    AstNode *func = unit->value.translation_unit.functions[0];
-    AstNode *block = func->value.function_decl.body;
-    ASSERT_TRUE(block && block->kind == AST_BLOCK, "Expect block body");
-    ASSERT_TRUE(block->value.block.statement_count == 1, "Expect one statement");
+    const AstNode *func = ast_node(unit, ast_function(unit, 0));
+    const AstNode *block = ast_node(unit, func->value.function_decl.body);
+    ASSERT_TRUE(block->kind == AST_BLOCK, "Expect block body");
+    ASSERT_TRUE(block->value.block.count == 1, "Expect one statement");
 
-    AstNode *ret = block->value.block.statements[0];
-    AstNode *expr = ret->value.return_stmt.expression;
+    const AstNode *ret = body_statement(unit, 0, 0);
+    const AstNode *expr = ast_node(unit, ret->value.return_stmt);
 
     ASSERT_TRUE(expr->kind == AST_BINARY_EXPR, "Top-level expression should be binary");
-    AstNode *left = expr->value.binary_expr.left;
-    AstNode *right = expr->value.binary_expr.right;
+    const AstNode *left = ast_node(unit, expr->value.binary_expr.left);
+    const AstNode *right = ast_node(unit, expr->value.binary_expr.right);
     ASSERT_TRUE(left->kind == AST_BINARY_EXPR, "Left branch should be binary for chained ops");
     ASSERT_TRUE(right->kind == AST_NUMBER_LITERAL, "Right branch should be number");
 
@@ -176,26 +358,56 @@ static int test_parse_binary_expression(void) {
     return EXIT_SUCCESS;
 }
 
+static int test_parse_multiplicative_precedence(void) {
+    const char *source = "int main() { return 1 - 2 * -3 % 4 + 5 / 6; }";
+
+    Parser parser;
+    parser_init(&parser, source, strlen(source));
+    AstTranslationUnit *unit = parser_parse_translation_unit(&parser);
+    ASSERT_TRUE(parser_status(&parser) == PARSER_OK, "Parser should accept * / %");
+
+    const AstNode *expr = ast_node(unit, body_statement(unit, 0, 0)->value.return_stmt);
+
+    /* ((1 - ((2 * -3) % 4)) + (5 / 6)) */
+    ASSERT_TRUE(expr->kind == AST_BINARY_EXPR && expr->op == AST_BIN_ADD, "Additive operator at the root");
+    const AstNode *quotient = ast_node(unit, expr->value.binary_expr.right);
+    ASSERT_TRUE(quotient->kind == AST_BINARY_EXPR && quotient->op == AST_BIN_DIV, "Division binds tighter");
+
+    const AstNode *difference = ast_node(unit, expr->value.binary_expr.left);
+    ASSERT_TRUE(difference->op == AST_BIN_SUB, "Additive operators associate left");
+    const AstNode *remainder = ast_node(unit, difference->value.binary_expr.right);
+    ASSERT_TRUE(remainder->kind == AST_BINARY_EXPR && remainder->op == AST_BIN_MOD, "Modulo binds tighter");
+
+    const AstNode *product = ast_node(unit, remainder->value.binary_expr.left);
+    ASSERT_TRUE(product->kind == AST_BINARY_EXPR && product->op == AST_BIN_MUL,
+                "Multiplicative operators associate left");
+    ASSERT_TRUE(ast_node(unit, product->value.binary_expr.right)->kind == AST_UNARY_EXPR,
+                "Unary minus binds tightest");
+
+    ast_free(unit);
+    return EXIT_SUCCESS;
+}
+
 static int test_parse_parenthesized_expression(void) {
     const char *source = "int main() { return (1 + 2); }";
 
     Parser parser;
     parser_init(&parser, source, strlen(source));
-    AstNode *unit = parser_parse_translation_unit(&parser);
+    AstTranslationUnit *unit = parser_parse_translation_unit(&parser);
 
     ASSERT_TRUE(parser_status(&parser) == PARSER_OK, "Parser should accept parentheses");
 
-    AstNode *func = unit->value.translation_unit.functions[0];
-    AstNode *block = func->value.function_decl.body;
-    ASSERT_TRUE(block && block->kind == AST_BLOCK, "Expect block body");
-    ASSERT_TRUE(block->value.block.statement_count == 1, "Expect one statement");
+    const AstNode *func = ast_node(unit, ast_function(unit, 0));
+    const AstNode *block = ast_node(unit, func->value.function_decl.body);
+    ASSERT_TRUE(block->kind == AST_BLOCK, "Expect block body");
+    ASSERT_TRUE(block->value.block.count == 1, "Expect one statement");
 
-    AstNode *ret = block->value.block.statements[0];
-    AstNode *expr = ret->value.return_stmt.expression;
+    const AstNode *ret = body_statement(unit, 0, 0);
+    const AstNode *expr = ast_node(unit, ret->value.return_stmt);
     ASSERT_TRUE(expr->kind == AST_BINARY_EXPR, "Parentheses should produce binary expr");
 
-    AstNode *left = expr->value.binary_expr.left;
-    AstNode *right = expr->value.binary_expr.right;
+    const AstNode *left = ast_node(unit, expr->value.binary_expr.left);
+    const AstNode *right = ast_node(unit, expr->value.binary_expr.right);
     ASSERT_TRUE(left->kind == AST_NUMBER_LITERAL, "Left child should be number");
     ASSERT_TRUE(right->kind == AST_NUMBER_LITERAL, "Right child should be number");
 
@@ -208,20 +420,20 @@ static int test_parse_unary_expression(void) {
 
     Parser parser;
     parser_init(&parser, source, strlen(source));
-    AstNode *unit = parser_parse_translation_unit(&parser);
+    AstTranslationUnit *unit = parser_parse_translation_unit(&parser);
 
     ASSERT_TRUE(parser_status(&parser) == PARSER_OK, "Parser should accept unary minus");
 
-    AstNode *func = unit->value.translation_unit.functions[0];
-    AstNode *block = func->value.function_decl.body;
-    ASSERT_TRUE(block && block->kind == AST_BLOCK, "Expect block body");
-    ASSERT_TRUE(block->value.block.statement_count == 1, "Expect one statement");
+    const AstNode *func = ast_node(unit, ast_function(unit, 0));
+    const AstNode *block = ast_node(unit, func->value.function_decl.body);
+    ASSERT_TRUE(block->kind == AST_BLOCK, "Expect block body");
+    ASSERT_TRUE(block->value.block.count == 1, "Expect one statement");
 
-    AstNode *ret = block->value.block.statements[0];
-    AstNode *expr = ret->value.return_stmt.expression;
+    const AstNode *ret = body_statement(unit, 0, 0);
+    const AstNode *expr = ast_node(unit, ret->value.return_stmt);
     ASSERT_TRUE(expr->kind == AST_UNARY_EXPR, "Expect unary expr");
-    ASSERT_TRUE(expr->value.unary_expr.op == AST_UNARY_MINUS, "Operator should be minus");
-    ASSERT_TRUE(expr->value.unary_expr.operand->kind == AST_NUMBER_LITERAL, "Operand should be number");
+    ASSERT_TRUE(expr->op == AST_UNARY_MINUS, "Operator should be minus");
+    ASSERT_TRUE(ast_node(unit, expr->value.unary_expr)->kind == AST_NUMBER_LITERAL, "Operand should be number");
 
     ast_free(unit);
     return EXIT_SUCCESS;
@@ -232,30 +444,37 @@ static int test_parse_var_decl_and_assignment(void) {
 
     Parser parser;
     parser_init(&parser, source, strlen(source));
-    AstNode *unit = parser_parse_translation_unit(&parser);
+    AstTranslationUnit *unit = parser_parse_translation_unit(&parser);
 
     ASSERT_TRUE(parser_status(&parser) == PARSER_OK, "Parser should succeed");
 
-    AstNode *func = unit->value.translation_unit.functions[0];
-    AstNode *block = func->value.function_decl.body;
-    ASSERT_TRUE(block && block->kind == AST_BLOCK, "Expect block body");
-    ASSERT_TRUE(block->value.block.statement_count == 3, "Expect three statements");
+    const AstNode *func = ast_node(unit, ast_function(unit, 0));
+    const AstNode *block = ast_node(unit, func->value.function_decl.body);
+    ASSERT_TRUE(block->kind == AST_BLOCK, "Expect block body");
+    ASSERT_TRUE(block->value.block.count == 3, "Expect three statements");
 
-    AstNode *decl = block->value.block.statements[0];
+    const AstNode *decl = body_statement(unit, 0, 0);
     ASSERT_TRUE(decl->kind == AST_VAR_DECL, "First statement should be declaration");
-    ASSERT_TRUE(strncmp(decl->value.var_decl.name.name, "x", 1) == 0, "Var name");
-    ASSERT_TRUE(decl->value.var_decl.initializer &&
-                    decl->value.var_decl.initializer->kind == AST_NUMBER_LITERAL,
+    const AstIdentifier *declared = ast_name(unit, decl->value.var_decl.name);
+    ASSERT_TRUE(strncmp(declared->name, "x", 1) == 0, "Var name");
+    ASSERT_TRUE(decl->value.var_decl.initializer != AST_NODE_NONE &&
+                    ast_node(unit, decl->value.var_decl.initializer)->kind == AST_NUMBER_LITERAL,
                 "Initializer should be literal");
 
-    AstNode *assign = block->value.block.statements[1];
+    const AstNode *assign = body_statement(unit, 0, 1);
     ASSERT_TRUE(assign->kind == AST_ASSIGNMENT, "Second statement should be assignment");
-    ASSERT_TRUE(strncmp(assign->value.assignment.target.name, "x", 1) == 0, "Assignment target");
-    ASSERT_TRUE(assign->value.assignment.value->kind == AST_BINARY_EXPR,
+    const AstIdentifier *target = ast_name(unit, assign->value.assignment.target);
+    ASSERT_TRUE(strncmp(target->name, "x", 1) == 0, "Assignment target");
+    ASSERT_TRUE(ast_node(unit, assign->value.assignment.value)->kind == AST_BINARY_EXPR,
                 "Assignment value should be binary expression");
 
-    AstNode *ret = block->value.block.statements[2];
+    const AstNode *ret = body_statement(unit, 0, 2);
     ASSERT_TRUE(ret->kind == AST_RETURN_STMT, "Third statement should be return");
+    const AstNode *use = ast_node(unit, ret->value.return_stmt);
+    ASSERT_TRUE(declared->symbol != SYMBOL_NONE, "Declared name should be interned");
+    ASSERT_TRUE(target->symbol == declared->symbol, "Assignment target should share the declaration's symbol");
+    ASSERT_TRUE(ast_name(unit, use->value.identifier)->symbol == declared->symbol,
+                "Identifier use should share the declaration's symbol");
 
     ast_free(unit);
     return EXIT_SUCCESS;
@@ -266,7 +485,7 @@ static int test_parse_failure_on_missing_rbrace(void) {
 
     Parser parser;
     parser_init(&parser, source, strlen(source));
-    AstNode *unit = parser_parse_translation_unit(&parser);
+    AstTranslationUnit *unit = parser_parse_translation_unit(&parser);
 
     ASSERT_TRUE(parser_status(&parser) == PARSER_ERROR, "Parser should report error for missing '}'");
     ast_free(unit);
@@ -278,13 +497,65 @@ static int test_parse_failure_on_unexpected_keyword(void) {
 
     Parser parser;
     parser_init(&parser, source, strlen(source));
-    AstNode *unit = parser_parse_translation_unit(&parser);
+    AstTranslationUnit *unit = parser_parse_translation_unit(&parser);
 
     ASSERT_TRUE(parser_status(&parser) == PARSER_ERROR, "Parser should report error on unexpected keyword");
     ast_free(unit);
     return EXIT_SUCCESS;
 }
 
+static int test_parse_builds_flat_pools(void) {
+    const char *source =
+        "int main() { int x = 1; { int y = x + 2; x = y - 3; } return x; }"
+        "int foo() { return 1 + 2 + 3 + 4 + 5 + 6 + 7 + 8; }";
+
+    Parser parser;
+    parser_init(&parser, source, strlen(source));
+    AstTranslationUnit *unit = parser_parse_translation_unit(&parser);
+
+    ASSERT_TRUE(parser_status(&parser) == PARSER_OK, "Parser should succeed");
+    ASSERT_TRUE(sizeof(AstNode) == 12, "Nodes stay 12 bytes whatever their kind");
+    ASSERT_TRUE(unit->nodes[AST_NODE_NONE].kind == AST_NONE, "Slot 0 is the absent node");
+    ASSERT_TRUE(unit->node_count == 34, "One pool entry per node, plus slot 0");
+    ASSERT_TRUE(unit->name_count == 8 && unit->literal_count == 11, "Spellings live in the side pools");
+    /* Inner block (2), main's body (3), foo's body (1), then the functions. */
+    ASSERT_TRUE(unit->child_count == 8, "Every child id is stored once");
+    ASSERT_TRUE(unit->functions.first == 6 && unit->functions.count == 2, "Functions are the last range");
+    ASSERT_TRUE(unit->node_capacity == unit->node_count && unit->child_capacity == unit->child_count,
+                "Pools are trimmed once the unit is complete");
+    ASSERT_TRUE(ast_memory(unit) >= unit->node_count * sizeof(AstNode), "Memory covers the node pool");
+
+    const AstNode *body = ast_node(unit, ast_node(unit, ast_function(unit, 0))->value.function_decl.body);
+    ASSERT_TRUE(body->value.block.count == 3, "Expect three statements");
+    ASSERT_TRUE(body_statement(unit, 0, 1)->kind == AST_BLOCK, "Nested block preserved");
+    ASSERT_TRUE(body_statement(unit, 0, 1)->value.block.first == 0, "Inner block closes first");
+
+    ast_free(unit);
+    return EXIT_SUCCESS;
+}
+
+static int test_parse_many_statements_grows_block(void) {
+    char source[8192];
+    size_t used = (size_t)snprintf(source, sizeof(source), "int main() { int x = 0;");
+    for (int i = 0; i < 200; ++i) {
+        used += (size_t)snprintf(source + used, sizeof(source) - used, " x = x + %d;", i);
+    }
+    snprintf(source + used, sizeof(source) - used, " return x; }");
+
+    Parser parser;
+    parser_init(&parser, source, strlen(source));
+    AstTranslationUnit *unit = parser_parse_translation_unit(&parser);
+
+    ASSERT_TRUE(parser_status(&parser) == PARSER_OK, "Parser should succeed");
+    const AstNode *block = ast_node(unit, ast_node(unit, ast_function(unit, 0))->value.function_decl.body);
+    ASSERT_TRUE(block->value.block.count == 202, "Expect all statements");
+    ASSERT_TRUE(body_statement(unit, 0, 0)->kind == AST_VAR_DECL, "First statement kept after growth");
+    ASSERT_TRUE(body_statement(unit, 0, 201)->kind == AST_RETURN_STMT, "Last statement kept after growth");
+
+    ast_free(unit);
+    return EXIT_SUCCESS;
+}
+
 int main(void) {
     typedef int (*test_fn)(void);
     struct {
@@ -302,9 +573,17 @@ int main(void) {
         {"parse_failure_on_missing_rbrace", test_parse_failure_on_missing_rbrace},
         {"parse_failure_on_unexpected_keyword", test_parse_failure_on_unexpected_keyword},
         {"parse_binary_expression", test_parse_binary_expression},
+        {"parse_multiplicative_precedence", test_parse_multiplicative_precedence},
         {"parse_parenthesized_expression", test_parse_parenthesized_expression},
         {"parse_unary_expression", test_parse_unary_expression},
         {"parse_var_decl_and_assignment", test_parse_var_decl_and_assignment},
+        {"parse_builds_flat_pools", test_parse_builds_flat_pools},
+        {"parse_many_statements_grows_block", test_parse_many_statements_grows_block},
+        {"parse_errors_go_to_diagnostics_stream", test_parse_errors_go_to_diagnostics_stream},
+        {"parse_streaming_matches_prelexed", test_parse_streaming_matches_prelexed},
+        {"parse_functions_in_batches", test_parse_functions_in_batches},
+        {"parse_functions_stops_at_error", test_parse_functions_stops_at_error},
+        {"parse_rejects_non_integer_literal", test_parse_rejects_non_integer_literal},
     };
 
     size_t count = sizeof(tests) / sizeof(tests[0]);
@@ -0,0 +1,280 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "backend/codegen.h"
+#include "backend/peephole.h"
+#include "backend/x86.h"
+#include "frontend/parser.h"
+
+#define ASSERT_TRUE(cond, msg)                                                                   \
+    do {                                                                                          \
+        if (!(cond)) {                                                                            \
+            fprintf(stderr, "Assertion failed: %s (line %d): %s\n", __FILE__, __LINE__, msg);   \
+            return EXIT_FAILURE;                                                                  \
+        }                                                                                         \
+    } while (0)
+
+/* Optimizes `code`, prints it as function `f` into `buffer` and frees it. */
+static size_t optimize_and_print(X86Code *code, PeepholeStats *stats, char *buffer, size_t size) {
+    size_t removed = peephole_optimize(code, stats);
+
+    Emitter out;
+    emitter_init(&out, NULL);
+    x86_print_code(code, "f", 1, &out);
+    size_t length = (out.length < size - 1) ? out.length : size - 1;
+    memcpy(buffer, out.data, length);
+    buffer[length] = '\0';
+    emitter_free(&out);
+    x86_code_free(code);
+    return removed;
+}
+
+static int test_peephole_redundant_move(void) {
+    X86Code code;
+    x86_code_init(&code);
+    x86_emit(&code, X86_MOV, 4, x86_reg(X86_RBX), x86_reg(X86_RBX));
+    x86_emit(&code, X86_MOV, 4, x86_reg(X86_RBX), x86_reg(X86_R12));
+    x86_emit(&code, X86_MOV, 4, x86_reg(X86_R12), x86_reg(X86_RBX));
+    x86_emit(&code, X86_MOV, 4, x86_reg(X86_R12), x86_reg(X86_RAX));
+    x86_emit(&code, X86_RET, 8, x86_none(), x86_none());
+
+    PeepholeStats stats = {{0}};
+    char buffer[256];
+    ASSERT_TRUE(optimize_and_print(&code, &stats, buffer, sizeof(buffer)) == 2, "Two moves removed");
+    ASSERT_TRUE(strcmp(buffer, "    movl %ebx, %r12d\n    movl %r12d, %eax\n    ret\n") == 0, "Expected moves kept");
+    ASSERT_TRUE(stats.hits[PEEPHOLE_REDUNDANT_MOVE] == 2, "Both rewrites counted");
+    return EXIT_SUCCESS;
+}
+
+static int test_peephole_store_load(void) {
+    X86Code code;
+    x86_code_init(&code);
+    x86_emit(&code, X86_MOV, 4, x86_reg(X86_RBX), x86_mem(X86_RBP, -8));
+    x86_emit(&code, X86_MOV, 4, x86_mem(X86_RBP, -8), x86_reg(X86_RBX));
+    x86_emit(&code, X86_MOV, 4, x86_reg(X86_R12), x86_mem(X86_RBP, -12));
+    x86_emit(&code, X86_MOV, 4, x86_mem(X86_RBP, -12), x86_reg(X86_R13));
+    x86_emit(&code, X86_RET, 8, x86_none(), x86_none());
+
+    PeepholeStats stats = {{0}};
+    char buffer[256];
+    optimize_and_print(&code, &stats, buffer, sizeof(buffer));
+    ASSERT_TRUE(strcmp(buffer,
+                       "    movl %ebx, -8(%rbp)\n"
+                       "    movl %r12d, -12(%rbp)\n"
+                       "    movl %r12d, %r13d\n"
+                       "    ret\n") == 0,
+                "Loads should reuse the stored register");
+    ASSERT_TRUE(stats.hits[PEEPHOLE_STORE_LOAD] == 2, "Both loads rewritten");
+    return EXIT_SUCCESS;
+}
+
+static int test_peephole_copy_forward(void) {
+    X86Code code;
+    x86_code_init(&code);
+    x86_emit(&code, X86_MOV, 4, x86_imm(0), x86_reg(X86_RAX));
+    x86_emit(&code, X86_MOV, 4, x86_reg(X86_RAX), x86_mem(X86_RBP, -8));
+    x86_emit(&code, X86_MOV, 4, x86_imm(5), x86_reg(X86_RAX));
+    x86_emit(&code, X86_RET, 8, x86_none(), x86_none());
+
+    PeepholeStats stats = {{0}};
+    char buffer[256];
+    optimize_and_print(&code, &stats, buffer, sizeof(buffer));
+    ASSERT_TRUE(strcmp(buffer, "    movl $0, -8(%rbp)\n    movl $5, %eax\n    ret\n") == 0,
+                "Constant should be stored directly");
+    ASSERT_TRUE(stats.hits[PEEPHOLE_COPY_FORWARD] == 1, "One copy forwarded");
+    ASSERT_TRUE(stats.hits[PEEPHOLE_ZERO_XOR] == 0, "A store of zero stays a move");
+    return EXIT_SUCCESS;
+}
+
+static int test_peephole_keeps_live_temporaries(void) {
+    X86Code code;
+    x86_code_init(&code);
+    x86_emit(&code, X86_MOV, 4, x86_imm(3), x86_reg(X86_RCX));
+    x86_emit(&code, X86_MOV, 4, x86_reg(X86_RCX), x86_mem(X86_RBP, -8));
+    x86_emit(&code, X86_ADD, 4, x86_reg(X86_RCX), x86_reg(X86_RBX));
+    x86_emit(&code, X86_RET, 8, x86_none(), x86_none());
+
+    char buffer[256];
+    ASSERT_TRUE(optimize_and_print(&code, NULL, buffer, sizeof(buffer)) == 0, "Nothing may be removed");
+    ASSERT_TRUE(strstr(buffer, "    movl $3, %ecx\n    movl %ecx, -8(%rbp)\n") != NULL, "Live %ecx kept");
+    return EXIT_SUCCESS;
+}
+
+static int test_peephole_retarget(void) {
+    X86Code code;
+    x86_code_init(&code);
+    x86_emit(&code, X86_MOV, 4, x86_reg(X86_RBX), x86_reg(X86_RAX));
+    x86_emit(&code, X86_ADD, 4, x86_reg(X86_R12), x86_reg(X86_RAX));
+    x86_emit(&code, X86_MOV, 4, x86_reg(X86_RAX), x86_reg(X86_R13));
+    x86_emit(&code, X86_MOV, 4, x86_imm(1), x86_reg(X86_RAX));
+    x86_emit(&code, X86_RET, 8, x86_none(), x86_none());
+
+    PeepholeStats stats = {{0}};
+    char buffer[256];
+    optimize_and_print(&code, &stats, buffer, sizeof(buffer));
+    ASSERT_TRUE(strcmp(buffer, "    movl %ebx, %r13d\n    add %r12d, %r13d\n    movl $1, %eax\n    ret\n") == 0,
+                "Sum should be computed in %r13d");
+    ASSERT_TRUE(stats.hits[PEEPHOLE_RETARGET] == 1, "One retarget");
+    return EXIT_SUCCESS;
+}
+
+static int test_peephole_retarget_renames_addresses(void) {
+    X86Code code;
+    x86_code_init(&code);
+    x86_emit(&code, X86_MOV, 4, x86_reg(X86_R12), x86_reg(X86_RCX));
+    x86_emit(&code, X86_LEA, 4, x86_mem_index(X86_RBX, X86_RCX, 2, 0), x86_reg(X86_RAX));
+    x86_emit(&code, X86_MOV, 4, x86_reg(X86_RCX), x86_reg(X86_R13));
+    x86_emit(&code, X86_RET, 8, x86_none(), x86_none());
+
+    char buffer[256];
+    optimize_and_print(&code, NULL, buffer, sizeof(buffer));
+    ASSERT_TRUE(strcmp(buffer, "    movl %r12d, %r13d\n    lea (%rbx,%r13,2), %eax\n    ret\n") == 0,
+                "The index register should be renamed with the definition");
+
+    /* cltd and idiv read %eax and %edx without naming them. */
+    x86_code_init(&code);
+    x86_emit(&code, X86_MOV, 4, x86_mem(X86_RBP, -8), x86_reg(X86_RAX));
+    x86_emit(&code, X86_CDQ, 4, x86_none(), x86_none());
+    x86_emit(&code, X86_IDIV, 4, x86_reg(X86_RBX), x86_none());
+    x86_emit(&code, X86_MOV, 4, x86_reg(X86_RAX), x86_reg(X86_R12));
+    x86_emit(&code, X86_RET, 8, x86_none(), x86_none());
+    ASSERT_TRUE(optimize_and_print(&code, NULL, buffer, sizeof(buffer)) == 0, "Nothing may be removed");
+    ASSERT_TRUE(strstr(buffer, "    movl -8(%rbp), %eax\n    cltd\n    idiv %ebx\n    movl %eax, %r12d\n") != NULL,
+                "The dividend stays in %eax");
+    return EXIT_SUCCESS;
+}
+
+static int test_peephole_jump_to_next(void) {
+    X86Code code;
+    x86_code_init(&code);
+    x86_emit(&code, X86_JMP, 8, x86_label(2), x86_none());
+    x86_emit(&code, X86_LABEL, 8, x86_label(1), x86_none());
+    x86_emit(&code, X86_LABEL, 8, x86_label(2), x86_none());
+    x86_emit(&code, X86_JMP, 8, x86_label(X86_RETURN_LABEL), x86_none());
+    x86_emit(&code, X86_LABEL, 8, x86_label(3), x86_none());
+    x86_emit(&code, X86_LABEL, 8, x86_label(X86_RETURN_LABEL), x86_none());
+    x86_emit(&code, X86_RET, 8, x86_none(), x86_none());
+
+    PeepholeStats stats = {{0}};
+    char buffer[256];
+    ASSERT_TRUE(optimize_and_print(&code, &stats, buffer, sizeof(buffer)) == 2, "Both jumps removed");
+    ASSERT_TRUE(strcmp(buffer, ".Lf_bb1:\n.Lf_bb2:\n.Lf_bb3:\n.Lf_return:\n    ret\n") == 0, "Only labels remain");
+    ASSERT_TRUE(stats.hits[PEEPHOLE_JUMP_TO_NEXT] == 2, "Both jumps counted");
+    return EXIT_SUCCESS;
+}
+
+static int test_peephole_add_lea(void) {
+    X86Code code;
+    x86_code_init(&code);
+    x86_emit(&code, X86_MOV, 4, x86_reg(X86_RBX), x86_reg(X86_R12));
+    x86_emit(&code, X86_SUB, 4, x86_imm(3), x86_reg(X86_R12));
+    x86_emit(&code, X86_MOV, 4, x86_reg(X86_RBX), x86_reg(X86_R13));
+    x86_emit(&code, X86_ADD, 4, x86_imm(1), x86_reg(X86_R13));
+    x86_emit(&code, X86_JNE, 8, x86_label(1), x86_none());
+    x86_emit(&code, X86_LABEL, 8, x86_label(1), x86_none());
+    x86_emit(&code, X86_RET, 8, x86_none(), x86_none());
+
+    PeepholeStats stats = {{0}};
+    char buffer[256];
+    optimize_and_print(&code, &stats, buffer, sizeof(buffer));
+    ASSERT_TRUE(strstr(buffer, "    lea -3(%rbx), %r12d\n") != NULL, "Subtraction becomes lea");
+    ASSERT_TRUE(strstr(buffer, "    add $1, %r13d\n    jne .Lf_bb1\n") != NULL, "Flags for jne must survive");
+    ASSERT_TRUE(stats.hits[PEEPHOLE_ADD_LEA] == 1, "One lea");
+    return EXIT_SUCCESS;
+}
+
+static int test_peephole_zero_xor(void) {
+    X86Code code;
+    x86_code_init(&code);
+    x86_emit(&code, X86_MOV, 4, x86_imm(0), x86_reg(X86_RBX));
+    x86_emit(&code, X86_MOV, 4, x86_imm(0), x86_reg(X86_RAX));
+    x86_emit(&code, X86_RET, 8, x86_none(), x86_none());
+
+    PeepholeStats stats = {{0}};
+    char buffer[256];
+    optimize_and_print(&code, &stats, buffer, sizeof(buffer));
+    ASSERT_TRUE(strcmp(buffer, "    xor %ebx, %ebx\n    xor %eax, %eax\n    ret\n") == 0, "Zeroing idiom expected");
+    ASSERT_TRUE(stats.hits[PEEPHOLE_ZERO_XOR] == 2, "Both moves rewritten");
+    return EXIT_SUCCESS;
+}
+
+/* Emits `source` at -O`opt_level` into `buffer`, collecting rule hits in `stats`. */
+static int emit_source(const char *source, int opt_level, PeepholeStats *stats, char *buffer, size_t size) {
+    Parser parser;
+    parser_init(&parser, source, strlen(source));
+    AstTranslationUnit *unit = parser_parse_translation_unit(&parser);
+    if (parser_status(&parser) != PARSER_OK) {
+        ast_free(unit);
+        return -1;
+    }
+
+    CodegenOptions options;
+    codegen_options_init(&options);
+    options.opt_level = opt_level;
+    options.peephole_stats = stats;
+
+    FILE *tmp = tmpfile();
+    int status = (tmp && codegen_emit_translation_unit_with_options(unit, tmp, &options) == 0) ? 0 : -1;
+    if (status == 0) {
+        rewind(tmp);
+        size_t read = fread(buffer, 1, size - 1, tmp);
+        buffer[read] = '\0';
+    }
+    if (tmp) {
+        fclose(tmp);
+    }
+    ast_free(unit);
+    return status;
+}
+
+static int test_peephole_runs_at_o1_only(void) {
+    const char *source = "int main() { int a = 0; { int b = a + 1; a = b; } return a; }";
+    char optimized[4096];
+    char plain[4096];
+    PeepholeStats o1 = {{0}};
+    PeepholeStats o0 = {{0}};
+    ASSERT_TRUE(emit_source(source, 1, &o1, optimized, sizeof(optimized)) == 0, "-O1 should succeed");
+    ASSERT_TRUE(emit_source(source, 0, &o0, plain, sizeof(plain)) == 0, "-O0 should succeed");
+
+    size_t hits = 0;
+    for (size_t r = 0; r < PEEPHOLE_RULE_COUNT; ++r) {
+        hits += o1.hits[r];
+        ASSERT_TRUE(o0.hits[r] == 0, "-O0 must not run the peephole");
+    }
+    ASSERT_TRUE(hits > 0, "-O1 should rewrite something");
+    ASSERT_TRUE(strstr(optimized, "    jmp .Lmain_return\n.Lmain_return:\n") == NULL, "Jump to next label removed");
+    ASSERT_TRUE(strstr(plain, "    jmp .Lmain_return\n.Lmain_return:\n") != NULL, "-O0 keeps the jump");
+    return EXIT_SUCCESS;
+}
+
+int main(void) {
+    typedef int (*test_fn)(void);
+    struct {
+        const char *name;
+        test_fn fn;
+    } tests[] = {
+        {"peephole_redundant_move", test_peephole_redundant_move},
+        {"peephole_store_load", test_peephole_store_load},
+        {"peephole_copy_forward", test_peephole_copy_forward},
+        {"peephole_keeps_live_temporaries", test_peephole_keeps_live_temporaries},
+        {"peephole_retarget", test_peephole_retarget},
+        {"peephole_retarget_renames_addresses", test_peephole_retarget_renames_addresses},
+        {"peephole_jump_to_next", test_peephole_jump_to_next},
+        {"peephole_add_lea", test_peephole_add_lea},
+        {"peephole_zero_xor", test_peephole_zero_xor},
+        {"peephole_runs_at_o1_only", test_peephole_runs_at_o1_only},
+    };
+
+    size_t count = sizeof(tests) / sizeof(tests[0]);
+    for (size_t i = 0; i < count; ++i) {
+        int result = tests[i].fn();
+        if (result != EXIT_SUCCESS) {
+            fprintf(stderr, "Test '%s' failed.\n", tests[i].name);
+            return result;
+        }
+    }
+
+    printf("All peephole tests passed (%zu cases).\n", count);
+    return EXIT_SUCCESS;
+}